@@ -14,7 +14,47 @@ namespace lth_util = leatherman::util;
 namespace fs = boost::filesystem;
 
 #ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+
 static const fs::perms FILE_PERMS { fs::owner_read | fs::owner_write | fs::group_read };
+
+// pxp-agent sends SIGTERM to the wrapper when the action exceeds its
+// deadline; forward it to the process group of the executable, then
+// kill it once the termination grace period elapses, so that the exit
+// code is stored before pxp-agent kills the wrapper itself
+static volatile sig_atomic_t child_pid { 0 };
+static volatile sig_atomic_t termination_grace { 0 };
+static volatile sig_atomic_t terminating { 0 };
+
+static void signalChild(int sig)
+{
+    if (child_pid > 0 && kill(-child_pid, sig) != 0)
+        kill(child_pid, sig);
+}
+
+static void onTerminate(int)
+{
+    terminating = 1;
+    signalChild(SIGTERM);
+    if (termination_grace > 0)
+        alarm(static_cast<unsigned int>(termination_grace));
+}
+
+static void onAlarm(int)
+{
+    signalChild(SIGKILL);
+}
+
+static void installSignalHandlers()
+{
+    struct sigaction action {};
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = onTerminate;
+    sigaction(SIGTERM, &action, nullptr);
+    action.sa_handler = onAlarm;
+    sigaction(SIGALRM, &action, nullptr);
+}
 #endif
 
 int main(int argc, char *argv[])
@@ -26,13 +66,28 @@ int main(int argc, char *argv[])
     //    "input": "(string to pass to the executable on stdin)",
     //    "stdout": "(filepath to write stdout to)",
     //    "stderr": "(filepath to write stderr to)",
-    //    "exitcode": "(filepath to write exitcode to)"
+    //    "exitcode": "(filepath to write exitcode to)",
+    //    "termination_grace": (optional; seconds between SIGTERM and SIGKILL)
     // }
     boost::nowide::cin >> std::noskipws;
     std::istream_iterator<char> i_s_i(boost::nowide::cin), end;
     auto params = lth_jc::JsonContainer(std::string { i_s_i, end });
     auto executable = params.get<std::string>("executable");
     int exitcode;
+    std::function<void(size_t)> pid_callback { nullptr };
+
+#ifndef _WIN32
+    if (params.includes("termination_grace")) {
+        termination_grace = params.get<int>("termination_grace");
+        installSignalHandlers();
+        pid_callback = [](size_t pid) {
+            child_pid = static_cast<sig_atomic_t>(pid);
+            // SIGTERM may have arrived before the child was spawned
+            if (terminating)
+                signalChild(SIGTERM);
+        };
+    }
+#endif
 
     try {
         auto exec = lth_exec::execute(
@@ -42,7 +97,7 @@ int main(int argc, char *argv[])
             params.get<std::string>("stdout"),
             params.get<std::string>("stderr"),
             {},       // environment
-            nullptr,  // PID callback
+            pid_callback,
             0,        // timeout
 #ifndef _WIN32
             // Not used on Windows. We instead rely on inherited directory ACLs.
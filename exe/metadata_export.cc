@@ -0,0 +1,88 @@
+// Prints the action metadata stored in the spool as JSON, for
+// debugging; accepts metadata records, the JSON files written by older
+// versions and packed results files, whose output is printed along
+// with the metadata.
+//
+// Usage: pxp-agent-metadata-export <metadata or .pxpr file>...
+
+#include <pxp-agent/metadata_record.hpp>
+#include <pxp-agent/transaction_record.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <boost/nowide/args.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <boost/nowide/iostream.hpp>
+
+#include <iterator>
+#include <string>
+
+namespace lth_jc = leatherman::json_container;
+
+namespace PXPAgent {
+
+static lth_jc::JsonContainer exportPacked(const std::string& data)
+{
+    using TransactionRecord::Segment;
+    auto segments = TransactionRecord::decode(data);
+
+    lth_jc::JsonContainer results {};
+    results.set<lth_jc::JsonContainer>(
+        "metadata", MetadataRecord::decode(segments[Segment::Metadata]));
+    for (const auto& output : { std::make_pair(Segment::Stdout, "stdout"),
+                                std::make_pair(Segment::Stderr, "stderr"),
+                                std::make_pair(Segment::Exitcode, "exitcode") })
+        if (segments.find(output.first) != segments.end())
+            results.set<std::string>(output.second, segments[output.first]);
+    return results;
+}
+
+}  // namespace PXPAgent
+
+static bool exportMetadata(const std::string& file_path)
+{
+    boost::nowide::ifstream file { file_path.c_str(), std::ios::binary };
+    if (!file) {
+        boost::nowide::cerr << file_path << ": failed to open the file\n";
+        return false;
+    }
+
+    std::string data { std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>() };
+
+    try {
+        lth_jc::JsonContainer metadata {};
+        if (PXPAgent::TransactionRecord::isRecord(data)) {
+            metadata = PXPAgent::exportPacked(data);
+        } else if (PXPAgent::MetadataRecord::isRecord(data)) {
+            metadata = PXPAgent::MetadataRecord::decode(data);
+        } else {
+            metadata = lth_jc::JsonContainer { data };
+        }
+        boost::nowide::cout << metadata.toPrettyJson() << "\n";
+        return true;
+    } catch (const PXPAgent::TransactionRecord::Error& e) {
+        boost::nowide::cerr << file_path << ": " << e.what() << "\n";
+    } catch (const PXPAgent::MetadataRecord::Error& e) {
+        boost::nowide::cerr << file_path << ": " << e.what() << "\n";
+    } catch (const lth_jc::data_parse_error& e) {
+        boost::nowide::cerr << file_path << ": invalid JSON: " << e.what() << "\n";
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    boost::nowide::args arg_utf8(argc, argv);
+
+    if (argc < 2) {
+        boost::nowide::cerr << "usage: " << argv[0] << " <metadata or .pxpr file>...\n";
+        return 2;
+    }
+
+    int exit_code { 0 };
+    for (int i = 1; i < argc; i++)
+        if (!exportMetadata(argv[i]))
+            exit_code = 1;
+    return exit_code;
+}
@@ -5,14 +5,22 @@
 
 #include <cpp-pcp-client/protocol/chunks.hpp>      // ParsedChunk
 
+#include <cpp-pcp-client/util/thread.hpp>
+
 #include <leatherman/json_container/json_container.hpp>
 
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <vector>
 
 namespace PXPAgent {
 
+/// The message chunks and the params of a request are immutable and
+/// shared by all the copies of an ActionRequest, so that passing a
+/// request to the thread of a non-blocking action, or to a module,
+/// does not copy its (possibly huge) payload.
 class ActionRequest {
   public:
     struct Error : public std::runtime_error {
@@ -22,6 +30,7 @@ class ActionRequest {
     /// Throws an ActionRequest::Error in case it fails to retrieve
     /// the data chunk from the specified ParsedChunks or in case of
     /// binary data (currently not supported).
+    /// Pass an rvalue to avoid copying the chunks.
     ActionRequest(RequestType type_,
                   PCPClient::ParsedChunks parsed_chunks_);
 
@@ -34,17 +43,36 @@ class ActionRequest {
     const std::string& module() const;
     const std::string& action() const;
     const bool& notifyOutcome() const;
+    /// Seconds the action may run for, as specified by the optional
+    /// "timeout" data entry; 0 means no timeout
+    const unsigned int& timeout() const;
+    /// Encodings of the results accepted by the requester, as listed
+    /// by the optional "result_encodings" data entry
+    const std::vector<std::string>& resultEncodings() const;
+    bool acceptsResultEncoding(const std::string& encoding) const;
     const PCPClient::ParsedChunks& parsedChunks() const;
     const std::string& resultsDir() const;
 
-    // The following accessors perform lazy initialization
     // The params entry is not required; in case it's not included
     // in the request, an empty JsonContainer object is returned
     const leatherman::json_container::JsonContainer& params() const;
+
+    // The following accessors perform lazy initialization
     const std::string& paramsTxt() const;
     const std::string& prettyLabel() const;
 
   private:
+    struct Payload {
+        PCPClient::ParsedChunks parsed_chunks;
+        leatherman::json_container::JsonContainer params;
+
+        // Lazy initialized, by any of the copies of the request
+        mutable PCPClient::Util::mutex params_txt_mutex;
+        mutable std::string params_txt;
+
+        explicit Payload(PCPClient::ParsedChunks&& chunks);
+    };
+
     RequestType type_;
     std::string id_;
     std::string sender_;
@@ -52,18 +80,18 @@ class ActionRequest {
     std::string module_;
     std::string action_;
     bool notify_outcome_;
-    PCPClient::ParsedChunks parsed_chunks_;
+    unsigned int timeout_;
+    std::vector<std::string> result_encodings_;
+    std::shared_ptr<const Payload> payload_;
 
     // Lazy initialized; no setter is available
-    mutable leatherman::json_container::JsonContainer params_;
-    mutable std::string params_txt_;
     mutable std::string pretty_label_;
 
     // This has its own setter - it's not part of request's state
     mutable std::string results_dir_;
 
-    void init();
-    void validateFormat();
+    void init(PCPClient::ParsedChunks&& parsed_chunks);
+    static void validateFormat(const PCPClient::ParsedChunks& parsed_chunks);
 };
 
 }  // namespace PXPAgent
@@ -11,9 +11,12 @@
 
 #include <string>
 #include <stdexcept>
+#include <vector>
 
 namespace PXPAgent {
 
+class ResponseTextBuilder;
+
 class ActionResponse {
   public:
     struct Error : public std::runtime_error {
@@ -52,6 +55,10 @@ class ActionResponse {
     // update the execution_error entry.
     void setBadResultsAndEnd(const std::string& execution_error);
 
+    // Set the resources used by the action processes, as accounted by
+    // their cgroup, in the action metadata.
+    void setResourceUsage(leatherman::json_container::JsonContainer&& usage);
+
     const std::string& prettyRequestLabel() const;
 
     // Returns true if specified JSON object is conform to the
@@ -75,8 +82,45 @@ class ActionResponse {
     leatherman::json_container::JsonContainer
     toJSON(ResponseType response_type) const;
 
+    // Returns the same text as toJSON(response_type).toString(), but
+    // serializes the string entries of the results, including the
+    // action's output, with Util::appendJSONString, without copying
+    // the output into a JSON object.
+    // Throws a PCPClient::JsonContainer::data_key_error in case a
+    // required entry is missing.
+    std::string toJSONString(ResponseType response_type) const;
+
+    // As above, but stops serializing as soon as the text is known to
+    // be larger than max_size bytes. Returns the size of the text, in
+    // that case a lower bound of it, with json_text left incomplete.
+    size_t toJSONString(ResponseType response_type,
+                        size_t max_size,
+                        std::string& json_text) const;
+
+    // As above, but with the results replaced by their gzip compressed
+    // JSON text, in base64, as described for
+    // PXPSchemas::GZIP_RESULTS_ENCODING. Not for RPC errors.
+    // Throws a Util::CompressionError in case of failure.
+    size_t toCompressedJSONString(ResponseType response_type,
+                                  size_t max_size,
+                                  std::string& json_text) const;
+
   private:
     mutable std::string pretty_request_label_;
+
+    // Keys of the results set by setValidResultsAndEnd, so that they
+    // can be serialized without getting a copy of the results first.
+    std::vector<std::string> results_keys_;
+
+    // Returns the results of a status response, without the output
+    // of the action and its resource usage.
+    leatherman::json_container::JsonContainer statusOutputResults() const;
+
+    // Returns true if results_keys_ are the keys of the results.
+    bool resultsKeysAreCurrent() const;
+
+    // Writes the JSON text of the results of the specified response type.
+    void writeResults(ResponseTextBuilder& builder, ResponseType response_type) const;
 };
 
 }  // namespace PXPAgents
@@ -6,21 +6,23 @@
 
 namespace PXPAgent {
 
-enum class ActionStatus { Unknown, Running, Success, Failure, Undetermined };
+enum class ActionStatus { Unknown, Running, Success, Failure, Undetermined, TimedOut };
 
 static const std::map<ActionStatus, std::string> ACTION_STATUS_NAMES {
     { ActionStatus::Unknown, "unknown" },
     { ActionStatus::Running, "running" },
     { ActionStatus::Success, "success" },
     { ActionStatus::Failure, "failure" },
-    { ActionStatus::Undetermined, "undetermined" } };
+    { ActionStatus::Undetermined, "undetermined" },
+    { ActionStatus::TimedOut, "timed_out" } };
 
 static const std::map<std::string, ActionStatus> NAMES_OF_ACTION_STATUS {
     { "unknown", ActionStatus::Unknown },
     { "running", ActionStatus::Running },
     { "success", ActionStatus::Success },
     { "failure", ActionStatus::Failure },
-    { "undetermined", ActionStatus::Undetermined } };
+    { "undetermined", ActionStatus::Undetermined },
+    { "timed_out", ActionStatus::TimedOut } };
 
 }  // namespace PXPAgent
 
@@ -142,6 +142,9 @@ class Configuration
         std::string crl;
         std::string spool_dir;
         std::string spool_dir_purge_ttl;
+        bool spool_dir_pack_results;
+        uint32_t spool_dir_max_size;
+        uint32_t spool_dir_max_transactions;
         std::string modules_config_dir;
         std::string task_cache_dir;
         std::string task_cache_dir_purge_ttl;
@@ -157,6 +160,14 @@ class Configuration
         uint32_t task_download_connect_timeout_s;
         uint32_t task_download_timeout_s;
         uint32_t max_message_size;
+        uint32_t apply_worker_pool_size;
+        std::string apply_fact_cache_ttl;
+        std::string cgroup_parent;
+        uint32_t result_compression_threshold;
+        std::string metrics_file;
+        uint32_t trace_buffer_size;
+        std::string trace_file;
+        uint32_t watchdog_threshold_ms;
     };
 
     /// Reset the HorseWhisperer singleton.
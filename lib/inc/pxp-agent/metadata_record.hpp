@@ -0,0 +1,59 @@
+#ifndef SRC_AGENT_METADATA_RECORD_HPP_
+#define SRC_AGENT_METADATA_RECORD_HPP_
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+// The binary format of the action metadata stored in the spool.
+//
+// A record starts with a fixed header: the "PXPM" magic, the format
+// version, the action status (its ActionStatus value plus one, or 0 if
+// the status is not set or unknown) and the lengths of the start and
+// end timestamps, followed by the timestamps. The metadata entries come
+// next, in their order, each as:
+//  - a type byte (string, bool, or other JSON);
+//  - the key, prefixed by its 16 bit length;
+//  - the value, prefixed by its 64 bit length; strings are stored as
+//    they are, bools as one byte and the other values, such as the
+//    results, as JSON text.
+// Integers are little endian.
+//
+// Purging only needs the status and start time, which are decoded from
+// the first SUMMARY_SIZE bytes, without reading the results.
+namespace MetadataRecord {
+
+struct Error : public std::runtime_error {
+    explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+static const uint8_t VERSION { 1 };
+
+// Maximum size of the header and the timestamps
+static const size_t SUMMARY_SIZE { 8 + 2 * 255 };
+
+struct Summary {
+    // Empty if not set, or if the status is not a known ActionStatus
+    std::string status;
+    std::string start;
+};
+
+// Returns true if the data starts with the record magic, rather than
+// being metadata stored as JSON text by older versions.
+bool isRecord(const std::string& data);
+
+std::string encode(const leatherman::json_container::JsonContainer& metadata);
+
+// Throw an Error if the record is truncated or invalid.
+leatherman::json_container::JsonContainer decode(const std::string& data);
+Summary decodeSummary(const std::string& data);
+
+}  // namespace MetadataRecord
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_METADATA_RECORD_HPP_
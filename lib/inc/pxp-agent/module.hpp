@@ -4,11 +4,13 @@
 #include <pxp-agent/action_response.hpp>
 #include <pxp-agent/action_request.hpp>
 #include <pxp-agent/module_type.hpp>
+#include <pxp-agent/util/structural_schema.hpp>
 
 #include <cpp-pcp-client/validator/validator.hpp>  // Validator
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <map>
 #include <vector>
 #include <string>
 
@@ -60,6 +62,13 @@ class Module {
     /// in the response object's metadata.
     virtual void processOutputAndUpdateMetadata(ActionResponse& response);
 
+    /// Validate the input params of the specified action; throw a
+    /// PCPClient::validation_error in case they are invalid.
+    /// Actions with a structural input schema are validated without
+    /// input_validator_.
+    void validateInput(const std::string& action_name,
+                       const leatherman::json_container::JsonContainer& params) const;
+
     /// Validate the output contained in the ActionResponse instance,
     /// by using the module's 'output' JSON schema. In case of errors,
     /// the response's metadata will be updated ('results_are_valid'
@@ -80,6 +89,15 @@ class Module {
     /// Subclass implementations should throw a ProcessingError in
     /// case it fails to execute the action.
     virtual ActionResponse callAction(const ActionRequest& request) = 0;
+
+    /// Register the input / results schema of an action, named after
+    /// it, both as a structural schema and in the matching validator
+    void registerInputSchema(const Util::StructuralSchema& schema);
+    void registerResultsSchema(const Util::StructuralSchema& schema);
+
+  private:
+    std::map<std::string, Util::StructuralSchema> input_schemas_;
+    std::map<std::string, Util::StructuralSchema> results_schemas_;
 };
 
 }  // namespace PXPAgent
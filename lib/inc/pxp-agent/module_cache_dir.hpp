@@ -3,7 +3,8 @@
 
 #include <cpp-pcp-client/util/thread.hpp>
 #include <leatherman/curl/client.hpp>
-#include <leatherman/json_container/json_container.hpp>
+#include <pxp-agent/util/module_params.hpp>
+#include <pxp-agent/util/trash_dir.hpp>
 #include <boost/filesystem/path.hpp>
 
 namespace PXPAgent {
@@ -22,7 +23,7 @@ namespace PXPAgent {
                                       uint32_t timeout,
                                       leatherman::curl::client& client,
                                       const boost::filesystem::path& cache_dir,
-                                      leatherman::json_container::JsonContainer& file);
+                                      const Util::RemoteFile& file);
 
       boost::filesystem::path downloadFileFromMaster(const std::vector<std::string>& master_uris,
                                                     uint32_t connect_timeout,
@@ -30,8 +31,12 @@ namespace PXPAgent {
                                                     leatherman::curl::client& client,
                                                     const boost::filesystem::path& cache_dir,
                                                     const boost::filesystem::path& destination,
-                                                    const leatherman::json_container::JsonContainer& file);
+                                                    const Util::RemoteFile& file);
 
+      // Removes the cached directories older than the ttl. If no
+      // purge_callback is specified, they are moved to the trash
+      // directory, '<cache_dir>/.trash', and removed in the background,
+      // so that the purge doesn't block createCacheDir().
       unsigned int purgeCache(const std::string& ttl,
                               std::vector<std::string> ongoing_transactions,
                               std::function<void(const std::string& dir_path)> purge_callback);
@@ -45,12 +50,13 @@ namespace PXPAgent {
                                                         uint32_t timeout_s,
                                                         leatherman::curl::client& client,
                                                         const boost::filesystem::path& file_path,
-                                                        const leatherman::json_container::JsonContainer& uri);
+                                                        const Util::RemoteFile& file);
 
-      std::string createUrlEndpoint(const leatherman::json_container::JsonContainer& uri);
+      std::string createUrlEndpoint(const Util::RemoteFile& file);
       std::string calculateSha256(const std::string& path);
       PCPClient::Util::mutex cache_purge_mutex_;
       PCPClient::Util::mutex curl_mutex_;
+      Util::TrashDir trash_;
   };
 }
 #endif
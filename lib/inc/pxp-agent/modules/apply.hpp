@@ -3,12 +3,21 @@
 
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
+#include <pxp-agent/util/apply_worker_pool.hpp>
 #include <pxp-agent/util/bolt_module.hpp>
 #include <pxp-agent/util/purgeable.hpp>
 #include <pxp-agent/module_cache_dir.hpp>
 
 #include <leatherman/locale/locale.hpp>
 
+#include <cpp-pcp-client/util/chrono.hpp>
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <ctime>
+#include <map>
+#include <memory>
+
 namespace PXPAgent {
 namespace Modules {
 
@@ -21,6 +30,8 @@ class Apply : public PXPAgent::Util::BoltModule, public PXPAgent::Util::Purgeabl
               const std::string& key,
               const std::string& crl,
               const std::string& proxy,
+              uint32_t worker_pool_size,
+              const std::string& fact_cache_ttl,
               std::shared_ptr<ModuleCacheDir> module_cache_dir,
               std::shared_ptr<ResultsStorage> storage);
 
@@ -34,7 +45,31 @@ class Apply : public PXPAgent::Util::BoltModule, public PXPAgent::Util::Purgeabl
             std::vector<std::string> ongoing_transactions,
             std::function<void(const std::string& dir_path)> purge_callback = nullptr) override;
 
+    protected:
+        /// Decode the params of the request once, for building the
+        /// command and processing the request
+        ActionResponse callAction(const ActionRequest& request) override;
+
+        /// Return the cached facts of a prep request, if any; process
+        /// the request on a warm worker, if one is available, or fall
+        /// back to running the shim otherwise.
+        void callBlockingAction(const ActionRequest& request,
+                                const Util::CommandObject& command,
+                                ActionResponse& response) override;
+
+        void callNonBlockingAction(const ActionRequest& request,
+                                   const Util::CommandObject& command,
+                                   ActionResponse& response) override;
+
     private:
+      /// The params of a request used by the module
+      struct RequestParams {
+          /// Environment of the plugins; it names the plugin cache dir
+          std::string environment;
+          /// Whether a prep must not return cached facts
+          bool refresh_facts;
+      };
+
       boost::filesystem::path exec_prefix_;
 
       std::vector<std::string> primary_uris_;
@@ -43,6 +78,81 @@ class Apply : public PXPAgent::Util::BoltModule, public PXPAgent::Util::Purgeabl
       std::string key_;
       std::string crl_;
       std::string proxy_;
+
+      std::unique_ptr<Util::ApplyWorkerPool> worker_pool_;
+
+      /// Modification time of the shim copy written last, so that it's
+      /// only read again if it was modified or removed
+      std::time_t ruby_shim_mtime_;
+      PCPClient::Util::mutex ruby_shim_mutex_;
+
+      /// Facts returned by the last prep of an environment; they are
+      /// valid for as long as the server serves the same plugins for
+      /// the environment, for up to fact_cache_ttl_
+      struct CachedFacts {
+          std::string plugin_version;
+          PCPClient::Util::chrono::steady_clock::time_point time;
+          std::string facts;
+      };
+
+      PCPClient::Util::chrono::minutes fact_cache_ttl_;
+      std::map<std::string, CachedFacts> fact_cache_;
+      PCPClient::Util::mutex fact_cache_mutex_;
+
+      static RequestParams decodeParams(const ActionRequest& request);
+
+      Util::CommandObject buildCommandObject(const ActionRequest& request,
+                                             const RequestParams& request_params);
+
+      void processBlockingAction(const ActionRequest& request,
+                                 const RequestParams& request_params,
+                                 const Util::CommandObject& command,
+                                 ActionResponse& response);
+
+      void processNonBlockingAction(const ActionRequest& request,
+                                    const RequestParams& request_params,
+                                    const Util::CommandObject& command,
+                                    ActionResponse& response);
+
+      std::string getWorkerInput(const std::string& environment);
+
+      /// Whether requests can be processed by workers; not if actions
+      /// are executed in their own cgroup
+      bool useWorkers() const;
+
+      /// Return true if the request was processed by a worker, after
+      /// setting the response output; the deadline, if any, is armed
+      /// with the process that executes the request
+      bool runOnWorker(const ActionRequest& request,
+                       const RequestParams& request_params,
+                       const Util::CommandObject& command,
+                       Util::ActionDeadline* deadline,
+                       ActionResponse& response);
+
+      /// The digest of the plugins the cache of the environment was
+      /// last synchronized with; empty if unknown
+      std::string getPluginVersion(const std::string& environment);
+
+      /// Synchronize the plugin cache of the environment of the request
+      /// by running the shim's pluginsync only; return the digest of
+      /// the plugins served for the environment, or empty if unknown
+      std::string syncPlugins(const ActionRequest& request,
+                              const RequestParams& request_params,
+                              const Util::CommandObject& command);
+
+      /// Return true if the facts requested by a prep are cached and
+      /// the plugins served for the environment are unchanged, after
+      /// setting them as the output
+      bool getCachedFacts(const ActionRequest& request,
+                          const RequestParams& request_params,
+                          const Util::CommandObject& command,
+                          ActionOutput& output);
+
+      /// Cache the facts returned by a successful prep; invalidate the
+      /// facts of all environments after an apply
+      void updateFactCache(const ActionRequest& request,
+                           const RequestParams& request_params,
+                           const ActionOutput& output);
 };
 
 }  // namespace Modules
@@ -0,0 +1,25 @@
+#ifndef SRC_MODULES_METRICS_H_
+#define SRC_MODULES_METRICS_H_
+
+#include <pxp-agent/module.hpp>
+#include <pxp-agent/action_response.hpp>
+
+namespace PXPAgent {
+namespace Modules {
+
+/// Reports the metrics of Util::Metrics::Registry; the results of the
+/// 'metrics' action map the name and labels of each series, in the
+/// Prometheus format, to its current value. The 'trace' action returns
+/// the spans recorded by Util::Trace in the Chrome trace event format.
+class Metrics : public PXPAgent::Module {
+  public:
+    Metrics();
+
+  private:
+    ActionResponse callAction(const ActionRequest& request) override;
+};
+
+}  // namespace Modules
+}  // namespace PXPAgent
+
+#endif  // SRC_MODULES_METRICS_H_
@@ -7,6 +7,7 @@
 #include <pxp-agent/results_storage.hpp>
 #include <pxp-agent/util/purgeable.hpp>
 #include <pxp-agent/util/bolt_module.hpp>
+#include <pxp-agent/util/module_params.hpp>
 
 #include <leatherman/curl/client.hpp>
 #include <set>
@@ -50,11 +51,11 @@ class Task : public PXPAgent::Util::BoltModule, public PXPAgent::Util::Purgeable
 
     leatherman::curl::client client_;
 
-    boost::filesystem::path downloadMultiFile(std::vector<leatherman::json_container::JsonContainer> const& files,
+    boost::filesystem::path downloadMultiFile(std::vector<Util::RemoteFile> const& files,
         std::set<std::string> const& download_set,
         boost::filesystem::path const& spool_dir);
 
-    leatherman::json_container::JsonContainer selectLibFile(std::vector<leatherman::json_container::JsonContainer> const& files,
+    Util::RemoteFile const& selectLibFile(std::vector<Util::RemoteFile> const& files,
         std::string const& file_name);
 
     Util::CommandObject buildCommandObject(const ActionRequest& request) override;
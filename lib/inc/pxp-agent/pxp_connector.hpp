@@ -32,16 +32,27 @@ class PXPConnector {
     // Asserts that the ActionResponse arg has all needed entries.
     virtual void sendPXPError(const ActionResponse& response) = 0;
 
+    // The following send the response data serialized by
+    // ActionResponse::toJSONString, as json_text, so that it's not
+    // serialized again; compressed_results tells whether it was
+    // serialized by ActionResponse::toCompressedJSONString instead.
+
     // Asserts that the ActionResponse arg has all needed entries.
     virtual void sendBlockingResponse(const ActionResponse& response,
-                                      const ActionRequest& request) = 0;
+                                      const ActionRequest& request,
+                                      const std::string& json_text,
+                                      bool compressed_results) = 0;
 
     // Asserts that the ActionResponse arg has all needed entries.
     virtual void sendStatusResponse(const ActionResponse& response,
-                                    const ActionRequest& request) = 0;
+                                    const ActionRequest& request,
+                                    const std::string& json_text,
+                                    bool compressed_results) = 0;
 
     // Asserts that the ActionResponse arg has all needed entries.
-    virtual void sendNonBlockingResponse(const ActionResponse& response) = 0;
+    virtual void sendNonBlockingResponse(const ActionResponse& response,
+                                         const std::string& json_text,
+                                         bool compressed_results) = 0;
 
     virtual void sendProvisionalResponse(const ActionRequest& request) = 0;
 
@@ -29,14 +29,20 @@ class PXPConnectorV1 : public PCPClient::v1::Connector, public PXPConnector {
 
     // Asserts that the ActionResponse arg has all needed entries.
     void sendBlockingResponse(const ActionResponse& response,
-                              const ActionRequest& request) override;
+                              const ActionRequest& request,
+                              const std::string& json_text,
+                              bool compressed_results) override;
 
     // Asserts that the ActionResponse arg has all needed entries.
     void sendStatusResponse(const ActionResponse& response,
-                            const ActionRequest& request) override;
+                            const ActionRequest& request,
+                            const std::string& json_text,
+                            bool compressed_results) override;
 
     // Asserts that the ActionResponse arg has all needed entries.
-    void sendNonBlockingResponse(const ActionResponse& response) override;
+    void sendNonBlockingResponse(const ActionResponse& response,
+                                 const std::string& json_text,
+                                 bool compressed_results) override;
 
     void connect(int max_connect_attempts = 0) override;
 
@@ -51,7 +57,8 @@ class PXPConnectorV1 : public PCPClient::v1::Connector, public PXPConnector {
 
     void sendBlockingResponse_(const ActionResponse::ResponseType& response_type,
                                const ActionResponse& response,
-                               const ActionRequest& request);
+                               const ActionRequest& request,
+                               const std::string& json_text);
 };
 
 }  // namespace PXPAgent
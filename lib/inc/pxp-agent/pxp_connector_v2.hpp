@@ -27,14 +27,20 @@ class PXPConnectorV2 : public PCPClient::v2::Connector, public PXPConnector {
 
     // Asserts that the ActionResponse arg has all needed entries.
     void sendBlockingResponse(const ActionResponse& response,
-                              const ActionRequest& request) override;
+                              const ActionRequest& request,
+                              const std::string& json_text,
+                              bool compressed_results) override;
 
     // Asserts that the ActionResponse arg has all needed entries.
     void sendStatusResponse(const ActionResponse& response,
-                            const ActionRequest& request) override;
+                            const ActionRequest& request,
+                            const std::string& json_text,
+                            bool compressed_results) override;
 
     // Asserts that the ActionResponse arg has all needed entries.
-    void sendNonBlockingResponse(const ActionResponse& response) override;
+    void sendNonBlockingResponse(const ActionResponse& response,
+                                 const std::string& json_text,
+                                 bool compressed_results) override;
 
     void connect(int max_connect_attempts = 0) override;
 
@@ -45,9 +51,8 @@ class PXPConnectorV2 : public PCPClient::v2::Connector, public PXPConnector {
                                  MessageCallback callback) override;
 
   private:
-    void sendBlockingResponse_(const ActionResponse::ResponseType& response_type,
-                               const ActionResponse& response,
-                               const ActionRequest& request);
+    void sendBlockingResponse_(const ActionRequest& request,
+                               const leatherman::json_container::JsonContainer& response_data);
 };
 
 }  // namespace PXPAgent
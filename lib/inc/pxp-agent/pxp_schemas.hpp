@@ -25,6 +25,13 @@ PCPClient::Schema NonBlockingRequestSchema();
 PCPClient::Schema NonBlockingResponseSchema();
 PCPClient::Schema ProvisionalResponseSchema();
 
+// Encoding of compressed results; requests accept it by listing it
+// in their optional result_encodings entry. The results of responses
+// are then replaced, when large, by an object with the gzip compressed
+// JSON text of the results, in base64, as "content", and the encoding
+// as "content_encoding".
+static const std::string GZIP_RESULTS_ENCODING { "gzip+base64" };
+
 // PXP error
 static const std::string PXP_ERROR_MSG_TYPE {
     "http://puppetlabs.com/rpc_error_message" };
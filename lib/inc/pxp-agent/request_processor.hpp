@@ -8,13 +8,18 @@
 #include <pxp-agent/pxp_connector.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/util/metrics.hpp>
 
 #include <cpp-pcp-client/util/thread.hpp>
 
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace PXPAgent {
@@ -68,6 +73,15 @@ class RequestProcessor {
     /// specified module
     std::string getModuleConfig(const std::string& module_name) const;
 
+    /// Metrics of the requests of an action; they are registered for
+    /// all the loaded actions when starting, so that they're updated
+    /// without locking
+    struct ActionMetrics {
+        Util::Metrics::Counter* requests;
+        Util::Metrics::Counter* failures;
+        Util::Metrics::Histogram* duration;
+    };
+
   private:
     /// Manages the lifecycle of non-blocking action jobs
     ThreadContainer thread_container_;
@@ -102,11 +116,33 @@ class RequestProcessor {
 
     /// Flag; set to true if the dtor has been called
     bool is_destructing_;
+
+    /// Flag; set to true when the results exceed the spool dir quotas,
+    /// to purge them without waiting for the next scheduled purge
+    bool spool_pressure_;
     const uint32_t max_message_size_;
 
+    /// Size above which the results of responses are compressed, when
+    /// the requester accepts it
+    const uint32_t result_compression_threshold_;
+
     /// Resources to purge
     std::vector<std::shared_ptr<Util::Purgeable>> purgeables_;
 
+    /// Metrics of each action, by module and action name
+    std::map<std::pair<std::string, std::string>, ActionMetrics> action_metrics_;
+
+    /// File where the metrics are periodically written, if any, and
+    /// the thread writing it; the thread uses purge_mutex_ and
+    /// purge_cond_var_ to be stopped
+    const std::string metrics_file_;
+    std::unique_ptr<PCPClient::Util::thread> metrics_thread_ptr_;
+
+    /// Size of the task cache, returned by its gauge; gauges are
+    /// sampled with the registry locked, so the cache is walked by
+    /// refreshTaskCacheSize instead
+    std::atomic<uint64_t> task_cache_bytes_;
+
     /// Throw a RequestProcessor::Error in case of unknown module,
     /// unknown action, or if the requested input parameters entry
     /// does not match the JSON schema defined for the relevant action
@@ -114,7 +150,7 @@ class RequestProcessor {
 
     void processBlockingRequest(const ActionRequest& request);
 
-    void processNonBlockingRequest(const ActionRequest& request);
+    void processNonBlockingRequest(const std::shared_ptr<const ActionRequest>& request_ptr);
 
     // Provides the status of the task performed for a non-blocking
     // request by processing the results data from the spool dir.
@@ -128,6 +164,12 @@ class RequestProcessor {
     /// Load the modules configuration files
     void loadModulesConfiguration();
 
+    /// Set the limits and the timeout specified by the action_limits
+    /// and action_timeout entries of the configuration of a module,
+    /// then remove the entries
+    void loadActionSettings(const std::string& module_name,
+                            leatherman::json_container::JsonContainer& config_json);
+
     /// Register module in the module map
     void registerModule(std::shared_ptr<Module>);
 
@@ -143,8 +185,23 @@ class RequestProcessor {
     /// Log the loaded modules
     void logLoadedModules() const;
 
+    /// Register the metrics of the loaded actions and the gauges
+    /// sampling the state of the agent
+    void registerMetrics();
+
+    /// Metrics of the action of a validated request
+    const ActionMetrics& actionMetrics(const ActionRequest& request) const;
+
+    /// Write the metrics file every minute
+    void metricsExportTask();
+
+    /// Walk the task cache to update task_cache_bytes_; called by the
+    /// metrics export and purge tasks
+    void refreshTaskCacheSize();
+
     /// Purge task for resources that need to purge e.g. directories; the purge
-    /// call will be triggered min("1h", gcd(TTLS))
+    /// call will be triggered when the task starts, then every min("1h", gcd(TTLS)).
+    /// The spool dir is also purged whenever its quotas are exceeded
     void purgeTask();
 };
 
@@ -2,23 +2,38 @@
 #define SRC_AGENT_RESULTS_STORAGE_HPP_
 
 #include <pxp-agent/action_output.hpp>
+#include <pxp-agent/metadata_record.hpp>
+#include <pxp-agent/time.hpp>
+#include <pxp-agent/transaction_record.hpp>
 #include <pxp-agent/util/purgeable.hpp>
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
 #include <vector>
 #include <string>
 #include <stdexcept>
-#include <functional>  // std::function
+#include <functional>  // std::function, std::greater
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace PXPAgent {
 
 // NOTE(ale): possible execptions thrown while inspecting files are
 // propagated by ResultsStorage methods (more specifically, errors
 // raised by boost::filesystem::exists() are not filtered).
+//
+// The results of each transaction are stored in a results directory
+// named after its transaction ID. If results packing is enabled, the
+// results directory of a completed transaction is then replaced by a
+// single TransactionRecord file, '<transaction_id>.pxpr'; the methods
+// below work with both layouts.
 class ResultsStorage final : public PXPAgent::Util::Purgeable {
   public:
     struct Error : public std::runtime_error {
@@ -26,14 +41,26 @@ class ResultsStorage final : public PXPAgent::Util::Purgeable {
     };
 
     ResultsStorage() = delete;
-    ResultsStorage(std::string spool_dir, std::string spool_dir_ttl);
+    ResultsStorage(std::string spool_dir,
+                   std::string spool_dir_ttl,
+                   bool pack_results = false);
     ResultsStorage(const ResultsStorage&) = delete;
     ResultsStorage& operator=(const ResultsStorage&) = delete;
 
-    // Returns true if a results directory for the specified
-    // transaction exists, false otherwise.
+    // Returns true if a results directory or a packed results file
+    // for the specified transaction exists, false otherwise.
     bool find(const std::string& transaction_id);
 
+    // Returns true if the results of the transaction are packed.
+    bool isPacked(const std::string& transaction_id);
+
+    // If results packing is enabled, replaces the results directory
+    // of the transaction by a packed results file; does nothing if
+    // the action is still running.
+    // Throws an Error in case it fails to read the results or to
+    // write the packed file.
+    void packResults(const std::string& transaction_id);
+
     // Initializes the metadata file for the specified transaction.
     // Creates the results directory if necessary.
     // Throws an Error in case it fails to create the directory or
@@ -50,19 +77,28 @@ class ResultsStorage final : public PXPAgent::Util::Purgeable {
         const leatherman::json_container::JsonContainer& metadata);
 
     // Returns the action metadata specified by the transaction.
+    // The metadata file is either a MetadataRecord or, if written by
+    // an older version, JSON text.
     // Throws an Error in case:
     //  - the metadata file does not exist;
     //  - the function fails to read the content of the metadata file;
-    //  - the content of the metadata file is not valid JSON;
-    //  - the metadata does not comply with its JSON schema.
+    //  - the record is invalid or the content is not valid JSON;
+    //  - the JSON metadata does not comply with its JSON schema.
     leatherman::json_container::JsonContainer
     getActionMetadata(const std::string& transaction_id);
 
+    // Returns the status and start time of the action, reading only
+    // the header of its metadata record.
+    // Throws an Error in the above cases or if the status or start
+    // time are missing.
+    MetadataRecord::Summary
+    getActionSummary(const std::string& transaction_id);
+
     // Returns true if the PID file for the specified transaction
     // exists, false otherwise.
     bool pidFileExists(const std::string& transaction_id);
 
-    // Returns the PID.
+    // Returns the PID; packed results have no PID file.
     // Throws an error in case:
     //  - there's no PID file for the specified transaction;
     //  - it fails to read a valid integer PID.
@@ -82,9 +118,36 @@ class ResultsStorage final : public PXPAgent::Util::Purgeable {
     ActionOutput getOutput(const std::string& transaction_id,
                            int exitcode);
 
+    // Limits the total size and number of the results of completed
+    // actions; 0 means no limit. The usage is updated as actions
+    // complete and their results are purged, and is known once purge()
+    // has been called. When a limit is exceeded, on_pressure is called
+    // (with an internal lock held, so it must not call ResultsStorage)
+    // and the next purge() removes the oldest results until the usage
+    // is below 90% of the limits, regardless of their ttl.
+    void setQuotas(uint64_t max_bytes,
+                   uint32_t max_transactions,
+                   std::function<void()> on_pressure);
+
+    struct Usage {
+        uint64_t bytes;
+        size_t transactions;
+    };
+
+    // Returns the size and number of the results of the completed
+    // actions accounted for the quotas
+    Usage getUsage();
+
     // Cleans up the spool directory by removing the results
-    // directories that are older than the specified ttl and skipping
-    // the directories related to ongoing tasks.
+    // directories and packed results that are older than the
+    // specified ttl (unless its value is 0) or that exceed the quotas,
+    // and skipping the ones related to ongoing tasks.
+    // If results packing is enabled, the results directories of the
+    // other completed transactions are packed.
+    // The first call inspects the whole spool directory and indexes
+    // the completed transactions by their start time, as do metadata
+    // updates; the following calls only inspect the expired entries
+    // of the index.
     // This function is not thread safe.
     // If a purge_callback is not specified, the boost filesystem's
     // remove_all() will be used.
@@ -94,10 +157,73 @@ class ResultsStorage final : public PXPAgent::Util::Purgeable {
         std::function<void(const std::string& dir_path)> purge_callback = nullptr) override;
 
   private:
+    struct ExpiryEntry {
+        boost::posix_time::ptime start;
+        std::string transaction_id;
+
+        bool operator>(const ExpiryEntry& other) const
+        {
+            return start > other.start;
+        }
+    };
+
     boost::filesystem::path spool_dir_path_;
+    bool pack_results_;
+
+    // Min-heap of the completed transactions, by start time; it may
+    // hold stale or duplicate entries, which are checked when popped
+    std::priority_queue<ExpiryEntry,
+                        std::vector<ExpiryEntry>,
+                        std::greater<ExpiryEntry>> expiry_index_;
+    bool expiry_index_ready_;
+    PCPClient::Util::mutex expiry_index_mutex_;
+
+    // Size of the results of the indexed transactions; also guarded
+    // by expiry_index_mutex_
+    std::unordered_map<std::string, uint64_t> usage_;
+    uint64_t usage_bytes_;
+    uint64_t max_bytes_;
+    uint32_t max_transactions_;
+    std::function<void()> on_pressure_;
+    bool pressure_signalled_;
+
+    // Whether the usage exceeds the quotas or, if low_watermark is
+    // set, 90% of them; requires expiry_index_mutex_
+    bool exceedsQuotas(bool low_watermark) const;
+
+    uint64_t resultsSize(const std::string& transaction_id);
+
+    // Adds the transaction to the expiry index if its metadata is final
+    void indexExpiry(const std::string& transaction_id,
+                     const leatherman::json_container::JsonContainer& metadata);
+
+    void indexExpiry(const std::string& transaction_id,
+                     boost::posix_time::ptime start);
+
+    bool removeResults(const std::string& transaction_id,
+                       std::function<void(const std::string& dir_path)>& purge_callback);
+
+    unsigned int purgeAll_(Timestamp& ts,
+                           bool ttl_enabled,
+                           const std::unordered_set<std::string>& ongoing_transactions,
+                           std::function<void(const std::string& dir_path)>& purge_callback);
+
+    unsigned int purgeOverQuotas_(const std::unordered_set<std::string>& ongoing_transactions,
+                                  std::function<void(const std::string& dir_path)>& purge_callback);
+
+    unsigned int purgeExpired_(Timestamp& ts,
+                               const std::unordered_set<std::string>& ongoing_transactions,
+                               std::function<void(const std::string& dir_path)>& purge_callback);
+
+    boost::filesystem::path packedPath(const std::string& transaction_id) const;
+
+    TransactionRecord::Segments readPacked(const std::string& transaction_id);
 
     ActionOutput getOutput_(const std::string& transaction_id,
                             bool get_exitcode);
+
+    ActionOutput getDirectoryOutput_(const std::string& transaction_id,
+                                     bool get_exitcode);
 };
 
 }  // namespace PXPAgent
@@ -74,6 +74,10 @@ class ThreadContainer {
 
     uint32_t getNumAddedThreads() const;
     uint32_t getNumErasedThreads() const;
+
+    /// Return the number of stored threads that have not completed
+    uint32_t getNumRunningThreads() const;
+
     std::vector<std::string> getThreadNames() const;
 
     void setName(const std::string& name);
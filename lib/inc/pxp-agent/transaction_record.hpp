@@ -0,0 +1,53 @@
+#ifndef SRC_AGENT_TRANSACTION_RECORD_HPP_
+#define SRC_AGENT_TRANSACTION_RECORD_HPP_
+
+#include <pxp-agent/metadata_record.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+// The format of the files that store the results of completed
+// transactions in a packed spool, in place of their results
+// directories.
+//
+// A record starts with the "PXPT" magic and the format version,
+// followed by segments, each made of a type byte and the segment data,
+// prefixed by its 64 bit little endian length. The metadata segment,
+// a MetadataRecord, comes first, so that the summary of the action can
+// be decoded from the first SUMMARY_SIZE bytes.
+namespace TransactionRecord {
+
+struct Error : public std::runtime_error {
+    explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+static const uint8_t VERSION { 1 };
+
+enum class Segment : uint8_t { Metadata = 1, Stdout, Stderr, Exitcode };
+
+using Segments = std::map<Segment, std::string>;
+
+// Size of the record header and of the header of the first segment
+static const size_t HEADER_SIZE { 5 + 9 };
+
+static const size_t SUMMARY_SIZE { HEADER_SIZE + MetadataRecord::SUMMARY_SIZE };
+
+bool isRecord(const std::string& data);
+
+// The segments are stored in the order of their types; the metadata
+// segment is required
+std::string encode(const Segments& segments);
+
+// Throw an Error if the record is truncated or invalid
+Segments decode(const std::string& data);
+MetadataRecord::Summary decodeSummary(const std::string& data);
+
+}  // namespace TransactionRecord
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_TRANSACTION_RECORD_HPP_
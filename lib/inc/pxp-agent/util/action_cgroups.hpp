@@ -0,0 +1,111 @@
+#ifndef SRC_UTIL_ACTION_CGROUPS_HPP_
+#define SRC_UTIL_ACTION_CGROUPS_HPP_
+
+#include <pxp-agent/action_request.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Values of the cgroup v2 interface files (cpu.weight, memory.max
+/// and io.weight) set for the cgroup of each action of a module
+using ActionLimits = std::map<std::string, std::string>;
+
+/// The cgroup v2 leaf that contains the processes of an action.
+/// The cgroup is removed on destruction, unless it still contains
+/// processes.
+class ActionCGroup {
+  public:
+    ActionCGroup() = delete;
+    ActionCGroup(const ActionCGroup&) = delete;
+    ActionCGroup& operator=(const ActionCGroup&) = delete;
+
+    explicit ActionCGroup(boost::filesystem::path path);
+
+    ~ActionCGroup();
+
+    const boost::filesystem::path& path() const;
+
+    /// Rewrite the specified command so that its process moves itself
+    /// into the cgroup before executing the command, by means of a
+    /// shell; none of the processes of the command can then start
+    /// outside the cgroup. The command is executed in any case.
+    /// The command is left unchanged if the executable can't be
+    /// found, so that executing it fails as it would otherwise.
+    void attachBeforeExec(std::string& executable,
+                          std::vector<std::string>& arguments) const;
+
+    /// Return the resources used by the processes of the cgroup:
+    /// CPU time (cpu_time_ms), peak memory (memory_peak_kb), and
+    /// I/O (io_read_kb, io_write_kb). Entries whose accounting is
+    /// not available are omitted.
+    leatherman::json_container::JsonContainer getUsage() const;
+
+  private:
+    boost::filesystem::path path_;
+};
+
+/// Creates a cgroup v2 leaf for each action under a parent cgroup, so
+/// that actions don't share the cgroup of pxp-agent and can be
+/// limited per module. Accessed as a singleton, like ResultsMutex.
+class ActionCGroups {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    static ActionCGroups& Instance() {
+        static ActionCGroups instance {};
+        return instance;
+    }
+
+    /// Return the limits specified by the "action_limits" entry of a
+    /// module configuration file; throw an Error in case of unknown
+    /// interface files or values that are neither strings nor
+    /// integers.
+    static ActionLimits parseLimits(const leatherman::json_container::JsonContainer& limits);
+
+    /// Create action cgroups under parent_dir, which must be a cgroup
+    /// v2 directory that pxp-agent can manage and that does not
+    /// contain the pxp-agent process itself. Enable the cpu, memory
+    /// and io controllers for its children, if possible, and remove
+    /// empty cgroups left by a previous run.
+    /// Throw an Error in case parent_dir is not a cgroup v2 directory
+    /// or cgroups are not supported on this platform.
+    void configure(const std::string& parent_dir);
+
+    void setModuleLimits(const std::string& module_name, ActionLimits limits);
+
+    bool enabled() const;
+
+    /// Return the cgroup for the specified request, after applying
+    /// the limits of its module, or nullptr in case cgroups are not
+    /// enabled or the cgroup cannot be created (errors are logged).
+    std::unique_ptr<ActionCGroup> create(const ActionRequest& request);
+
+    /// Disable cgroups and clear module limits; useful for testing
+    void reset();
+
+  private:
+    boost::filesystem::path parent_dir_;
+    std::map<std::string, ActionLimits> module_limits_;
+    mutable PCPClient::Util::mutex mutex_;
+
+    ActionCGroups() = default;
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_ACTION_CGROUPS_HPP_
@@ -0,0 +1,107 @@
+#ifndef SRC_UTIL_ACTION_DEADLINES_HPP_
+#define SRC_UTIL_ACTION_DEADLINES_HPP_
+
+#include <pxp-agent/action_request.hpp>
+#include <pxp-agent/action_response.hpp>
+#include <pxp-agent/util/timer_wheel.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+/// The deadline of a running action. Once armed with the PID of the
+/// action process, the process group is sent SIGTERM when the timeout
+/// elapses and SIGKILL if it is still running after the grace period
+/// (on Windows, the process is terminated when the timeout elapses).
+/// The timers are cancelled on destruction.
+class ActionDeadline {
+  public:
+    ActionDeadline() = delete;
+    ActionDeadline(const ActionDeadline&) = delete;
+    ActionDeadline& operator=(const ActionDeadline&) = delete;
+
+    ActionDeadline(TimerWheel& wheel,
+                   PCPClient::Util::chrono::milliseconds timeout,
+                   PCPClient::Util::chrono::milliseconds grace_period);
+
+    ~ActionDeadline();
+
+    /// Return a pid callback that arms the deadline before calling
+    /// pid_callback, if any. The deadline must be armed once.
+    std::function<void(size_t)> arming(std::function<void(size_t)> pid_callback);
+
+    /// Whether the action process was terminated by the deadline
+    bool expired() const;
+
+    PCPClient::Util::chrono::milliseconds timeout() const;
+
+    PCPClient::Util::chrono::milliseconds gracePeriod() const;
+
+    /// In case the deadline expired, mark the response as timed out,
+    /// reporting the timeout as execution error; call it after the
+    /// output of the action has been processed.
+    void updateResponse(ActionResponse& response) const;
+
+  private:
+    // Shared with the timer callbacks, which may run after destruction;
+    // the callbacks hold the mutex while checking done and signalling
+    struct State {
+        std::atomic<int> pid { 0 };
+        std::atomic<bool> expired { false };
+        bool done { false };
+        PCPClient::Util::mutex mutex;
+    };
+
+    TimerWheel& wheel_;
+    PCPClient::Util::chrono::milliseconds timeout_;
+    PCPClient::Util::chrono::milliseconds grace_period_;
+    std::shared_ptr<State> state_;
+    TimerWheel::TimerId term_timer_;
+    TimerWheel::TimerId kill_timer_;
+};
+
+/// Creates the deadlines of actions, from the "timeout" of requests and
+/// the "action_timeout" of module configuration files, all enforced by
+/// a single timer wheel. Accessed as a singleton, like ResultsMutex.
+class ActionDeadlines {
+  public:
+    /// Seconds between SIGTERM and SIGKILL
+    static const unsigned int KILL_GRACE_S;
+
+    static ActionDeadlines& Instance() {
+        static ActionDeadlines instance {};
+        return instance;
+    }
+
+    /// Set the timeout, in seconds, of the actions of the specified
+    /// module; 0 means no timeout
+    void setModuleTimeout(const std::string& module_name, unsigned int timeout_s);
+
+    /// Return the deadline of the specified request, which is the
+    /// shortest between the request and module timeouts, or nullptr
+    /// in case neither is set.
+    std::unique_ptr<ActionDeadline> create(const ActionRequest& request);
+
+    /// Clear module timeouts; useful for testing
+    void reset();
+
+  private:
+    std::map<std::string, unsigned int> module_timeouts_;
+    std::unique_ptr<TimerWheel> wheel_ptr_;
+    PCPClient::Util::mutex mutex_;
+
+    ActionDeadlines() = default;
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_ACTION_DEADLINES_HPP_
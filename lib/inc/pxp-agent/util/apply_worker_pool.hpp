@@ -0,0 +1,130 @@
+#ifndef SRC_UTIL_APPLY_WORKER_POOL_HPP_
+#define SRC_UTIL_APPLY_WORKER_POOL_HPP_
+
+#include <pxp-agent/action_output.hpp>
+#include <pxp-agent/util/bolt_module.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Pool of pre-initialised Puppet processes, one per environment,
+/// used by the apply module to avoid booting Ruby, loading Puppet
+/// and initialising its settings for every apply / prep request.
+///
+/// Workers run the apply shim in worker mode; each one listens on a
+/// local socket and forks a child process for every request it
+/// receives, so that requests don't share any Puppet state. A
+/// worker processes one request at a time; a request for a busy
+/// environment is not queued, the caller is instead expected to
+/// fall back to running the shim directly.
+///
+/// Workers are not supported on Windows; there the pool is always
+/// disabled.
+class ApplyWorkerPool {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    ApplyWorkerPool() = delete;
+    ApplyWorkerPool(const ApplyWorkerPool&) = delete;
+    ApplyWorkerPool& operator=(const ApplyWorkerPool&) = delete;
+
+    /// The pool is disabled if max_workers is 0. Sockets and worker
+    /// logs are stored in workers_dir.
+    ApplyWorkerPool(uint32_t max_workers,
+                    boost::filesystem::path workers_dir,
+                    uint32_t idle_timeout_s);
+
+    /// Stop all workers.
+    ~ApplyWorkerPool();
+
+    bool enabled() const;
+
+    /// Process the specified shim input on the warm worker of the
+    /// specified environment and return true, after setting the
+    /// output. The PID of the process that executes the request is
+    /// passed to pid_callback, if any.
+    ///
+    /// Return false, without processing the request, in case no idle
+    /// worker is ready for the environment; in that case, if the
+    /// pool has capacity, a worker is started in the background by
+    /// using the specified shim command and worker_input, which
+    /// contains the settings used to initialize Puppet.
+    ///
+    /// Throw an ApplyWorkerPool::Error in case the worker failed
+    /// after accepting the request; as the request may have been
+    /// partially processed, it should not be retried.
+    bool run(const std::string& environment,
+             const CommandObject& shim_command,
+             const std::string& worker_input,
+             const std::string& input,
+             ActionOutput& output,
+             std::function<void(size_t)> pid_callback = nullptr);
+
+  private:
+    struct Worker;
+
+    std::atomic<uint32_t> max_workers_;
+    boost::filesystem::path workers_dir_;
+    uint32_t idle_timeout_s_;
+
+    /// Used to name sockets; paths of Unix domain sockets are short
+    uint32_t worker_counter_;
+
+    std::map<std::string, std::shared_ptr<Worker>> workers_;
+
+    /// Evicted workers, until their thread is joined
+    std::vector<std::shared_ptr<Worker>> stopped_workers_;
+    PCPClient::Util::mutex workers_mutex_;
+
+    /// Return a worker for the environment that is ready to accept
+    /// a request and flag it as busy, or nullptr otherwise. Start a
+    /// worker, if necessary and possible.
+    /// Must be called while holding workers_mutex_.
+    std::shared_ptr<Worker> acquireWorker(const std::string& environment,
+                                          const CommandObject& shim_command,
+                                          const std::string& worker_input);
+
+    /// Start a worker process on a dedicated thread that waits for
+    /// it to exit.
+    /// Must be called while holding workers_mutex_.
+    void startWorker(const std::string& environment,
+                     const CommandObject& shim_command,
+                     const std::string& worker_input);
+
+    /// Remove the workers whose process exited and join their thread.
+    /// Must be called while holding workers_mutex_.
+    void reapWorkers();
+
+    /// Stop the least recently used idle worker; return false if
+    /// all workers are busy. Its thread is joined by reapWorkers or by
+    /// the destructor.
+    /// Must be called while holding workers_mutex_.
+    bool evictWorker();
+
+    /// Ask the worker process to exit; a worker whose process is not
+    /// started yet is stopped as soon as it starts.
+    static void stopWorker(Worker& worker);
+
+    /// Remove the socket and the output files of the worker.
+    static void removeWorkerFiles(const Worker& worker);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_APPLY_WORKER_POOL_HPP_
@@ -5,6 +5,8 @@
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/module_cache_dir.hpp>
 #include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/util/action_cgroups.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
 
 #include <leatherman/execution/execution.hpp>
 
@@ -54,11 +56,16 @@ class BoltModule : public PXPAgent::Module {
         std::shared_ptr<ResultsStorage> storage_;
         std::shared_ptr<ModuleCacheDir> module_cache_dir_;
 
-        // Execute a CommandObject synchronously
-        virtual leatherman::execution::result run_sync(const CommandObject &cmd);
+        // Execute a CommandObject synchronously; its process moves
+        // itself to the specified cgroup, if any, before executing the
+        // command
+        virtual leatherman::execution::result run_sync(const CommandObject &cmd,
+                                                       const ActionCGroup* cgroup = nullptr);
 
-        // Execute a CommandObject asynchronously, spawning a new process
-        virtual leatherman::execution::result run(const CommandObject &cmd);
+        // Execute a CommandObject asynchronously, spawning a new
+        // process; see run_sync for the cgroup
+        virtual leatherman::execution::result run(const CommandObject &cmd,
+                                                  const ActionCGroup* cgroup = nullptr);
 
         virtual void callBlockingAction(
                 const ActionRequest& request,
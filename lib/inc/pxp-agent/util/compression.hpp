@@ -0,0 +1,30 @@
+#ifndef SRC_UTIL_COMPRESSION_HPP_
+#define SRC_UTIL_COMPRESSION_HPP_
+
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+    struct CompressionError : public std::runtime_error {
+        explicit CompressionError(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// Compress the data in the gzip format (RFC 1952), with zlib.
+    /// Throws a CompressionError in case of failure.
+    std::string gzipCompress(const std::string& data);
+
+    /// Decompress gzip data; throws a CompressionError if the data is
+    /// not in the gzip format or is truncated.
+    std::string gzipDecompress(const std::string& data);
+
+    /// Encode the data in standard base64 (RFC 4648), with padding.
+    std::string base64Encode(const std::string& data);
+
+    /// Decode standard base64, with padding; throws a CompressionError
+    /// if the text is not valid base64.
+    std::string base64Decode(const std::string& text);
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_COMPRESSION_HPP_
@@ -0,0 +1,31 @@
+#ifndef SRC_UTIL_JSON_ESCAPE_HPP_
+#define SRC_UTIL_JSON_ESCAPE_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+    /// Implementations of the JSON string escaping; the vectorised ones
+    /// are available on x86 CPUs that support the instruction set.
+    enum class JSONEscaper { Scalar, SSE2, AVX2 };
+
+    /// Whether the CPU supports the specified implementation
+    bool supportsJSONEscaper(JSONEscaper escaper);
+
+    /// Append the data to out as a quoted JSON string, escaping it as
+    /// rapidjson does (quotes, backslashes and control characters; the
+    /// other bytes, including UTF-8 sequences, are copied as they are).
+    /// Runs of bytes that need no escaping are found with the fastest
+    /// implementation supported by the CPU and appended in bulk.
+    void appendJSONString(std::string& out, const char* data, size_t size);
+    void appendJSONString(std::string& out, const std::string& s);
+
+    /// Escape with the specified implementation, which must be
+    /// supported by the CPU; useful for testing and benchmarking
+    void appendJSONString(std::string& out, const char* data, size_t size,
+                          JSONEscaper escaper);
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_JSON_ESCAPE_HPP_
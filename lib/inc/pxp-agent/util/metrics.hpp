@@ -0,0 +1,168 @@
+#ifndef SRC_UTIL_METRICS_HPP_
+#define SRC_UTIL_METRICS_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+namespace Metrics {
+
+struct Error : public std::runtime_error {
+    explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+/// Label names and values of a series, e.g. {{"module", "echo"}}
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+/// Number of slots the counters are split into; each thread updates
+/// the slot it was assigned, so that concurrent updates seldom contend
+static const size_t NUM_SHARDS { 16 };
+
+/// Monotonic counter. add() is lock-free and, being a relaxed atomic
+/// increment of a cache line that is mostly updated by the calling
+/// thread only, cheap enough for hot paths; value() sums the slots.
+class Counter {
+  public:
+    Counter();
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    void add(uint64_t n = 1);
+    uint64_t value() const;
+
+  private:
+    struct Shard {
+        std::atomic<uint64_t> value;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    // The shards start at the first cache line boundary of the buffer,
+    // as new doesn't align them
+    std::unique_ptr<char[]> buffer_;
+    Shard* shards_;
+};
+
+/// Distribution of the observed values over fixed buckets, with the
+/// same update cost as Counter. The sum of the values is kept in
+/// millionths.
+class Histogram {
+  public:
+    /// Buckets for durations in seconds, from 5 ms to 1 h; a function,
+    /// so that histograms can be created by static initializers
+    static const std::vector<double>& durationBounds();
+
+    struct Snapshot {
+        /// Cumulative count of each bucket, the last one being +Inf
+        std::vector<uint64_t> buckets;
+        uint64_t count;
+        double sum;
+    };
+
+    /// The upper bounds of the buckets must be sorted
+    explicit Histogram(std::vector<double> bounds = durationBounds());
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void observe(double value);
+    Snapshot snapshot() const;
+    const std::vector<double>& bounds() const { return bounds_; }
+
+  private:
+    std::vector<double> bounds_;
+    // Per shard: the count of each bucket, then the sum; padded to
+    // a multiple of 64 bytes
+    size_t stride_;
+    // As for Counter, the slots start at a cache line boundary
+    std::unique_ptr<char[]> buffer_;
+    std::atomic<uint64_t>* slots_;
+};
+
+struct Sample {
+    std::string name;
+    Labels labels;
+    double value;
+};
+
+struct Family {
+    std::string name;
+    std::string help;
+    std::string type;  // "counter", "gauge" or "histogram"
+    std::vector<Sample> samples;
+};
+
+/// Process-wide set of metrics. Counters and histograms are created on
+/// first use and live as long as the process, so callers can keep the
+/// returned references and update them without locking the registry.
+/// Gauges are sampled by calling the registered function when the
+/// metrics are collected.
+class Registry {
+  public:
+    static Registry& Instance();
+
+    /// Return the counter / histogram with the specified name and
+    /// labels, creating it if needed. Throw an Error if a metric with
+    /// the same name but a different type exists.
+    Counter& counter(const std::string& name,
+                     const std::string& help,
+                     const Labels& labels = {});
+    Histogram& histogram(const std::string& name,
+                         const std::string& help,
+                         const Labels& labels = {},
+                         const std::vector<double>& bounds = Histogram::durationBounds());
+
+    /// Register or replace the function sampling a gauge; it's called
+    /// without the registry locked, but it must not collect the metrics
+    /// nor remove gauges. Once removeGauge returns, the function it
+    /// removed is no longer being called.
+    void setGauge(const std::string& name,
+                  const std::string& help,
+                  std::function<double()> sample);
+    void removeGauge(const std::string& name);
+
+    /// Return the current value of all metrics, sorted by name;
+    /// histograms are expanded in _bucket, _sum and _count samples
+    std::vector<Family> collect() const;
+
+  private:
+    struct Entry {
+        std::string help;
+        std::string type;
+        std::map<Labels, std::unique_ptr<Counter>> counters;
+        std::map<Labels, std::unique_ptr<Histogram>> histograms;
+        std::function<double()> gauge;
+    };
+
+    std::map<std::string, Entry> entries_;
+    mutable PCPClient::Util::mutex mutex_;
+    // Held while collecting, before mutex_, so that removeGauge waits
+    // for the gauges being sampled
+    mutable PCPClient::Util::mutex gauges_mutex_;
+
+    Registry() = default;
+    Entry& entry(const std::string& name,
+                 const std::string& help,
+                 const std::string& type);
+};
+
+/// Name and labels of the sample in the Prometheus format,
+/// e.g. 'requests_total{module="echo"}'
+std::string seriesName(const Sample& sample);
+
+/// Render the metrics in the Prometheus text exposition format
+std::string toPrometheusText(const std::vector<Family>& families);
+
+}  // namespace Metrics
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_METRICS_HPP_
@@ -0,0 +1,97 @@
+#ifndef SRC_UTIL_MODULE_PARAMS_HPP_
+#define SRC_UTIL_MODULE_PARAMS_HPP_
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+// Input params of the internal modules, decoded from the request params
+// in a single pass, so that modules do not look entries up by key.
+// The decode functions throw a Module::ProcessingError in case an entry
+// has the wrong type or a required entry is missing; the params are
+// expected to be validated beforehand against the module input schema.
+
+/// A file served by the primary, as specified by the "files" entries of
+/// task and file requests and by the "script" entry of script requests
+struct RemoteFile {
+    std::string filename;
+    std::string sha256;
+    std::string uri_path;
+    // Query parameters of the URI, in request order
+    std::vector<std::pair<std::string, std::string>> uri_params;
+
+    static RemoteFile decode(const leatherman::json_container::JsonContainer& file);
+};
+
+struct TaskParams {
+    struct Implementation {
+        std::string name;
+        std::string input_method;
+        std::vector<std::string> requirements;
+        std::vector<std::string> files;
+    };
+
+    std::string task;
+    std::vector<RemoteFile> files;
+    leatherman::json_container::JsonContainer input;
+
+    // Task metadata; in case the request has no "metadata" entry,
+    // these are taken from the params themselves
+    std::string input_method;
+    std::vector<std::string> features;
+    std::vector<Implementation> implementations;
+    std::vector<std::string> metadata_files;
+
+    static TaskParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+struct ScriptParams {
+    RemoteFile script;
+    std::vector<std::string> arguments;
+
+    static ScriptParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+struct FileParams {
+    struct Entry {
+        RemoteFile source;
+        std::string destination;
+        std::string link_source;
+        std::string kind;
+    };
+
+    std::vector<Entry> files;
+
+    static FileParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+struct CommandParams {
+    std::string command;
+
+    static CommandParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+struct ApplyParams {
+    // Environment of the catalog; the catalog itself is passed through
+    // to the shim as part of the serialized params
+    std::string environment;
+
+    static ApplyParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+struct PrepParams {
+    std::string environment;
+    bool refresh_facts;
+
+    static PrepParams decode(const leatherman::json_container::JsonContainer& params);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_MODULE_PARAMS_HPP_
@@ -7,6 +7,13 @@ namespace Util {
 bool processExists(int pid);
 int getPid();
 
+// Asks the process group led by pid to terminate (SIGTERM) or, if
+// force is set, kills it (SIGKILL); actions are started in their own
+// group (create_detached_process), so that the processes they spawn
+// are signalled as well. On Windows, the process is terminated.
+// Returns false if the group could not be signalled.
+bool terminateProcessGroup(int pid, bool force);
+
 }  // namespace Util
 }  // namespace PXPAgent
 
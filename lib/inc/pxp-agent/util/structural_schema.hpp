@@ -0,0 +1,71 @@
+#ifndef SRC_UTIL_STRUCTURAL_SCHEMA_HPP_
+#define SRC_UTIL_STRUCTURAL_SCHEMA_HPP_
+
+#include <cpp-pcp-client/validator/schema.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Schema of a JSON object, specified by the type of its entries,
+/// whether they are required and, for objects, their own schema;
+/// entries that are not constrained are allowed.
+///
+/// Constraints are stored in a flat list, so that checking a document
+/// costs a type lookup per constrained entry and never walks the
+/// unconstrained content (e.g. the catalog of an apply request), as
+/// opposed to PCPClient::Validator, which runs a generic JSON schema
+/// engine on every validation. The constraints mirror the ones of
+/// PCPClient::Schema; toSchema() returns the equivalent Schema.
+class StructuralSchema {
+  public:
+    explicit StructuralSchema(std::string name);
+
+    void addConstraint(std::string field,
+                       PCPClient::TypeConstraint type = PCPClient::TypeConstraint::Any,
+                       bool required = false);
+
+    /// The field must be an object matching sub_schema
+    void addConstraint(std::string field,
+                       const StructuralSchema& sub_schema,
+                       bool required = false);
+
+    const std::string& getName() const;
+
+    PCPClient::Schema toSchema() const;
+
+    /// Return true if data, or its entry at the specified path, is an
+    /// object that satisfies the constraints; the entry is not copied
+    bool matches(const leatherman::json_container::JsonContainer& data,
+                 const std::vector<leatherman::json_container::JsonContainerKey>& path = {}) const;
+
+    /// Throw a PCPClient::validation_error if data does not match
+    void validate(const leatherman::json_container::JsonContainer& data,
+                  const std::vector<leatherman::json_container::JsonContainerKey>& path = {}) const;
+
+  private:
+    struct Constraint {
+        std::string field;
+        PCPClient::TypeConstraint type;
+        bool required;
+        std::shared_ptr<const StructuralSchema> sub_schema;
+    };
+
+    std::string name_;
+    std::vector<Constraint> constraints_;
+
+    // Return the first violated constraint of the object at path, or
+    // an empty string
+    std::string check(const leatherman::json_container::JsonContainer& data,
+                      const std::vector<leatherman::json_container::JsonContainerKey>& path) const;
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_STRUCTURAL_SCHEMA_HPP_
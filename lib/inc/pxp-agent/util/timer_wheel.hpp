@@ -0,0 +1,75 @@
+#ifndef SRC_UTIL_TIMER_WHEEL_HPP_
+#define SRC_UTIL_TIMER_WHEEL_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Hashed timer wheel; a single thread advances the wheel by one slot
+/// per tick and executes the callbacks of the expired timers, so that
+/// scheduling and cancelling a timer are O(1), regardless of the number
+/// of pending timers.
+///
+/// Timers fire on the first tick after their delay elapsed; callbacks
+/// are executed on the wheel thread, without holding any lock, and
+/// must not block.
+class TimerWheel {
+  public:
+    using TimerId = uint64_t;
+
+    TimerWheel() = delete;
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerWheel(PCPClient::Util::chrono::milliseconds tick, size_t num_slots);
+
+    /// Stop the wheel thread; pending timers are discarded
+    ~TimerWheel();
+
+    /// Schedule callback to be executed after delay.
+    TimerId schedule(PCPClient::Util::chrono::milliseconds delay,
+                     std::function<void()> callback);
+
+    /// Return false in case the timer already fired or was cancelled.
+    bool cancel(TimerId timer_id);
+
+    size_t pending() const;
+
+  private:
+    struct Timer {
+        TimerId id;
+        uint64_t rounds;
+        std::function<void()> callback;
+    };
+
+    using Slot = std::list<Timer>;
+
+    const PCPClient::Util::chrono::milliseconds tick_;
+    std::vector<Slot> slots_;
+    size_t current_slot_;
+    TimerId next_id_;
+
+    /// Locates the pending timers, to cancel them
+    std::unordered_map<TimerId, std::pair<size_t, Slot::iterator>> timers_;
+
+    bool stopping_;
+    mutable PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+    std::unique_ptr<PCPClient::Util::thread> thread_ptr_;
+
+    void run();
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_TIMER_WHEEL_HPP_
@@ -0,0 +1,146 @@
+#ifndef SRC_UTIL_TRACE_HPP_
+#define SRC_UTIL_TRACE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+namespace Trace {
+
+struct Error : public std::runtime_error {
+    explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+/// Ring buffer of the most recent spans, i.e. the stages of the
+/// processing of requests. Recording a span is lock-free: the writer
+/// claims a slot with an atomic increment and guards its update with
+/// the slot's sequence number, which readers check to skip the slots
+/// being written (a seqlock). When the ring wraps around while a slot
+/// is still being written, the newer span is dropped.
+class Tracer {
+  public:
+    /// The capacity is rounded up to a power of 2
+    explicit Tracer(size_t capacity);
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+    ~Tracer();
+
+    /// The stage must be a string literal, or otherwise outlive the
+    /// tracer; transaction IDs are truncated to 48 characters
+    void record(const char* stage,
+                const std::string& transaction_id,
+                int64_t start_us,
+                int64_t end_us);
+
+    size_t capacity() const { return mask_ + 1; }
+
+    /// Number of spans dropped since the tracer was created
+    uint64_t numDropped() const;
+
+    /// The recorded spans in the Chrome trace event format, as complete
+    /// ("X") events with the transaction ID in their args; it can be
+    /// loaded in chrome://tracing or https://ui.perfetto.dev
+    std::string toChromeTrace() const;
+
+  private:
+    struct Slot;
+
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_;
+    std::atomic<uint64_t> num_dropped_;
+};
+
+/// Enable tracing with a process-wide tracer of the specified capacity;
+/// calls after the first one have no effect
+void enable(size_t capacity);
+
+/// Whether tracing is enabled; checking it costs an atomic load
+bool isEnabled();
+
+/// Time from a steady clock, in microseconds
+int64_t now();
+
+/// Record a span that ends now, if tracing is enabled
+void record(const char* stage, const std::string& transaction_id, int64_t start_us);
+
+/// Record a span, if tracing is enabled
+void record(const char* stage,
+            const std::string& transaction_id,
+            int64_t start_us,
+            int64_t end_us);
+
+/// The spans of the process-wide tracer in the Chrome trace event
+/// format; with no events if tracing is disabled
+std::string toChromeTrace();
+
+/// Write toChromeTrace() to the specified file; throw an Error on
+/// failure
+void dumpChromeTrace(const std::string& file_path);
+
+/// Dump the trace to the specified file whenever pxp-agent receives
+/// SIGUSR1; the dump is done by a thread, not in the signal handler.
+/// Not supported on Windows, where the trace can only be obtained with
+/// the 'trace' action of the 'metrics' module.
+void installDumpSignalHandler(const std::string& file_path);
+
+/// Records the span from its construction to its destruction, or to
+/// the first call to end(); the transaction ID is referenced, so it
+/// must outlive the span
+class Span {
+  public:
+    Span(const char* stage, const std::string& transaction_id)
+            : stage_ { stage },
+              transaction_id_ ( transaction_id ),
+              start_us_ { isEnabled() ? now() : 0 } {}
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+    ~Span() { end(); }
+
+    void end() {
+        if (start_us_ != 0)
+            record(stage_, transaction_id_, start_us_);
+        start_us_ = 0;
+    }
+
+  private:
+    const char* stage_;
+    const std::string& transaction_id_;
+    int64_t start_us_;
+};
+
+/// Records the 'child_spawn' span, from construction to the call of
+/// the pid callback of the child process, and the 'child_run' span,
+/// from then to the first call to end(); like Span, it references the
+/// transaction ID
+class ChildSpans {
+  public:
+    explicit ChildSpans(const std::string& transaction_id);
+    ChildSpans(const ChildSpans&) = delete;
+    ChildSpans& operator=(const ChildSpans&) = delete;
+    ~ChildSpans() { end(); }
+
+    /// Return a pid callback that calls pid_callback, if any, and
+    /// then records the spawn; pid_callback itself if tracing is
+    /// disabled. It must be called before end().
+    std::function<void(size_t)> spawning(std::function<void(size_t)> pid_callback);
+
+    void end();
+
+  private:
+    const std::string& transaction_id_;
+    int64_t start_us_;
+    int64_t spawned_us_;
+};
+
+}  // namespace Trace
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_TRACE_HPP_
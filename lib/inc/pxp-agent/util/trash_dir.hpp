@@ -0,0 +1,77 @@
+#ifndef SRC_UTIL_TRASH_DIR_HPP_
+#define SRC_UTIL_TRASH_DIR_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Removes directories in the background: they are first renamed into
+/// the trash directory, which is cheap and atomic, then removed by a
+/// thread that runs with the lowest CPU and I/O priorities (on Linux)
+/// and that throttles its removals, so that purging large directories
+/// doesn't compete with actions.
+/// The trash directory must be on the same file system as the
+/// directories moved into it; whatever is left in it is removed the
+/// next time it's emptied.
+class TrashDir {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// Default number of files and directories removed per second
+    static const uint32_t DEFAULT_REMOVALS_PER_S;
+
+    TrashDir() = delete;
+    TrashDir(const TrashDir&) = delete;
+    TrashDir& operator=(const TrashDir&) = delete;
+    explicit TrashDir(boost::filesystem::path trash_dir,
+                      uint32_t removals_per_s = DEFAULT_REMOVALS_PER_S);
+
+    /// Stops the removal thread, leaving what's left in the trash
+    ~TrashDir();
+
+    const boost::filesystem::path& path() const { return trash_dir_; }
+
+    /// Atomically moves the file or directory into the trash; it will
+    /// be removed once the trash is emptied.
+    /// Throws an Error if it fails to create the trash directory or to
+    /// rename the path.
+    void moveToTrash(const boost::filesystem::path& path);
+
+    /// Wakes up the removal thread, starting it if necessary, to remove
+    /// the content of the trash; does not block.
+    void empty();
+
+  private:
+    const boost::filesystem::path trash_dir_;
+    const uint32_t removals_per_s_;
+    uint32_t num_removals_;
+    // Prefixes the names in the trash, as a previous instance may have
+    // left entries named after its own counter
+    const std::string instance_id_;
+    uint64_t num_moved_;
+    bool pending_;
+    bool is_destructing_;
+    std::unique_ptr<PCPClient::Util::thread> thread_ptr_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+
+    void removalTask();
+
+    // Returns false if interrupted by the dtor
+    bool removeThrottled(const boost::filesystem::path& path);
+};
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_TRASH_DIR_HPP_
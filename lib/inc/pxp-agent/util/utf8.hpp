@@ -1,9 +1,28 @@
 #ifndef SRC_UTIL_UTF8_HPP_
 #define SRC_UTIL_UTF8_HPP_
 
+#include <cstddef>
+#include <string>
+
 namespace PXPAgent {
 namespace Util {
-    bool isValidUTF8(std::string &s);
+    /// Implementations of the UTF-8 validation; the vectorised ones are
+    /// available on x86 CPUs that support the instruction set.
+    enum class UTF8Validator { Scalar, SSE4, AVX2 };
+
+    /// Whether the CPU supports the specified implementation
+    bool supportsUTF8Validator(UTF8Validator validator);
+
+    /// Return true if the data is valid UTF-8, as per RFC 3629 (no
+    /// overlong encodings, surrogates or code points above U+10FFFF).
+    /// The fastest implementation supported by the CPU is used; the
+    /// data is not modified.
+    bool isValidUTF8(const char* data, size_t size);
+    bool isValidUTF8(const std::string& s);
+
+    /// Validate with the specified implementation, which must be
+    /// supported by the CPU; useful for testing and benchmarking
+    bool isValidUTF8(const char* data, size_t size, UTF8Validator validator);
 }  // namespace Util
 }  // namespace PXPAgent
 
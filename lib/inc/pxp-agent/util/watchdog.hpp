@@ -0,0 +1,158 @@
+#ifndef SRC_UTIL_WATCHDOG_HPP_
+#define SRC_UTIL_WATCHDOG_HPP_
+
+#include <pxp-agent/util/metrics.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+namespace Watchdog {
+
+struct Error : public std::runtime_error {
+    explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+};
+
+#ifdef _WIN32
+using ThreadHandle = unsigned long;
+#else
+using ThreadHandle = pthread_t;
+#endif
+
+/// A thread, or a pool of threads, executing units of work; e.g. the
+/// thread running the PCP message callbacks. The watchdog tracks:
+///  - the busy time of each unit of work, see Busy; a unit lasting
+///    longer than the threshold is a stall, reported once by the
+///    watchdog thread, with a stack sample of the stalled thread;
+///  - the dispatch lag, i.e. the delay between the time a unit of
+///    work was due, or queued, and the time it started.
+/// Busy units of work of an executor must not overlap, so that an
+/// executor backed by a pool can only track its dispatch lag.
+class Executor {
+  public:
+    /// The consequence of a stall, appended to its warning
+    Executor(const std::string& name, const std::string& stall_consequence);
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    const std::string& name() const { return name_; }
+
+    /// Record the lag of a unit of work starting now; warn and count a
+    /// stall if it exceeds the threshold
+    void recordLag(PCPClient::Util::chrono::steady_clock::time_point due);
+
+    /// Number of stalls and late units of work so far
+    uint64_t numStalls() const { return stalls_.value(); }
+
+  private:
+    friend class Busy;
+    friend class Waiting;
+    friend void checkExecutors();
+
+    const std::string name_;
+    const std::string stall_consequence_;
+    Metrics::Histogram& busy_duration_;
+    Metrics::Histogram& lag_;
+    Metrics::Counter& stalls_;
+
+    // Guards the fields of the current unit of work; the watchdog
+    // signals the stalled thread with it locked, so that the thread
+    // cannot exit in the meantime
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::chrono::steady_clock::time_point busy_since_;
+    bool is_busy_;
+    bool is_waiting_;
+    PCPClient::Util::chrono::steady_clock::time_point waiting_since_;
+    uint64_t activity_;
+    uint64_t reported_activity_;
+    ThreadHandle thread_;
+};
+
+/// Return the executor with the specified name, creating it if needed;
+/// like metrics, executors live as long as the process
+Executor& executor(const std::string& name,
+                   const std::string& stall_consequence = "");
+
+/// Start the watchdog thread, which checks the executors for stalls
+/// four times per threshold, and install the stack sampler; calls
+/// after the first one only change the threshold. Throw an Error if
+/// the stack sampler cannot be installed; the watchdog runs anyway.
+void enable(uint32_t threshold_ms);
+
+/// Stop the watchdog thread
+void disable();
+
+/// Whether the watchdog is enabled; checking it costs an atomic load
+bool isEnabled();
+
+uint32_t thresholdMs();
+
+/// Check the executors once, reporting the new stalls; done by the
+/// watchdog thread
+void checkExecutors();
+
+/// Marks the calling thread as busy with a unit of work of the
+/// executor, from its construction to its destruction, if the
+/// watchdog is enabled
+class Busy {
+  public:
+    explicit Busy(Executor& executor);
+    Busy(const Busy&) = delete;
+    Busy& operator=(const Busy&) = delete;
+    ~Busy();
+
+  private:
+    Executor* executor_;
+    uint64_t activity_;
+};
+
+/// Excludes the time the calling thread spends waiting, e.g. for the
+/// process of a blocking action, from its current unit of work of the
+/// executor, from its construction to its destruction; the wait is
+/// neither reported as a stall nor counted in the busy time. Must be
+/// used by the thread that is busy with the executor, if any.
+class Waiting {
+  public:
+    explicit Waiting(Executor& executor);
+    Waiting(const Waiting&) = delete;
+    Waiting& operator=(const Waiting&) = delete;
+    ~Waiting();
+
+  private:
+    Executor* executor_;
+};
+
+//
+// Stack sampling; platform specific
+//
+
+ThreadHandle currentThread();
+
+/// Prepare the sampling of stacks; throw an Error on failure
+void installStackSampler();
+
+/// Ask the thread to sample its stack; the thread must not exit
+/// before the call returns. Return false if it could not be asked, or
+/// if the sample requested last is still pending after its collection
+/// timed out.
+bool requestStackSample(ThreadHandle thread);
+
+/// Wait for the stack sample requested last, for up to a second, and
+/// return its frames; an empty vector if none was taken
+std::vector<std::string> collectStackSample();
+
+}  // namespace Watchdog
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_UTIL_WATCHDOG_HPP_
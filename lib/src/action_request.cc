@@ -1,25 +1,36 @@
 #include <pxp-agent/action_request.hpp>
+#include <pxp-agent/util/trace.hpp>
 
 #include <leatherman/locale/locale.hpp>
 
+#include <algorithm>
+
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.action_request"
 #include <leatherman/logging/logging.hpp>
 
 namespace PXPAgent {
 
-namespace lth_jc  = leatherman::json_container;
-namespace lth_loc = leatherman::locale;
+namespace lth_jc   = leatherman::json_container;
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+ActionRequest::Payload::Payload(PCPClient::ParsedChunks&& chunks)
+        : parsed_chunks { std::move(chunks) },
+          params { "{}" },
+          params_txt_mutex {},
+          params_txt {} {
+}
 
 ActionRequest::ActionRequest(RequestType type,
                              PCPClient::ParsedChunks parsed_chunks)
         : type_ { type },
           notify_outcome_ { true },
-          parsed_chunks_ { std::move(parsed_chunks) },
-          params_ { "{}" },
-          params_txt_ {},
+          timeout_ { 0 },
+          result_encodings_ {},
+          payload_ {},
           pretty_label_ {},
           results_dir_ {} {
-    init();
+    init(std::move(parsed_chunks));
 }
 
 void ActionRequest::setResultsDir(const std::string& results_dir) const {
@@ -33,25 +44,32 @@ const std::string& ActionRequest::transactionId() const { return transaction_id_
 const std::string& ActionRequest::module() const { return module_; }
 const std::string& ActionRequest::action() const { return action_; }
 const bool& ActionRequest::notifyOutcome() const { return notify_outcome_; }
+const unsigned int& ActionRequest::timeout() const { return timeout_; }
+const std::vector<std::string>& ActionRequest::resultEncodings() const {
+    return result_encodings_;
+}
+
+bool ActionRequest::acceptsResultEncoding(const std::string& encoding) const {
+    return std::find(result_encodings_.begin(), result_encodings_.end(), encoding)
+           != result_encodings_.end();
+}
 
 const PCPClient::ParsedChunks& ActionRequest::parsedChunks() const {
-    return parsed_chunks_;
+    return payload_->parsed_chunks;
 }
 
 const std::string& ActionRequest::resultsDir() const { return results_dir_; }
 
 const lth_jc::JsonContainer& ActionRequest::params() const {
-    if (params_.empty() && parsed_chunks_.data.includes("params"))
-        params_ = parsed_chunks_.data.get<lth_jc::JsonContainer>("params");
-
-    return params_;
+    return payload_->params;
 }
 
 const std::string& ActionRequest::paramsTxt() const {
-    if (params_txt_.empty())
-        params_txt_ = params().toString();
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { payload_->params_txt_mutex };
+    if (payload_->params_txt.empty())
+        payload_->params_txt = payload_->params.toString();
 
-    return params_txt_;
+    return payload_->params_txt;
 }
 
 const std::string& ActionRequest::prettyLabel() const {
@@ -65,30 +83,61 @@ const std::string& ActionRequest::prettyLabel() const {
 
 // Private interface
 
-void ActionRequest::init() {
-    id_ = parsed_chunks_.envelope.get<std::string>("id");
-    sender_ = parsed_chunks_.envelope.get<std::string>("sender");
+void ActionRequest::init(PCPClient::ParsedChunks&& parsed_chunks) {
+    // The span is recorded once the transaction ID is known
+    auto start_us = Util::Trace::isEnabled() ? Util::Trace::now() : 0;
+    id_ = parsed_chunks.envelope.get<std::string>("id");
+    sender_ = parsed_chunks.envelope.get<std::string>("sender");
 
     LOG_DEBUG("Validating {1} request {2} by {3}:\n{4}",
-              REQUEST_TYPE_NAMES.at(type_), id_, sender_, parsed_chunks_.toString());
+              REQUEST_TYPE_NAMES.at(type_), id_, sender_, parsed_chunks.toString());
+
+    validateFormat(parsed_chunks);
 
-    validateFormat();
+    std::shared_ptr<Payload> payload { new Payload(std::move(parsed_chunks)) };
+    const auto& data = payload->parsed_chunks.data;
 
-    transaction_id_ = parsed_chunks_.data.get<std::string>("transaction_id");
-    module_ = parsed_chunks_.data.get<std::string>("module");
-    action_ = parsed_chunks_.data.get<std::string>("action");
+    transaction_id_ = data.get<std::string>("transaction_id");
+    module_ = data.get<std::string>("module");
+    action_ = data.get<std::string>("action");
 
     if (type_ == RequestType::NonBlocking)
-        notify_outcome_ = parsed_chunks_.data.get<bool>("notify_outcome");
+        notify_outcome_ = data.get<bool>("notify_outcome");
+
+    if (data.includes("timeout")) {
+        auto timeout = data.get<int>("timeout");
+        if (timeout < 0)
+            throw ActionRequest::Error {
+                lth_loc::translate("the timeout must not be negative") };
+        timeout_ = static_cast<unsigned int>(timeout);
+    }
+
+    if (data.includes("result_encodings")) {
+        try {
+            result_encodings_ = data.get<std::vector<std::string>>("result_encodings");
+        } catch (const lth_jc::data_type_error&) {
+            throw ActionRequest::Error {
+                lth_loc::translate("the result_encodings must be strings") };
+        }
+    }
+
+    // Extracted once; all the copies of the request share it
+    if (data.includes("params"))
+        payload->params = data.get<lth_jc::JsonContainer>("params");
+
+    payload_ = std::move(payload);
+
+    if (start_us != 0)
+        Util::Trace::record("parse", transaction_id_, start_us);
 }
 
-void ActionRequest::validateFormat() {
-    if (!parsed_chunks_.has_data)
+void ActionRequest::validateFormat(const PCPClient::ParsedChunks& parsed_chunks) {
+    if (!parsed_chunks.has_data)
         throw ActionRequest::Error { lth_loc::translate("no data") };
-    if (parsed_chunks_.invalid_data)
+    if (parsed_chunks.invalid_data)
         throw ActionRequest::Error { lth_loc::translate("invalid data") };
     // NOTE(ale): currently, we don't support ContentType::Binary
-    if (parsed_chunks_.data_type != PCPClient::ContentType::Json)
+    if (parsed_chunks.data_type != PCPClient::ContentType::Json)
         throw ActionRequest::Error {
             lth_loc::translate("data is not in JSON format") };
 }
@@ -1,4 +1,8 @@
 #include <pxp-agent/action_response.hpp>
+#include <pxp-agent/util/structural_schema.hpp>
+#include <pxp-agent/util/json_escape.hpp>
+#include <pxp-agent/util/compression.hpp>
+#include <pxp-agent/pxp_schemas.hpp>
 
 #include <cpp-pcp-client/validator/validator.hpp>
 #include <cpp-pcp-client/validator/schema.hpp>
@@ -11,6 +15,7 @@
 #include <leatherman/logging/logging.hpp>
 
 #include <cassert>
+#include <limits>
 #include <utility>  // std::forward
 
 namespace PXPAgent {
@@ -35,11 +40,17 @@ const std::string END { "end" };
 const std::string RESULTS { "results" };
 const std::string RESULTS_ARE_VALID { "results_are_valid" };
 const std::string EXECUTION_ERROR { "execution_error" };
+const std::string RESOURCE_USAGE { "resource_usage" };
 
-static PCPClient::Validator getActionMetadataValidator()
+static const std::string STDOUT { "stdout" };
+static const std::string STDERR { "stderr" };
+static const std::string CONTENT { "content" };
+static const std::string CONTENT_ENCODING { "content_encoding" };
+
+static Util::StructuralSchema getActionMetadataSchema()
 {
     using T_C = PCPClient::TypeConstraint;
-    PCPClient::Schema sch { ACTION_METADATA_SCHEMA, PCPClient::ContentType::Json };
+    Util::StructuralSchema sch { ACTION_METADATA_SCHEMA };
 
     // Entries created during initialization (all mandatory)
     sch.addConstraint(REQUESTER, T_C::String, true);
@@ -57,10 +68,9 @@ static PCPClient::Validator getActionMetadataValidator()
     sch.addConstraint(RESULTS, T_C::Any, false);
     sch.addConstraint(RESULTS_ARE_VALID, T_C::Bool, false);
     sch.addConstraint(EXECUTION_ERROR, T_C::String, false);
+    sch.addConstraint(RESOURCE_USAGE, T_C::Object, false);
 
-    PCPClient::Validator validator {};
-    validator.registerSchema(sch);
-    return validator;
+    return sch;
 }
 
 //
@@ -74,8 +84,9 @@ ActionResponse::getMetadataFromRequest(const ActionRequest& request)
     m.set<std::string>(REQUESTER, request.sender());
     m.set<std::string>(MODULE, request.module());
     m.set<std::string>(ACTION, request.action());
-    m.set<std::string>(REQUEST_PARAMS,
-        request.paramsTxt().empty() ? "none" : request.paramsTxt());
+    // The params are redacted when stored, in case they are sensitive;
+    // don't serialize them (the whole catalog, for apply) to drop them
+    m.set<std::string>(REQUEST_PARAMS, "{}");
 
     m.set<std::string>(TRANSACTION_ID, request.transactionId());
     m.set<std::string>(REQUEST_ID, request.id());
@@ -125,6 +136,7 @@ void ActionResponse::setValidResultsAndEnd(lth_jc::JsonContainer&& results,
 {
     action_metadata.set<std::string>(END, lth_util::get_ISO8601_time());
     action_metadata.set<bool>(RESULTS_ARE_VALID, true);
+    results_keys_ = results.keys();
     action_metadata.set<lth_jc::JsonContainer>(RESULTS,
         std::forward<lth_jc::JsonContainer>(results));
     action_metadata.set<std::string>(STATUS,
@@ -142,6 +154,12 @@ void ActionResponse::setBadResultsAndEnd(const std::string& execution_error)
         ACTION_STATUS_NAMES.at(ActionStatus::Failure));
 }
 
+void ActionResponse::setResourceUsage(lth_jc::JsonContainer&& usage)
+{
+    action_metadata.set<lth_jc::JsonContainer>(RESOURCE_USAGE,
+        std::forward<lth_jc::JsonContainer>(usage));
+}
+
 const std::string& ActionResponse::prettyRequestLabel() const
 {
     if (pretty_request_label_.empty())
@@ -157,9 +175,10 @@ const std::string& ActionResponse::prettyRequestLabel() const
 
 bool ActionResponse::isValidActionMetadata(const lth_jc::JsonContainer& metadata)
 {
-    static PCPClient::Validator validator { getActionMetadataValidator() };
+    // Checked for every response, hence structurally
+    static const Util::StructuralSchema schema { getActionMetadataSchema() };
     try {
-        validator.validate(metadata, ACTION_METADATA_SCHEMA);
+        schema.validate(metadata);
         return true;
     } catch (const PCPClient::validation_error& e) {
         LOG_TRACE("Invalid action metadata: {1}", e.what());
@@ -201,6 +220,173 @@ bool ActionResponse::valid(R_T response_type) const
     return is_valid;
 }
 
+// Writes the JSON text of a response, up to a maximum size. As an
+// escaped string is at least as long as the raw one plus its quotes,
+// strings that can't fit are not escaped at all; once the text is
+// known to exceed the maximum, the writes are ignored and size()
+// returns a lower bound of the size of the whole text.
+class ResponseTextBuilder {
+  public:
+    ResponseTextBuilder(std::string& out, size_t max_size)
+            : out_ (out),
+              max_size_ { max_size },
+              size_ { out.size() }
+    {
+    }
+
+    bool exceeded() const { return size_ > max_size_; }
+
+    size_t size() const { return size_; }
+
+    void raw(char c)
+    {
+        raw(&c, 1);
+    }
+
+    void raw(const std::string& text)
+    {
+        raw(text.data(), text.size());
+    }
+
+    void raw(const char* text, size_t size)
+    {
+        size_ += size;
+        if (!exceeded())
+            out_.append(text, size);
+    }
+
+    void string(const std::string& s)
+    {
+        if (exceeded())
+            return;
+        if (size_ + s.size() + 2 > max_size_) {
+            size_ += s.size() + 2;
+            return;
+        }
+        Util::appendJSONString(out_, s);
+        size_ = out_.size();
+    }
+
+    void member(const std::string& key)
+    {
+        string(key);
+        raw(':');
+    }
+
+    void member(const std::string& key, const std::string& value)
+    {
+        member(key);
+        string(value);
+    }
+
+    // Write the comma separated members of the JSON object; string
+    // values are escaped by pxp-agent, as they include the output of
+    // actions, the rest by JsonContainer
+    void members(const lth_jc::JsonContainer& object)
+    {
+        bool first { true };
+        for (const auto& key : object.keys()) {
+            if (exceeded())
+                return;
+            if (!first)
+                raw(',');
+            first = false;
+
+            if (object.type(key) == lth_jc::DataType::String) {
+                member(key, object.get<std::string>(key));
+            } else {
+                member(key);
+                raw(object.toString(key));
+            }
+        }
+    }
+
+    // As above, for the specified keys of the object entry of the
+    // container, so that the object isn't copied out of it first
+    void members(const lth_jc::JsonContainer& container,
+                 const std::string& object_key,
+                 const std::vector<std::string>& keys)
+    {
+        bool first { true };
+        for (const auto& key : keys) {
+            if (exceeded())
+                return;
+            if (!first)
+                raw(',');
+            first = false;
+
+            if (container.type({ object_key, key }) == lth_jc::DataType::String) {
+                member(key, container.get<std::string>({ object_key, key }));
+            } else {
+                member(key);
+                raw(container.get<lth_jc::JsonContainer>({ object_key, key }).toString());
+            }
+        }
+    }
+
+  private:
+    std::string& out_;
+    size_t max_size_;
+    size_t size_;
+};
+
+lth_jc::JsonContainer ActionResponse::statusOutputResults() const
+{
+    auto action_status = action_metadata.get<std::string>({ RESULTS, STATUS });
+    lth_jc::JsonContainer action_results {};
+    action_results.set<std::string>(TRANSACTION_ID, status_query_transaction);
+
+    if (action_status == ACTION_STATUS_NAMES.at(ActionStatus::Running)) {
+        action_results.set<std::string>(STATUS,
+            ACTION_STATUS_NAMES.at(ActionStatus::Running));
+    } else if (action_status == ACTION_STATUS_NAMES.at(ActionStatus::Success)
+            || action_status == ACTION_STATUS_NAMES.at(ActionStatus::Failure)
+            || action_status == ACTION_STATUS_NAMES.at(ActionStatus::TimedOut)) {
+        // TODO(ale): decouple the status of the action from
+        // the output of the action once PXP v.2 gets in, as
+        // doing so would break compatibility against old
+        // clj-pxp-puppet; in practice set STATUS to
+        // action_status, instead of setting it to "failure"
+        // (in case the output is bad) or, otherwise, to
+        // (exitcode == EXIT_SUCCESS), as done in:
+        // https://github.com/puppetlabs/pxp-agent/blob/1.0.2/lib/src/modules/status.cc#L232
+        action_results.set<int>("exitcode", output.exitcode);
+
+        if (action_status != ACTION_STATUS_NAMES.at(ActionStatus::Success)) {
+            // The output was bad or the action timed out (not
+            // a PXP v1 status); report a failure
+            action_results.set<std::string>(STATUS,
+                ACTION_STATUS_NAMES.at(ActionStatus::Failure));
+        } else {
+            // The output was good; use exitcode
+            action_results.set<std::string>(STATUS,
+                (output.exitcode == EXIT_SUCCESS
+                    ? ACTION_STATUS_NAMES.at(ActionStatus::Success)
+                    : ACTION_STATUS_NAMES.at(ActionStatus::Failure)));
+        }
+    } else {
+        // TODO(ale): also UNDETERMINED once PXP v.2 is in
+        action_results.set<std::string>(STATUS,
+            ACTION_STATUS_NAMES.at(ActionStatus::Unknown));
+    }
+
+    // If an execution error exists, report that instead of any results.
+    if (action_metadata.includes(EXECUTION_ERROR)) {
+        auto exec_err = action_metadata.get<std::string>(EXECUTION_ERROR);
+        if (!exec_err.empty()) {
+            lth_jc::JsonContainer err_obj;
+            err_obj.set("kind", "puppetlabs.pxp-agent/execution-error");
+            err_obj.set("details", lth_jc::JsonContainer{});
+            err_obj.set("msg", exec_err);
+            lth_jc::JsonContainer result_obj;
+            result_obj.set("_error", err_obj);
+            action_results.set(STDOUT, result_obj.toString());
+        }
+    }
+
+    return action_results;
+}
+
 // TODO(ale): update this after PXP v2.0 changes
 lth_jc::JsonContainer ActionResponse::toJSON(R_T response_type) const
 {
@@ -216,60 +402,16 @@ lth_jc::JsonContainer ActionResponse::toJSON(R_T response_type) const
             break;
         case (R_T::StatusOutput):
         {
-            auto action_status = action_metadata.get<std::string>({ RESULTS, STATUS });
-            lth_jc::JsonContainer action_results {};
-            action_results.set<std::string>(TRANSACTION_ID, status_query_transaction);
-
-            if (action_status == ACTION_STATUS_NAMES.at(ActionStatus::Running)) {
-                action_results.set<std::string>(STATUS,
-                    ACTION_STATUS_NAMES.at(ActionStatus::Running));
-            } else if (action_status == ACTION_STATUS_NAMES.at(ActionStatus::Success)
-                    || action_status == ACTION_STATUS_NAMES.at(ActionStatus::Failure)) {
-                // TODO(ale): decouple the status of the action from
-                // the output of the action once PXP v.2 gets in, as
-                // doing so would break compatibility against old
-                // clj-pxp-puppet; in practice set STATUS to
-                // action_status, instead of setting it to "failure"
-                // (in case the output is bad) or, otherwise, to
-                // (exitcode == EXIT_SUCCESS), as done in:
-                // https://github.com/puppetlabs/pxp-agent/blob/1.0.2/lib/src/modules/status.cc#L232
-                action_results.set<int>("exitcode", output.exitcode);
-
-                if (action_status == ACTION_STATUS_NAMES.at(ActionStatus::Failure)) {
-                    // The output was bad; report a failure
-                    action_results.set<std::string>(STATUS,
-                        ACTION_STATUS_NAMES.at(ActionStatus::Failure));
-                } else {
-                    // The output was good; use exitcode
-                    action_results.set<std::string>(STATUS,
-                        (output.exitcode == EXIT_SUCCESS
-                            ? ACTION_STATUS_NAMES.at(ActionStatus::Success)
-                            : ACTION_STATUS_NAMES.at(ActionStatus::Failure)));
-                }
-            } else {
-                // TODO(ale): also UNDETERMINED once PXP v.2 is in
-                action_results.set<std::string>(STATUS,
-                    ACTION_STATUS_NAMES.at(ActionStatus::Unknown));
-            }
+            auto action_results = statusOutputResults();
 
-            // If an execution error exists, report that instead of any results.
-            if (action_metadata.includes(EXECUTION_ERROR)) {
-                auto exec_err = action_metadata.get<std::string>(EXECUTION_ERROR);
-                if (!exec_err.empty()) {
-                    lth_jc::JsonContainer err_obj;
-                    err_obj.set("kind", "puppetlabs.pxp-agent/execution-error");
-                    err_obj.set("details", lth_jc::JsonContainer{});
-                    err_obj.set("msg", exec_err);
-                    lth_jc::JsonContainer result_obj;
-                    result_obj.set("_error", err_obj);
-                    action_results.set("stdout", result_obj.toString());
-                }
-            }
-
-            if (!action_results.includes("stdout") && !output.std_out.empty())
-                action_results.set<std::string>("stdout", output.std_out);
+            if (!action_results.includes(STDOUT) && !output.std_out.empty())
+                action_results.set<std::string>(STDOUT, output.std_out);
             if (!output.std_err.empty())
-                action_results.set<std::string>("stderr", output.std_err);
+                action_results.set<std::string>(STDERR, output.std_err);
+
+            if (action_metadata.includes({ RESULTS, RESOURCE_USAGE }))
+                action_results.set<lth_jc::JsonContainer>(RESOURCE_USAGE,
+                    action_metadata.get<lth_jc::JsonContainer>({ RESULTS, RESOURCE_USAGE }));
 
             r.set<lth_jc::JsonContainer>(RESULTS, action_results);
 
@@ -285,4 +427,116 @@ lth_jc::JsonContainer ActionResponse::toJSON(R_T response_type) const
     return r;
 }
 
+std::string ActionResponse::toJSONString(R_T response_type) const
+{
+    std::string json_text {};
+    toJSONString(response_type, std::numeric_limits<size_t>::max(), json_text);
+    return json_text;
+}
+
+size_t ActionResponse::toJSONString(R_T response_type,
+                                    size_t max_size,
+                                    std::string& json_text) const
+{
+    json_text.clear();
+    ResponseTextBuilder builder { json_text, max_size };
+
+    // Small, with no output; JsonContainer does just as well
+    if (response_type == R_T::RPCError) {
+        builder.raw(toJSON(response_type).toString());
+        return builder.size();
+    }
+
+    builder.raw('{');
+    builder.member(TRANSACTION_ID, action_metadata.get<std::string>(TRANSACTION_ID));
+    builder.raw(',');
+    builder.member(RESULTS);
+    writeResults(builder, response_type);
+    builder.raw('}');
+    return builder.size();
+}
+
+size_t ActionResponse::toCompressedJSONString(R_T response_type,
+                                              size_t max_size,
+                                              std::string& json_text) const
+{
+    assert(response_type != R_T::RPCError);
+
+    std::string results_text {};
+    ResponseTextBuilder results_builder {
+        results_text, std::numeric_limits<size_t>::max() };
+    writeResults(results_builder, response_type);
+    auto content = Util::base64Encode(Util::gzipCompress(results_text));
+    results_text.clear();
+    results_text.shrink_to_fit();
+
+    json_text.clear();
+    ResponseTextBuilder builder { json_text, max_size };
+    builder.raw('{');
+    builder.member(TRANSACTION_ID, action_metadata.get<std::string>(TRANSACTION_ID));
+    builder.raw(',');
+    builder.member(RESULTS);
+    builder.raw('{');
+    builder.member(CONTENT_ENCODING, PXPSchemas::GZIP_RESULTS_ENCODING);
+    builder.raw(',');
+    builder.member(CONTENT, content);
+    builder.raw("}}");
+    return builder.size();
+}
+
+//
+// Private interface
+//
+
+bool ActionResponse::resultsKeysAreCurrent() const
+{
+    // The results may have been replaced through action_metadata; as
+    // keys are unique, they are the cached ones if they are as many
+    // and all of them are included
+    if (action_metadata.size(RESULTS) != results_keys_.size())
+        return false;
+    for (const auto& key : results_keys_) {
+        if (!action_metadata.includes({ RESULTS, key }))
+            return false;
+    }
+    return true;
+}
+
+void ActionResponse::writeResults(ResponseTextBuilder& builder,
+                                  R_T response_type) const
+{
+    if (response_type == R_T::StatusOutput) {
+        auto action_results = statusOutputResults();
+        builder.raw('{');
+        builder.members(action_results);
+
+        if (!action_results.includes(STDOUT) && !output.std_out.empty()) {
+            builder.raw(',');
+            builder.member(STDOUT, output.std_out);
+        }
+        if (!output.std_err.empty()) {
+            builder.raw(',');
+            builder.member(STDERR, output.std_err);
+        }
+
+        if (!builder.exceeded() && action_metadata.includes({ RESULTS, RESOURCE_USAGE })) {
+            builder.raw(',');
+            builder.member(RESOURCE_USAGE);
+            builder.raw(action_metadata.get<lth_jc::JsonContainer>(
+                { RESULTS, RESOURCE_USAGE }).toString());
+        }
+        builder.raw('}');
+    } else if (action_metadata.type(RESULTS) == lth_jc::DataType::Object) {
+        builder.raw('{');
+        if (resultsKeysAreCurrent()) {
+            builder.members(action_metadata, RESULTS, results_keys_);
+        } else {
+            builder.members(action_metadata.get<lth_jc::JsonContainer>(RESULTS));
+        }
+        builder.raw('}');
+    } else {
+        builder.raw(action_metadata.toString(RESULTS));
+    }
+}
+
 }  // namespace PXPAgent
@@ -144,6 +144,8 @@ static const std::string DEFAULT_CONFIG_FILE { (DEFAULT_CONF_DIR / "pxp-agent.co
 static const std::string DEFAULT_PCP_VERSION { "1" };
 static const std::string DEFAULT_DIR_PURGE_TTL { "14d" };
 
+static const std::string DEFAULT_FACT_CACHE_TTL { "0m" };
+
 static const std::string AGENT_CLIENT_TYPE { "agent" };
 
 const fs::perms NIX_FILE_PERMS { fs::owner_read | fs::owner_write | fs::group_read };
@@ -448,6 +450,9 @@ const Configuration::Agent& Configuration::getAgentConfiguration() const
         HW::GetFlag<std::string>("ssl-crl"),
         HW::GetFlag<std::string>("spool-dir"),
         HW::GetFlag<std::string>("spool-dir-purge-ttl"),
+        HW::GetFlag<bool>("spool-dir-pack-results"),
+        static_cast<uint32_t >(HW::GetFlag<int>("spool-dir-max-size")),
+        static_cast<uint32_t >(HW::GetFlag<int>("spool-dir-max-transactions")),
         HW::GetFlag<std::string>("modules-config-dir"),
         HW::GetFlag<std::string>("task-cache-dir"),
         HW::GetFlag<std::string>("task-cache-dir-purge-ttl"),
@@ -462,7 +467,15 @@ const Configuration::Agent& Configuration::getAgentConfiguration() const
         static_cast<uint32_t >(HW::GetFlag<int>("ping-interval")),
         static_cast<uint32_t >(HW::GetFlag<int>("task-download-connect-timeout")),
         static_cast<uint32_t >(HW::GetFlag<int>("task-download-timeout")),
-        HW::GetFlag<uint32_t>("max-message-size") };
+        HW::GetFlag<uint32_t>("max-message-size"),
+        static_cast<uint32_t >(HW::GetFlag<int>("apply-worker-pool-size")),
+        HW::GetFlag<std::string>("apply-fact-cache-ttl"),
+        HW::GetFlag<std::string>("cgroup-parent"),
+        static_cast<uint32_t >(HW::GetFlag<int>("result-compression-threshold")),
+        lth_file::tilde_expand(HW::GetFlag<std::string>("metrics-file")),
+        static_cast<uint32_t >(HW::GetFlag<int>("trace-buffer-size")),
+        lth_file::tilde_expand(HW::GetFlag<std::string>("trace-file")),
+        static_cast<uint32_t >(HW::GetFlag<int>("watchdog-threshold")) };
     return agent_configuration_;
 }
 
@@ -785,6 +798,36 @@ void Configuration::defineDefaultValues()
                     Types::String,
                     DEFAULT_DIR_PURGE_TTL) } });
 
+    defaults_.insert(
+        Option { "spool-dir-pack-results",
+                 Base_ptr { new Entry<bool>(
+                    "spool-dir-pack-results",
+                    "",
+                    lth_loc::translate("Store the results of each completed action "
+                                       "in a single file, default: false"),
+                    Types::Bool,
+                    false) } });
+
+    defaults_.insert(
+        Option { "spool-dir-max-size",
+                 Base_ptr { new Entry<int>(
+                    "spool-dir-max-size",
+                    "",
+                    lth_loc::translate("Maximum size, in MiB, of the results of the "
+                                       "completed actions, default: 0 (unlimited)"),
+                    Types::Int,
+                    0) } });
+
+    defaults_.insert(
+        Option { "spool-dir-max-transactions",
+                 Base_ptr { new Entry<int>(
+                    "spool-dir-max-transactions",
+                    "",
+                    lth_loc::translate("Maximum number of completed actions whose "
+                                       "results are stored, default: 0 (unlimited)"),
+                    Types::Int,
+                    0) } });
+
     defaults_.insert(
         Option { "task-cache-dir-purge-ttl",
                  Base_ptr { new Entry<std::string>(
@@ -832,6 +875,94 @@ void Configuration::defineDefaultValues()
                     Types::Int,
                     64 * 1024 * 1024) } });
 
+    defaults_.insert(
+        Option { "apply-worker-pool-size",
+                 Base_ptr { new Entry<int>(
+                    "apply-worker-pool-size",
+                    "",
+                    lth_loc::translate("Maximum number of warm Puppet processes kept "
+                                       "to serve apply requests, one per environment; "
+                                       "default: 0 (disabled)"),
+                    Types::Int,
+                    0) } });
+
+    defaults_.insert(
+        Option { "apply-fact-cache-ttl",
+                 Base_ptr { new Entry<std::string>(
+                    "apply-fact-cache-ttl",
+                    "",
+                    lth_loc::format("TTL for the facts returned by the apply prep "
+                                    "action before being resolved again, "
+                                    "default: '{1}' (disabled)",
+                                    DEFAULT_FACT_CACHE_TTL),
+                    Types::String,
+                    DEFAULT_FACT_CACHE_TTL) } });
+
+    defaults_.insert(
+        Option { "cgroup-parent",
+                 Base_ptr { new Entry<std::string>(
+                    "cgroup-parent",
+                    "",
+                    lth_loc::translate("cgroup v2 directory under which each action "
+                                       "is executed in its own cgroup (Linux only); "
+                                       "default: none"),
+                    Types::String,
+                    "") } });
+
+    defaults_.insert(
+        Option { "result-compression-threshold",
+                 Base_ptr { new Entry<int>(
+                    "result-compression-threshold",
+                    "",
+                    lth_loc::translate("Size in Bytes above which the results of "
+                                       "responses are compressed, when the requester "
+                                       "accepts it; default: 1 MiB"),
+                    Types::Int,
+                    1024 * 1024) } });
+
+    defaults_.insert(
+        Option { "metrics-file",
+                 Base_ptr { new Entry<std::string>(
+                    "metrics-file",
+                    "",
+                    lth_loc::translate("File where the agent metrics are written every "
+                                       "minute, in the Prometheus text format; "
+                                       "default: none"),
+                    Types::String,
+                    "") } });
+
+    defaults_.insert(
+        Option { "trace-buffer-size",
+                 Base_ptr { new Entry<int>(
+                    "trace-buffer-size",
+                    "",
+                    lth_loc::translate("Number of the most recent request stages kept "
+                                       "for tracing; default: 0 (no tracing)"),
+                    Types::Int,
+                    0) } });
+
+    defaults_.insert(
+        Option { "trace-file",
+                 Base_ptr { new Entry<std::string>(
+                    "trace-file",
+                    "",
+                    lth_loc::translate("File where the trace of the request stages is "
+                                       "written, in the Chrome trace format, on "
+                                       "SIGUSR1; default: none"),
+                    Types::String,
+                    "") } });
+
+    defaults_.insert(
+        Option { "watchdog-threshold",
+                 Base_ptr { new Entry<int>(
+                    "watchdog-threshold",
+                    "",
+                    lth_loc::translate("Time in ms after which a busy or late thread is "
+                                       "reported as stalled, with a stack sample; "
+                                       "default: 5000 ms, 0 to disable"),
+                    Types::Int,
+                    5000) } });
+
 #ifndef _WIN32
     // NOTE(ale): we don't daemonize on Windows; we rely NSSM to start
     // the pxp-agent service and on CreateMutexA() to avoid multiple
@@ -1190,7 +1321,22 @@ void Configuration::validateAndNormalizeOtherSettings()
     }
 #endif
 
-    for (auto purge_ttl : {"spool-dir-purge-ttl", "task-cache-dir-purge-ttl"}) {
+    auto cgroup_parent = HW::GetFlag<std::string>("cgroup-parent");
+    if (!cgroup_parent.empty()) {
+#ifdef __linux__
+        if (!fs::exists(fs::path(cgroup_parent) / "cgroup.controllers"))
+            throw Configuration::Error {
+                lth_loc::format("the cgroup-parent '{1}' is not a cgroup v2 directory",
+                                cgroup_parent) };
+#else
+        throw Configuration::Error {
+            lth_loc::translate("cgroup-parent is only supported on Linux") };
+#endif
+    }
+
+    for (auto purge_ttl : {"spool-dir-purge-ttl",
+                           "task-cache-dir-purge-ttl",
+                           "apply-fact-cache-ttl"}) {
         try {
             Timestamp(HW::GetFlag<std::string>(purge_ttl));
         } catch (const Timestamp::Error& e) {
@@ -1204,7 +1350,13 @@ void Configuration::validateAndNormalizeOtherSettings()
                          "association-request-ttl",
                          "pcp-message-ttl",
                          "task-download-connect-timeout",
-                         "task-download-timeout"}) {
+                         "task-download-timeout",
+                         "apply-worker-pool-size",
+                         "result-compression-threshold",
+                         "spool-dir-max-size",
+                         "spool-dir-max-transactions",
+                         "trace-buffer-size",
+                         "watchdog-threshold"}) {
         if (HW::GetFlag<int>(msg_ttl) < 0)
             throw Configuration::Error {
                 lth_loc::format("{1} must be positive", msg_ttl) };
@@ -2,6 +2,9 @@
 #include <pxp-agent/module_type.hpp>
 #include <pxp-agent/action_output.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/util/action_cgroups.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
+#include <pxp-agent/util/trace.hpp>
 
 #include <leatherman/execution/execution.hpp>
 
@@ -21,6 +24,7 @@
 #include <atomic>
 #include <memory>   // std::shared_ptr
 #include <utility>  // std::move
+#include <vector>
 
 // TODO(ale): disable assert() once we're confident with the code...
 // To disable assert()
@@ -318,21 +322,40 @@ ActionResponse ExternalModule::callBlockingAction(const ActionRequest& request)
     LOG_INFO("Executing the {1}", request.prettyLabel());
     LOG_TRACE("Input for the {1}: {2}", request.prettyLabel(), action_args);
 
-    auto exec = lth_exec::execute(
+    auto deadline = Util::ActionDeadlines::Instance().create(request);
+    std::function<void(size_t)> pid_callback {
+        deadline ? deadline->arming(nullptr) : nullptr };
 #ifdef _WIN32
-        "cmd.exe", { "/c", path_, action_name },
+    std::string executable { "cmd.exe" };
+    std::vector<std::string> arguments { "/c", path_, action_name };
 #else
-        path_, { action_name },
+    std::string executable { path_ };
+    std::vector<std::string> arguments { action_name };
 #endif
+    auto cgroup = Util::ActionCGroups::Instance().create(request);
+    if (cgroup)
+        cgroup->attachBeforeExec(executable, arguments);
+    Util::Trace::ChildSpans child_spans { request.transactionId() };
+    pid_callback = child_spans.spawning(pid_callback);
+
+    auto exec = lth_exec::execute(
+        executable, arguments,
         action_args,                           // args
         std::map<std::string, std::string>(),  // environment
+        pid_callback,                          // pid callback
         0,                                     // timeout
         { lth_exec::execution_options::thread_safe,
           lth_exec::execution_options::merge_environment,
-          lth_exec::execution_options::inherit_locale });  // options
+          lth_exec::execution_options::inherit_locale,
+          lth_exec::execution_options::create_detached_process });  // options
+    child_spans.end();
 
     response.output = ActionOutput { exec.exit_code, exec.output, exec.error };
     processOutputAndUpdateMetadata(response);
+    if (deadline)
+        deadline->updateResponse(response);
+    if (cgroup)
+        response.setResourceUsage(cgroup->getUsage());
     return response;
 }
 
@@ -353,24 +376,39 @@ ActionResponse ExternalModule::callNonBlockingAction(const ActionRequest& reques
     // the child process is executed in a new process contract
     // on Solaris and a new process group on Windows
 
-    auto exec = lth_exec::execute(
+    std::function<void(size_t)> pid_callback {
+        [results_dir_path](size_t pid) {
+            auto pid_file = (results_dir_path / "pid").string();
+            lth_file::atomic_write_to_file(std::to_string(pid) + "\n", pid_file,
+                                           NIX_FILE_PERMS, std::ios::binary);
+        } };
+    auto deadline = Util::ActionDeadlines::Instance().create(request);
+    if (deadline)
+        pid_callback = deadline->arming(pid_callback);
 #ifdef _WIN32
-        "cmd.exe", { "/c", path_, action_name },
+    std::string executable { "cmd.exe" };
+    std::vector<std::string> arguments { "/c", path_, action_name };
 #else
-        path_, { action_name },
+    std::string executable { path_ };
+    std::vector<std::string> arguments { action_name };
 #endif
+    auto cgroup = Util::ActionCGroups::Instance().create(request);
+    if (cgroup)
+        cgroup->attachBeforeExec(executable, arguments);
+    Util::Trace::ChildSpans child_spans { request.transactionId() };
+    pid_callback = child_spans.spawning(pid_callback);
+
+    auto exec = lth_exec::execute(
+        executable, arguments,
         input_txt,  // input arguments, passed via stdin
         std::map<std::string, std::string>(),  // environment
-        [results_dir_path](size_t pid) {
-            auto pid_file = (results_dir_path / "pid").string();
-            lth_file::atomic_write_to_file(std::to_string(pid) + "\n", pid_file,
-                                           NIX_FILE_PERMS, std::ios::binary);
-        },          // pid callback
+        pid_callback,  // pid callback
         0,          // timeout
         { lth_exec::execution_options::thread_safe,
           lth_exec::execution_options::create_detached_process,
           lth_exec::execution_options::merge_environment,
           lth_exec::execution_options::inherit_locale });  // options
+    child_spans.end();
 
     LOG_INFO("The execution of the {1} has completed", request.prettyLabel());
 
@@ -396,8 +434,15 @@ ActionResponse ExternalModule::callNonBlockingAction(const ActionRequest& reques
         pcp_util::chrono::milliseconds(OUTPUT_DELAY_MS));
 
     // Stdout / stderr output should be on file; read it
-    response.output = storage_->getOutput(request.transactionId(), exec.exit_code);
+    {
+        Util::Trace::Span span { "output_read", request.transactionId() };
+        response.output = storage_->getOutput(request.transactionId(), exec.exit_code);
+    }
     processOutputAndUpdateMetadata(response);
+    if (deadline)
+        deadline->updateResponse(response);
+    if (cgroup)
+        response.setResourceUsage(cgroup->getUsage());
     return response;
 }
 
@@ -0,0 +1,210 @@
+#include <pxp-agent/metadata_record.hpp>
+#include <pxp-agent/action_status.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <cstring>
+
+namespace PXPAgent {
+namespace MetadataRecord {
+
+namespace lth_jc  = leatherman::json_container;
+namespace lth_loc = leatherman::locale;
+
+static const char MAGIC[] { 'P', 'X', 'P', 'M' };
+static const size_t HEADER_SIZE { 8 };
+
+static const std::string START { "start" };
+static const std::string END { "end" };
+static const std::string STATUS { "status" };
+
+// Key of the wrapper object used to decode JSON values of any type
+static const std::string WRAPPED { "v" };
+
+enum class EntryType : uint8_t { String = 1, Bool, Json };
+
+static void appendUInt(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+// Reads a record, throwing an Error if it's truncated
+class Reader {
+  public:
+    explicit Reader(const std::string& data)
+            : data_ (data),
+              pos_ { 0 }
+    {
+    }
+
+    bool done() const { return pos_ == data_.size(); }
+
+    uint64_t uint(size_t bytes)
+    {
+        require(bytes);
+        uint64_t value { 0 };
+        for (size_t i = 0; i < bytes; i++)
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data_[pos_ + i]))
+                     << (8 * i);
+        pos_ += bytes;
+        return value;
+    }
+
+    std::string bytes(uint64_t size)
+    {
+        require(size);
+        std::string value { data_, pos_, static_cast<size_t>(size) };
+        pos_ += static_cast<size_t>(size);
+        return value;
+    }
+
+  private:
+    const std::string& data_;
+    size_t pos_;
+
+    void require(uint64_t size) const
+    {
+        if (size > data_.size() - pos_)
+            throw Error { lth_loc::translate("truncated metadata record") };
+    }
+};
+
+bool isRecord(const std::string& data)
+{
+    return data.size() >= sizeof(MAGIC)
+           && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+static std::string timestamp(const lth_jc::JsonContainer& metadata, const std::string& key)
+{
+    if (!metadata.includes(key) || metadata.type(key) != lth_jc::DataType::String)
+        return {};
+    auto value = metadata.get<std::string>(key);
+    // Longer timestamps (not written by pxp-agent) are only entries
+    return value.size() <= 255 ? value : std::string {};
+}
+
+std::string encode(const lth_jc::JsonContainer& metadata)
+{
+    uint8_t status_code { 0 };
+    if (metadata.includes(STATUS) && metadata.type(STATUS) == lth_jc::DataType::String) {
+        auto found = NAMES_OF_ACTION_STATUS.find(metadata.get<std::string>(STATUS));
+        if (found != NAMES_OF_ACTION_STATUS.end())
+            status_code = static_cast<uint8_t>(found->second) + 1;
+    }
+    auto start = timestamp(metadata, START);
+    auto end = timestamp(metadata, END);
+
+    std::string out {};
+    out.append(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(VERSION));
+    out.push_back(static_cast<char>(status_code));
+    out.push_back(static_cast<char>(start.size()));
+    out.push_back(static_cast<char>(end.size()));
+    out += start;
+    out += end;
+
+    for (const auto& key : metadata.keys()) {
+        std::string value {};
+        EntryType type {};
+
+        switch (metadata.type(key)) {
+            case lth_jc::DataType::String:
+                type = EntryType::String;
+                value = metadata.get<std::string>(key);
+                break;
+            case lth_jc::DataType::Bool:
+                type = EntryType::Bool;
+                value.push_back(metadata.get<bool>(key) ? 1 : 0);
+                break;
+            default:
+                type = EntryType::Json;
+                value = metadata.toString(key);
+        }
+
+        if (key.size() > 0xFFFF)
+            throw Error { lth_loc::translate("metadata key too long") };
+
+        out.push_back(static_cast<char>(type));
+        appendUInt(out, key.size(), 2);
+        out += key;
+        appendUInt(out, value.size(), 8);
+        out += value;
+    }
+
+    return out;
+}
+
+static Summary readHeader(Reader& reader)
+{
+    if (reader.bytes(sizeof(MAGIC)) != std::string(MAGIC, sizeof(MAGIC)))
+        throw Error { lth_loc::translate("not a metadata record") };
+
+    auto version = reader.uint(1);
+    if (version != VERSION)
+        throw Error { lth_loc::format("unsupported metadata record version {1}",
+                                      version) };
+
+    auto status_code = reader.uint(1);
+    auto start_size = reader.uint(1);
+    auto end_size = reader.uint(1);
+
+    Summary summary {};
+    if (status_code > 0) {
+        auto found = ACTION_STATUS_NAMES.find(static_cast<ActionStatus>(status_code - 1));
+        if (found != ACTION_STATUS_NAMES.end())
+            summary.status = found->second;
+    }
+    summary.start = reader.bytes(start_size);
+    reader.bytes(end_size);
+    return summary;
+}
+
+Summary decodeSummary(const std::string& data)
+{
+    Reader reader { data };
+    return readHeader(reader);
+}
+
+lth_jc::JsonContainer decode(const std::string& data)
+{
+    Reader reader { data };
+    readHeader(reader);
+
+    lth_jc::JsonContainer metadata {};
+    while (!reader.done()) {
+        auto type = static_cast<EntryType>(reader.uint(1));
+        auto key = reader.bytes(reader.uint(2));
+        auto value = reader.bytes(reader.uint(8));
+
+        try {
+            switch (type) {
+                case EntryType::String:
+                    metadata.set<std::string>(key, std::move(value));
+                    break;
+                case EntryType::Bool:
+                    metadata.set<bool>(key, !value.empty() && value[0] != 0);
+                    break;
+                case EntryType::Json:
+                {
+                    lth_jc::JsonContainer wrapper { "{\"" + WRAPPED + "\":" + value + "}" };
+                    metadata.set<lth_jc::JsonContainer>(
+                        key, wrapper.get<lth_jc::JsonContainer>(WRAPPED));
+                    break;
+                }
+                default:
+                    throw Error { lth_loc::format("invalid type of the metadata entry '{1}'",
+                                                  key) };
+            }
+        } catch (const lth_jc::data_parse_error&) {
+            throw Error { lth_loc::format("invalid JSON in the metadata entry '{1}'",
+                                          key) };
+        }
+    }
+
+    return metadata;
+}
+
+}  // namespace MetadataRecord
+}  // namespace PXPAgent
@@ -1,5 +1,6 @@
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/action_status.hpp>
+#include <pxp-agent/util/trace.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.module"
 #include <leatherman/logging/logging.hpp>
@@ -16,10 +17,35 @@ namespace lth_loc = leatherman::locale;
 
 Module::Module()
         : input_validator_ {},
-          results_validator_ {}
+          results_validator_ {},
+          input_schemas_ {},
+          results_schemas_ {}
 {
 }
 
+void Module::registerInputSchema(const Util::StructuralSchema& schema)
+{
+    input_validator_.registerSchema(schema.toSchema());
+    input_schemas_.emplace(schema.getName(), schema);
+}
+
+void Module::registerResultsSchema(const Util::StructuralSchema& schema)
+{
+    results_validator_.registerSchema(schema.toSchema());
+    results_schemas_.emplace(schema.getName(), schema);
+}
+
+void Module::validateInput(const std::string& action_name,
+                           const lth_jc::JsonContainer& params) const
+{
+    auto schema = input_schemas_.find(action_name);
+    if (schema != input_schemas_.end()) {
+        schema->second.validate(params);
+    } else {
+        input_validator_.validate(params, action_name);
+    }
+}
+
 bool Module::hasAction(const std::string& action_name)
 {
     return std::find(actions.begin(), actions.end(), action_name)
@@ -40,9 +66,16 @@ void Module::validateOutputAndUpdateMetadata(ActionResponse& response)
     std::string err_msg {};
 
     try {
-        results_validator_.validate(
-            response.action_metadata.get<lth_jc::JsonContainer>("results"),
-            response.action_metadata.get<std::string>("action"));
+        auto action_name = response.action_metadata.get<std::string>("action");
+        auto schema = results_schemas_.find(action_name);
+        if (schema != results_schemas_.end()) {
+            // Checked in place, without copying the results
+            schema->second.validate(response.action_metadata, { "results" });
+        } else {
+            results_validator_.validate(
+                response.action_metadata.get<lth_jc::JsonContainer>("results"),
+                action_name);
+        }
         LOG_TRACE("Successfully validated the results for the {1}",
                   response.prettyRequestLabel());
     } catch (PCPClient::validation_error&) {
@@ -92,6 +125,7 @@ ActionResponse Module::executeAction(const ActionRequest& request)
         }
 
         assert(response.action_metadata.includes("results"));
+        Util::Trace::Span span { "output_validation", request.transactionId() };
         validateOutputAndUpdateMetadata(response);
         return response;
     } catch (const Module::ProcessingError& e) {
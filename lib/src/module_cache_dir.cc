@@ -2,6 +2,7 @@
 #include <pxp-agent/module.hpp>
 #include <pxp-agent/util/purgeable.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/util/metrics.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/time.hpp>
 
@@ -29,10 +30,31 @@ namespace lth_file    = leatherman::file_util;
 namespace lth_jc      = leatherman::json_container;
 
 namespace PXPAgent {
+  // Not a valid sha256, so it can't be a cached directory
+  static const std::string TRASH_DIR { ".trash" };
+
+  static Util::Metrics::Counter& CACHE_HITS {
+    Util::Metrics::Registry::Instance().counter(
+      "pxp_agent_task_cache_hits_total",
+      "Files found in the task cache with the expected sha256") };
+  static Util::Metrics::Counter& CACHE_MISSES {
+    Util::Metrics::Registry::Instance().counter(
+      "pxp_agent_task_cache_misses_total",
+      "Files missing from the task cache, or with a different sha256") };
+  static Util::Metrics::Counter& DOWNLOADED_BYTES {
+    Util::Metrics::Registry::Instance().counter(
+      "pxp_agent_task_downloaded_bytes_total",
+      "Bytes of the files downloaded into the task cache") };
+  static Util::Metrics::Counter& DOWNLOAD_FAILURES {
+    Util::Metrics::Registry::Instance().counter(
+      "pxp_agent_task_download_failures_total",
+      "Files that could not be downloaded into the task cache") };
+
   ModuleCacheDir::ModuleCacheDir(const std::string& cache_dir,
                                  const std::string& cache_dir_purge_ttl) :
     cache_dir_ { cache_dir },
-    purge_ttl_ { cache_dir_purge_ttl }
+    purge_ttl_ { cache_dir_purge_ttl },
+    trash_ { static_cast<fs::path>(cache_dir) / TRASH_DIR }
   {}
 
   // Creates the <cache_dir>/<sha256> directory (and parent dirs), ensuring that its permissions are readable by
@@ -72,6 +94,8 @@ namespace PXPAgent {
       // Lambda function
       [&](std::string const& sub_dir) -> bool {
         fs::path dir_path { sub_dir };
+        if (dir_path.filename() == TRASH_DIR)
+          return true;
         LOG_TRACE("Inspecting '{1}' for purging", sub_dir);
 
         boost::system::error_code ec;
@@ -83,7 +107,11 @@ namespace PXPAgent {
           LOG_TRACE("Removing '{1}'", sub_dir);
 
           try {
-            purge_callback(dir_path.string());
+            if (purge_callback == nullptr) {
+              trash_.moveToTrash(dir_path);
+            } else {
+              purge_callback(dir_path.string());
+            }
             num_purged_dirs++;
           } catch (const std::exception& e) {
             LOG_ERROR("Failed to remove '{1}': {2}", sub_dir, e.what());
@@ -92,6 +120,10 @@ namespace PXPAgent {
         return true;  // Return from Lamda function passed to lth_file::each_subdirectory
       });
 
+    // Also removes what was left in the trash by previous runs
+    if (purge_callback == nullptr && fs::exists(trash_.path()))
+      trash_.empty();
+
     LOG_INFO(lth_loc::format_n(
       // LOCALE: info
       "Removed {1} directory from '{2}'",
@@ -140,17 +172,16 @@ namespace PXPAgent {
     return md_value_hex;
   }
 
-  std::string ModuleCacheDir::createUrlEndpoint(const lth_jc::JsonContainer& uri) {
-    std::string url = uri.get<std::string>("path");
-    auto params = uri.getWithDefault<lth_jc::JsonContainer>("params", lth_jc::JsonContainer());
-    if (params.empty()) {
+  std::string ModuleCacheDir::createUrlEndpoint(const Util::RemoteFile& file) {
+    std::string url = file.uri_path;
+    if (file.uri_params.empty()) {
       return url;
     }
     auto curl_handle = lth_curl::curl_handle();
     url += "?";
-    for (auto& key : params.keys()) {
-      auto escaped_key = std::string(lth_curl::curl_escaped_string(curl_handle, key));
-      auto escaped_val = std::string(lth_curl::curl_escaped_string(curl_handle, params.get<std::string>(key)));
+    for (auto& param : file.uri_params) {
+      auto escaped_key = std::string(lth_curl::curl_escaped_string(curl_handle, param.first));
+      auto escaped_val = std::string(lth_curl::curl_escaped_string(curl_handle, param.second));
       url += escaped_key + "=" + escaped_val + "&";
     }
     // Remove trailing ampersand (&)
@@ -170,9 +201,9 @@ namespace PXPAgent {
                                                                      uint32_t timeout_s,
                                                                      lth_curl::client& client,
                                                                      const fs::path& file_path,
-                                                                     const lth_jc::JsonContainer& uri) {
+                                                                     const Util::RemoteFile& file) {
     pcp_util::lock_guard<pcp_util::mutex> curl_lock { curl_mutex_ };
-    auto endpoint = createUrlEndpoint(uri);
+    auto endpoint = createUrlEndpoint(file);
     std::tuple<bool, std::string> result = std::make_tuple(false, "");
     for (auto& master_uri : master_uris) {
       auto url = master_uri + endpoint;
@@ -223,14 +254,16 @@ namespace PXPAgent {
                                                   lth_curl::client& client,
                                                   const fs::path& cache_dir,
                                                   const fs::path& destination,
-                                                  const lth_jc::JsonContainer& file) {
+                                                  const Util::RemoteFile& file) {
     auto filename = destination.filename();
-    auto sha256 = file.get<std::string>("sha256");
+    const auto& sha256 = file.sha256;
 
     if (fs::exists(destination) && boost::to_upper_copy<std::string>(sha256) == boost::to_upper_copy<std::string>(calculateSha256(destination.string()))) {
       fs::permissions(destination, NIX_DOWNLOADED_FILE_PERMS);
+      CACHE_HITS.add();
       return destination;
     }
+    CACHE_MISSES.add();
 
     if (master_uris.empty()) {
       throw Module::ProcessingError(lth_loc::format("Cannot download file. No master-uris were provided"));
@@ -247,15 +280,22 @@ namespace PXPAgent {
     //
     //    (2) It somewhat simplifies error handling if multiple threads try to download
     //    the same file.
-    auto download_result = downloadFileWithCurl(master_uris, connect_timeout, timeout, client, tempname, file.get<lth_jc::JsonContainer>("uri"));
+    auto download_result = downloadFileWithCurl(master_uris, connect_timeout, timeout, client, tempname, file);
     if (!std::get<0>(download_result)) {
+      DOWNLOAD_FAILURES.add();
       throw Module::ProcessingError(lth_loc::format(
         "Downloading file {1} failed after trying all the available master-uris. Most recent error message: {2}",
         filename,
         std::get<1>(download_result)));
     }
 
+    boost::system::error_code ec;
+    auto downloaded_bytes = fs::file_size(tempname, ec);
+    if (!ec)
+      DOWNLOADED_BYTES.add(downloaded_bytes);
+
     if (sha256 != calculateSha256(tempname.string())) {
+      DOWNLOAD_FAILURES.add();
       fs::remove(tempname);
       throw Module::ProcessingError(lth_loc::format("The downloaded file {1} has a SHA that differs from the provided SHA", filename));
     }
@@ -287,13 +327,13 @@ namespace PXPAgent {
                                          uint32_t timeout,
                                          lth_curl::client& client,
                                          const fs::path&   cache_dir,
-                                         lth_jc::JsonContainer& file) {
-      LOG_DEBUG("Verifying file based on {1}", file.toString());
+                                         const Util::RemoteFile& file) {
+      LOG_DEBUG("Verifying file '{1}' with sha256 {2}", file.filename, file.sha256);
 
       try {
           // files remain in the cache_dir rather than being written out to a destination
           // elsewhere on the filesystem.
-          auto destination = cache_dir / fs::path(file.get<std::string>("filename")).filename();
+          auto destination = cache_dir / fs::path(file.filename).filename();
           return downloadFileFromMaster(master_uris, connect_timeout, timeout, client, cache_dir, destination, file);
       } catch (Module::ProcessingError& e) {
           throw Module::ProcessingError { lth_loc::format("Failed to download file with: {1}", e.what()) };
@@ -1,140 +1,244 @@
 #include <pxp-agent/modules/apply.hpp>
+#include <pxp-agent/util/action_cgroups.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/util/module_params.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/time.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/system/error_code.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/tokenizer.hpp>
+#include <cassert>
 #include <leatherman/json_container/json_container.hpp>
 #include <leatherman/file_util/file.hpp>
 #include <leatherman/locale/locale.hpp>
 
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.modules.apply"
+#include <leatherman/logging/logging.hpp>
+
 namespace fs = boost::filesystem;
 namespace lth_file = leatherman::file_util;
 namespace lth_jc   = leatherman::json_container;
 namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
 
 namespace PXPAgent {
 namespace Modules {
 
     static const std::string apply_ACTION { "apply" };
-    static const std::string apply_ACTION_INPUT_SCHEMA { R"(
-    {
-        "type": "object",
-        "properties": {
-            "catalog": {
-                "type": "object"
-            },
-            "apply_options": {
-                "type": "object"
-            }
-        },
-        "required": ["catalog", "apply_options"]
-    }
-    )" };
-
     static const std::string prep_ACTION { "prep" };
 
     // TODO: Actually manage this file in packaging (or perhaps fetch it from puppetserver).
-    // For now just copy it to the cache dir each time unless there is already a copy
+    // For now just copy it to the cache dir each time it differs from the existing copy
     static const std::string APPLY_RUBY_SHIM {
 R"(#! /opt/puppetlabs/puppet/bin/ruby
 # frozen_string_literal: true
 
+require 'digest'
 require 'fileutils'
 require 'json'
 require 'puppet'
 require 'puppet/configurer'
 require 'securerandom'
+require 'socket'
 require 'tempfile'
 require 'uri'
 
-## TODO: Option to read from a file is for debugging. Only read from stdin in production.
-args = JSON.parse(ARGV[0] ? File.read(ARGV[0]) : STDIN.read)
-
 # Create temporary directories for all core Puppet settings so we don't clobber
 # existing state or read from puppet.conf. Also create a temporary modulepath.
 # Additionally include rundir, which gets its own initialization.
-puppet_root = Dir.mktmpdir
-moduledir = File.join(puppet_root, 'modules')
-Dir.mkdir(moduledir)
-plugin_cache = args['plugin_cache']
-plugin_dest = File.join(plugin_cache, 'plugins')
-pluginfact_dest = File.join(plugin_cache, 'pluginfacts')
-# Use isolated directories in puppet_root
-setting_keys = Puppet::Settings::REQUIRED_APP_SETTINGS.append(:rundir)
-cli_base = (setting_keys).flat_map do |setting|
-  ["--#{setting}", File.join(puppet_root, setting.to_s.chomp('dir'))]
+def initialize_puppet(args, puppet_root)
+  moduledir = File.join(puppet_root, 'modules')
+  Dir.mkdir(moduledir)
+  plugin_cache = args['plugin_cache']
+  plugin_dest = File.join(plugin_cache, 'plugins')
+  pluginfact_dest = File.join(plugin_cache, 'pluginfacts')
+  # Use isolated directories in puppet_root
+  setting_keys = Puppet::Settings::REQUIRED_APP_SETTINGS + [:rundir]
+  cli_base = setting_keys.flat_map do |setting|
+    ["--#{setting}", File.join(puppet_root, setting.to_s.chomp('dir'))]
+  end
+  cli_base.concat([
+    '--modulepath',
+    moduledir,
+    '--plugindest',
+    plugin_dest,
+    '--pluginfactdest',
+    pluginfact_dest
+  ])
+  # There will always be at least a single master URI
+  # TODO: make sure comma separated is what --server_list expects
+  server_list = args['primary_uris'].map { |uri| URI.parse(uri).host }.join(',')
+
+  # These settings are required for communication with puppetserver. This is primarily for
+  # pluginsync but it is also required if a catalog requires files from modules served by
+  # puppetserver (Puppet[:default_file_terminus] = rest by default)
+  cli_settings_pluginsync = [
+    '--localcacert',
+    args['ca'],
+    '--hostcert',
+    args['crt'],
+    '--hostprivkey',
+    args['key'],
+    '--hostcrl',
+    args['crl'],
+    '--server_list',
+    server_list
+  ]
+
+  # Break apart proxy and extract individual settings
+  proxy_flags = {
+    user: '--http_proxy_user',
+    password: '--http_proxy_password',
+    port: '--http_proxy_port',
+    host: '--http_proxy_host'
+  }
+  # Proxy will always be a string (even if its empty)
+  parsed_proxy = URI.parse(args['proxy'])
+  proxy_flags.each do |uri_method, setting_flag|
+    val = parsed_proxy.send(uri_method)
+    cli_settings_pluginsync << setting_flag << val unless val.nil?
+  end
+
+  Puppet.initialize_settings(cli_base + cli_settings_pluginsync)
 end
-cli_base.concat([
-  '--modulepath',
-  moduledir,
-  '--plugindest',
-  plugin_dest,
-  '--pluginfactdest',
-  pluginfact_dest
-])
-# There will always be at least a single master URI
-# TODO: make sure comma separated is what --server_list expects
-server_list = args['primary_uris'].map { |uri| URI.parse(uri).host }.join(',')
-
-# These settings are required for communication with puppetserver. This is primarily for
-# pluginsync but it is also required if a catalog requires files from modules served by 
-# puppetserver (Puppet[:default_file_terminus] = rest by default)
-cli_settings_pluginsync = [
-  '--localcacert',
-  args['ca'],
-  '--hostcert',
-  args['crt'],
-  '--hostprivkey',
-  args['key'],
-  '--hostcrl',
-  args['crl'],
-  '--server_list',
-  server_list
-]
-
-# Break apart proxy and extract individual settings
-proxy_flags = {
-  user: '--http_proxy_user',
-  password: '--http_proxy_password',
-  port: '--http_proxy_port',
-  host: '--http_proxy_host'
-}
-# Proxy will always be a string (even if its empty)
-parsed_proxy = URI.parse(args['proxy'])
-proxy_flags.each do |uri_method, setting_flag|
-  val = parsed_proxy.send(uri_method)
-  cli_settings_pluginsync << setting_flag << val unless val.nil?
+
+PLUGIN_SOURCES = {
+  'plugins' => [:pluginsource, :plugindest],
+  'pluginfacts' => [:pluginfactsource, :pluginfactdest]
+}.freeze
+
+# Return the metadata of the plugin and pluginfact files served for the
+# environment, as [name, metadata] pairs, or nil if it can't be retrieved.
+def remote_plugin_metadata(environment)
+  PLUGIN_SOURCES.flat_map do |name, (source, _)|
+    metadatas = Puppet::FileServing::Metadata.indirection.search(
+      Puppet[source],
+      environment: environment,
+      recurse: true,
+      links: :manage,
+      ignore: Puppet[:pluginsignore].split(/\s+/),
+      checksum_type: Puppet[:digest_algorithm].to_sym
+    )
+    (metadatas || []).map { |metadata| [name, metadata] }
+  end
+rescue StandardError => e
+  Puppet.debug("Could not retrieve the metadata of plugins: #{e}")
+  nil
 end
 
-exit_code = 0
-begin
+# The checksum of directories is their ctime, which depends on the server
+# that served them; it is left out so that the digest only changes with the
+# content of the plugins.
+def plugin_manifest_digest(metadata)
+  entries = metadata.map do |name, m|
+    checksum = m.ftype == 'directory' ? '' : m.checksum.to_s
+    [name, m.relative_path, m.ftype, m.mode.to_s, checksum].join("\t")
+  end
+  Digest::SHA256.hexdigest(entries.sort.join("\n"))
+end
 
-  Puppet.initialize_settings(cli_base + cli_settings_pluginsync)
+# Whether the local copy of every file listed in the metadata has the
+# expected checksum.
+def plugin_cache_matches?(metadata)
+  metadata.all? do |name, m|
+    path = File.join(Puppet[PLUGIN_SOURCES[name][1]], m.relative_path)
+    case m.ftype
+    when 'directory'
+      File.directory?(path)
+    when 'file'
+      type = m.checksum_type.to_s
+      File.file?(path) &&
+        Puppet::Util::Checksums.method("#{type}_file").call(path) == Puppet::Util::Checksums.sumdata(m.checksum)
+    else
+      File.symlink?(path) || File.exist?(path)
+    end
+  end
+rescue StandardError => e
+  Puppet.debug("Could not verify the plugin cache: #{e}")
+  false
+end
+
+def read_plugin_manifest(manifest_path)
+  JSON.parse(File.read(manifest_path))['digest']
+rescue StandardError
+  nil
+end
+
+def write_plugin_manifest(manifest_path, digest)
+  tmp_path = "#{manifest_path}.#{Process.pid}"
+  File.write(tmp_path, JSON.generate('digest' => digest))
+  File.rename(tmp_path, manifest_path)
+end
+
+# Synchronize the plugins of the environment with puppetserver.
+#
+# The plugin cache keeps a manifest with the digest of the metadata of the
+# files it was synchronized with; the sync is skipped if the server still
+# serves the same files. Otherwise the downloaders only transfer the files
+# whose checksum differs from the local copy. The manifest is only updated
+# once all files are verified.
+#
+# Returns the digest of the plugins served for the environment if the cache
+# is in sync with them, or nil otherwise.
+#
+# The sync holds an exclusive lock on the plugin cache, so that concurrent
+# requests for the same environment wait for the sync in flight and then
+# find the manifest up to date.
+def pluginsync(plugin_cache, environment)
+  manifest_path = File.join(plugin_cache, '.pluginsync_manifest.json')
+  File.open(File.join(plugin_cache, '.pluginsync.lock'), File::RDWR | File::CREAT, 0o600) do |lock|
+    lock.flock(File::LOCK_EX)
+
+    metadata = remote_plugin_metadata(environment)
+    digest = metadata && plugin_manifest_digest(metadata)
+    if digest && digest == read_plugin_manifest(manifest_path)
+      Puppet.debug("Plugins of environment #{environment} are up to date")
+      return digest
+    end
+    FileUtils.rm_f(manifest_path)
+
+    downloader = Puppet::Configurer::Downloader.new(
+      "plugin",
+      Puppet[:plugindest],
+      Puppet[:pluginsource],
+      Puppet[:pluginsignore],
+      environment
+    )
+    downloader.evaluate
+
+    source_permissions = Puppet::Util::Platform.windows? ? :ignore : :use
+    plugin_fact_downloader = Puppet::Configurer::Downloader.new(
+      "pluginfacts",
+      Puppet[:pluginfactdest],
+      Puppet[:pluginfactsource],
+      Puppet[:pluginsignore],
+      environment,
+      source_permissions
+    )
+    plugin_fact_downloader.evaluate
+
+    if digest && plugin_cache_matches?(metadata)
+      write_plugin_manifest(manifest_path, digest)
+      digest
+    end
+  end
+end
 
+# Pluginsync, resolve facts and either apply the catalog or print the facts;
+# the pluginsync action only prints the digest of the synced plugins.
+# Returns the exit code.
+def run_action(args)
   remote_env_for_plugins = Puppet::Node::Environment.remote(args['environment'])
-  downloader = Puppet::Configurer::Downloader.new(
-    "plugin",
-    Puppet[:plugindest],
-    Puppet[:pluginsource],
-    Puppet[:pluginsignore],
-    remote_env_for_plugins
-  )
-  downloader.evaluate
-
-  source_permissions = Puppet::Util::Platform.windows? ? :ignore : :use
-  plugin_fact_downloader = Puppet::Configurer::Downloader.new(
-    "pluginfacts",
-    Puppet[:pluginfactdest],
-    Puppet[:pluginfactsource],
-    Puppet[:pluginsignore],
-    remote_env_for_plugins,
-    source_permissions
-  )
-  plugin_fact_downloader.evaluate
+  digest = pluginsync(args['plugin_cache'], remote_env_for_plugins)
+  if args['action'] == 'pluginsync'
+    puts digest.to_s
+    return digest ? 0 : 1
+  end
 
   # Append the newe paths to the load path (copying them over to the new vardir takes time and seems unneeded)
-  $LOAD_PATH << plugin_dest << pluginfact_dest
+  $LOAD_PATH << Puppet[:plugindest] << Puppet[:pluginfactdest]
 
   # Avoid extraneous output
   Puppet[:report] = false
@@ -170,22 +274,136 @@ begin
     end
 
     puts JSON.pretty_generate(report.to_data_hash)
-    exit_code = report.exit_status != 1
+    report.exit_status != 1 ? 0 : 1
   else
     facts.name = facts.values['clientcert']
     puts facts.values.to_json
+    0
   end
-ensure
+end
+
+def remove_puppet_root(puppet_root)
+  FileUtils.remove_dir(puppet_root)
+rescue Errno::ENOTEMPTY => e
+  STDERR.puts("Could not cleanup temporary directory: #{e}")
+end
+
+# Process a request received by a worker in a child process, so that the worker's
+# Puppet state is never modified. The PID of the child is sent first, followed by
+# "<exitcode> <stdout size> <stderr size>\n<stdout><stderr>".
+def process_request(client, server)
+  args = JSON.parse(client.read)
+  pid = fork do
+    begin
+      Signal.trap('TERM', 'DEFAULT')
+      # Lead a process group, so that pxp-agent can terminate the request
+      # once its deadline expires without terminating the worker
+      Process.setpgid(0, 0)
+      server.close
+      client.write("#{Process.pid}\n")
+      client.flush
+
+      # Use new directories for state, reports and logs, as a new process would do
+      request_root = Dir.mktmpdir
+      [:vardir, :logdir, :rundir].each do |setting|
+        Puppet[setting] = File.join(request_root, setting.to_s.chomp('dir'))
+      end
+
+      out = Tempfile.new('stdout')
+      err = Tempfile.new('stderr')
+      $stdout.reopen(out)
+      $stderr.reopen(err)
+      exit_code = 1
+      begin
+        exit_code = run_action(args)
+      rescue Exception => e # rubocop:disable Lint/RescueException
+        STDERR.puts("#{e.class}: #{e.message}\n#{(e.backtrace || []).join("\n")}")
+      ensure
+        remove_puppet_root(request_root)
+      end
+      $stdout.flush
+      $stderr.flush
+      stdout = File.binread(out.path)
+      stderr = File.binread(err.path)
+      out.close!
+      err.close!
+      client.write("#{exit_code} #{stdout.bytesize} #{stderr.bytesize}\n")
+      client.write(stdout)
+      client.write(stderr)
+      client.close
+    ensure
+      exit!(0)
+    end
+  end
+  Process.wait(pid)
+end
+
+# Initialize Puppet once, then accept requests on the socket until stopped with
+# SIGTERM, idle for idle_timeout seconds, or until the socket is removed or
+# pxp-agent exits.
+def serve(args, socket_path, idle_timeout)
+  Signal.trap('TERM') { exit }
+  puppet_root = Dir.mktmpdir
+  initialize_puppet(args, puppet_root)
+
+  parent = Process.ppid
+  FileUtils.rm_f(socket_path)
+  # Bind with a restrictive umask, so that the socket is never accessible to
+  # other users, not even until a chmod
+  umask = File.umask(0o077)
   begin
-    FileUtils.remove_dir(puppet_root)
-  rescue Errno::ENOTEMPTY => e
-    STDERR.puts("Could not cleanup temporary directory: #{e}")
+    server = UNIXServer.new(socket_path)
+  ensure
+    File.umask(umask)
+  end
+  last_request = Time.now
+  loop do
+    break if Process.ppid != parent || !File.socket?(socket_path)
+    unless IO.select([server], nil, nil, 5)
+      break if Time.now - last_request > idle_timeout
+      next
+    end
+    client = server.accept
+    begin
+      process_request(client, server)
+    rescue StandardError => e
+      STDERR.puts("Failed to process request: #{e}")
+    ensure
+      client.close
+    end
+    last_request = Time.now
+  end
+ensure
+  if server
+    server.close
+    FileUtils.rm_f(socket_path)
   end
+  remove_puppet_root(puppet_root) if puppet_root
+end
+
+if ARGV[0] == '--worker'
+  serve(JSON.parse(STDIN.read), ARGV[1], Integer(ARGV[2]))
+  exit 0
+end
+
+## TODO: Option to read from a file is for debugging. Only read from stdin in production.
+args = JSON.parse(ARGV[0] ? File.read(ARGV[0]) : STDIN.read)
+
+puppet_root = Dir.mktmpdir
+exit_code = 0
+begin
+  initialize_puppet(args, puppet_root)
+  exit_code = run_action(args)
+ensure
+  remove_puppet_root(puppet_root)
 end
 
 exit exit_code
 )" };
 
+    // Workers exit after being idle for this long
+    static const uint32_t APPLY_WORKER_IDLE_TIMEOUT_S { 15 * 60 };
+
     Apply::Apply(const fs::path& exec_prefix,
                  const std::vector<std::string>& primary_uris,
                  const std::string& ca,
@@ -193,6 +411,8 @@ exit exit_code
                  const std::string& key,
                  const std::string& crl,
                  const std::string& proxy,
+                 uint32_t worker_pool_size,
+                 const std::string& fact_cache_ttl,
                  std::shared_ptr<ModuleCacheDir> module_cache_dir,
                  std::shared_ptr<ResultsStorage> storage) :
         BoltModule { exec_prefix, std::move(storage), std::move(module_cache_dir) },
@@ -202,38 +422,81 @@ exit exit_code
         crt_ { crt },
         key_ { key },
         crl_ { crl },
-        proxy_ { proxy }
+        proxy_ { proxy },
+        worker_pool_ { new Util::ApplyWorkerPool(worker_pool_size,
+                                                 fs::path(module_cache_dir_->cache_dir_) / "apply_workers",
+                                                 APPLY_WORKER_IDLE_TIMEOUT_S) },
+        ruby_shim_mtime_ { -1 },
+        fact_cache_ttl_ { Timestamp::getMinutes(fact_cache_ttl) }
     {
         module_name = "apply";
         actions.push_back(apply_ACTION);
         actions.push_back(prep_ACTION);
-        PCPClient::Schema apply_input_schema { apply_ACTION, lth_jc::JsonContainer { apply_ACTION_INPUT_SCHEMA } };
-        input_validator_.registerSchema(apply_input_schema);
+        // Checked structurally, so that the catalog is never walked
+        Util::StructuralSchema apply_input_schema { apply_ACTION };
+        apply_input_schema.addConstraint("catalog", PCPClient::TypeConstraint::Object, true);
+        apply_input_schema.addConstraint("apply_options", PCPClient::TypeConstraint::Object, true);
+        registerInputSchema(apply_input_schema);
 
-        PCPClient::Schema prep_input_schema { prep_ACTION };
+        Util::StructuralSchema prep_input_schema { prep_ACTION };
         prep_input_schema.addConstraint("environment", PCPClient::TypeConstraint::String, true);
-        input_validator_.registerSchema(prep_input_schema);
+        prep_input_schema.addConstraint("refresh_facts", PCPClient::TypeConstraint::Bool, false);
+        registerInputSchema(prep_input_schema);
 
-        PCPClient::Schema apply_output_schema { apply_ACTION };
-        results_validator_.registerSchema(apply_output_schema);
+        Util::StructuralSchema apply_output_schema { apply_ACTION };
+        registerResultsSchema(apply_output_schema);
 
 
-        PCPClient::Schema prep_output_schema { prep_ACTION };
-        results_validator_.registerSchema(prep_output_schema);
+        Util::StructuralSchema prep_output_schema { prep_ACTION };
+        registerResultsSchema(prep_output_schema);
     }
 
     // This is copied here for now until we decide how to manage the ruby shim
     // NIX_DIR_PERMS is defined in pxp-agent/configuration
     #define NIX_DOWNLOADED_FILE_PERMS NIX_DIR_PERMS
 
+    Apply::RequestParams Apply::decodeParams(const ActionRequest& request)
+    {
+        if (request.action() == apply_ACTION)
+            return RequestParams { Util::ApplyParams::decode(request.params()).environment,
+                                   false };
+        auto prep_params = Util::PrepParams::decode(request.params());
+        return RequestParams { std::move(prep_params.environment),
+                               prep_params.refresh_facts };
+    }
+
+    // Append the entries set by pxp-agent to the serialized request
+    // params, instead of adding them to a copy of the params (that
+    // includes the whole catalog); later entries take precedence
+    static std::string spliceShimInput(const std::string& params_txt,
+                                       const std::string& shim_settings_txt)
+    {
+        assert(params_txt.size() >= 2 && shim_settings_txt.size() > 2);
+        if (params_txt == "{}")
+            return shim_settings_txt;
+
+        std::string input {};
+        input.reserve(params_txt.size() + shim_settings_txt.size());
+        input.append(params_txt, 0, params_txt.size() - 1);
+        input.push_back(',');
+        input.append(shim_settings_txt, 1, std::string::npos);
+        return input;
+    }
+
     Util::CommandObject Apply::buildCommandObject(const ActionRequest& request)
+    {
+        return buildCommandObject(request, decodeParams(request));
+    }
+
+    Util::CommandObject Apply::buildCommandObject(const ActionRequest& request,
+                                                  const RequestParams& request_params)
     {
         if (crl_ == "") {
           throw Configuration::Error { lth_loc::format("ssl-crl setting is requried for apply") };
         }
         // Shared
         auto action = request.action();
-        auto params = request.params();
+        lth_jc::JsonContainer params {};
         params.set<std::string>("ca", ca_);
         params.set<std::string>("crt", crt_);
         params.set<std::string>("key", key_);
@@ -245,23 +508,28 @@ exit exit_code
         const std::string ruby_shim_cache_dir = "apply_ruby_shim";
         const fs::path& cache_dir = module_cache_dir_->createCacheDir(ruby_shim_cache_dir);
 
-        std::string plugin_cache_name;
-
         const std::string ruby_shim_script_name = "apply_ruby_shim.rb";
         auto apply_ruby_shim_path = cache_dir / ruby_shim_script_name;
 
-        if (!fs::exists(apply_ruby_shim_path)) {
-          lth_file::atomic_write_to_file(APPLY_RUBY_SHIM, apply_ruby_shim_path.string(), NIX_DOWNLOADED_FILE_PERMS, std::ios::binary);
+        // Also replace the copy left by a different pxp-agent version;
+        // it's only read again if it changed since it was checked last
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { ruby_shim_mutex_ };
+            boost::system::error_code ec;
+            auto mtime = fs::last_write_time(apply_ruby_shim_path, ec);
+            if (ec || mtime != ruby_shim_mtime_) {
+                if (ec || lth_file::read(apply_ruby_shim_path.string()) != APPLY_RUBY_SHIM) {
+                  lth_file::atomic_write_to_file(APPLY_RUBY_SHIM, apply_ruby_shim_path.string(), NIX_DOWNLOADED_FILE_PERMS, std::ios::binary);
+                }
+                ruby_shim_mtime_ = fs::last_write_time(apply_ruby_shim_path, ec);
+                if (ec)
+                    ruby_shim_mtime_ = -1;
+            }
         }
 
-        if (action == "apply") {
-            plugin_cache_name = params.get<std::string>({"catalog", "environment"});
-            params.set<std::string>("environment", params.get<std::string>({"catalog", "environment"}));
-            params.set<std::string>("action", "apply");
-        } else {
-            plugin_cache_name = params.get<std::string>("environment");
-            params.set<std::string>("action", "prep");
-        }
+        const auto& plugin_cache_name = request_params.environment;
+        params.set<std::string>("environment", plugin_cache_name);
+        params.set<std::string>("action", action == apply_ACTION ? "apply" : "prep");
 
         const auto plugin_cache = module_cache_dir_->createCacheDir(plugin_cache_name);
         params.set<std::string>("plugin_cache", plugin_cache.string());
@@ -270,7 +538,7 @@ exit exit_code
             "",  // Executable will be detremined by findExecutableAndArguments
             {},  // No args for invoking shim
             {},  // Shim expects catalog on stdin
-            params.toString(),  // JSON encoded string to be passed to shim on stdin
+            spliceShimInput(request.paramsTxt(), params.toString()),  // Passed to shim on stdin
             [results_dir](size_t pid) {
                 auto pid_file = (results_dir / "pid").string();
                 lth_file::atomic_write_to_file(std::to_string(pid) + "\n", pid_file,
@@ -282,13 +550,298 @@ exit exit_code
         return cmd;
     }
 
+    // The settings required by a worker to initialize Puppet
+    std::string Apply::getWorkerInput(const std::string& environment)
+    {
+        lth_jc::JsonContainer worker_input {};
+        worker_input.set<std::string>("ca", ca_);
+        worker_input.set<std::string>("crt", crt_);
+        worker_input.set<std::string>("key", key_);
+        worker_input.set<std::string>("crl", crl_);
+        worker_input.set<std::string>("proxy", proxy_);
+        worker_input.set<std::string>("environment", environment);
+        worker_input.set<std::string>("plugin_cache",
+            (fs::path(module_cache_dir_->cache_dir_) / environment).string());
+        worker_input.set<std::vector<std::string>>("primary_uris", primary_uris_);
+        return worker_input.toString();
+    }
+
+    bool Apply::useWorkers() const
+    {
+        // Requests processed by a worker would run in the cgroup of the
+        // worker, with no limits nor resource usage of their own
+        return worker_pool_->enabled() && !Util::ActionCGroups::Instance().enabled();
+    }
+
+    bool Apply::runOnWorker(const ActionRequest& request,
+                            const RequestParams& request_params,
+                            const Util::CommandObject& command,
+                            Util::ActionDeadline* deadline,
+                            ActionResponse& response)
+    {
+        if (!useWorkers())
+            return false;
+
+        const auto& environment = request_params.environment;
+
+        // The deadline applies to the process that executes the request;
+        // the worker itself keeps running
+        auto pid_callback = command.pid_callback;
+        if (deadline)
+            pid_callback = deadline->arming(pid_callback);
+
+        try {
+            return worker_pool_->run(environment,
+                                     command,
+                                     getWorkerInput(environment),
+                                     command.input,
+                                     response.output,
+                                     pid_callback);
+        } catch (const Util::ApplyWorkerPool::Error& e) {
+            // The output is lost if the process was terminated
+            if (deadline && deadline->expired()) {
+                response.output = ActionOutput { EXIT_FAILURE, "", e.what() };
+                return true;
+            }
+            throw Module::ProcessingError {
+                lth_loc::format("The apply worker for environment '{1}' failed to "
+                                "process the {2}: {3}",
+                                environment, request.prettyLabel(), e.what()) };
+        }
+    }
+
+    std::string Apply::getPluginVersion(const std::string& environment)
+    {
+        // Written by the shim once the plugin cache is in sync
+        auto manifest_path = fs::path(module_cache_dir_->cache_dir_)
+                             / environment / ".pluginsync_manifest.json";
+        std::string manifest {};
+        if (!fs::exists(manifest_path) || !lth_file::read(manifest_path.string(), manifest))
+            return "";
+
+        try {
+            lth_jc::JsonContainer manifest_json { manifest };
+            if (manifest_json.includes("digest")
+                    && manifest_json.type("digest") == lth_jc::DataType::String)
+                return manifest_json.get<std::string>("digest");
+        } catch (const lth_jc::data_parse_error&) {
+        }
+        return "";
+    }
+
+    std::string Apply::syncPlugins(const ActionRequest& request,
+                                   const RequestParams& request_params,
+                                   const Util::CommandObject& command)
+    {
+        const auto& environment = request_params.environment;
+        auto sync_command = command;
+        sync_command.input = spliceShimInput(command.input, "{\"action\":\"pluginsync\"}");
+        sync_command.pid_callback = nullptr;
+
+        ActionOutput output { EXIT_FAILURE, "", "" };
+        try {
+            if (!useWorkers()
+                    || !worker_pool_->run(environment,
+                                          sync_command,
+                                          getWorkerInput(environment),
+                                          sync_command.input,
+                                          output)) {
+                auto exec = run_sync(sync_command, nullptr);
+                output = ActionOutput { exec.exit_code, exec.output, exec.error };
+            }
+        } catch (const std::exception& e) {
+            LOG_WARNING("Failed to synchronize the plugins of environment '{1}' for the {2}: {3}",
+                        environment, request.prettyLabel(), e.what());
+            return "";
+        }
+
+        if (output.exitcode != EXIT_SUCCESS) {
+            LOG_DEBUG("Failed to synchronize the plugins of environment '{1}' for the {2}: {3}",
+                      environment, request.prettyLabel(), output.std_err);
+            return "";
+        }
+        return boost::algorithm::trim_copy(output.std_out);
+    }
+
+    bool Apply::getCachedFacts(const ActionRequest& request,
+                               const RequestParams& request_params,
+                               const Util::CommandObject& command,
+                               ActionOutput& output)
+    {
+        if (fact_cache_ttl_.count() == 0 || request.action() != prep_ACTION)
+            return false;
+
+        const auto& environment = request_params.environment;
+        CachedFacts cached_facts {};
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { fact_cache_mutex_ };
+            auto cached = fact_cache_.find(environment);
+            if (cached == fact_cache_.end())
+                return false;
+
+            if (request_params.refresh_facts) {
+                LOG_DEBUG("Refreshing the cached facts of environment '{1}' for the {2}",
+                          environment, request.prettyLabel());
+                fact_cache_.erase(cached);
+                return false;
+            }
+
+            if (pcp_util::chrono::steady_clock::now() - cached->second.time > fact_cache_ttl_) {
+                fact_cache_.erase(cached);
+                return false;
+            }
+            cached_facts = cached->second;
+        }
+
+        // The facts are only valid for the plugins currently served for
+        // the environment; syncing them also keeps the plugin cache up to
+        // date, as a prep would do
+        if (syncPlugins(request, request_params, command) != cached_facts.plugin_version) {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { fact_cache_mutex_ };
+            auto cached = fact_cache_.find(environment);
+            if (cached != fact_cache_.end()
+                    && cached->second.plugin_version == cached_facts.plugin_version)
+                fact_cache_.erase(cached);
+            return false;
+        }
+
+        LOG_DEBUG("Using the cached facts of environment '{1}' for the {2}",
+                  environment, request.prettyLabel());
+        output = ActionOutput { EXIT_SUCCESS, std::move(cached_facts.facts), "" };
+        return true;
+    }
+
+    void Apply::updateFactCache(const ActionRequest& request,
+                                const RequestParams& request_params,
+                                const ActionOutput& output)
+    {
+        if (fact_cache_ttl_.count() == 0)
+            return;
+
+        const auto& environment = request_params.environment;
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { fact_cache_mutex_ };
+
+        // Applying a catalog may change any fact of the host, whatever
+        // the environment of the catalog
+        if (request.action() != prep_ACTION) {
+            fact_cache_.clear();
+            return;
+        }
+
+        if (output.exitcode != EXIT_SUCCESS) {
+            fact_cache_.erase(environment);
+            return;
+        }
+
+        auto plugin_version = getPluginVersion(environment);
+        if (plugin_version.empty()) {
+            fact_cache_.erase(environment);
+            return;
+        }
+
+        fact_cache_[environment] = CachedFacts { std::move(plugin_version),
+                                                 pcp_util::chrono::steady_clock::now(),
+                                                 output.std_out };
+    }
+
+    ActionResponse Apply::callAction(const ActionRequest& request)
+    {
+        // Decoded once, for all the steps of the request
+        auto request_params = decodeParams(request);
+        auto command = buildCommandObject(request, request_params);
+        ActionResponse response { ModuleType::Internal, request };
+
+        if (request.type() == RequestType::Blocking) {
+            processBlockingAction(request, request_params, command, response);
+        } else {
+            processNonBlockingAction(request, request_params, command, response);
+        }
+
+        return response;
+    }
+
+    void Apply::callBlockingAction(const ActionRequest& request,
+                                   const Util::CommandObject& command,
+                                   ActionResponse& response)
+    {
+        processBlockingAction(request, decodeParams(request), command, response);
+    }
+
+    void Apply::processBlockingAction(const ActionRequest& request,
+                                      const RequestParams& request_params,
+                                      const Util::CommandObject& command,
+                                      ActionResponse& response)
+    {
+        if (getCachedFacts(request, request_params, command, response.output)) {
+            processOutputAndUpdateMetadata(response);
+            return;
+        }
+
+        std::unique_ptr<Util::ActionDeadline> deadline {};
+        if (useWorkers())
+            deadline = Util::ActionDeadlines::Instance().create(request);
+        if (runOnWorker(request, request_params, command, deadline.get(), response)) {
+            processOutputAndUpdateMetadata(response);
+            if (deadline)
+                deadline->updateResponse(response);
+        } else {
+            BoltModule::callBlockingAction(request, command, response);
+        }
+        updateFactCache(request, request_params, response.output);
+    }
+
+    // Store the output as the execution wrapper would do; the exit code
+    // must be written last, as it flags the output as ready
+    static void writeOutput(const fs::path& results_dir, const ActionOutput& output)
+    {
+        lth_file::atomic_write_to_file(output.std_out,
+                                       (results_dir / "stdout").string(),
+                                       NIX_FILE_PERMS, std::ios::binary);
+        lth_file::atomic_write_to_file(output.std_err,
+                                       (results_dir / "stderr").string(),
+                                       NIX_FILE_PERMS, std::ios::binary);
+        lth_file::atomic_write_to_file(std::to_string(output.exitcode),
+                                       (results_dir / "exitcode").string(),
+                                       NIX_FILE_PERMS, std::ios::binary);
+    }
+
+    void Apply::callNonBlockingAction(const ActionRequest& request,
+                                      const Util::CommandObject& command,
+                                      ActionResponse& response)
+    {
+        processNonBlockingAction(request, decodeParams(request), command, response);
+    }
+
+    void Apply::processNonBlockingAction(const ActionRequest& request,
+                                         const RequestParams& request_params,
+                                         const Util::CommandObject& command,
+                                         ActionResponse& response)
+    {
+        if (getCachedFacts(request, request_params, command, response.output)) {
+            writeOutput(request.resultsDir(), response.output);
+            processOutputAndUpdateMetadata(response);
+            return;
+        }
+
+        std::unique_ptr<Util::ActionDeadline> deadline {};
+        if (useWorkers())
+            deadline = Util::ActionDeadlines::Instance().create(request);
+        if (runOnWorker(request, request_params, command, deadline.get(), response)) {
+            writeOutput(request.resultsDir(), response.output);
+            processOutputAndUpdateMetadata(response);
+            if (deadline)
+                deadline->updateResponse(response);
+        } else {
+            BoltModule::callNonBlockingAction(request, command, response);
+        }
+        updateFactCache(request, request_params, response.output);
+    }
+
     unsigned int Apply::purge(
         const std::string& ttl,
         std::vector<std::string> ongoing_transactions,
         std::function<void(const std::string& dir_path)> purge_callback)
     {
-        if (purge_callback == nullptr)
-            purge_callback = &Purgeable::defaultDirPurgeCallback;
         return module_cache_dir_->purgeCache(ttl, ongoing_transactions, purge_callback);
     }
 
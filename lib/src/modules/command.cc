@@ -1,6 +1,7 @@
 #include <pxp-agent/modules/command.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/util/module_params.hpp>
 #include <leatherman/file_util/file.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/algorithm/string.hpp>
@@ -26,22 +27,17 @@ Command::Command(const fs::path& exec_prefix, std::shared_ptr<ResultsStorage> st
     actions.push_back(COMMAND_RUN_ACTION);
 
     // Command actions require a single "command" string parameter
-    PCPClient::Schema input_schema { COMMAND_RUN_ACTION };
+    Util::StructuralSchema input_schema { COMMAND_RUN_ACTION };
     input_schema.addConstraint("command", PCPClient::TypeConstraint::String, true);
-    input_validator_.registerSchema(input_schema);
+    registerInputSchema(input_schema);
 
-    PCPClient::Schema output_schema { COMMAND_RUN_ACTION };
-    results_validator_.registerSchema(output_schema);
+    Util::StructuralSchema output_schema { COMMAND_RUN_ACTION };
+    registerResultsSchema(output_schema);
 }
 
 Util::CommandObject Command::buildCommandObject(const ActionRequest& request)
 {
-    const auto params = request.params();
-
-    assert(params.includes("command") &&
-           params.type("command") == lth_jc::DataType::String);
-
-    auto raw_command = params.get<std::string>("command");
+    auto raw_command = Util::CommandParams::decode(request.params()).command;
     #ifdef _WIN32
         // We use powershell for windows because this will match bolt's behavior:
         // bolt uses WinRM as a transport for windows, and WinRM uses powershell.exe
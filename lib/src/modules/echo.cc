@@ -13,17 +13,17 @@ static const std::string ECHO { "echo" };
 Echo::Echo() {
     module_name = ECHO;
     actions.push_back(ECHO);
-    PCPClient::Schema input_schema { ECHO };
+    Util::StructuralSchema input_schema { ECHO };
     input_schema.addConstraint("argument", PCPClient::TypeConstraint::String,
                                true);
-    PCPClient::Schema output_schema { ECHO };
+    Util::StructuralSchema output_schema { ECHO };
 
-    input_validator_.registerSchema(input_schema);
-    results_validator_.registerSchema(output_schema);
+    registerInputSchema(input_schema);
+    registerResultsSchema(output_schema);
 }
 
 ActionResponse Echo::callAction(const ActionRequest& request) {
-    auto params = request.params();
+    const auto& params = request.params();
 
     assert(params.includes("argument")
            && params.type("argument") == lth_jc::DataType::String);
@@ -1,6 +1,7 @@
 #include <pxp-agent/modules/file.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
 #include <pxp-agent/util/bolt_module.hpp>
+#include <pxp-agent/util/module_params.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/module.hpp>
 #include <boost/algorithm/hex.hpp>
@@ -86,10 +87,10 @@ namespace Modules {
     actions.push_back(FILE_ACTION);
 
     PCPClient::Schema input_schema { FILE_ACTION, lth_jc::JsonContainer { FILE_ACTION_INPUT_SCHEMA } };
-    PCPClient::Schema output_schema { FILE_ACTION };
+    Util::StructuralSchema output_schema { FILE_ACTION };
 
     input_validator_.registerSchema(input_schema);
-    results_validator_.registerSchema(output_schema);
+    registerResultsSchema(output_schema);
 
     client_.set_ca_cert(ca);
     client_.set_client_cert(crt, key);
@@ -127,23 +128,21 @@ namespace Modules {
   // based on if the download succeeded or failed.
   ActionResponse File::callAction(const ActionRequest& request)
   {
-    auto file_params = request.params();
-    auto files = file_params.get<std::vector<lth_jc::JsonContainer>>("files");
+    auto file_params = Util::FileParams::decode(request.params());
     const fs::path& results_dir = request.resultsDir();
 
     ActionResponse response { ModuleType::Internal, request };
-    lth_jc::JsonContainer result;
-    for (auto this_file : files) {
-      auto destination = fs::path(this_file.get<std::string>("destination"));
-      auto kind = this_file.get<std::string>("kind");
+    for (const auto& this_file : file_params.files) {
+      auto destination = fs::path(this_file.destination);
+      const auto& kind = this_file.kind;
       if (kind == "file") {
         module_cache_dir_->downloadFileFromMaster(master_uris_,
                                                   file_download_connect_timeout_,
                                                   file_download_timeout_,
                                                   client_,
-                                                  module_cache_dir_->createCacheDir(this_file.get<std::string>("sha256")),
+                                                  module_cache_dir_->createCacheDir(this_file.source.sha256),
                                                   destination,
-                                                  this_file);
+                                                  this_file.source);
       } else if (kind == "directory"){
         if (fs::exists(destination)) {
           if (!fs::is_directory(destination)) {
@@ -158,7 +157,7 @@ namespace Modules {
             throw Module::ProcessingError { lth_loc::format("Destination {1} already exists and is not a symlink!", destination) };
           }
         } else {
-          Util::createSymLink(fs::path(this_file.get<std::string>("link_source")), destination);
+          Util::createSymLink(fs::path(this_file.link_source), destination);
         }
       } else {
         throw Module::ProcessingError { lth_loc::format("Not a valid file type! {1}", kind) };
@@ -175,8 +174,6 @@ namespace Modules {
       std::vector<std::string> ongoing_transactions,
       std::function<void(const std::string& dir_path)> purge_callback)
   {
-      if (purge_callback == nullptr)
-        purge_callback = &Purgeable::defaultDirPurgeCallback;
       return module_cache_dir_->purgeCache(ttl, ongoing_transactions, purge_callback);
   }
 
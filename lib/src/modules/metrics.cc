@@ -0,0 +1,54 @@
+#include <pxp-agent/modules/metrics.hpp>
+#include <pxp-agent/module_type.hpp>
+#include <pxp-agent/util/metrics.hpp>
+#include <pxp-agent/util/trace.hpp>
+
+#include <utility>  // std::move
+
+namespace PXPAgent {
+namespace Modules {
+
+namespace lth_jc = leatherman::json_container;
+
+static const std::string METRICS { "metrics" };
+static const std::string TRACE { "trace" };
+
+Metrics::Metrics() {
+    module_name = METRICS;
+    actions.push_back(METRICS);
+    actions.push_back(TRACE);
+
+    Util::StructuralSchema metrics_input_schema { METRICS };
+    Util::StructuralSchema metrics_output_schema { METRICS };
+    metrics_output_schema.addConstraint("metrics", PCPClient::TypeConstraint::Object, true);
+    registerInputSchema(metrics_input_schema);
+    registerResultsSchema(metrics_output_schema);
+
+    Util::StructuralSchema trace_input_schema { TRACE };
+    Util::StructuralSchema trace_output_schema { TRACE };
+    trace_output_schema.addConstraint("traceEvents", PCPClient::TypeConstraint::Array, true);
+    registerInputSchema(trace_input_schema);
+    registerResultsSchema(trace_output_schema);
+}
+
+ActionResponse Metrics::callAction(const ActionRequest& request) {
+    if (request.action() == TRACE) {
+        ActionResponse response { ModuleType::Internal, request };
+        response.setValidResultsAndEnd(lth_jc::JsonContainer { Util::Trace::toChromeTrace() });
+        return response;
+    }
+
+    lth_jc::JsonContainer metrics {};
+    for (const auto& family : Util::Metrics::Registry::Instance().collect())
+        for (const auto& sample : family.samples)
+            metrics.set<double>(Util::Metrics::seriesName(sample), sample.value);
+
+    ActionResponse response { ModuleType::Internal, request };
+    lth_jc::JsonContainer results {};
+    results.set<lth_jc::JsonContainer>("metrics", std::move(metrics));
+    response.setValidResultsAndEnd(std::move(results));
+    return response;
+}
+
+}  // namespace Modules
+}  // namespace PXPAgent
@@ -20,13 +20,13 @@ static const std::string PING { "ping" };
 Ping::Ping() {
     module_name = PING;
     actions.push_back(PING);
-    PCPClient::Schema input_schema { PING };
+    Util::StructuralSchema input_schema { PING };
     input_schema.addConstraint("sender_timestamp",
                                PCPClient::TypeConstraint::String);
-    PCPClient::Schema output_schema { PING };
+    Util::StructuralSchema output_schema { PING };
 
-    input_validator_.registerSchema(input_schema);
-    results_validator_.registerSchema(output_schema);
+    registerInputSchema(input_schema);
+    registerResultsSchema(output_schema);
 }
 
 lth_jc::JsonContainer Ping::ping(const ActionRequest& request) {
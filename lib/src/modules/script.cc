@@ -1,5 +1,6 @@
 #include <pxp-agent/modules/script.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/util/module_params.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/algorithm/string.hpp>
@@ -76,10 +77,10 @@ namespace Modules {
         actions.push_back(script_ACTION);
 
         PCPClient::Schema input_schema { script_ACTION, lth_jc::JsonContainer { script_ACTION_INPUT_SCHEMA } };
-        PCPClient::Schema output_schema { script_ACTION };
+        Util::StructuralSchema output_schema { script_ACTION };
 
         input_validator_.registerSchema(input_schema);
-        results_validator_.registerSchema(output_schema);
+        registerResultsSchema(output_schema);
 
         client_.set_ca_cert(ca);
         client_.set_client_cert(crt, key);
@@ -90,9 +91,7 @@ namespace Modules {
 
     Util::CommandObject Script::buildCommandObject(const ActionRequest& request)
     {
-        const auto params = request.params();
-        auto script = params.get<lth_jc::JsonContainer>("script");
-        auto arguments = params.get<std::vector<std::string>>("arguments");
+        auto params = Util::ScriptParams::decode(request.params());
         const fs::path& results_dir { request.resultsDir() };
 
         // get script from cache, download if necessary
@@ -100,11 +99,11 @@ namespace Modules {
                                                             download_connect_timeout_,
                                                             download_timeout_,
                                                             client_,
-                                                            module_cache_dir_->createCacheDir(script.get<std::string>("sha256")),
-                                                            script);
+                                                            module_cache_dir_->createCacheDir(params.script.sha256),
+                                                            params.script);
         Util::CommandObject cmd {
             "",         // Executable will be detremined by findExecutableAndArguments
-            arguments,  // Arguments
+            std::move(params.arguments),  // Arguments
             {},         // Environment
             "",         // Input
             [results_dir](size_t pid) {
@@ -123,8 +122,6 @@ namespace Modules {
         std::vector<std::string> ongoing_transactions,
         std::function<void(const std::string& dir_path)> purge_callback)
     {
-        if (purge_callback == nullptr)
-            purge_callback = &Purgeable::defaultDirPurgeCallback;
         return module_cache_dir_->purgeCache(ttl, ongoing_transactions, purge_callback);
     }
 }  // namespace Modules
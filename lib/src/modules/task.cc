@@ -3,6 +3,7 @@
 #include <pxp-agent/time.hpp>
 #include <pxp-agent/util/utf8.hpp>
 #include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/util/module_params.hpp>
 
 #include <cpp-pcp-client/util/chrono.hpp>
 
@@ -159,10 +160,10 @@ Task::Task(const fs::path& exec_prefix,
     actions.push_back(TASK_RUN_ACTION);
 
     PCPClient::Schema input_schema { TASK_RUN_ACTION, lth_jc::JsonContainer { TASK_RUN_ACTION_INPUT_SCHEMA } };
-    PCPClient::Schema output_schema { TASK_RUN_ACTION };
+    Util::StructuralSchema output_schema { TASK_RUN_ACTION };
 
     input_validator_.registerSchema(input_schema);
-    results_validator_.registerSchema(output_schema);
+    registerResultsSchema(output_schema);
 
     client_.set_ca_cert(ca);
     client_.set_client_cert(crt, key);
@@ -212,7 +213,7 @@ static fs::path createInstallDir(const fs::path& spool_dir, const std::set<std::
 
 // Get a unique list of "lib" files that the task has specified in metadata
 // this involves enumerating files when directories are requested
-std::set<std::string> getMultiFiles(std::vector<std::string> const& meta_files, std::vector<std::string>  const& impl_files, std::vector<lth_jc::JsonContainer> const& files) {
+std::set<std::string> getMultiFiles(std::vector<std::string> const& meta_files, std::vector<std::string>  const& impl_files, std::vector<Util::RemoteFile> const& files) {
     // build set of unique files to download and exclude the selected task executable
     std::set<std::string> download_set(meta_files.begin(), meta_files.end());
     download_set.insert(impl_files.begin(), impl_files.end());
@@ -228,9 +229,9 @@ std::set<std::string> getMultiFiles(std::vector<std::string> const& meta_files,
     // replace directories with it's child files
     for (auto f_name : directories) {
       download_set.erase(f_name);
-      for (auto f : files) {
-          if (f.get<std::string>("filename").substr(0, f_name.size()) == f_name) {
-              download_set.insert(f.get<std::string>("filename"));
+      for (const auto& f : files) {
+          if (f.filename.compare(0, f_name.size(), f_name) == 0) {
+              download_set.insert(f.filename);
           }
       }
     }
@@ -240,7 +241,7 @@ std::set<std::string> getMultiFiles(std::vector<std::string> const& meta_files,
 
 // iterate over unique set of filenames to support task
 // copy file from cache to install_dir
-fs::path Task::downloadMultiFile(std::vector<lth_jc::JsonContainer> const& files,
+fs::path Task::downloadMultiFile(std::vector<Util::RemoteFile> const& files,
                                  std::set<std::string> const& download_set,
                                  fs::path const& spool_dir)
 {
@@ -254,14 +255,14 @@ fs::path Task::downloadMultiFile(std::vector<lth_jc::JsonContainer> const& files
     auto install_dir = createInstallDir(spool, download_set);
     for (auto file_name : download_set) {
         // get file object info based on name
-        auto file_object = selectLibFile(files, file_name);
+        const auto& file_object = selectLibFile(files, file_name);
 
         // get file from cache, download if necessary
         auto lib_file = module_cache_dir_->getCachedFile(primary_uris_,
                                                          task_download_connect_timeout_,
                                                          task_download_timeout_,
                                                          client_,
-                                                         module_cache_dir_->createCacheDir(file_object.get<std::string>("sha256")),
+                                                         module_cache_dir_->createCacheDir(file_object.sha256),
                                                          file_object);
         // copy to expected location in install_dir
         fs::copy_file(lib_file, install_dir / fs::path(file_name));
@@ -270,13 +271,12 @@ fs::path Task::downloadMultiFile(std::vector<lth_jc::JsonContainer> const& files
     return install_dir;
 }
 
-lth_jc::JsonContainer Task::selectLibFile(std::vector<lth_jc::JsonContainer> const& files,
+Util::RemoteFile const& Task::selectLibFile(std::vector<Util::RemoteFile> const& files,
                                             std::string const& file_name)
 {
     auto file = std::find_if(files.cbegin(), files.cend(),
-        [&](lth_jc::JsonContainer const& file) {
-            auto filename = file.get<std::string>("filename");
-            return filename == file_name;
+        [&](Util::RemoteFile const& file) {
+            return file.filename == file_name;
         });
 
     if (file == files.cend()) {
@@ -286,13 +286,9 @@ lth_jc::JsonContainer Task::selectLibFile(std::vector<lth_jc::JsonContainer> con
     return *file;
 }
 
-struct Implementation {
-    std::string name;
-    std::string input_method;
-    std::vector<std::string> files;
-};
+using Implementation = Util::TaskParams::Implementation;
 
-static Implementation selectImplementation(std::vector<lth_jc::JsonContainer> const& implementations,
+static Implementation selectImplementation(std::vector<Implementation> const& implementations,
                                            std::set<std::string> const& features)
 {
     if (implementations.empty()) {
@@ -302,20 +298,13 @@ static Implementation selectImplementation(std::vector<lth_jc::JsonContainer> co
     // Select first entry in implementations where all requirements are in features.
     // If none, throw an error.
     auto impl = std::find_if(implementations.cbegin(), implementations.cend(),
-        [&](lth_jc::JsonContainer const& impl) {
-            auto reqs = impl.getWithDefault<std::vector<std::string>>("requirements", {});
-            if (reqs.empty()) {
-                return true;
-            } else {
-                return all_of(reqs.cbegin(), reqs.cend(),
-                    [&](std::string const& req) { return features.count(req) != 0; });
-            }
+        [&](Implementation const& impl) {
+            return all_of(impl.requirements.cbegin(), impl.requirements.cend(),
+                [&](std::string const& req) { return features.count(req) != 0; });
         });
 
     if (impl != implementations.cend()) {
-        auto input_method = impl->getWithDefault<std::string>("input_method", {});
-        auto files = impl->getWithDefault<std::vector<std::string>>("files", {});
-        return Implementation { impl->get<std::string>("name"), input_method, files };
+        return *impl;
     } else {
         auto feature_list = boost::algorithm::join(features, ", ");
         throw Module::ProcessingError {
@@ -323,8 +312,8 @@ static Implementation selectImplementation(std::vector<lth_jc::JsonContainer> co
     }
 }
 
-static lth_jc::JsonContainer selectTaskFile(std::vector<lth_jc::JsonContainer> const& files,
-                                            Implementation const& impl)
+static Util::RemoteFile const& selectTaskFile(std::vector<Util::RemoteFile> const& files,
+                                              Implementation const& impl)
 {
     if (files.empty()) {
         throw Module::ProcessingError {
@@ -337,9 +326,8 @@ static lth_jc::JsonContainer selectTaskFile(std::vector<lth_jc::JsonContainer> c
 
     // Select file based on impl.
     auto file = std::find_if(files.cbegin(), files.cend(),
-        [&](lth_jc::JsonContainer const& file) {
-            auto filename = file.get<std::string>("filename");
-            return filename == impl.name;
+        [&](Util::RemoteFile const& file) {
+            return file.filename == impl.name;
         });
 
     if (file == files.cend()) {
@@ -351,20 +339,17 @@ static lth_jc::JsonContainer selectTaskFile(std::vector<lth_jc::JsonContainer> c
 
 Util::CommandObject Task::buildCommandObject(const ActionRequest& request)
 {
-    auto task_execution_params = request.params();
-    auto task_metadata = task_execution_params.getWithDefault<lth_jc::JsonContainer>("metadata", task_execution_params);
-    auto task_name = task_execution_params.get<std::string>("task");
+    auto task_execution_params = Util::TaskParams::decode(request.params());
+    const auto& task_name = task_execution_params.task;
 
     std::set<std::string> feats = features();
-    auto extra_feats = task_metadata.getWithDefault<std::vector<std::string>>("features", {});
-    feats.insert(extra_feats.begin(), extra_feats.end());
+    feats.insert(task_execution_params.features.begin(), task_execution_params.features.end());
     LOG_DEBUG("Running task {1} with features: {2}", task_name, boost::algorithm::join(feats, ", "));
 
-    auto implementations = task_metadata.getWithDefault<std::vector<lth_jc::JsonContainer>>("implementations", {});
-    auto implementation = selectImplementation(implementations, feats);
+    auto implementation = selectImplementation(task_execution_params.implementations, feats);
 
-    if (implementation.input_method.empty() && task_metadata.includes("input_method")) {
-        implementation.input_method = task_metadata.get<std::string>("input_method");
+    if (implementation.input_method.empty()) {
+        implementation.input_method = task_execution_params.input_method;
     }
 
     static std::set<std::string> input_methods{{"stdin", "environment", "powershell", "both"}};
@@ -373,30 +358,24 @@ Util::CommandObject Task::buildCommandObject(const ActionRequest& request)
                 lth_loc::format("unsupported task input method: {1}", implementation.input_method) };
     }
 
-    auto files = task_execution_params.get<std::vector<lth_jc::JsonContainer>>("files");
-    auto file = selectTaskFile(files, implementation);
+    const auto& files = task_execution_params.files;
+    const auto& file = selectTaskFile(files, implementation);
     auto task_file = module_cache_dir_->getCachedFile(primary_uris_,
                                                       task_download_connect_timeout_,
                                                       task_download_timeout_,
                                                       client_,
-                                                      module_cache_dir_->createCacheDir(file.get<std::string>("sha256")),
+                                                      module_cache_dir_->createCacheDir(file.sha256),
                                                       file);
     // If input_method is unset use the default "powershell" for a powershell task or "both" for any other task
     if (implementation.input_method.empty()) {
         implementation.input_method = task_file.extension().string() == ".ps1" ? "powershell" : "both";
     }
 
-    auto task_params = task_execution_params.get<lth_jc::JsonContainer>("input");
+    auto& task_params = task_execution_params.input;
 
     task_params.set<std::string>("_task", task_name);
 
-    std::vector<std::string> meta_files;
-    // Only get files array from top level of metatdata instead of puppetserver supplied file data
-    try {
-        meta_files = task_metadata.getWithDefault<std::vector<std::string>>("files", {});
-    } catch (const leatherman::json_container::data_type_error& e) {}
-
-    auto lib_files = getMultiFiles(meta_files, implementation.files, files);
+    auto lib_files = getMultiFiles(task_execution_params.metadata_files, implementation.files, files);
 
     if (lib_files.size() > 0) {
         auto install_dir = downloadMultiFile(files, lib_files, request.resultsDir());
@@ -443,8 +422,6 @@ unsigned int Task::purge(
     std::vector<std::string> ongoing_transactions,
     std::function<void(const std::string& dir_path)> purge_callback)
 {
-    if (purge_callback == nullptr)
-      purge_callback = &Purgeable::defaultDirPurgeCallback;
     return module_cache_dir_->purgeCache(ttl, ongoing_transactions, purge_callback);
 }
 
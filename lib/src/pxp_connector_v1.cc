@@ -1,5 +1,6 @@
 #include <pxp-agent/pxp_connector_v1.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/util/metrics.hpp>
 
 #include <leatherman/json_container/json_container.hpp>
 
@@ -13,6 +14,11 @@ namespace PXPAgent {
 namespace lth_jc = leatherman::json_container;
 namespace lth_loc = leatherman::locale;
 
+static Util::Metrics::Counter& SEND_FAILURES {
+    Util::Metrics::Registry::Instance().counter(
+        "pxp_agent_send_failures_total",
+        "Messages that could not be sent to the broker") };
+
 //
 // PXPConnector V1
 //
@@ -67,6 +73,7 @@ void PXPConnectorV1::sendPCPError(const std::string& request_id,
         LOG_INFO("Replied to request {1} with a PCP error message",
                  request_id);
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send PCP error message for request {1}: {2}",
                   request_id, e.what());
     }
@@ -87,6 +94,7 @@ void PXPConnectorV1::sendProvisionalResponse(const ActionRequest& request)
         LOG_INFO("Sent provisional response for the {1} by {2}",
                  request.prettyLabel(), request.sender());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send provisional response for the {1} by {2} "
                   "(no further attempts will be made): {3}",
                   request.prettyLabel(), request.sender(), e.what());
@@ -109,6 +117,7 @@ void PXPConnectorV1::sendPXPError(const ActionRequest& request,
         LOG_INFO("Replied to {1} by {2}, request ID {3}, with a PXP error message",
                  request.prettyLabel(), request.sender(), request.id());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send a PXP error message for the {1} by {2} "
                   "(no further sending attempts will be made): {3}",
                   request.prettyLabel(), request.sender(), description);
@@ -130,6 +139,7 @@ void PXPConnectorV1::sendPXPError(const ActionResponse& response)
                  response.action_metadata.get<std::string>("requester"),
                  response.action_metadata.get<std::string>("request_id"));
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send a PXP error message for the {1} by {2} "
                   "(no further sending attempts will be made): {3}",
                   response.prettyRequestLabel(),
@@ -138,25 +148,36 @@ void PXPConnectorV1::sendPXPError(const ActionResponse& response)
     }
 }
 
+// The PCP v1 data chunk is the JSON text itself; send the serialized
+// response as it is, rather than a JsonContainer that the connector
+// would serialize again
 void PXPConnectorV1::sendBlockingResponse(const ActionResponse& response,
-                                          const ActionRequest& request)
+                                          const ActionRequest& request,
+                                          const std::string& json_text,
+                                          bool)
 {
     assert(response.valid(ActionResponse::ResponseType::Blocking));
     sendBlockingResponse_(ActionResponse::ResponseType::Blocking,
                           response,
-                          request);
+                          request,
+                          json_text);
 }
 
 void PXPConnectorV1::sendStatusResponse(const ActionResponse& response,
-                                        const ActionRequest& request)
+                                        const ActionRequest& request,
+                                        const std::string& json_text,
+                                        bool)
 {
     assert(response.valid(ActionResponse::ResponseType::StatusOutput));
     sendBlockingResponse_(ActionResponse::ResponseType::StatusOutput,
                           response,
-                          request);
+                          request,
+                          json_text);
 }
 
-void PXPConnectorV1::sendNonBlockingResponse(const ActionResponse& response)
+void PXPConnectorV1::sendNonBlockingResponse(const ActionResponse& response,
+                                             const std::string& json_text,
+                                             bool)
 {
     assert(response.valid(ActionResponse::ResponseType::NonBlocking));
     assert(response.action_metadata.get<std::string>("status") != "undetermined");
@@ -167,11 +188,12 @@ void PXPConnectorV1::sendNonBlockingResponse(const ActionResponse& response)
                 response.action_metadata.get<std::string>("requester") },
              PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
              pcp_message_ttl_s,
-             response.toJSON(ActionResponse::ResponseType::NonBlocking));
+             json_text);
         LOG_INFO("Sent response for the {1} by {2}",
                  response.prettyRequestLabel(),
                  response.action_metadata.get<std::string>("requester"));
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to reply to {1} by {2}, (no further attempts will "
                   "be made): {3}",
                   response.prettyRequestLabel(),
@@ -204,7 +226,8 @@ void PXPConnectorV1::registerMessageCallback(const PCPClient::Schema& schema,
 void PXPConnectorV1::sendBlockingResponse_(
         const ActionResponse::ResponseType& response_type,
         const ActionResponse& response,
-        const ActionRequest& request)
+        const ActionRequest& request,
+        const std::string& json_text)
 {
     auto debug = wrapDebug(request.parsedChunks());
 
@@ -212,11 +235,12 @@ void PXPConnectorV1::sendBlockingResponse_(
         send(std::vector<std::string> { request.sender() },
              PXPSchemas::BLOCKING_RESPONSE_TYPE,
              pcp_message_ttl_s,
-             response.toJSON(response_type),
+             json_text,
              debug);
         LOG_INFO("Sent response for the {1} by {2}",
                  request.prettyLabel(), request.sender());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to reply to the {1} by {2}: {3}",
                   request.prettyLabel(), request.sender(), e.what());
     }
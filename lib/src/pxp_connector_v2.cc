@@ -1,5 +1,6 @@
 #include <pxp-agent/pxp_connector_v2.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/util/metrics.hpp>
 
 #include <leatherman/json_container/json_container.hpp>
 
@@ -12,6 +13,11 @@ namespace PXPAgent {
 
 namespace lth_jc = leatherman::json_container;
 
+static Util::Metrics::Counter& SEND_FAILURES {
+    Util::Metrics::Registry::Instance().counter(
+        "pxp_agent_send_failures_total",
+        "Messages that could not be sent to the broker") };
+
 //
 // PXPConnector V2
 //
@@ -40,6 +46,7 @@ void PXPConnectorV2::sendPCPError(const std::string& request_id,
         LOG_INFO("Replied to request {1} with a PCP error message",
                  request_id);
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send PCP error message for request {1}: {2}",
                   request_id, e.what());
     }
@@ -57,6 +64,7 @@ void PXPConnectorV2::sendProvisionalResponse(const ActionRequest& request)
         LOG_INFO("Sent provisional response for the {1} by {2}",
                  request.prettyLabel(), request.sender());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send provisional response for the {1} by {2} "
                   "(no further attempts will be made): {3}",
                   request.prettyLabel(), request.sender(), e.what());
@@ -78,6 +86,7 @@ void PXPConnectorV2::sendPXPError(const ActionRequest& request,
         LOG_INFO("Replied to {1} by {2}, request ID {3}, with a PXP error message",
                  request.prettyLabel(), request.sender(), request.id());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send a PXP error message for the {1} by {2} "
                   "(no further sending attempts will be made): {3}",
                   request.prettyLabel(), request.sender(), description);
@@ -97,6 +106,7 @@ void PXPConnectorV2::sendPXPError(const ActionResponse& response)
                  response.action_metadata.get<std::string>("requester"),
                  response.action_metadata.get<std::string>("request_id"));
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to send a PXP error message for the {1} by {2} "
                   "(no further sending attempts will be made): {3}",
                   response.prettyRequestLabel(),
@@ -105,25 +115,38 @@ void PXPConnectorV2::sendPXPError(const ActionResponse& response)
     }
 }
 
+// The PCP v2 client only sends JSON data as part of the message
+// envelope, as a JsonContainer, which it serializes itself; build it
+// with ActionResponse::toJSON rather than parsing the serialized
+// response, unless its results were compressed, as that text is small
+// and the results would otherwise be compressed again
 void PXPConnectorV2::sendBlockingResponse(const ActionResponse& response,
-                                          const ActionRequest& request)
+                                          const ActionRequest& request,
+                                          const std::string& json_text,
+                                          bool compressed_results)
 {
     assert(response.valid(ActionResponse::ResponseType::Blocking));
-    sendBlockingResponse_(ActionResponse::ResponseType::Blocking,
-                          response,
-                          request);
+    sendBlockingResponse_(request,
+                          compressed_results
+                              ? lth_jc::JsonContainer { json_text }
+                              : response.toJSON(ActionResponse::ResponseType::Blocking));
 }
 
 void PXPConnectorV2::sendStatusResponse(const ActionResponse& response,
-                                        const ActionRequest& request)
+                                        const ActionRequest& request,
+                                        const std::string& json_text,
+                                        bool compressed_results)
 {
     assert(response.valid(ActionResponse::ResponseType::StatusOutput));
-    sendBlockingResponse_(ActionResponse::ResponseType::StatusOutput,
-                          response,
-                          request);
+    sendBlockingResponse_(request,
+                          compressed_results
+                              ? lth_jc::JsonContainer { json_text }
+                              : response.toJSON(ActionResponse::ResponseType::StatusOutput));
 }
 
-void PXPConnectorV2::sendNonBlockingResponse(const ActionResponse& response)
+void PXPConnectorV2::sendNonBlockingResponse(const ActionResponse& response,
+                                             const std::string& json_text,
+                                             bool compressed_results)
 {
     assert(response.valid(ActionResponse::ResponseType::NonBlocking));
     assert(response.action_metadata.get<std::string>("status") != "undetermined");
@@ -131,11 +154,14 @@ void PXPConnectorV2::sendNonBlockingResponse(const ActionResponse& response)
         // NOTE(ale): assuming debug was sent in provisional response
         send(response.action_metadata.get<std::string>("requester"),
              PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
-             response.toJSON(ActionResponse::ResponseType::NonBlocking));
+             compressed_results
+                 ? lth_jc::JsonContainer { json_text }
+                 : response.toJSON(ActionResponse::ResponseType::NonBlocking));
         LOG_INFO("Sent response for the {1} by {2}",
                  response.prettyRequestLabel(),
                  response.action_metadata.get<std::string>("requester"));
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to reply to {1} by {2}, (no further attempts will "
                   "be made): {3}",
                   response.prettyRequestLabel(),
@@ -166,17 +192,17 @@ void PXPConnectorV2::registerMessageCallback(const PCPClient::Schema& schema,
 //
 
 void PXPConnectorV2::sendBlockingResponse_(
-        const ActionResponse::ResponseType& response_type,
-        const ActionResponse& response,
-        const ActionRequest& request)
+        const ActionRequest& request,
+        const lth_jc::JsonContainer& response_data)
 {
     try {
         send(request.sender(),
              PXPSchemas::BLOCKING_RESPONSE_TYPE,
-             response.toJSON(response_type));
+             response_data);
         LOG_INFO("Sent response for the {1} by {2}",
                  request.prettyLabel(), request.sender());
     } catch (PCPClient::connection_error& e) {
+        SEND_FAILURES.add();
         LOG_ERROR("Failed to reply to the {1} by {2}: {3}",
                   request.prettyLabel(), request.sender(), e.what());
     }
@@ -16,6 +16,8 @@ PCPClient::Schema BlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    schema.addConstraint("timeout", T_Constraint::Int, false);
+    schema.addConstraint("result_encodings", T_Constraint::Array, false);
     return schema;
 }
 
@@ -35,6 +37,8 @@ PCPClient::Schema NonBlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    schema.addConstraint("timeout", T_Constraint::Int, false);
+    schema.addConstraint("result_encodings", T_Constraint::Array, false);
     return schema;
 }
 
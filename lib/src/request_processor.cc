@@ -9,12 +9,19 @@
 #include <pxp-agent/time.hpp>
 #include <pxp-agent/modules/command.hpp>
 #include <pxp-agent/modules/echo.hpp>
+#include <pxp-agent/modules/metrics.hpp>
 #include <pxp-agent/modules/ping.hpp>
 #include <pxp-agent/modules/task.hpp>
 #include <pxp-agent/modules/file.hpp>
 #include <pxp-agent/modules/script.hpp>
 #include <pxp-agent/modules/apply.hpp>
+#include <pxp-agent/util/action_cgroups.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
+#include <pxp-agent/util/compression.hpp>
 #include <pxp-agent/util/process.hpp>
+#include <pxp-agent/util/structural_schema.hpp>
+#include <pxp-agent/util/trace.hpp>
+#include <pxp-agent/util/watchdog.hpp>
 
 #include <leatherman/json_container/json_container.hpp>
 #include <leatherman/file_util/file.hpp>
@@ -55,6 +62,60 @@ namespace pcp_util = PCPClient::Util;
 // named mutex lock, before updating the metadata
 static const uint32_t METADATA_RACE_MS { 100 };
 
+// Entry of module configuration files that sets the resource limits
+// of the module's actions
+static const std::string ACTION_LIMITS { "action_limits" };
+static const std::string ACTION_TIMEOUT { "action_timeout" };
+
+// Interval between writes of the metrics file
+static const uint32_t METRICS_EXPORT_INTERVAL_S { 60 };
+
+// Gauges registered by the RequestProcessor, sampling its state
+static const std::string RUNNING_ACTIONS_GAUGE { "pxp_agent_running_actions" };
+static const std::string SPOOL_BYTES_GAUGE { "pxp_agent_spool_bytes" };
+static const std::string SPOOL_TRANSACTIONS_GAUGE { "pxp_agent_spool_transactions" };
+static const std::string TASK_CACHE_BYTES_GAUGE { "pxp_agent_task_cache_bytes" };
+
+static Util::Metrics::Counter& INVALID_REQUESTS {
+    Util::Metrics::Registry::Instance().counter(
+        "pxp_agent_invalid_requests_total",
+        "Requests rejected as invalid, or for an unknown module or action") };
+
+static Util::Metrics::Histogram& purgeDuration()
+{
+    static Util::Metrics::Histogram& the_histogram {
+        Util::Metrics::Registry::Instance().histogram(
+            "pxp_agent_purge_duration_seconds",
+            "Duration of the purges of the spool and task cache directories") };
+    return the_histogram;
+}
+
+// Executors tracked by the watchdog
+static Util::Watchdog::Executor& pcpMessagesExecutor()
+{
+    static Util::Watchdog::Executor& the_executor {
+        Util::Watchdog::executor(
+            "pcp_messages",
+            "the next PCP messages wait and keepalive pongs can be missed, which "
+            "leads to a disconnection after allowed-keepalive-timeouts misses") };
+    return the_executor;
+}
+
+static Util::Watchdog::Executor& purgeExecutor()
+{
+    static Util::Watchdog::Executor& the_executor {
+        Util::Watchdog::executor("purge") };
+    return the_executor;
+}
+
+static Util::Watchdog::Executor& nonBlockingActionsExecutor()
+{
+    static Util::Watchdog::Executor& the_executor {
+        Util::Watchdog::executor("non_blocking_actions",
+                                 "too many threads may be running") };
+    return the_executor;
+}
+
 //
 // Static functions
 //
@@ -66,40 +127,82 @@ static bool isStatusRequest(const ActionRequest& request)
 
 static const std::string STATUS_QUERY_SCHEMA { "query" };
 
-static PCPClient::Validator getStatusQueryValidator()
+static Util::StructuralSchema getStatusQuerySchema()
 {
-    PCPClient::Schema sch { STATUS_QUERY_SCHEMA };
+    Util::StructuralSchema sch { STATUS_QUERY_SCHEMA };
     sch.addConstraint("transaction_id", PCPClient::TypeConstraint::String, true);
-    PCPClient::Validator validator {};
-    validator.registerSchema(sch);
-    return validator;
+    return sch;
+}
+
+static void recordActionMetrics(const RequestProcessor::ActionMetrics& action_metrics,
+                                const ActionResponse& response,
+                                pcp_util::chrono::steady_clock::time_point start)
+{
+    auto duration = pcp_util::chrono::duration_cast<pcp_util::chrono::microseconds>(
+        pcp_util::chrono::steady_clock::now() - start);
+    action_metrics.duration->observe(duration.count() / 1e6);
+    if (!response.action_metadata.get<bool>("results_are_valid"))
+        action_metrics.failures->add();
 }
 
-// Check the size of the response, fail if the response
-// is too large
+// Serialize the response, failing if it's too large, and send it; the
+// serialization stops as soon as the limit is exceeded, otherwise its
+// text is sent as it is. Results larger than the compression threshold
+// are compressed, if the requester accepts it.
 void processResponse(const ActionResponse::ResponseType& response_type,
                      const ActionResponse& response,
                      const ActionRequest& request,
                      std::shared_ptr<PXPConnector> connector_ptr,
-                     const uint32_t max_message_size)
+                     const uint32_t max_message_size,
+                     const uint32_t result_compression_threshold)
 {
-    auto response_string = response.toJSON(response_type).toString();
+    Util::Trace::Span serialize_span { "serialize", request.transactionId() };
+    auto compress = response_type != ActionResponse::ResponseType::RPCError
+                    && result_compression_threshold < max_message_size
+                    && request.acceptsResultEncoding(PXPSchemas::GZIP_RESULTS_ENCODING);
+
+    std::string response_string {};
+    auto response_size = response.toJSONString(
+        response_type,
+        compress ? result_compression_threshold : max_message_size,
+        response_string);
+
+    auto compressed_results = false;
+    if (compress && response_size > result_compression_threshold) {
+        try {
+            response_size = response.toCompressedJSONString(response_type,
+                                                            max_message_size,
+                                                            response_string);
+            compressed_results = true;
+            LOG_DEBUG("Compressed the results of the response to the {1}",
+                      request.prettyLabel());
+        } catch (const Util::CompressionError& e) {
+            LOG_WARNING("Failed to compress the results of the response to the {1}: {2}",
+                        request.prettyLabel(), e.what());
+            response_size = response.toJSONString(response_type,
+                                                  max_message_size,
+                                                  response_string);
+        }
+    }
+
+    serialize_span.end();
+    Util::Trace::Span send_span { "send", request.transactionId() };
 
-    if (response_string.size() > max_message_size) {
+    if (response_size > max_message_size) {
         std::string err_msg {};
-        err_msg = lth_loc::format("Message size: {1} exceeded max-message-size {2}", response_string.size(), max_message_size);
+        err_msg = lth_loc::format("Message size: at least {1} exceeded max-message-size {2}", response_size, max_message_size);
         LOG_ERROR(err_msg);
         connector_ptr->sendPXPError(request, err_msg);
     } else {
         switch (response_type) {
             case ActionResponse::ResponseType::NonBlocking :
-                connector_ptr->sendNonBlockingResponse(response);
+                connector_ptr->sendNonBlockingResponse(response, response_string, compressed_results);
                 break;
             case ActionResponse::ResponseType::Blocking:
-                connector_ptr->sendBlockingResponse(response, request);
+                connector_ptr->sendBlockingResponse(response, request, response_string, compressed_results);
                 break;
             case ActionResponse::ResponseType::StatusOutput :
-                connector_ptr->sendStatusResponse(response, request);
+                connector_ptr->sendStatusResponse(response, request, response_string, compressed_results);
                 break;
             default :
                 // This really shouldn't happen in normal operation, since
@@ -115,13 +218,20 @@ void processResponse(const ActionResponse::ResponseType& response_type,
 // Non-blocking action task
 //
 void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
-                           ActionRequest request,
+                           // cppcheck-suppress passedByValue
+                           std::shared_ptr<const ActionRequest> request_ptr,
                            std::shared_ptr<PXPConnector> connector_ptr,
                            std::shared_ptr<ResultsStorage> storage_ptr,
                            // cppcheck-suppress passedByValue
                            std::shared_ptr<std::atomic<bool>> done,
-                           const uint32_t max_message_size)
+                           const uint32_t max_message_size,
+                           const uint32_t result_compression_threshold,
+                           const RequestProcessor::ActionMetrics action_metrics,
+                           pcp_util::chrono::steady_clock::time_point queued)
 {
+    const auto& request = *request_ptr;
+    nonBlockingActionsExecutor().recordLag(queued);
+
     ResultsMutex::Mutex_Ptr mtx_ptr;
     std::unique_ptr<ResultsMutex::Lock> lck_ptr;
     try {
@@ -166,8 +276,10 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
         }
     };
 
+    auto start = pcp_util::chrono::steady_clock::now();
     auto response = module_ptr->executeAction(request);
     assert(response.request_type == RequestType::NonBlocking);
+    recordActionMetrics(action_metrics, response, start);
 
     if (lck_ptr != nullptr) {
         LOG_TRACE("Locking transaction mutex {1}", request.transactionId());
@@ -188,7 +300,7 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
 
     if (response.action_metadata.get<bool>("notify_outcome")) {
         if (response.action_metadata.get<bool>("results_are_valid")){
-            processResponse(ActionResponse::ResponseType::NonBlocking, response, request, connector_ptr, max_message_size);
+            processResponse(ActionResponse::ResponseType::NonBlocking, response, request, connector_ptr, max_message_size, result_compression_threshold);
         } else {
             connector_ptr->sendPXPError(response);
         }
@@ -197,8 +309,9 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
     try {
         storage_ptr->updateMetadataFile(request.transactionId(),
                                         response.action_metadata);
+        storage_ptr->packResults(request.transactionId());
     } catch (const ResultsStorage::Error& e) {
-        LOG_ERROR("Failed to write metadata of the {1}: {2}",
+        LOG_ERROR("Failed to store the results of the {1}: {2}",
                   request.prettyLabel(), e.what());
     }
 }
@@ -215,16 +328,71 @@ RequestProcessor::RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
                                                  agent_configuration.task_cache_dir_purge_ttl) },
           connector_ptr_ { connector_ptr },
           storage_ptr_ { new ResultsStorage(agent_configuration.spool_dir,
-                                            agent_configuration.spool_dir_purge_ttl) },
+                                            agent_configuration.spool_dir_purge_ttl,
+                                            agent_configuration.spool_dir_pack_results) },
           spool_dir_path_ { agent_configuration.spool_dir },
           modules_ {},
           modules_config_dir_ { agent_configuration.modules_config_dir },
           modules_config_ {},
           is_destructing_ { false },
-          max_message_size_ { agent_configuration.max_message_size }
+          spool_pressure_ { false },
+          max_message_size_ { agent_configuration.max_message_size },
+          result_compression_threshold_ {
+              agent_configuration.result_compression_threshold },
+          metrics_file_ { agent_configuration.metrics_file },
+          task_cache_bytes_ { 0 }
 {
     assert(!spool_dir_path_.string().empty());
-    registerPurgeable(storage_ptr_);
+
+    if (agent_configuration.spool_dir_max_size > 0
+            || agent_configuration.spool_dir_max_transactions > 0) {
+        // Wake the purge thread as soon as a quota is exceeded, rather
+        // than waiting for the next scheduled purge
+        storage_ptr_->setQuotas(
+            static_cast<uint64_t>(agent_configuration.spool_dir_max_size) * 1024 * 1024,
+            agent_configuration.spool_dir_max_transactions,
+            [this]() {
+                pcp_util::lock_guard<pcp_util::mutex> the_lock { purge_mutex_ };
+                spool_pressure_ = true;
+                purge_cond_var_.notify_all();
+            });
+        // Quotas are enforced even if the spool dir TTL is 0
+        purgeables_.push_back(storage_ptr_);
+    } else {
+        registerPurgeable(storage_ptr_);
+    }
+
+    if (!agent_configuration.cgroup_parent.empty()) {
+        try {
+            Util::ActionCGroups::Instance().configure(agent_configuration.cgroup_parent);
+        } catch (const Util::ActionCGroups::Error& e) {
+            LOG_ERROR("Actions will be executed in the cgroup of pxp-agent: {1}", e.what());
+        }
+    }
+
+    if (agent_configuration.trace_buffer_size > 0) {
+        Util::Trace::enable(agent_configuration.trace_buffer_size);
+        LOG_INFO("Tracing the last {1} request stages",
+                 agent_configuration.trace_buffer_size);
+
+        if (!agent_configuration.trace_file.empty()) {
+            try {
+                Util::Trace::installDumpSignalHandler(agent_configuration.trace_file);
+            } catch (const Util::Trace::Error& e) {
+                LOG_WARNING("The trace will not be written on SIGUSR1: {1}", e.what());
+            }
+        }
+    }
+
+    if (agent_configuration.watchdog_threshold_ms > 0) {
+        try {
+            Util::Watchdog::enable(agent_configuration.watchdog_threshold_ms);
+        } catch (const Util::Watchdog::Error& e) {
+            LOG_INFO("Stalled threads will be reported without a stack sample: {1}",
+                     e.what());
+        }
+    }
+
     loadModulesConfiguration();
     loadInternalModules(agent_configuration);
 
@@ -236,51 +404,72 @@ RequestProcessor::RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
     }
 
     logLoadedModules();
+    registerMetrics();
 
-    if (!purgeables_.empty()) {
-        for (auto purgeable : purgeables_) {
-            purgeable->purge(purgeable->get_ttl(), thread_container_.getThreadNames());
-        }
+    if (!metrics_file_.empty())
+        metrics_thread_ptr_.reset(
+            new pcp_util::thread(&RequestProcessor::metricsExportTask, this));
+
+    // The first purge runs on the purge thread, so that a large
+    // backlog doesn't delay the connection to the broker
+    if (!purgeables_.empty())
         purge_thread_ptr_.reset(
             new pcp_util::thread(&RequestProcessor::purgeTask, this));
-    }
 }
 
 RequestProcessor::~RequestProcessor()
 {
+    storage_ptr_->setQuotas(0, 0, nullptr);
+    for (const auto& gauge : { RUNNING_ACTIONS_GAUGE, SPOOL_BYTES_GAUGE,
+                               SPOOL_TRANSACTIONS_GAUGE, TASK_CACHE_BYTES_GAUGE })
+        Util::Metrics::Registry::Instance().removeGauge(gauge);
+
     {
         pcp_util::lock_guard<pcp_util::mutex> the_lock { purge_mutex_ };
         is_destructing_ = true;
-        purge_cond_var_.notify_one();
+        purge_cond_var_.notify_all();
     }
 
     if (purge_thread_ptr_ != nullptr && purge_thread_ptr_->joinable())
         purge_thread_ptr_->join();
+
+    if (metrics_thread_ptr_ != nullptr && metrics_thread_ptr_->joinable())
+        metrics_thread_ptr_->join();
+
+    Util::Watchdog::disable();
 }
 
 void RequestProcessor::processRequest(const RequestType& request_type,
                                       const PCPClient::ParsedChunks& parsed_chunks)
 {
+    // Runs on the thread of the PCP message callbacks
+    Util::Watchdog::Busy busy { pcpMessagesExecutor() };
+
     try {
-        // Inspect and validate the request message format
-        ActionRequest request { request_type, parsed_chunks };
+        // Inspect and validate the request message format; it's shared
+        // with the task of a non-blocking action, rather than copied
+        auto request_ptr = std::make_shared<const ActionRequest>(request_type, parsed_chunks);
+        const auto& request = *request_ptr;
 
         LOG_INFO("Processing {1}, request ID {2}, by {3}",
                  request.prettyLabel(), request.id(), request.sender());
 
         try {
             // We can access the request content; validate it
+            Util::Trace::Span span { "validate", request.transactionId() };
             validateRequestContent(request);
         } catch (RequestProcessor::Error& e) {
             // Invalid request; send *RPC Error message*
             LOG_ERROR("Invalid {1}, request ID {2} by {3}. Will reply with an "
                       "RPC Error message. Error: {4}",
                       request.prettyLabel(), request.id(), request.sender(), e.what());
+            INVALID_REQUESTS.add();
             connector_ptr_->sendPXPError(request, e.what());
             return;
         }
 
         LOG_DEBUG("The {1} has been successfully validated", request.prettyLabel());
+        actionMetrics(request).requests->add();
 
         try {
             if (isStatusRequest(request)) {
@@ -288,7 +477,7 @@ void RequestProcessor::processRequest(const RequestType& request_type,
             } else if (request.type() == RequestType::Blocking) {
                 processBlockingRequest(request);
             } else {
-                processNonBlockingRequest(request);
+                processNonBlockingRequest(request_ptr);
             }
 
             LOG_DEBUG("The {1}, request ID {2} by {3}, has been successfully processed",
@@ -309,6 +498,7 @@ void RequestProcessor::processRequest(const RequestType& request_type,
         LOG_ERROR("Invalid request with ID {1} by {2}. Will reply with a PCP "
                   "error. Error: {3}",
                   id, sender, e.what());
+        INVALID_REQUESTS.add();
         connector_ptr_->sendPCPError(id, e.what(), endpoints);
     }
 }
@@ -339,7 +529,7 @@ std::string RequestProcessor::getModuleConfig(const std::string& module_name) co
 
 void RequestProcessor::validateRequestContent(const ActionRequest& request) const
 {
-    static PCPClient::Validator status_query_validator { getStatusQueryValidator() };
+    static const Util::StructuralSchema status_query_schema { getStatusQuerySchema() };
 
     auto is_status_request = isStatusRequest(request);
 
@@ -372,10 +562,12 @@ void RequestProcessor::validateRequestContent(const ActionRequest& request) cons
                   request.prettyLabel(), request.id(), request.sender());
 
         // NB: the registred schemas have the same name as the action
-        auto& validator = (is_status_request
-                                ? status_query_validator
-                                : modules_.at(request.module())->input_validator_);
-        validator.validate(request.params(), request.action());
+        if (is_status_request) {
+            status_query_schema.validate(request.params());
+        } else {
+            modules_.at(request.module())->validateInput(request.action(),
+                                                         request.params());
+        }
     } catch (PCPClient::validation_error& e) {
         LOG_DEBUG("Invalid input parameters of the {1}, request ID {2} by {3}: {4}",
                   request.prettyLabel(), request.id(), request.sender(), e.what());
@@ -386,19 +578,28 @@ void RequestProcessor::validateRequestContent(const ActionRequest& request) cons
 
 void RequestProcessor::processBlockingRequest(const ActionRequest& request)
 {
-    auto response = modules_[request.module()]->executeAction(request);
+    auto start = pcp_util::chrono::steady_clock::now();
+    ActionResponse response { [this, &request]() {
+        // Blocking actions are expected to last, and are bounded by
+        // their deadline, if any; they are not stalls of the thread
+        Util::Watchdog::Waiting waiting { pcpMessagesExecutor() };
+        return modules_[request.module()]->executeAction(request);
+    }() };
+    recordActionMetrics(actionMetrics(request), response, start);
     if (response.action_metadata.get<bool>("results_are_valid")) {
         LOG_INFO("The {1}, request ID {2} by {3}, has successfully completed",
                  request.prettyLabel(), request.id(), request.sender());
-        processResponse(ActionResponse::ResponseType::Blocking, response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::Blocking, response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
     } else {
         LOG_ERROR(response.action_metadata.get<std::string>("execution_error"));
         connector_ptr_->sendPXPError(response);
     }
 }
 
-void RequestProcessor::processNonBlockingRequest(const ActionRequest& request)
+void RequestProcessor::processNonBlockingRequest(
+        const std::shared_ptr<const ActionRequest>& request_ptr)
 {
+    const auto& request = *request_ptr;
     request.setResultsDir(
         std::move((spool_dir_path_ / request.transactionId()).string()));
     std::string err_msg {};
@@ -420,6 +621,7 @@ void RequestProcessor::processNonBlockingRequest(const ActionRequest& request)
         } else {
             try {
                 // Initialize the action metadata file
+                Util::Trace::Span span { "metadata_init", request.transactionId() };
                 auto metadata = ActionResponse::getMetadataFromRequest(request);
                 storage_ptr_->initializeMetadataFile(request.transactionId(),
                                                      metadata);
@@ -434,16 +636,20 @@ void RequestProcessor::processNonBlockingRequest(const ActionRequest& request)
                 // Flag to enable signaling from task to thread_container
                 auto done = std::make_shared<std::atomic<bool>>(false);
 
+                Util::Trace::Span span { "thread_spawn", request.transactionId() };
                 // NB: we got the_lock, so we're sure this will not throw
                 // due to another stored thread with the same name
                 thread_container_.add(request.transactionId(),
                                       pcp_util::thread(&nonBlockingActionTask,
                                                        modules_[request.module()],
-                                                       request,
+                                                       request_ptr,
                                                        connector_ptr_,
                                                        storage_ptr_,
                                                        done,
-                                                       max_message_size_),
+                                                       max_message_size_,
+                                                       result_compression_threshold_,
+                                                       actionMetrics(request),
+                                                       pcp_util::chrono::steady_clock::now()),
                                       done);
             }
         }
@@ -507,7 +713,7 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
         status_response.setValidResultsAndEnd(
             std::move(status_results),
             lth_loc::translate("found no results directory"));
-        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
         return;
     }
 
@@ -605,13 +811,17 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
         // TODO(ale): send RPC error once PXP v2.0 changes are in
         status_response.setValidResultsAndEnd(std::move(status_results),
                                               metadata_retrieval_error);
-        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
         return;
     }
 
     // At this point, we have a valid metadata object;
     // inspect it and see if it was finalized
 
+    if (metadata.includes("resource_usage"))
+        status_results.set<lth_jc::JsonContainer>("resource_usage",
+            metadata.get<lth_jc::JsonContainer>("resource_usage"));
+
     std::string execution_error {};
     auto stored_status = metadata.get<std::string>("status");
     LOG_TRACE("The status of the transaction {1} is '{2}', as reported in its "
@@ -647,7 +857,7 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
 
         status_response.setValidResultsAndEnd(std::move(status_results),
                                               execution_error);
-        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
 
         return;
     }
@@ -709,7 +919,7 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
 
         status_response.setValidResultsAndEnd(std::move(status_results),
                                               execution_error);
-        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
         return;
     }
 
@@ -741,7 +951,7 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
         status_response.setValidResultsAndEnd(
                 std::move(status_results),
                 lth_loc::translate("found no results directory"));
-        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+        processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
 
         // Update the metadata with a final 'status' value
         metadata.set<std::string>("status", AS.at(ActionStatus::Undetermined));
@@ -788,8 +998,10 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
         if (mtx_ptr != nullptr) {
             ResultsMutex::LockGuard r_l { *mtx_ptr };
             storage_ptr_->updateMetadataFile(t_id, a_r.action_metadata);
+            storage_ptr_->packResults(t_id);
         } else {
             storage_ptr_->updateMetadataFile(t_id, a_r.action_metadata);
+            storage_ptr_->packResults(t_id);
         }
     } catch (const ResultsStorage::Error& err) {
         LOG_ERROR("Failed to update metadata of the transaction {1}: {2}",
@@ -807,7 +1019,7 @@ void RequestProcessor::processStatusRequest(const ActionRequest& request)
 
     status_response.setValidResultsAndEnd(std::move(status_results),
                                           execution_error);
-    processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_);
+    processResponse(ActionResponse::ResponseType::StatusOutput, status_response, request, connector_ptr_, max_message_size_, result_compression_threshold_);
 }
 
 //
@@ -831,6 +1043,11 @@ void RequestProcessor::loadModulesConfiguration()
 
                 try {
                     auto config_json = lth_jc::JsonContainer(lth_file::read(s));
+                    if (config_json.type() == lth_jc::DataType::Object
+                            && (config_json.includes(ACTION_LIMITS)
+                                || config_json.includes(ACTION_TIMEOUT))) {
+                        loadActionSettings(module_name, config_json);
+                    }
                     modules_config_[module_name] = std::move(config_json);
                     LOG_DEBUG("Loaded module configuration for module '{1}' "
                               "from {2}", module_name, s);
@@ -853,6 +1070,45 @@ void RequestProcessor::loadModulesConfiguration()
     }
 }
 
+void RequestProcessor::loadActionSettings(const std::string& module_name,
+                                          lth_jc::JsonContainer& config_json)
+{
+    if (config_json.includes(ACTION_LIMITS)) {
+        try {
+            Util::ActionCGroups::Instance().setModuleLimits(
+                module_name,
+                Util::ActionCGroups::parseLimits(
+                    config_json.get<lth_jc::JsonContainer>(ACTION_LIMITS)));
+            LOG_DEBUG("Loaded the action limits of module '{1}'", module_name);
+        } catch (const Util::ActionCGroups::Error& e) {
+            LOG_WARNING("Ignoring the action limits of module '{1}': {2}",
+                        module_name, e.what());
+        }
+    }
+
+    if (config_json.includes(ACTION_TIMEOUT)) {
+        if (config_json.type(ACTION_TIMEOUT) == lth_jc::DataType::Int
+                && config_json.get<int>(ACTION_TIMEOUT) >= 0) {
+            Util::ActionDeadlines::Instance().setModuleTimeout(
+                module_name,
+                static_cast<unsigned int>(config_json.get<int>(ACTION_TIMEOUT)));
+            LOG_DEBUG("Loaded the action timeout of module '{1}'", module_name);
+        } else {
+            LOG_WARNING("Ignoring the action timeout of module '{1}': it must be "
+                        "a non-negative number of seconds", module_name);
+        }
+    }
+
+    // The entries are handled by pxp-agent; don't pass them to the module
+    lth_jc::JsonContainer module_config {};
+    for (const auto& key : config_json.keys()) {
+        if (key != ACTION_LIMITS && key != ACTION_TIMEOUT)
+            module_config.set<lth_jc::JsonContainer>(
+                key, config_json.get<lth_jc::JsonContainer>(key));
+    }
+    config_json = std::move(module_config);
+}
+
 void RequestProcessor::registerModule(std::shared_ptr<Module> module_ptr)
 {
     if (!modules_.emplace(module_ptr->module_name, module_ptr).second) {
@@ -871,6 +1127,7 @@ void RequestProcessor::loadInternalModules(const Configuration::Agent& agent_con
 {
     registerModule(std::make_shared<Modules::Echo>());
     registerModule(std::make_shared<Modules::Ping>());
+    registerModule(std::make_shared<Modules::Metrics>());
     auto command = std::make_shared<Modules::Command>(
         Configuration::Instance().getExecPrefix(),
         storage_ptr_);
@@ -924,6 +1181,8 @@ void RequestProcessor::loadInternalModules(const Configuration::Agent& agent_con
         agent_configuration.key,
         agent_configuration.crl,
         agent_configuration.master_proxy,
+        agent_configuration.apply_worker_pool_size,
+        agent_configuration.apply_fact_cache_ttl,
         module_cache_dir_,
         storage_ptr_);
     registerModule(apply);
@@ -1011,6 +1270,112 @@ void RequestProcessor::logLoadedModules() const
     }
 }
 
+//
+// Metrics (private interface)
+//
+
+static uint64_t directorySize(const fs::path& dir_path)
+{
+    boost::system::error_code ec;
+    uint64_t size { 0 };
+    for (fs::recursive_directory_iterator it { dir_path, ec }, end;
+            !ec && it != end; it.increment(ec)) {
+        if (fs::is_regular_file(it->status())) {
+            auto file_size = fs::file_size(it->path(), ec);
+            if (!ec)
+                size += file_size;
+            ec.clear();
+        }
+    }
+    return size;
+}
+
+void RequestProcessor::registerMetrics()
+{
+    auto& registry = Util::Metrics::Registry::Instance();
+
+    auto registerAction = [&](const std::string& module_name, const std::string& action) {
+        Util::Metrics::Labels labels { { "module", module_name }, { "action", action } };
+        action_metrics_[std::make_pair(module_name, action)] = ActionMetrics {
+            &registry.counter("pxp_agent_requests_total",
+                              "Valid requests, by module and action", labels),
+            &registry.counter("pxp_agent_request_failures_total",
+                              "Actions that failed or returned invalid results",
+                              labels),
+            &registry.histogram("pxp_agent_request_duration_seconds",
+                                "Duration of the actions", labels) };
+    };
+
+    for (const auto& module : modules_)
+        for (const auto& action : module.second->actions)
+            registerAction(module.first, action);
+    registerAction("status", "query");
+
+    // Exported before their first use
+    purgeDuration();
+    pcpMessagesExecutor();
+    purgeExecutor();
+    nonBlockingActionsExecutor();
+
+    registry.setGauge(RUNNING_ACTIONS_GAUGE,
+                      "Non-blocking actions being executed",
+                      [this]() -> double {
+                          return thread_container_.getNumRunningThreads();
+                      });
+    registry.setGauge(SPOOL_BYTES_GAUGE,
+                      "Size of the results of the completed actions in the spool directory",
+                      [this]() -> double {
+                          return static_cast<double>(storage_ptr_->getUsage().bytes);
+                      });
+    registry.setGauge(SPOOL_TRANSACTIONS_GAUGE,
+                      "Completed actions whose results are in the spool directory",
+                      [this]() -> double {
+                          return static_cast<double>(storage_ptr_->getUsage().transactions);
+                      });
+    registry.setGauge(TASK_CACHE_BYTES_GAUGE,
+                      "Size of the task cache directory",
+                      [this]() -> double {
+                          return static_cast<double>(task_cache_bytes_.load());
+                      });
+}
+
+void RequestProcessor::refreshTaskCacheSize()
+{
+    task_cache_bytes_ = directorySize(module_cache_dir_->cache_dir_);
+}
+
+const RequestProcessor::ActionMetrics&
+RequestProcessor::actionMetrics(const ActionRequest& request) const
+{
+    // Validated requests are for a registered action
+    return action_metrics_.at(std::make_pair(request.module(), request.action()));
+}
+
+void RequestProcessor::metricsExportTask()
+{
+    LOG_INFO("Writing the metrics to '{1}' every {2} seconds",
+             metrics_file_, METRICS_EXPORT_INTERVAL_S);
+
+    while (true) {
+        refreshTaskCacheSize();
+        try {
+            lth_file::atomic_write_to_file(
+                Util::Metrics::toPrometheusText(
+                    Util::Metrics::Registry::Instance().collect()),
+                metrics_file_);
+        } catch (const std::exception& e) {
+            LOG_WARNING("Failed to write the metrics to '{1}': {2}",
+                        metrics_file_, e.what());
+        }
+
+        pcp_util::unique_lock<pcp_util::mutex> the_lock { purge_mutex_ };
+        if (purge_cond_var_.wait_for(the_lock,
+                                     pcp_util::chrono::seconds(METRICS_EXPORT_INTERVAL_S),
+                                     [this]() { return is_destructing_; }))
+            return;
+    }
+}
+
 //
 // Resource purge task (private interface)
 //
@@ -1031,29 +1396,84 @@ static unsigned int minutes_gcd(std::vector<std::shared_ptr<Util::Purgeable>> pu
 
 void RequestProcessor::purgeTask()
 {
-    // Use min of 1h and gcd of purgeable TTLs.
-    auto num_minutes = std::min(60u, minutes_gcd(purgeables_));
+    // Use min of 1h and gcd of purgeable TTLs; the spool dir can be
+    // purged only to enforce its quotas, with a TTL of 0
+    auto ttls_gcd = minutes_gcd(purgeables_);
+    auto num_minutes = ttls_gcd > 0 ? std::min(60u, ttls_gcd) : 60u;
     LOG_INFO(lth_loc::format_n(
         // LOCALE: info
         "Scheduling the check every {1} minute for directories to purge; thread id {2}",
         "Scheduling the check every {1} minutes for directories to purge; thread id {2}",
         num_minutes, num_minutes, pcp_util::this_thread::get_id()));
 
-    while (true) {
-        pcp_util::unique_lock<pcp_util::mutex> the_lock { purge_mutex_ };
-        auto now = pcp_util::chrono::system_clock::now();
+    // The lock is released while purging, so that the dtor doesn't
+    // wait for a whole pass; it's checked between purgeables
+    auto isDestructing = [this]() -> bool {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { purge_mutex_ };
+        return is_destructing_;
+    };
 
-        if (!is_destructing_)
+    // Returns the duration of the purge in ms
+    auto purge = [this](Util::Purgeable& purgeable) -> int64_t {
+        Util::Watchdog::Busy busy { purgeExecutor() };
+        auto start = pcp_util::chrono::steady_clock::now();
+        purgeable.purge(purgeable.get_ttl(), thread_container_.getThreadNames());
+        auto elapsed_ms = pcp_util::chrono::duration_cast<pcp_util::chrono::milliseconds>(
+            pcp_util::chrono::steady_clock::now() - start).count();
+        purgeDuration().observe(elapsed_ms / 1e3);
+        return elapsed_ms;
+    };
+
+    LOG_INFO("Starting the purge of {1} locations in the background",
+             purgeables_.size());
+    size_t num_done { 0 };
+    for (auto purgeable : purgeables_) {
+        if (isDestructing())
+            return;
+
+        auto elapsed_ms = purge(*purgeable);
+        LOG_INFO("Purged {1} of {2} locations in the background; the last one took {3} ms",
+                 ++num_done, purgeables_.size(), elapsed_ms);
+    }
+    refreshTaskCacheSize();
+
+    auto next_purge = pcp_util::chrono::steady_clock::now()
+                      + pcp_util::chrono::minutes(num_minutes);
+
+    while (true) {
+        bool spool_pressure { false };
+        {
+            pcp_util::unique_lock<pcp_util::mutex> the_lock { purge_mutex_ };
             purge_cond_var_.wait_until(
                 the_lock,
-                now + pcp_util::chrono::minutes(num_minutes));
+                next_purge,
+                [this]() { return is_destructing_ || spool_pressure_; });
 
-        if (is_destructing_)
-            return;
+            if (is_destructing_)
+                return;
+
+            spool_pressure = spool_pressure_;
+            spool_pressure_ = false;
+        }
+
+        // Doesn't delay the next scheduled purge
+        if (spool_pressure) {
+            LOG_DEBUG("Purging '{1}' to enforce its quotas", spool_dir_path_.string());
+            purge(*storage_ptr_);
+            continue;
+        }
+
+        purgeExecutor().recordLag(next_purge);
+
+        next_purge = pcp_util::chrono::steady_clock::now()
+                     + pcp_util::chrono::minutes(num_minutes);
 
         for (auto purgeable : purgeables_) {
-            purgeable->purge(purgeable->get_ttl(), thread_container_.getThreadNames());
+            if (isDestructing())
+                return;
+            purge(*purgeable);
         }
+        refreshTaskCacheSize();
     }
 }
 
@@ -1,7 +1,10 @@
 #include <pxp-agent/results_storage.hpp>
 #include <pxp-agent/action_response.hpp>
+#include <pxp-agent/action_status.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/metadata_record.hpp>
 #include <pxp-agent/time.hpp>
+#include <pxp-agent/transaction_record.hpp>
 
 #include <leatherman/file_util/file.hpp>
 #include <leatherman/file_util/directory.hpp>
@@ -14,11 +17,13 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
-#include <algorithm>  // std::find
+#include <fstream>
+#include <iterator>
 
 namespace PXPAgent {
 
 namespace fs = boost::filesystem;
+namespace pcp_util = PCPClient::Util;
 namespace lth_jc   = leatherman::json_container;
 namespace lth_file = leatherman::file_util;
 namespace lth_loc  = leatherman::locale;
@@ -29,28 +34,100 @@ static const std::string STDERR { "stderr" };
 static const std::string EXITCODE { "exitcode" };
 static const std::string PID { "pid" };
 
-ResultsStorage::ResultsStorage(std::string spool_dir, std::string spool_dir_ttl)
-        : Purgeable { std::move(spool_dir_ttl) }, spool_dir_path_ { std::move(spool_dir) }
+// Suffix of the files that replace the results directories of the
+// completed transactions, when packing results
+static const std::string PACKED { ".pxpr" };
+
+ResultsStorage::ResultsStorage(std::string spool_dir,
+                               std::string spool_dir_ttl,
+                               bool pack_results)
+        : Purgeable { std::move(spool_dir_ttl) },
+          spool_dir_path_ { std::move(spool_dir) },
+          pack_results_ { pack_results },
+          expiry_index_ {},
+          expiry_index_ready_ { false },
+          expiry_index_mutex_ {},
+          usage_ {},
+          usage_bytes_ { 0 },
+          max_bytes_ { 0 },
+          max_transactions_ { 0 },
+          on_pressure_ {},
+          pressure_signalled_ { false }
 {
 }
 
 bool ResultsStorage::find(const std::string& transaction_id)
 {
     auto p = spool_dir_path_ / transaction_id;
-    return fs::exists(p) && fs::is_directory(p);
+    return (fs::exists(p) && fs::is_directory(p))
+           || fs::is_regular_file(packedPath(transaction_id));
 }
 
-static void writeMetadata(const lth_jc::JsonContainer& metadata, const std::string& file_path) {
+bool ResultsStorage::isPacked(const std::string& transaction_id)
+{
+    return !fs::exists(spool_dir_path_ / transaction_id)
+           && fs::is_regular_file(packedPath(transaction_id));
+}
+
+fs::path ResultsStorage::packedPath(const std::string& transaction_id) const
+{
+    return spool_dir_path_ / (transaction_id + PACKED);
+}
+
+static const std::string REDACTED_REQUEST_PARAMS { "{}" };
+
+static bool hasRedactedParams(const lth_jc::JsonContainer& metadata) {
+    return metadata.includes("request_params")
+           && metadata.type("request_params") == lth_jc::DataType::String
+           && metadata.get<std::string>("request_params") == REDACTED_REQUEST_PARAMS;
+}
+
+static std::string encodeMetadata(const lth_jc::JsonContainer& metadata) {
     // Redact "request_params" key in case parameters are sensitive.
-    lth_jc::JsonContainer metadata_ { metadata };
-    metadata_.set<std::string>("request_params", "{}");
-    std::string txt = metadata_.toString() + "\n";
+    // The metadata created by ActionResponse is already redacted; avoid
+    // copying it
+    try {
+        if (hasRedactedParams(metadata))
+            return MetadataRecord::encode(metadata);
+
+        lth_jc::JsonContainer metadata_ { metadata };
+        metadata_.set<std::string>("request_params", REDACTED_REQUEST_PARAMS);
+        return MetadataRecord::encode(metadata_);
+    } catch (const MetadataRecord::Error& e) {
+        throw ResultsStorage::Error {
+            lth_loc::format("failed to encode metadata: {1}", e.what()) };
+    }
+}
+
+// Metadata stored as JSON by older versions is replaced by a record on
+// its next update
+static void writeFile(const std::string& data, const std::string& file_path) {
     try {
-        lth_file::atomic_write_to_file(txt, file_path, NIX_FILE_PERMS, std::ios::binary);
+        lth_file::atomic_write_to_file(data, file_path, NIX_FILE_PERMS, std::ios::binary);
     } catch (const std::exception& e) {
         throw ResultsStorage::Error {
-            lth_loc::format("failed to write metadata: {1}", e.what()) };
+            lth_loc::format("failed to write '{1}': {2}", file_path, e.what()) };
+    }
+}
+
+// Reads the whole file or, if max_size is not 0, up to max_size bytes
+static bool readFile(const std::string& file_path,
+                             std::string& data,
+                             size_t max_size = 0)
+{
+    std::ifstream file { file_path, std::ios::binary };
+    if (!file)
+        return false;
+
+    if (max_size == 0) {
+        data.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+    } else {
+        data.resize(max_size);
+        file.read(&data[0], static_cast<std::streamsize>(max_size));
+        data.resize(static_cast<size_t>(file.gcount()));
     }
+    return !file.bad();
 }
 
 void ResultsStorage::initializeMetadataFile(const std::string& transaction_id,
@@ -72,7 +149,8 @@ void ResultsStorage::initializeMetadataFile(const std::string& transaction_id,
     }
 
     auto metadata_file = (results_path / METADATA).string();
-    writeMetadata(metadata, metadata_file);
+    writeFile(encodeMetadata(metadata), metadata_file);
+    indexExpiry(transaction_id, metadata);
 }
 
 void ResultsStorage::updateMetadataFile(const std::string& transaction_id,
@@ -83,8 +161,92 @@ void ResultsStorage::updateMetadataFile(const std::string& transaction_id,
             lth_loc::format("no results directory for the transaction {1}",
                             transaction_id) };
 
-    auto metadata_file = (spool_dir_path_ / transaction_id / METADATA).string();
-    writeMetadata(metadata, metadata_file);
+    if (isPacked(transaction_id)) {
+        auto segments = readPacked(transaction_id);
+        segments[TransactionRecord::Segment::Metadata] = encodeMetadata(metadata);
+        writeFile(TransactionRecord::encode(segments), packedPath(transaction_id).string());
+    } else {
+        auto metadata_file = (spool_dir_path_ / transaction_id / METADATA).string();
+        writeFile(encodeMetadata(metadata), metadata_file);
+    }
+    indexExpiry(transaction_id, metadata);
+}
+
+TransactionRecord::Segments
+ResultsStorage::readPacked(const std::string& transaction_id)
+{
+    std::string data {};
+    if (!readFile(packedPath(transaction_id).string(), data))
+        throw Error {
+            lth_loc::format("failed to read the results of the transaction {1}",
+                            transaction_id) };
+
+    try {
+        return TransactionRecord::decode(data);
+    } catch (const TransactionRecord::Error& e) {
+        throw Error {
+            lth_loc::format("invalid results file of the transaction {1}: {2}",
+                            transaction_id, e.what()) };
+    }
+}
+
+void ResultsStorage::packResults(const std::string& transaction_id)
+{
+    if (!pack_results_ || isPacked(transaction_id))
+        return;
+
+    auto results_path = spool_dir_path_ / transaction_id;
+    std::string metadata_txt {};
+    if (!readFile((results_path / METADATA).string(), metadata_txt))
+        throw Error {
+            lth_loc::format("failed to read metadata file of the transaction {1}",
+                            transaction_id) };
+
+    if (!MetadataRecord::isRecord(metadata_txt))
+        metadata_txt = encodeMetadata(getActionMetadata(transaction_id));
+
+    try {
+        if (MetadataRecord::decodeSummary(metadata_txt).status
+                == ACTION_STATUS_NAMES.at(ActionStatus::Running)) {
+            LOG_DEBUG("Not packing the results of the transaction {1}, as the "
+                      "action is running", transaction_id);
+            return;
+        }
+    } catch (const MetadataRecord::Error& e) {
+        throw Error {
+            lth_loc::format("invalid metadata record of the transaction {1}: {2}",
+                            transaction_id, e.what()) };
+    }
+
+    TransactionRecord::Segments segments {};
+    segments[TransactionRecord::Segment::Metadata] = std::move(metadata_txt);
+    for (const auto& output : { std::make_pair(TransactionRecord::Segment::Stdout, STDOUT),
+                                std::make_pair(TransactionRecord::Segment::Stderr, STDERR),
+                                std::make_pair(TransactionRecord::Segment::Exitcode, EXITCODE) }) {
+        auto file_path = (results_path / output.second).string();
+        if (fs::exists(file_path) && !readFile(file_path, segments[output.first]))
+            throw Error { lth_loc::format("failed to read '{1}'", file_path) };
+    }
+
+    writeFile(TransactionRecord::encode(segments), packedPath(transaction_id).string());
+
+    try {
+        fs::remove_all(results_path);
+    } catch (const fs::filesystem_error& e) {
+        LOG_WARNING("Failed to remove the results directory '{1}' of the packed "
+                    "transaction {2}: {3}", results_path.string(), transaction_id, e.what());
+    }
+
+    auto size = resultsSize(transaction_id);
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+        auto recorded = usage_.find(transaction_id);
+        if (recorded != usage_.end()) {
+            usage_bytes_ = usage_bytes_ - recorded->second + size;
+            recorded->second = size;
+        }
+    }
+    LOG_DEBUG("Packed the results of the transaction {1}", transaction_id);
 }
 
 lth_jc::JsonContainer
@@ -93,15 +255,31 @@ ResultsStorage::getActionMetadata(const std::string& transaction_id)
     auto metadata_file = (spool_dir_path_ / transaction_id / METADATA).string();
     std::string metadata_txt {};
 
-    if (!fs::exists(metadata_file))
+    if (isPacked(transaction_id)) {
+        metadata_file = packedPath(transaction_id).string();
+        metadata_txt = readPacked(transaction_id)[TransactionRecord::Segment::Metadata];
+    } else if (!fs::exists(metadata_file)) {
         throw Error {
             lth_loc::format("metadata file of the transaction {1} does not exist",
                             transaction_id) };
-
-    if (!lth_file::read(metadata_file, metadata_txt))
+    } else if (!readFile(metadata_file, metadata_txt)) {
         throw Error {
             lth_loc::format("failed to read metadata file of the transaction {1}",
                             transaction_id) };
+    }
+
+    if (MetadataRecord::isRecord(metadata_txt)) {
+        try {
+            // Records are only written after validation
+            return MetadataRecord::decode(metadata_txt);
+        } catch (const MetadataRecord::Error& e) {
+            LOG_DEBUG("The metadata file '{1}' is not a valid record: {2}",
+                      metadata_file, e.what());
+            throw Error {
+                lth_loc::format("invalid metadata record of the transaction {1}",
+                                transaction_id) };
+        }
+    }
 
     try {
         lth_jc::JsonContainer metadata { metadata_txt };
@@ -124,19 +302,59 @@ ResultsStorage::getActionMetadata(const std::string& transaction_id)
     }
 }
 
+MetadataRecord::Summary
+ResultsStorage::getActionSummary(const std::string& transaction_id)
+{
+    auto metadata_file = (spool_dir_path_ / transaction_id / METADATA).string();
+    auto packed = isPacked(transaction_id);
+    if (packed)
+        metadata_file = packedPath(transaction_id).string();
+
+    std::string header {};
+    if (!readFile(metadata_file, header,
+                  packed ? TransactionRecord::SUMMARY_SIZE : MetadataRecord::SUMMARY_SIZE))
+        throw Error {
+            lth_loc::format("failed to read metadata file of the transaction {1}",
+                            transaction_id) };
+
+    MetadataRecord::Summary summary {};
+    if (packed) {
+        try {
+            summary = TransactionRecord::decodeSummary(header);
+        } catch (const TransactionRecord::Error& e) {
+            throw Error {
+                lth_loc::format("invalid results file of the transaction {1}: {2}",
+                                transaction_id, e.what()) };
+        }
+    } else if (MetadataRecord::isRecord(header)) {
+        try {
+            summary = MetadataRecord::decodeSummary(header);
+        } catch (const MetadataRecord::Error& e) {
+            throw Error {
+                lth_loc::format("invalid metadata record of the transaction {1}: {2}",
+                                transaction_id, e.what()) };
+        }
+    } else {
+        auto metadata = getActionMetadata(transaction_id);
+        summary.status = metadata.get<std::string>("status");
+        summary.start = metadata.get<std::string>("start");
+    }
+
+    if (summary.status.empty() || summary.start.empty())
+        throw Error {
+            lth_loc::format("invalid action metadata of the transaction {1}",
+                            transaction_id) };
+
+    return summary;
+}
+
 bool ResultsStorage::pidFileExists(const std::string& transaction_id)
 {
     return fs::exists(spool_dir_path_ / transaction_id / PID);
 }
 
-static int readIntegerFromFile(const std::string& file_path)
+static int parseInteger(const std::string& number_txt, const std::string& file_path)
 {
-    std::string number_txt {};
-
-    if (!fs::exists(file_path) || !lth_file::read(file_path, number_txt))
-        throw ResultsStorage::Error {
-            lth_loc::format("failed to read file '{1}'", file_path) };
-
     try {
         return std::stoi(number_txt);
     } catch (const std::invalid_argument& e) {
@@ -147,6 +365,17 @@ static int readIntegerFromFile(const std::string& file_path)
     }
 }
 
+static int readIntegerFromFile(const std::string& file_path)
+{
+    std::string number_txt {};
+
+    if (!fs::exists(file_path) || !lth_file::read(file_path, number_txt))
+        throw ResultsStorage::Error {
+            lth_loc::format("failed to read file '{1}'", file_path) };
+
+    return parseInteger(number_txt, file_path);
+}
+
 int ResultsStorage::getPID(const std::string& transaction_id)
 {
     return readIntegerFromFile((spool_dir_path_ / transaction_id / PID).string());
@@ -154,11 +383,41 @@ int ResultsStorage::getPID(const std::string& transaction_id)
 
 bool ResultsStorage::outputIsReady(const std::string& transaction_id)
 {
-    return fs::exists(spool_dir_path_ / transaction_id / EXITCODE);
+    return fs::exists(spool_dir_path_ / transaction_id / EXITCODE)
+           || isPacked(transaction_id);
 }
 
 ActionOutput ResultsStorage::getOutput_(const std::string& transaction_id,
                                         bool get_exitcode)
+{
+    if (!isPacked(transaction_id)) {
+        try {
+            return getDirectoryOutput_(transaction_id, get_exitcode);
+        } catch (const Error&) {
+            // The results may have been packed while reading them
+            if (!isPacked(transaction_id))
+                throw;
+        }
+    }
+
+    auto segments = readPacked(transaction_id);
+    ActionOutput output {};
+    output.std_out = std::move(segments[TransactionRecord::Segment::Stdout]);
+    output.std_err = std::move(segments[TransactionRecord::Segment::Stderr]);
+    if (get_exitcode) {
+        auto exitcode = segments.find(TransactionRecord::Segment::Exitcode);
+        if (exitcode == segments.end())
+            throw Error {
+                lth_loc::format("no exit code stored for the transaction {1}",
+                                transaction_id) };
+        output.exitcode = parseInteger(exitcode->second,
+                                       packedPath(transaction_id).string());
+    }
+    return output;
+}
+
+ActionOutput ResultsStorage::getDirectoryOutput_(const std::string& transaction_id,
+                                                 bool get_exitcode)
 {
     auto results_path = (spool_dir_path_ / transaction_id);
 
@@ -208,59 +467,345 @@ ActionOutput ResultsStorage::getOutput(const std::string& transaction_id,
     return output;
 }
 
+void ResultsStorage::indexExpiry(const std::string& transaction_id,
+                                 const lth_jc::JsonContainer& metadata)
+{
+    if (!metadata.includes("status") || !metadata.includes("start")
+            || metadata.type("status") != lth_jc::DataType::String
+            || metadata.type("start") != lth_jc::DataType::String
+            || metadata.get<std::string>("status")
+                   == ACTION_STATUS_NAMES.at(ActionStatus::Running))
+        return;
+
+    try {
+        indexExpiry(transaction_id,
+                    Timestamp::fromISO(metadata.get<std::string>("start")));
+    } catch (const Timestamp::Error& e) {
+        LOG_DEBUG("Not indexing the transaction {1} for purging: {2}",
+                  transaction_id, e.what());
+    }
+}
+
+void ResultsStorage::indexExpiry(const std::string& transaction_id,
+                                 boost::posix_time::ptime start)
+{
+    auto size = resultsSize(transaction_id);
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+    expiry_index_.push(ExpiryEntry { start, transaction_id });
+
+    auto& recorded_size = usage_[transaction_id];
+    usage_bytes_ = usage_bytes_ - recorded_size + size;
+    recorded_size = size;
+
+    // Until the first purge has indexed the whole spool, the usage is
+    // not known
+    if (expiry_index_ready_ && !pressure_signalled_ && exceedsQuotas(false)) {
+        LOG_INFO("The results stored in '{1}' exceed their quota ({2} bytes, {3} "
+                 "transactions)", spool_dir_path_.string(), usage_bytes_, usage_.size());
+        pressure_signalled_ = true;
+        if (on_pressure_)
+            on_pressure_();
+    }
+}
+
+void ResultsStorage::setQuotas(uint64_t max_bytes,
+                               uint32_t max_transactions,
+                               std::function<void()> on_pressure)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+    max_bytes_ = max_bytes;
+    max_transactions_ = max_transactions;
+    on_pressure_ = std::move(on_pressure);
+}
+
+ResultsStorage::Usage ResultsStorage::getUsage()
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+    return Usage { usage_bytes_, usage_.size() };
+}
+
+bool ResultsStorage::exceedsQuotas(bool low_watermark) const
+{
+    // The low watermark is 90% of the quota
+    auto limit = [low_watermark](uint64_t quota) -> uint64_t {
+        return low_watermark ? quota - quota / 10 : quota;
+    };
+    return (max_bytes_ > 0 && usage_bytes_ > limit(max_bytes_))
+           || (max_transactions_ > 0 && usage_.size() > limit(max_transactions_));
+}
+
+uint64_t ResultsStorage::resultsSize(const std::string& transaction_id)
+{
+    boost::system::error_code ec;
+    if (isPacked(transaction_id)) {
+        auto size = fs::file_size(packedPath(transaction_id), ec);
+        return ec ? 0 : size;
+    }
+
+    uint64_t size { 0 };
+    for (fs::directory_iterator it { spool_dir_path_ / transaction_id, ec }, end;
+            !ec && it != end; it.increment(ec)) {
+        auto file_size = fs::file_size(it->path(), ec);
+        if (!ec)
+            size += file_size;
+        ec.clear();
+    }
+    return size;
+}
+
+bool ResultsStorage::removeResults(
+                const std::string& transaction_id,
+                std::function<void(const std::string& dir_path)>& purge_callback)
+{
+    auto path = isPacked(transaction_id) ? packedPath(transaction_id)
+                                         : spool_dir_path_ / transaction_id;
+    LOG_TRACE("Removing '{1}'", path.string());
+
+    try {
+        purge_callback(path.string());
+
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+        auto recorded = usage_.find(transaction_id);
+        if (recorded != usage_.end()) {
+            usage_bytes_ -= recorded->second;
+            usage_.erase(recorded);
+        }
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to remove '{1}': {2}", path.string(), e.what());
+        return false;
+    }
+}
+
+unsigned int ResultsStorage::purgeAll_(
+                Timestamp& ts,
+                bool ttl_enabled,
+                const std::unordered_set<std::string>& ongoing_transactions,
+                std::function<void(const std::string& dir_path)>& purge_callback)
+{
+    unsigned int num_purged_dirs { 0 };
+
+    auto inspect = [&](const std::string& transaction_id, const std::string& s) -> void {
+        LOG_TRACE("Inspecting '{1}' for purging", s);
+
+        try {
+            auto summary = getActionSummary(transaction_id);
+
+            if (summary.status == ACTION_STATUS_NAMES.at(ActionStatus::Running)) {
+                // Indexed once its metadata is updated
+                LOG_TRACE("Skipping '{1}' as the action status is 'running'", s);
+                return;
+            }
+
+            auto start = Timestamp::fromISO(summary.start);
+            auto ongoing = ongoing_transactions.count(transaction_id) > 0;
+
+            if (ongoing || !ttl_enabled || !ts.isNewerThan(start)) {
+                indexExpiry(transaction_id, start);
+                // Results stored before enabling packing, or by an
+                // agent that stopped before packing them
+                if (pack_results_ && !ongoing)
+                    packResults(transaction_id);
+            } else if (removeResults(transaction_id, purge_callback)) {
+                num_purged_dirs++;
+            }
+        } catch (const Error& e) {
+            LOG_WARNING("Failed to retrieve the metadata for the transaction {1} "
+                        "(the results will not be removed): {2}",
+                        transaction_id, e.what());
+        } catch (const Timestamp::Error& e) {
+            LOG_WARNING("Failed to process the metadata for the transaction {1} "
+                        "(the results will not be removed): {2}",
+                        transaction_id, e.what());
+        }
+    };
+
+    lth_file::each_subdirectory(
+        spool_dir_path_.string(),
+        [&](std::string const& s) -> bool {
+            inspect(fs::path(s).filename().string(), s);
+            return true;
+        });
+
+    lth_file::each_file(
+        spool_dir_path_.string(),
+        [&](std::string const& s) -> bool {
+            auto file_name = fs::path(s).filename().string();
+            inspect(file_name.substr(0, file_name.size() - PACKED.size()), s);
+            return true;
+        },
+        ".*\\" + PACKED);
+
+    return num_purged_dirs;
+}
+
+unsigned int ResultsStorage::purgeExpired_(
+                Timestamp& ts,
+                const std::unordered_set<std::string>& ongoing_transactions,
+                std::function<void(const std::string& dir_path)>& purge_callback)
+{
+    unsigned int num_purged_dirs { 0 };
+    std::vector<ExpiryEntry> ongoing_entries {};
+    std::unordered_set<std::string> inspected {};
+
+    while (true) {
+        ExpiryEntry entry {};
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+            if (expiry_index_.empty() || !ts.isNewerThan(expiry_index_.top().start))
+                break;
+            entry = expiry_index_.top();
+            expiry_index_.pop();
+        }
+
+        if (ongoing_transactions.count(entry.transaction_id) > 0) {
+            ongoing_entries.push_back(std::move(entry));
+            continue;
+        }
+
+        // Duplicate entry, or already removed
+        if (!inspected.insert(entry.transaction_id).second || !find(entry.transaction_id))
+            continue;
+
+        LOG_TRACE("Inspecting the results of the transaction {1} for purging",
+                  entry.transaction_id);
+
+        try {
+            // The metadata may have been updated after being indexed
+            auto summary = getActionSummary(entry.transaction_id);
+
+            if (summary.status == ACTION_STATUS_NAMES.at(ActionStatus::Running))
+                continue;
+
+            auto start = Timestamp::fromISO(summary.start);
+            if (!ts.isNewerThan(start)) {
+                indexExpiry(entry.transaction_id, start);
+            } else if (removeResults(entry.transaction_id, purge_callback)) {
+                num_purged_dirs++;
+            }
+        } catch (const Error& e) {
+            LOG_WARNING("Failed to retrieve the metadata for the transaction {1} "
+                        "(the results will not be removed): {2}",
+                        entry.transaction_id, e.what());
+        } catch (const Timestamp::Error& e) {
+            LOG_WARNING("Failed to process the metadata for the transaction {1} "
+                        "(the results will not be removed): {2}",
+                        entry.transaction_id, e.what());
+        }
+    }
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+    for (auto& entry : ongoing_entries)
+        expiry_index_.push(std::move(entry));
+
+    return num_purged_dirs;
+}
+
+unsigned int ResultsStorage::purgeOverQuotas_(
+                const std::unordered_set<std::string>& ongoing_transactions,
+                std::function<void(const std::string& dir_path)>& purge_callback)
+{
+    unsigned int num_purged_dirs { 0 };
+    std::vector<ExpiryEntry> ongoing_entries {};
+    std::unordered_set<std::string> inspected {};
+
+    while (true) {
+        ExpiryEntry entry {};
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+            if (expiry_index_.empty() || !exceedsQuotas(true)) {
+                pressure_signalled_ = false;
+                break;
+            }
+            entry = expiry_index_.top();
+            expiry_index_.pop();
+        }
+
+        if (ongoing_transactions.count(entry.transaction_id) > 0) {
+            ongoing_entries.push_back(std::move(entry));
+            continue;
+        }
+
+        if (!inspected.insert(entry.transaction_id).second || !find(entry.transaction_id))
+            continue;
+
+        try {
+            if (getActionSummary(entry.transaction_id).status
+                    != ACTION_STATUS_NAMES.at(ActionStatus::Running)
+                    && removeResults(entry.transaction_id, purge_callback))
+                num_purged_dirs++;
+        } catch (const Error& e) {
+            LOG_WARNING("Failed to retrieve the metadata for the transaction {1} "
+                        "(the results will not be removed): {2}",
+                        entry.transaction_id, e.what());
+        }
+    }
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+    for (auto& entry : ongoing_entries)
+        expiry_index_.push(std::move(entry));
+
+    // Results that could not be removed are no longer indexed; stop
+    // accounting for them, so that they don't trigger purges forever
+    if (expiry_index_.size() < usage_.size()) {
+        std::unordered_set<std::string> indexed {};
+        auto index = expiry_index_;
+        while (!index.empty()) {
+            indexed.insert(index.top().transaction_id);
+            index.pop();
+        }
+        for (auto it = usage_.begin(); it != usage_.end();) {
+            if (indexed.count(it->first) == 0) {
+                usage_bytes_ -= it->second;
+                it = usage_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (num_purged_dirs > 0)
+        LOG_INFO("Removed the results of the {1} oldest transactions to respect the "
+                 "quotas of '{2}'", num_purged_dirs, spool_dir_path_.string());
+    return num_purged_dirs;
+}
+
 unsigned int ResultsStorage::purge(
                 const std::string& ttl,
                 std::vector<std::string> ongoing_transactions,
                 std::function<void(const std::string& dir_path)> purge_callback)
 {
-    unsigned int num_purged_dirs { 0 };
     Timestamp ts { ttl };
+    auto ttl_enabled = Timestamp::getMinutes(ttl) > 0;
     if (purge_callback == nullptr)
         purge_callback = &Purgeable::defaultDirPurgeCallback;
 
-    LOG_INFO("About to purge the results directories from '{1}'; TTL = {2}",
-             spool_dir_path_.string(), ttl);
+    const std::unordered_set<std::string> ongoing { ongoing_transactions.begin(),
+                                                    ongoing_transactions.end() };
+    bool index_ready { false };
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+        index_ready = expiry_index_ready_;
+    }
 
-    lth_file::each_subdirectory(
-        spool_dir_path_.string(),
-        [&](std::string const& s) -> bool {
-            fs::path dir_path { s };
-            auto transaction_id = dir_path.filename().string();
-            LOG_TRACE("Inspecting '{1}' for purging", s);
-
-            if (!ongoing_transactions.empty()
-                    && std::find(ongoing_transactions.begin(),
-                                 ongoing_transactions.end(),
-                                 transaction_id) != ongoing_transactions.end())
-                return true;
-
-            try {
-                auto md = getActionMetadata(transaction_id);
-
-                if (md.get<std::string>("status") == "running") {
-                    LOG_TRACE("Skipping '{1}' as the action status is 'running'", s);
-                } else if (ts.isNewerThan(md.get<std::string>("start"))) {
-                    LOG_TRACE("Removing '{1}'", s);
-
-                    try {
-                        purge_callback(dir_path.string());
-                        num_purged_dirs++;
-                    } catch (const std::exception& e) {
-                        LOG_ERROR("Failed to remove '{1}': {2}", s, e.what());
-                    }
-                }
-            } catch (const Error& e) {
-                LOG_WARNING("Failed to retrieve the metadata for the transaction {1} "
-                            "(the results directory will not be removed): {2}",
-                            transaction_id, e.what());
-            } catch (const Timestamp::Error& e) {
-                LOG_WARNING("Failed to process the metadata for the transaction {1} "
-                            "(the results directory will not be removed): {2}",
-                            transaction_id, e.what());
-            }
+    unsigned int num_purged_dirs { 0 };
+    if (index_ready) {
+        if (ttl_enabled) {
+            LOG_INFO("About to purge the expired results from '{1}'; TTL = {2}",
+                     spool_dir_path_.string(), ttl);
+            num_purged_dirs = purgeExpired_(ts, ongoing, purge_callback);
+        }
+    } else {
+        LOG_INFO("About to purge the results directories from '{1}'; TTL = {2}",
+                 spool_dir_path_.string(), ttl);
+        num_purged_dirs = purgeAll_(ts, ttl_enabled, ongoing, purge_callback);
 
-            return true;
-        });
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { expiry_index_mutex_ };
+        expiry_index_ready_ = true;
+    }
+
+    num_purged_dirs += purgeOverQuotas_(ongoing, purge_callback);
 
     LOG_INFO(lth_loc::format_n(
         // LOCALE: info
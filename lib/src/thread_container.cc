@@ -140,6 +140,15 @@ uint32_t ThreadContainer::getNumErasedThreads() const {
     return num_erased_threads_;
 }
 
+uint32_t ThreadContainer::getNumRunningThreads() const {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    uint32_t num_running { 0 };
+    for (const auto& thread : threads_)
+        if (!*thread.second->is_done)
+            num_running++;
+    return num_running;
+}
+
 std::vector<std::string> ThreadContainer::getThreadNames() const {
     pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
     std::vector<std::string> names;
@@ -110,11 +110,10 @@ std::string Timestamp::convertToISO(std::string extended_ISO8601_time)
     return extended_ISO8601_time;
 }
 
-bool Timestamp::isNewerThan(const std::string& extended_ISO8601_time)
+pt::ptime Timestamp::fromISO(const std::string& extended_ISO8601_time)
 {
     try {
-        auto t_p = pt::from_iso_string(Timestamp::convertToISO(extended_ISO8601_time));
-        return time_point > t_p;
+        return pt::from_iso_string(Timestamp::convertToISO(extended_ISO8601_time));
     } catch (const std::exception& e) {
         std::string err { e.what() };
         throw Error {
@@ -124,6 +123,16 @@ bool Timestamp::isNewerThan(const std::string& extended_ISO8601_time)
     }
 }
 
+bool Timestamp::isNewerThan(const std::string& extended_ISO8601_time)
+{
+    return time_point > Timestamp::fromISO(extended_ISO8601_time);
+}
+
+bool Timestamp::isNewerThan(const pt::ptime& t_p)
+{
+    return time_point > t_p;
+}
+
 bool Timestamp::isNewerThan(const std::time_t& t)
 {
     return time_point > pt::from_time_t(t);
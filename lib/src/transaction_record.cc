@@ -0,0 +1,115 @@
+#include <pxp-agent/transaction_record.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <cstring>
+
+namespace PXPAgent {
+namespace TransactionRecord {
+
+namespace lth_loc = leatherman::locale;
+
+static const char MAGIC[] { 'P', 'X', 'P', 'T' };
+
+static void appendSize(std::string& out, uint64_t size)
+{
+    for (size_t i = 0; i < 8; i++)
+        out.push_back(static_cast<char>((size >> (8 * i)) & 0xFF));
+}
+
+static uint64_t readSize(const std::string& data, size_t pos)
+{
+    uint64_t size { 0 };
+    for (size_t i = 0; i < 8; i++)
+        size |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i]))
+                << (8 * i);
+    return size;
+}
+
+bool isRecord(const std::string& data)
+{
+    return data.size() >= sizeof(MAGIC)
+           && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::string encode(const Segments& segments)
+{
+    if (segments.find(Segment::Metadata) == segments.end())
+        throw Error { lth_loc::translate("missing metadata segment") };
+
+    size_t size { sizeof(MAGIC) + 1 };
+    for (const auto& segment : segments)
+        size += 9 + segment.second.size();
+
+    std::string out {};
+    out.reserve(size);
+    out.append(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(VERSION));
+
+    // std::map keeps the segments sorted; Metadata is the first type
+    for (const auto& segment : segments) {
+        out.push_back(static_cast<char>(segment.first));
+        appendSize(out, segment.second.size());
+        out += segment.second;
+    }
+
+    return out;
+}
+
+static void checkHeader(const std::string& data)
+{
+    if (!isRecord(data) || data.size() < sizeof(MAGIC) + 1)
+        throw Error { lth_loc::translate("not a transaction record") };
+
+    auto version = static_cast<uint8_t>(data[sizeof(MAGIC)]);
+    if (version != VERSION)
+        throw Error { lth_loc::format("unsupported transaction record version {1}",
+                                      static_cast<int>(version)) };
+}
+
+Segments decode(const std::string& data)
+{
+    checkHeader(data);
+
+    Segments segments {};
+    size_t pos { sizeof(MAGIC) + 1 };
+    while (pos < data.size()) {
+        if (data.size() - pos < 9)
+            throw Error { lth_loc::translate("truncated transaction record") };
+
+        auto type = static_cast<Segment>(data[pos]);
+        auto size = readSize(data, pos + 1);
+        pos += 9;
+
+        if (size > data.size() - pos)
+            throw Error { lth_loc::translate("truncated transaction record") };
+        if (type < Segment::Metadata || type > Segment::Exitcode)
+            throw Error { lth_loc::translate("invalid segment in transaction record") };
+
+        segments[type] = data.substr(pos, static_cast<size_t>(size));
+        pos += static_cast<size_t>(size);
+    }
+
+    if (segments.find(Segment::Metadata) == segments.end())
+        throw Error { lth_loc::translate("missing metadata segment") };
+
+    return segments;
+}
+
+MetadataRecord::Summary decodeSummary(const std::string& data)
+{
+    checkHeader(data);
+
+    if (data.size() < HEADER_SIZE
+            || static_cast<Segment>(data[sizeof(MAGIC) + 1]) != Segment::Metadata)
+        throw Error { lth_loc::translate("missing metadata segment") };
+
+    try {
+        return MetadataRecord::decodeSummary(data.substr(HEADER_SIZE));
+    } catch (const MetadataRecord::Error& e) {
+        throw Error { e.what() };
+    }
+}
+
+}  // namespace TransactionRecord
+}  // namespace PXPAgent
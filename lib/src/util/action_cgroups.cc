@@ -0,0 +1,265 @@
+#include <pxp-agent/util/action_cgroups.hpp>
+
+#include <leatherman/execution/execution.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.action_cgroups"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+namespace lth_exec = leatherman::execution;
+namespace lth_file = leatherman::file_util;
+namespace lth_jc   = leatherman::json_container;
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+static const std::vector<std::string> LIMIT_FILES { "cpu.weight", "memory.max", "io.weight" };
+
+static const std::string CONTROLLERS { "+cpu +memory +io" };
+
+// Interface files of cgroupfs must be written with a single write
+static bool writeInterfaceFile(const fs::path& file_path, const std::string& value)
+{
+    boost::nowide::ofstream ofs { file_path.string() };
+    ofs << value;
+    ofs.flush();
+    return static_cast<bool>(ofs);
+}
+
+static uint64_t readUint(const std::string& value)
+{
+    try {
+        return std::stoull(value);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+// JSON integers are signed; saturate instead of wrapping
+static int64_t toInt64(uint64_t value)
+{
+    return static_cast<int64_t>(
+        std::min<uint64_t>(value, std::numeric_limits<int64_t>::max()));
+}
+
+//
+// ActionCGroup
+//
+
+ActionCGroup::ActionCGroup(fs::path path)
+    : path_ { std::move(path) }
+{
+}
+
+ActionCGroup::~ActionCGroup()
+{
+    // Fails in case processes spawned by the action are still running
+    boost::system::error_code ec;
+    fs::remove(path_, ec);
+    if (ec)
+        LOG_DEBUG("Not removing the cgroup {1}: {2}", path_.string(), ec.message());
+}
+
+const fs::path& ActionCGroup::path() const
+{
+    return path_;
+}
+
+void ActionCGroup::attachBeforeExec(std::string& executable,
+                                    std::vector<std::string>& arguments) const
+{
+    // The shell would fail with 127 instead
+    auto executable_path = lth_exec::which(executable);
+    if (executable_path.empty()) {
+        LOG_DEBUG("Not moving the process of {1} to the cgroup {2}: not found",
+                  executable, path_.string());
+        return;
+    }
+
+    // The shell writes its own pid, which the command inherits by exec;
+    // the command runs outside the cgroup if that fails
+    std::vector<std::string> sh_arguments {
+        "-c",
+        "{ echo $$ > \"$0\"; } 2>/dev/null; exec \"$@\"",
+        (path_ / "cgroup.procs").string(),
+        executable_path };
+    sh_arguments.insert(sh_arguments.end(), arguments.begin(), arguments.end());
+    executable = "/bin/sh";
+    arguments = std::move(sh_arguments);
+}
+
+lth_jc::JsonContainer ActionCGroup::getUsage() const
+{
+    lth_jc::JsonContainer usage {};
+    std::string content {};
+
+    if (lth_file::read((path_ / "cpu.stat").string(), content)) {
+        std::istringstream iss { content };
+        std::string key, value;
+        while (iss >> key >> value) {
+            if (key == "usage_usec") {
+                usage.set<int64_t>("cpu_time_ms", toInt64(readUint(value) / 1000));
+                break;
+            }
+        }
+    }
+
+    // memory.peak is available since Linux 5.19
+    if (lth_file::read((path_ / "memory.peak").string(), content))
+        usage.set<int64_t>("memory_peak_kb", toInt64(readUint(content) / 1024));
+
+    // One line per device: "<major>:<minor> rbytes=<n> wbytes=<n> ..."
+    if (lth_file::read((path_ / "io.stat").string(), content)) {
+        uint64_t read_bytes { 0 };
+        uint64_t write_bytes { 0 };
+        std::istringstream iss { content };
+        std::string field;
+        while (iss >> field) {
+            if (boost::starts_with(field, "rbytes="))
+                read_bytes += readUint(field.substr(7));
+            else if (boost::starts_with(field, "wbytes="))
+                write_bytes += readUint(field.substr(7));
+        }
+        usage.set<int64_t>("io_read_kb", toInt64(read_bytes / 1024));
+        usage.set<int64_t>("io_write_kb", toInt64(write_bytes / 1024));
+    }
+
+    return usage;
+}
+
+//
+// ActionCGroups
+//
+
+ActionLimits ActionCGroups::parseLimits(const lth_jc::JsonContainer& limits)
+{
+    if (limits.type() != lth_jc::DataType::Object)
+        throw Error { lth_loc::translate("action_limits must be an object") };
+
+    ActionLimits parsed {};
+    for (const auto& key : limits.keys()) {
+        if (std::find(LIMIT_FILES.begin(), LIMIT_FILES.end(), key) == LIMIT_FILES.end())
+            throw Error { lth_loc::format("unknown action limit '{1}'", key) };
+
+        switch (limits.type(key)) {
+            case lth_jc::DataType::Int:
+                parsed[key] = std::to_string(limits.get<int>(key));
+                break;
+            case lth_jc::DataType::String:
+                parsed[key] = limits.get<std::string>(key);
+                break;
+            default:
+                throw Error {
+                    lth_loc::format("the action limit '{1}' must be a string or an integer", key) };
+        }
+    }
+
+    return parsed;
+}
+
+void ActionCGroups::configure(const std::string& parent_dir)
+{
+#ifdef __linux__
+    fs::path parent { parent_dir };
+    if (!fs::exists(parent / "cgroup.controllers"))
+        throw Error {
+            lth_loc::format("'{1}' is not a cgroup v2 directory", parent_dir) };
+
+    if (!writeInterfaceFile(parent / "cgroup.subtree_control", CONTROLLERS))
+        LOG_WARNING("Failed to enable the cpu, memory, and io controllers in {1}; "
+                    "action resources may not be limited or accounted",
+                    parent_dir);
+
+    // Remove the cgroups of actions that completed while pxp-agent
+    // was not running; the ones still containing processes are kept
+    boost::system::error_code ec;
+    for (fs::directory_iterator it { parent, ec }, end; !ec && it != end; it.increment(ec)) {
+        if (fs::is_directory(it->status())) {
+            boost::system::error_code remove_ec;
+            fs::remove(it->path(), remove_ec);
+        }
+    }
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    parent_dir_ = parent;
+    LOG_INFO("Actions will be executed in their own cgroup under {1}", parent_dir);
+#else
+    throw Error { lth_loc::translate("cgroups are only supported on Linux") };
+#endif
+}
+
+void ActionCGroups::setModuleLimits(const std::string& module_name, ActionLimits limits)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    module_limits_[module_name] = std::move(limits);
+}
+
+bool ActionCGroups::enabled() const
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return !parent_dir_.empty();
+}
+
+std::unique_ptr<ActionCGroup> ActionCGroups::create(const ActionRequest& request)
+{
+    fs::path cgroup_path {};
+    ActionLimits limits {};
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        if (parent_dir_.empty())
+            return nullptr;
+
+        cgroup_path = parent_dir_ / request.transactionId();
+        auto module_limits = module_limits_.find(request.module());
+        if (module_limits != module_limits_.end())
+            limits = module_limits->second;
+    }
+
+    boost::system::error_code ec;
+    if (!fs::create_directory(cgroup_path, ec)) {
+        LOG_WARNING("Failed to create the cgroup {1} for the {2}; it will be executed "
+                    "in the cgroup of pxp-agent: {3}",
+                    cgroup_path.string(), request.prettyLabel(),
+                    (ec ? ec.message() : lth_loc::translate("it already exists")));
+        return nullptr;
+    }
+
+    std::unique_ptr<ActionCGroup> cgroup { new ActionCGroup(cgroup_path) };
+
+    for (const auto& limit : limits) {
+        // io.weight also accepts per device weights
+        auto value = (limit.first == "io.weight" && limit.second.find(' ') == std::string::npos)
+                     ? "default " + limit.second
+                     : limit.second;
+        if (!writeInterfaceFile(cgroup_path / limit.first, value))
+            LOG_WARNING("Failed to set {1} to '{2}' for the {3}",
+                        limit.first, limit.second, request.prettyLabel());
+    }
+
+    LOG_DEBUG("Created the cgroup {1} for the {2}", cgroup_path.string(), request.prettyLabel());
+    return cgroup;
+}
+
+void ActionCGroups::reset()
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    parent_dir_.clear();
+    module_limits_.clear();
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
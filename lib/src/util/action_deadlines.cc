@@ -0,0 +1,157 @@
+#include <pxp-agent/util/action_deadlines.hpp>
+#include <pxp-agent/util/process.hpp>
+#include <pxp-agent/action_status.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.action_deadlines"
+#include <leatherman/logging/logging.hpp>
+
+#include <algorithm>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+const unsigned int ActionDeadlines::KILL_GRACE_S { 10 };
+
+// Deadlines are expressed in seconds; 512 slots of 100 ms cover the
+// most common timeouts without extra rounds
+static const pcp_util::chrono::milliseconds WHEEL_TICK { 100 };
+static const size_t WHEEL_SLOTS { 512 };
+
+//
+// ActionDeadline
+//
+
+ActionDeadline::ActionDeadline(TimerWheel& wheel,
+                               pcp_util::chrono::milliseconds timeout,
+                               pcp_util::chrono::milliseconds grace_period)
+    : wheel_ { wheel },
+      timeout_ { timeout },
+      grace_period_ { grace_period },
+      state_ { std::make_shared<State>() },
+      term_timer_ { 0 },
+      kill_timer_ { 0 }
+{
+}
+
+ActionDeadline::~ActionDeadline()
+{
+    // The PID may be recycled once the action completed; callbacks
+    // that already started signal the process before it is reaped
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { state_->mutex };
+        state_->done = true;
+    }
+    if (term_timer_ != 0)
+        wheel_.cancel(term_timer_);
+    if (kill_timer_ != 0)
+        wheel_.cancel(kill_timer_);
+}
+
+std::function<void(size_t)> ActionDeadline::arming(std::function<void(size_t)> pid_callback)
+{
+    return [this, pid_callback](size_t pid) {
+        state_->pid = static_cast<int>(pid);
+        auto state = state_;
+
+        term_timer_ = wheel_.schedule(timeout_, [state]() {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { state->mutex };
+            if (state->done)
+                return;
+            LOG_WARNING("The action process {1} exceeded its deadline; terminating it",
+                        state->pid.load());
+            state->expired = true;
+            terminateProcessGroup(state->pid, false);
+        });
+
+        auto grace_ms = grace_period_.count();
+        kill_timer_ = wheel_.schedule(timeout_ + grace_period_, [state, grace_ms]() {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { state->mutex };
+            if (state->done)
+                return;
+            LOG_WARNING("The action process {1} did not terminate within {2} ms; "
+                        "killing it", state->pid.load(), grace_ms);
+            terminateProcessGroup(state->pid, true);
+        });
+
+        if (pid_callback)
+            pid_callback(pid);
+    };
+}
+
+bool ActionDeadline::expired() const
+{
+    return state_->expired;
+}
+
+pcp_util::chrono::milliseconds ActionDeadline::timeout() const
+{
+    return timeout_;
+}
+
+pcp_util::chrono::milliseconds ActionDeadline::gracePeriod() const
+{
+    return grace_period_;
+}
+
+void ActionDeadline::updateResponse(ActionResponse& response) const
+{
+    if (!expired())
+        return;
+
+    response.setBadResultsAndEnd(
+        lth_loc::format("The {1} timed out after {2} seconds",
+                        response.prettyRequestLabel(),
+                        pcp_util::chrono::duration_cast<pcp_util::chrono::seconds>(
+                            timeout_).count()));
+    response.setStatus(ActionStatus::TimedOut);
+}
+
+//
+// ActionDeadlines
+//
+
+void ActionDeadlines::setModuleTimeout(const std::string& module_name,
+                                       unsigned int timeout_s)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    module_timeouts_[module_name] = timeout_s;
+}
+
+std::unique_ptr<ActionDeadline> ActionDeadlines::create(const ActionRequest& request)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto timeout_s = request.timeout();
+    auto module_timeout = module_timeouts_.find(request.module());
+    if (module_timeout != module_timeouts_.end() && module_timeout->second > 0)
+        timeout_s = (timeout_s == 0)
+                    ? module_timeout->second
+                    : std::min(timeout_s, module_timeout->second);
+
+    if (timeout_s == 0)
+        return nullptr;
+
+    // Start the wheel thread only once a deadline is needed
+    if (wheel_ptr_ == nullptr)
+        wheel_ptr_.reset(new TimerWheel(WHEEL_TICK, WHEEL_SLOTS));
+
+    LOG_DEBUG("The {1} will be terminated if it runs for more than {2} seconds",
+              request.prettyLabel(), timeout_s);
+    return std::unique_ptr<ActionDeadline> {
+        new ActionDeadline(*wheel_ptr_,
+                           pcp_util::chrono::seconds(timeout_s),
+                           pcp_util::chrono::seconds(KILL_GRACE_S)) };
+}
+
+void ActionDeadlines::reset()
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    module_timeouts_.clear();
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -1,4 +1,5 @@
 #include <pxp-agent/util/bolt_module.hpp>
+#include <pxp-agent/util/trace.hpp>
 #include <pxp-agent/util/utf8.hpp>
 
 #include <leatherman/execution/execution.hpp>
@@ -9,6 +10,8 @@
 #include <leatherman/logging/logging.hpp>
 #include <pxp-agent/configuration.hpp>
 
+#include <algorithm>
+
 namespace PXPAgent {
 namespace Util {
 
@@ -18,6 +21,7 @@ namespace lth_exec = leatherman::execution;
 namespace lth_file = leatherman::file_util;
 namespace lth_jc   = leatherman::json_container;
 namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
 
 #ifdef _WIN32
 // The extension is required with lth_exec::execute when using a full path.
@@ -83,25 +87,38 @@ void BoltModule::processOutputAndUpdateMetadata(PXPAgent::ActionResponse &respon
     }
 }
 
-leatherman::execution::result BoltModule::run_sync(const CommandObject &cmd) {
+leatherman::execution::result BoltModule::run_sync(const CommandObject &cmd,
+                                                   const ActionCGroup* cgroup) {
+    auto executable = cmd.executable;
+    auto arguments = cmd.arguments;
+    if (cgroup)
+        cgroup->attachBeforeExec(executable, arguments);
     return lth_exec::execute(
-            cmd.executable,
-            cmd.arguments,
+            executable,
+            arguments,
             cmd.input,
             cmd.environment,
             cmd.pid_callback,
             0,  // timeout
+            // In its own process group, so that its deadline terminates
+            // the processes it spawned as well
             leatherman::util::option_set<lth_exec::execution_options> {
                     lth_exec::execution_options::thread_safe,
                     lth_exec::execution_options::merge_environment,
-                    lth_exec::execution_options::inherit_locale
+                    lth_exec::execution_options::inherit_locale,
+                    lth_exec::execution_options::create_detached_process
             });
 }
 
-leatherman::execution::result BoltModule::run(const CommandObject &cmd) {
+leatherman::execution::result BoltModule::run(const CommandObject &cmd,
+                                              const ActionCGroup* cgroup) {
+    auto executable = cmd.executable;
+    auto arguments = cmd.arguments;
+    if (cgroup)
+        cgroup->attachBeforeExec(executable, arguments);
     return lth_exec::execute(
-            cmd.executable,
-            cmd.arguments,
+            executable,
+            arguments,
             cmd.input,
             cmd.environment,
             cmd.pid_callback,
@@ -119,9 +136,26 @@ void BoltModule::callBlockingAction(
         const Util::CommandObject &command,
         ActionResponse &response
 ) {
-    auto exec = run_sync(command);
+    auto cgroup = ActionCGroups::Instance().create(request);
+    auto deadline = ActionDeadlines::Instance().create(request);
+    Trace::ChildSpans child_spans { request.transactionId() };
+    const CommandObject* cmd { &command };
+    CommandObject armed_command {};
+    if (deadline || Trace::isEnabled()) {
+        armed_command = command;
+        if (deadline)
+            armed_command.pid_callback = deadline->arming(command.pid_callback);
+        armed_command.pid_callback = child_spans.spawning(armed_command.pid_callback);
+        cmd = &armed_command;
+    }
+    auto exec = run_sync(*cmd, cgroup.get());
+    child_spans.end();
     response.output = ActionOutput { exec.exit_code, exec.output, exec.error };
     processOutputAndUpdateMetadata(response);
+    if (deadline)
+        deadline->updateResponse(response);
+    if (cgroup)
+        response.setResourceUsage(cgroup->getUsage());
 }
 
 void BoltModule::callNonBlockingAction(
@@ -143,6 +177,15 @@ void BoltModule::callNonBlockingAction(
     wrapper_input.set<std::string>("stderr", (results_dir / "stderr").string());
     wrapper_input.set<std::string>("exitcode", (results_dir / "exitcode").string());
 
+    // The wrapper forwards SIGTERM to the command and kills it before
+    // the grace period ends, so that its exit code gets stored
+    auto deadline = ActionDeadlines::Instance().create(request);
+    if (deadline)
+        wrapper_input.set<int>("termination_grace",
+            static_cast<int>(std::max<int64_t>(
+                pcp_util::chrono::duration_cast<pcp_util::chrono::seconds>(
+                    deadline->gracePeriod()).count() / 2, 1)));
+
     CommandObject wrapped_command {
         (exec_prefix_ / EXECUTION_WRAPPER_EXECUTABLE).string(),
         {},
@@ -155,16 +198,33 @@ void BoltModule::callNonBlockingAction(
         }
     };
 
-    auto exec = run(wrapped_command);
+    if (deadline)
+        wrapped_command.pid_callback = deadline->arming(wrapped_command.pid_callback);
+    Trace::ChildSpans child_spans { request.transactionId() };
+    wrapped_command.pid_callback = child_spans.spawning(wrapped_command.pid_callback);
+    auto cgroup = ActionCGroups::Instance().create(request);
+    auto exec = run(wrapped_command, cgroup.get());
+    child_spans.end();
 
     // Stdout / stderr output should be on file, written by the execution wrapper:
-    response.output = storage_->getOutput(request.transactionId(), exec.exit_code);
+    {
+        Trace::Span span { "output_read", request.transactionId() };
+        response.output = storage_->getOutput(request.transactionId(), exec.exit_code);
+    }
     processOutputAndUpdateMetadata(response);
+    if (deadline)
+        deadline->updateResponse(response);
+    if (cgroup)
+        response.setResourceUsage(cgroup->getUsage());
 }
 
 ActionResponse BoltModule::callAction(const ActionRequest& request)
 {
+    // Task and script requests download their files while the command
+    // is built
+    Trace::Span download_span { "download", request.transactionId() };
     auto cmd = buildCommandObject(request);
+    download_span.end();
     ActionResponse response { ModuleType::Internal, request };
 
     if (request.type() == RequestType::Blocking) {
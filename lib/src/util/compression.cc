@@ -0,0 +1,160 @@
+#include <pxp-agent/util/compression.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <openssl/evp.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_loc = leatherman::locale;
+
+// Window bits selecting the gzip format, rather than the zlib one
+static const int GZIP_WINDOW_BITS { 15 + 16 };
+
+// zlib counts the available bytes as uInt; feed larger data in chunks
+static const size_t MAX_ZLIB_CHUNK { std::numeric_limits<uInt>::max() };
+
+std::string gzipCompress(const std::string& data)
+{
+    z_stream stream {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw CompressionError { lth_loc::translate("failed to initialize zlib") };
+
+    std::string compressed {};
+    compressed.resize(deflateBound(&stream, static_cast<uLong>(data.size())) + 32);
+
+    auto input = reinterpret_cast<const Bytef*>(data.data());
+    size_t input_left { data.size() };
+    int ret { Z_OK };
+
+    while (ret != Z_STREAM_END) {
+        if (stream.avail_in == 0 && input_left > 0) {
+            stream.next_in = const_cast<Bytef*>(input);
+            stream.avail_in = static_cast<uInt>(std::min(input_left, MAX_ZLIB_CHUNK));
+            input += stream.avail_in;
+            input_left -= stream.avail_in;
+        }
+
+        if (stream.total_out == compressed.size())
+            compressed.resize(compressed.size() * 2);
+        size_t out_left { compressed.size() - stream.total_out };
+        stream.next_out = reinterpret_cast<Bytef*>(&compressed[stream.total_out]);
+        stream.avail_out = static_cast<uInt>(std::min(out_left, MAX_ZLIB_CHUNK));
+
+        ret = deflate(&stream, input_left > 0 ? Z_NO_FLUSH : Z_FINISH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            deflateEnd(&stream);
+            throw CompressionError { lth_loc::format("failed to compress: {1}",
+                                                     zError(ret)) };
+        }
+    }
+
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+std::string gzipDecompress(const std::string& data)
+{
+    z_stream stream {};
+    if (inflateInit2(&stream, GZIP_WINDOW_BITS) != Z_OK)
+        throw CompressionError { lth_loc::translate("failed to initialize zlib") };
+
+    std::string decompressed {};
+    decompressed.resize(data.size() * 4 + 1024);
+
+    auto input = reinterpret_cast<const Bytef*>(data.data());
+    size_t input_left { data.size() };
+    int ret { Z_OK };
+
+    while (ret != Z_STREAM_END) {
+        if (stream.avail_in == 0) {
+            if (input_left == 0) {
+                inflateEnd(&stream);
+                throw CompressionError { lth_loc::translate(
+                    "failed to decompress: truncated data") };
+            }
+            stream.next_in = const_cast<Bytef*>(input);
+            stream.avail_in = static_cast<uInt>(std::min(input_left, MAX_ZLIB_CHUNK));
+            input += stream.avail_in;
+            input_left -= stream.avail_in;
+        }
+
+        if (stream.total_out == decompressed.size())
+            decompressed.resize(decompressed.size() * 2);
+        size_t out_left { decompressed.size() - stream.total_out };
+        stream.next_out = reinterpret_cast<Bytef*>(&decompressed[stream.total_out]);
+        stream.avail_out = static_cast<uInt>(std::min(out_left, MAX_ZLIB_CHUNK));
+
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            inflateEnd(&stream);
+            throw CompressionError { lth_loc::format("failed to decompress: {1}",
+                                                     zError(ret)) };
+        }
+    }
+
+    decompressed.resize(stream.total_out);
+    inflateEnd(&stream);
+    return decompressed;
+}
+
+// EVP_EncodeBlock and EVP_DecodeBlock take int lengths; the blocks
+// are multiple of the 3 (encoding) and 4 (decoding) byte groups
+static const size_t BASE64_BLOCK { 3 * 1024 * 1024 };
+
+std::string base64Encode(const std::string& data)
+{
+    std::string text {};
+    text.resize((data.size() + 2) / 3 * 4);
+
+    size_t out { 0 };
+    for (size_t in = 0; in < data.size(); in += BASE64_BLOCK) {
+        auto size = std::min(BASE64_BLOCK, data.size() - in);
+        out += static_cast<size_t>(EVP_EncodeBlock(
+            reinterpret_cast<unsigned char*>(&text[out]),
+            reinterpret_cast<const unsigned char*>(data.data() + in),
+            static_cast<int>(size)));
+    }
+
+    return text;
+}
+
+std::string base64Decode(const std::string& text)
+{
+    if (text.size() % 4 != 0)
+        throw CompressionError { lth_loc::translate("invalid base64 text") };
+
+    std::string data {};
+    data.resize(text.size() / 4 * 3);
+
+    size_t out { 0 };
+    for (size_t in = 0; in < text.size(); in += BASE64_BLOCK / 3 * 4) {
+        auto size = std::min(BASE64_BLOCK / 3 * 4, text.size() - in);
+        auto decoded = EVP_DecodeBlock(
+            reinterpret_cast<unsigned char*>(&data[out]),
+            reinterpret_cast<const unsigned char*>(text.data() + in),
+            static_cast<int>(size));
+        if (decoded < 0)
+            throw CompressionError { lth_loc::translate("invalid base64 text") };
+        out += static_cast<size_t>(decoded);
+    }
+
+    // EVP_DecodeBlock counts the padding as decoded zero bytes
+    if (!text.empty() && text[text.size() - 1] == '=')
+        out--;
+    if (text.size() > 1 && text[text.size() - 2] == '=')
+        out--;
+    data.resize(out);
+    return data;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
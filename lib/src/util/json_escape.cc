@@ -0,0 +1,199 @@
+#include <pxp-agent/util/json_escape.hpp>
+
+#include <cstdint>
+
+// As for the UTF-8 validation, the vectorised loops are compiled with
+// target attributes and selected at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PXP_AGENT_JSON_ESCAPE_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace PXPAgent {
+namespace Util {
+
+// Escape sequences, as written by rapidjson::Writer: 'u' for \u00XX,
+// 0 for bytes copied as they are
+static const char ESCAPES[256] {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+      0,   0, '"',   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, '\\',  0,   0,   0,
+};
+
+static const char HEX_DIGITS[] { "0123456789ABCDEF" };
+
+static inline void appendEscape(std::string& out, unsigned char c)
+{
+    auto escape = ESCAPES[c];
+    out.push_back('\\');
+    out.push_back(escape);
+    if (escape == 'u') {
+        out.append("00", 2);
+        out.push_back(HEX_DIGITS[c >> 4]);
+        out.push_back(HEX_DIGITS[c & 0xF]);
+    }
+}
+
+// Append the bytes in [start, end), escaped; also used for the tails
+// of the vectorised loops
+static void escapeScalar(std::string& out, const char* data, size_t start, size_t end)
+{
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    size_t run_start { start };
+    for (size_t i = start; i < end; i++) {
+        if (ESCAPES[s[i]]) {
+            out.append(data + run_start, i - run_start);
+            appendEscape(out, s[i]);
+            run_start = i + 1;
+        }
+    }
+    out.append(data + run_start, end - run_start);
+}
+
+static void escapeScalar(std::string& out, const char* data, size_t size)
+{
+    escapeScalar(out, data, 0, size);
+}
+
+#ifdef PXP_AGENT_JSON_ESCAPE_SIMD
+
+// The vectorised loops compute, for each block, a mask of the bytes
+// that need escaping (control characters are the bytes equal to their
+// minimum with 0x1F), then append the clean run preceding each of them;
+// blocks without such bytes only extend the current run
+
+__attribute__((target("sse2")))
+static void escapeSSE2(std::string& out, const char* data, size_t size)
+{
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    size_t run_start { 0 };
+    size_t i { 0 };
+    for (; i + 16 <= size; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i needs_escape = _mm_or_si128(
+            _mm_cmpeq_epi8(_mm_min_epu8(input, max_control), input),
+            _mm_or_si128(_mm_cmpeq_epi8(input, quote),
+                         _mm_cmpeq_epi8(input, backslash)));
+        auto mask = static_cast<unsigned int>(_mm_movemask_epi8(needs_escape));
+        while (mask != 0) {
+            size_t pos { i + static_cast<size_t>(__builtin_ctz(mask)) };
+            out.append(data + run_start, pos - run_start);
+            appendEscape(out, s[pos]);
+            run_start = pos + 1;
+            mask &= mask - 1;
+        }
+    }
+
+    out.append(data + run_start, i - run_start);
+    escapeScalar(out, data, i, size);
+}
+
+__attribute__((target("avx2")))
+static void escapeAVX2(std::string& out, const char* data, size_t size)
+{
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    const __m256i max_control = _mm256_set1_epi8(0x1F);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    size_t run_start { 0 };
+    size_t i { 0 };
+    for (; i + 32 <= size; i += 32) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i needs_escape = _mm256_or_si256(
+            _mm256_cmpeq_epi8(_mm256_min_epu8(input, max_control), input),
+            _mm256_or_si256(_mm256_cmpeq_epi8(input, quote),
+                            _mm256_cmpeq_epi8(input, backslash)));
+        auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(needs_escape));
+        while (mask != 0) {
+            size_t pos { i + static_cast<size_t>(__builtin_ctz(mask)) };
+            out.append(data + run_start, pos - run_start);
+            appendEscape(out, s[pos]);
+            run_start = pos + 1;
+            mask &= mask - 1;
+        }
+    }
+
+    out.append(data + run_start, i - run_start);
+    escapeScalar(out, data, i, size);
+}
+
+#endif  // PXP_AGENT_JSON_ESCAPE_SIMD
+
+using EscapeFunction = void (*)(std::string&, const char*, size_t);
+
+bool supportsJSONEscaper(JSONEscaper escaper)
+{
+    switch (escaper) {
+        case JSONEscaper::Scalar:
+            return true;
+#ifdef PXP_AGENT_JSON_ESCAPE_SIMD
+        case JSONEscaper::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case JSONEscaper::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static EscapeFunction escapeFunction(JSONEscaper escaper)
+{
+    switch (escaper) {
+#ifdef PXP_AGENT_JSON_ESCAPE_SIMD
+        case JSONEscaper::SSE2:
+            return &escapeSSE2;
+        case JSONEscaper::AVX2:
+            return &escapeAVX2;
+#endif
+        default:
+            return &escapeScalar;
+    }
+}
+
+static JSONEscaper fastestEscaper()
+{
+    for (auto escaper : { JSONEscaper::AVX2, JSONEscaper::SSE2 })
+        if (supportsJSONEscaper(escaper))
+            return escaper;
+    return JSONEscaper::Scalar;
+}
+
+static void appendQuoted(std::string& out,
+                         const char* data,
+                         size_t size,
+                         EscapeFunction escape)
+{
+    out.reserve(out.size() + size + 2);
+    out.push_back('"');
+    escape(out, data, size);
+    out.push_back('"');
+}
+
+void appendJSONString(std::string& out, const char* data, size_t size)
+{
+    static const EscapeFunction escape { escapeFunction(fastestEscaper()) };
+    appendQuoted(out, data, size, escape);
+}
+
+void appendJSONString(std::string& out, const std::string& s)
+{
+    appendJSONString(out, s.data(), s.size());
+}
+
+void appendJSONString(std::string& out, const char* data, size_t size,
+                      JSONEscaper escaper)
+{
+    appendQuoted(out, data, size, escapeFunction(escaper));
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
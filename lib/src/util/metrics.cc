@@ -0,0 +1,312 @@
+#include <pxp-agent/util/metrics.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <locale>
+#include <new>
+#include <sstream>
+
+namespace PXPAgent {
+namespace Util {
+namespace Metrics {
+
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+static const size_t CACHE_LINE_SIZE { 64 };
+
+// Return the first cache line boundary of a buffer one cache line
+// larger than needed; new only aligns to alignof(std::max_align_t)
+static char* alignToCacheLine(char* buffer)
+{
+    auto address = reinterpret_cast<std::uintptr_t>(buffer);
+    return buffer + (CACHE_LINE_SIZE - address % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+}
+
+// Slot of the calling thread; threads are assigned slots round robin
+static size_t shardIndex()
+{
+    static std::atomic<size_t> next_shard { 0 };
+    thread_local size_t shard { next_shard++ % NUM_SHARDS };
+    return shard;
+}
+
+//
+// Counter
+//
+
+Counter::Counter()
+        : buffer_ { new char[NUM_SHARDS * sizeof(Shard) + CACHE_LINE_SIZE] },
+          shards_ { reinterpret_cast<Shard*>(alignToCacheLine(buffer_.get())) }
+{
+    for (size_t idx = 0; idx < NUM_SHARDS; idx++) {
+        new (&shards_[idx]) Shard;
+        shards_[idx].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Counter::add(uint64_t n)
+{
+    shards_[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t total { 0 };
+    for (size_t idx = 0; idx < NUM_SHARDS; idx++)
+        total += shards_[idx].value.load(std::memory_order_relaxed);
+    return total;
+}
+
+//
+// Histogram
+//
+
+const std::vector<double>& Histogram::durationBounds()
+{
+    static const std::vector<double> the_bounds {
+        0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300, 900, 3600 };
+    return the_bounds;
+}
+
+static const size_t SLOTS_PER_CACHE_LINE { CACHE_LINE_SIZE / sizeof(std::atomic<uint64_t>) };
+
+Histogram::Histogram(std::vector<double> bounds)
+        : bounds_ { std::move(bounds) },
+          // One slot per bucket, including +Inf, and one for the sum
+          stride_ { ((bounds_.size() + 2 + SLOTS_PER_CACHE_LINE - 1)
+                     / SLOTS_PER_CACHE_LINE) * SLOTS_PER_CACHE_LINE },
+          buffer_ { new char[stride_ * NUM_SHARDS * sizeof(std::atomic<uint64_t>)
+                             + CACHE_LINE_SIZE] },
+          slots_ { reinterpret_cast<std::atomic<uint64_t>*>(
+                       alignToCacheLine(buffer_.get())) }
+{
+    if (!std::is_sorted(bounds_.begin(), bounds_.end()))
+        throw Error { lth_loc::translate("the histogram bounds are not sorted") };
+
+    for (size_t idx = 0; idx < stride_ * NUM_SHARDS; idx++) {
+        new (&slots_[idx]) std::atomic<uint64_t>;
+        slots_[idx].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value)
+{
+    auto shard = &slots_[shardIndex() * stride_];
+    // The buckets' upper bounds are inclusive
+    auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    shard[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (value > 0)
+        shard[bounds_.size() + 1].fetch_add(static_cast<uint64_t>(value * 1e6),
+                                            std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot { std::vector<uint64_t>(bounds_.size() + 1, 0), 0, 0.0 };
+    uint64_t sum { 0 };
+
+    for (size_t shard = 0; shard < NUM_SHARDS; shard++) {
+        auto slots = &slots_[shard * stride_];
+        for (size_t bucket = 0; bucket <= bounds_.size(); bucket++)
+            snapshot.buckets[bucket] += slots[bucket].load(std::memory_order_relaxed);
+        sum += slots[bounds_.size() + 1].load(std::memory_order_relaxed);
+    }
+
+    for (size_t bucket = 1; bucket < snapshot.buckets.size(); bucket++)
+        snapshot.buckets[bucket] += snapshot.buckets[bucket - 1];
+    snapshot.count = snapshot.buckets.back();
+    snapshot.sum = sum / 1e6;
+    return snapshot;
+}
+
+//
+// Registry
+//
+
+static const std::string COUNTER { "counter" };
+static const std::string GAUGE { "gauge" };
+static const std::string HISTOGRAM { "histogram" };
+
+Registry& Registry::Instance()
+{
+    static Registry registry {};
+    return registry;
+}
+
+Registry::Entry& Registry::entry(const std::string& name,
+                                 const std::string& help,
+                                 const std::string& type)
+{
+    auto& entry = entries_[name];
+    if (entry.type.empty()) {
+        entry.help = help;
+        entry.type = type;
+    } else if (entry.type != type) {
+        throw Error {
+            lth_loc::format("the metric {1} is a {2}, not a {3}", name, entry.type, type) };
+    }
+    return entry;
+}
+
+Counter& Registry::counter(const std::string& name,
+                           const std::string& help,
+                           const Labels& labels)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto& counter = entry(name, help, COUNTER).counters[labels];
+    if (counter == nullptr)
+        counter.reset(new Counter());
+    return *counter;
+}
+
+Histogram& Registry::histogram(const std::string& name,
+                               const std::string& help,
+                               const Labels& labels,
+                               const std::vector<double>& bounds)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto& histogram = entry(name, help, HISTOGRAM).histograms[labels];
+    if (histogram == nullptr)
+        histogram.reset(new Histogram(bounds));
+    return *histogram;
+}
+
+void Registry::setGauge(const std::string& name,
+                        const std::string& help,
+                        std::function<double()> sample)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    entry(name, help, GAUGE).gauge = std::move(sample);
+}
+
+void Registry::removeGauge(const std::string& name)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_gauges_lock { gauges_mutex_ };
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto found = entries_.find(name);
+    if (found != entries_.end() && found->second.type == GAUGE)
+        entries_.erase(found);
+}
+
+// Format numbers as Prometheus does, regardless of the global locale
+static std::string formatValue(double value)
+{
+    std::ostringstream stream {};
+    stream.imbue(std::locale::classic());
+    stream.precision(15);
+    stream << value;
+    return stream.str();
+}
+
+std::vector<Family> Registry::collect() const
+{
+    // Gauges are sampled after unlocking the registry, so that the
+    // updates creating metrics don't wait for them
+    pcp_util::lock_guard<pcp_util::mutex> the_gauges_lock { gauges_mutex_ };
+    std::vector<Family> families {};
+    std::vector<std::pair<size_t, std::function<double()>>> gauges {};
+
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+
+        for (const auto& named_entry : entries_) {
+            const auto& name = named_entry.first;
+            const auto& entry = named_entry.second;
+            Family family { name, entry.help, entry.type, {} };
+
+            if (entry.type == COUNTER) {
+                for (const auto& counter : entry.counters)
+                    family.samples.push_back(
+                        Sample { name, counter.first, static_cast<double>(counter.second->value()) });
+            } else if (entry.type == GAUGE) {
+                if (!entry.gauge)
+                    continue;
+                gauges.emplace_back(families.size(), entry.gauge);
+            } else {
+                for (const auto& histogram : entry.histograms) {
+                    auto snapshot = histogram.second->snapshot();
+                    const auto& bounds = histogram.second->bounds();
+
+                    for (size_t bucket = 0; bucket < snapshot.buckets.size(); bucket++) {
+                        auto labels = histogram.first;
+                        labels.emplace_back("le", bucket < bounds.size()
+                                                  ? formatValue(bounds[bucket])
+                                                  : "+Inf");
+                        family.samples.push_back(
+                            Sample { name + "_bucket", std::move(labels),
+                                     static_cast<double>(snapshot.buckets[bucket]) });
+                    }
+                    family.samples.push_back(
+                        Sample { name + "_sum", histogram.first, snapshot.sum });
+                    family.samples.push_back(
+                        Sample { name + "_count", histogram.first,
+                                 static_cast<double>(snapshot.count) });
+                }
+            }
+
+            families.push_back(std::move(family));
+        }
+    }
+
+    for (const auto& gauge : gauges) {
+        auto& family = families[gauge.first];
+        family.samples.push_back(Sample { family.name, {}, gauge.second() });
+    }
+
+    return families;
+}
+
+//
+// Exposition
+//
+
+static std::string escape(const std::string& txt, bool is_label_value)
+{
+    std::string escaped {};
+    escaped.reserve(txt.size());
+    for (auto c : txt) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c == '"' && is_label_value) {
+            escaped += "\\\"";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string seriesName(const Sample& sample)
+{
+    if (sample.labels.empty())
+        return sample.name;
+
+    std::string series { sample.name + "{" };
+    for (const auto& label : sample.labels) {
+        if (series.back() != '{')
+            series += ",";
+        series += label.first + "=\"" + escape(label.second, true) + "\"";
+    }
+    return series + "}";
+}
+
+std::string toPrometheusText(const std::vector<Family>& families)
+{
+    std::string text {};
+    for (const auto& family : families) {
+        text += "# HELP " + family.name + " " + escape(family.help, false) + "\n";
+        text += "# TYPE " + family.name + " " + family.type + "\n";
+        for (const auto& sample : family.samples)
+            text += seriesName(sample) + " " + formatValue(sample.value) + "\n";
+    }
+    return text;
+}
+
+}  // namespace Metrics
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,239 @@
+#include <pxp-agent/util/module_params.hpp>
+#include <pxp-agent/module.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_jc  = leatherman::json_container;
+namespace lth_loc = leatherman::locale;
+
+// Reads the entries of an object, reporting errors with their path
+// from the request params
+class ObjectReader {
+  public:
+    explicit ObjectReader(const lth_jc::JsonContainer& data, std::string label = "")
+            : data_ (data),
+              label_ { std::move(label) }
+    {
+    }
+
+    std::string label(const std::string& key) const
+    {
+        return label_.empty() ? key : label_ + "." + key;
+    }
+
+    // Return true if the entry exists and has the specified type
+    bool has(const std::string& key, lth_jc::DataType type, bool required) const
+    {
+        if (!data_.includes(key)) {
+            if (required)
+                throw Module::ProcessingError {
+                    lth_loc::format("invalid input: '{1}' is missing", label(key)) };
+            return false;
+        }
+
+        if (data_.type(key) != type)
+            throw Module::ProcessingError {
+                lth_loc::format("invalid input: '{1}' has the wrong type", label(key)) };
+        return true;
+    }
+
+    std::string string(const std::string& key, bool required = false) const
+    {
+        return has(key, lth_jc::DataType::String, required)
+               ? data_.get<std::string>(key)
+               : std::string {};
+    }
+
+    bool boolean(const std::string& key, bool required = false) const
+    {
+        return has(key, lth_jc::DataType::Bool, required) && data_.get<bool>(key);
+    }
+
+    lth_jc::JsonContainer object(const std::string& key, bool required = false) const
+    {
+        return has(key, lth_jc::DataType::Object, required)
+               ? data_.get<lth_jc::JsonContainer>(key)
+               : lth_jc::JsonContainer {};
+    }
+
+    std::vector<std::string> strings(const std::string& key, bool required = false) const
+    {
+        if (!has(key, lth_jc::DataType::Array, required))
+            return {};
+
+        try {
+            return data_.get<std::vector<std::string>>(key);
+        } catch (const lth_jc::data_type_error&) {
+            throw Module::ProcessingError {
+                lth_loc::format("invalid input: '{1}' must contain only strings",
+                                label(key)) };
+        }
+    }
+
+    std::vector<lth_jc::JsonContainer> objects(const std::string& key,
+                                               bool required = false) const
+    {
+        if (!has(key, lth_jc::DataType::Array, required))
+            return {};
+
+        auto entries = data_.get<std::vector<lth_jc::JsonContainer>>(key);
+        for (const auto& entry : entries)
+            if (entry.type() != lth_jc::DataType::Object)
+                throw Module::ProcessingError {
+                    lth_loc::format("invalid input: '{1}' must contain only objects",
+                                    label(key)) };
+        return entries;
+    }
+
+  private:
+    const lth_jc::JsonContainer& data_;
+    std::string label_;
+};
+
+static std::string elementLabel(const ObjectReader& reader,
+                                const std::string& key,
+                                size_t idx)
+{
+    return reader.label(key) + "[" + std::to_string(idx) + "]";
+}
+
+static RemoteFile decodeRemoteFile(const lth_jc::JsonContainer& file,
+                                   const std::string& label)
+{
+    ObjectReader reader { file, label };
+    RemoteFile remote_file {};
+    remote_file.filename = reader.string("filename");
+    remote_file.sha256 = reader.string("sha256");
+
+    if (reader.has("uri", lth_jc::DataType::Object, false)) {
+        auto uri = file.get<lth_jc::JsonContainer>("uri");
+        ObjectReader uri_reader { uri, reader.label("uri") };
+        remote_file.uri_path = uri_reader.string("path", true);
+
+        auto uri_params = uri_reader.object("params");
+        for (auto& key : uri_params.keys()) {
+            if (uri_params.type(key) != lth_jc::DataType::String)
+                throw Module::ProcessingError {
+                    lth_loc::format("invalid input: '{1}' has the wrong type",
+                                    uri_reader.label("params") + "." + key) };
+            remote_file.uri_params.emplace_back(key, uri_params.get<std::string>(key));
+        }
+    }
+
+    return remote_file;
+}
+
+RemoteFile RemoteFile::decode(const lth_jc::JsonContainer& file)
+{
+    return decodeRemoteFile(file, "");
+}
+
+TaskParams TaskParams::decode(const lth_jc::JsonContainer& params)
+{
+    ObjectReader reader { params };
+    TaskParams task_params {};
+    task_params.task = reader.string("task", true);
+    task_params.input = reader.object("input", true);
+
+    auto files = reader.objects("files", true);
+    task_params.files.reserve(files.size());
+    for (size_t idx = 0; idx < files.size(); idx++)
+        task_params.files.push_back(
+            decodeRemoteFile(files[idx], elementLabel(reader, "files", idx)));
+
+    // Without metadata, the params themselves describe the task
+    auto has_metadata = reader.has("metadata", lth_jc::DataType::Object, false);
+    lth_jc::JsonContainer metadata_entry {};
+    if (has_metadata)
+        metadata_entry = params.get<lth_jc::JsonContainer>("metadata");
+    const auto& metadata = has_metadata ? metadata_entry : params;
+    ObjectReader metadata_reader { metadata, has_metadata ? "metadata" : "" };
+
+    task_params.input_method = metadata_reader.string("input_method");
+    task_params.features = metadata_reader.strings("features");
+
+    auto implementations = metadata_reader.objects("implementations");
+    task_params.implementations.reserve(implementations.size());
+    for (size_t idx = 0; idx < implementations.size(); idx++) {
+        ObjectReader impl_reader {
+            implementations[idx],
+            elementLabel(metadata_reader, "implementations", idx) };
+        task_params.implementations.push_back(Implementation {
+            impl_reader.string("name", true),
+            impl_reader.string("input_method"),
+            impl_reader.strings("requirements"),
+            impl_reader.strings("files") });
+    }
+
+    // Only the files listed in the metadata, as opposed to the file
+    // objects supplied by puppetserver
+    if (has_metadata)
+        task_params.metadata_files = metadata_reader.strings("files");
+
+    return task_params;
+}
+
+ScriptParams ScriptParams::decode(const lth_jc::JsonContainer& params)
+{
+    ObjectReader reader { params };
+    ScriptParams script_params {};
+    script_params.script = decodeRemoteFile(reader.object("script", true),
+                                            reader.label("script"));
+    script_params.arguments = reader.strings("arguments", true);
+    return script_params;
+}
+
+FileParams FileParams::decode(const lth_jc::JsonContainer& params)
+{
+    ObjectReader reader { params };
+    FileParams file_params {};
+
+    auto files = reader.objects("files", true);
+    file_params.files.reserve(files.size());
+    for (size_t idx = 0; idx < files.size(); idx++) {
+        auto label = elementLabel(reader, "files", idx);
+        ObjectReader entry_reader { files[idx], label };
+        file_params.files.push_back(Entry {
+            decodeRemoteFile(files[idx], label),
+            entry_reader.string("destination", true),
+            entry_reader.string("link_source"),
+            entry_reader.string("kind", true) });
+    }
+
+    return file_params;
+}
+
+CommandParams CommandParams::decode(const lth_jc::JsonContainer& params)
+{
+    return CommandParams { ObjectReader { params }.string("command", true) };
+}
+
+ApplyParams ApplyParams::decode(const lth_jc::JsonContainer& params)
+{
+    // Accessed by path, so that the catalog is not copied
+    static const std::vector<lth_jc::JsonContainerKey> ENVIRONMENT_PATH {
+        "catalog", "environment" };
+
+    ObjectReader reader { params };
+    if (!reader.has("catalog", lth_jc::DataType::Object, true)
+            || !params.includes(ENVIRONMENT_PATH)
+            || params.type(ENVIRONMENT_PATH) != lth_jc::DataType::String)
+        throw Module::ProcessingError {
+            lth_loc::format("invalid input: '{1}' must be a string",
+                            reader.label("catalog") + ".environment") };
+
+    return ApplyParams { params.get<std::string>(ENVIRONMENT_PATH) };
+}
+
+PrepParams PrepParams::decode(const lth_jc::JsonContainer& params)
+{
+    ObjectReader reader { params };
+    return PrepParams { reader.string("environment", true),
+                        reader.boolean("refresh_facts") };
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,456 @@
+#include <pxp-agent/util/apply_worker_pool.hpp>
+#include <pxp-agent/util/bolt_helpers.hpp>
+#include <pxp-agent/configuration.hpp>
+
+#include <leatherman/execution/execution.hpp>
+#include <leatherman/locale/locale.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.apply_worker_pool"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs       = boost::filesystem;
+namespace lth_exec = leatherman::execution;
+namespace lth_loc  = leatherman::locale;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+struct ApplyWorkerPool::Worker {
+    std::string environment;
+    fs::path socket_path;
+    fs::path stdout_path;
+    fs::path stderr_path;
+    std::atomic<int> pid { 0 };
+    std::atomic<bool> stopping { false };
+    std::atomic<bool> exited { false };
+    bool busy { false };
+    std::chrono::steady_clock::time_point last_used;
+    std::unique_ptr<pcp_util::thread> thread_ptr;
+};
+
+//
+// Local socket helpers
+//
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS { MSG_NOSIGNAL };
+#else
+static const int SEND_FLAGS { 0 };
+#endif
+
+// Return a socket connected to the specified path or -1 (errno set)
+static int connectToSocket(const std::string& socket_path)
+{
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+#ifdef SO_NOSIGPIPE
+    int on { 1 };
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    while (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (errno != EINTR) {
+            auto connect_errno = errno;
+            close(fd);
+            errno = connect_errno;
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+static bool sendAll(int fd, const std::string& data)
+{
+    size_t sent { 0 };
+    while (sent < data.size()) {
+        auto n = send(fd, data.data() + sent, data.size() - sent, SEND_FLAGS);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Append what's read to the buffer; return the number of read bytes
+// (0 in case of EOF) or -1 in case of failure
+static ssize_t readSome(int fd, std::string& buffer)
+{
+    char chunk[0x10000];  // 64 kB
+    ssize_t n;
+    do {
+        n = read(fd, chunk, sizeof(chunk));
+    } while (n < 0 && errno == EINTR);
+    if (n > 0)
+        buffer.append(chunk, static_cast<size_t>(n));
+    return n;
+}
+
+// Parse the output sent by the worker after processing a request;
+// it's formatted as:
+//   "<exitcode> <stdout size> <stderr size>\n<stdout><stderr>"
+static ActionOutput parseWorkerOutput(const std::string& buffer, size_t offset)
+{
+    auto header_end = buffer.find('\n', offset);
+    if (header_end == std::string::npos)
+        throw ApplyWorkerPool::Error {
+            lth_loc::translate("the worker closed the connection before sending the output") };
+
+    int exitcode;
+    size_t stdout_size, stderr_size;
+    auto header = buffer.substr(offset, header_end - offset);
+    if (std::sscanf(header.c_str(), "%d %zu %zu", &exitcode, &stdout_size, &stderr_size) != 3)
+        throw ApplyWorkerPool::Error {
+            lth_loc::format("invalid output header '{1}'", header) };
+
+    auto body_start = header_end + 1;
+    if (buffer.size() - body_start != stdout_size + stderr_size)
+        throw ApplyWorkerPool::Error {
+            lth_loc::translate("the worker sent a truncated output") };
+
+    return ActionOutput { exitcode,
+                          buffer.substr(body_start, stdout_size),
+                          buffer.substr(body_start + stdout_size, stderr_size) };
+}
+
+//
+// ApplyWorkerPool
+//
+
+ApplyWorkerPool::ApplyWorkerPool(uint32_t max_workers,
+                                 fs::path workers_dir,
+                                 uint32_t idle_timeout_s)
+        : max_workers_ { max_workers },
+          workers_dir_ { std::move(workers_dir) },
+          idle_timeout_s_ { idle_timeout_s },
+          worker_counter_ { 0 }
+{
+    if (enabled())
+        LOG_DEBUG("Up to {1} warm apply workers will be started; sockets will "
+                  "be stored in '{2}'", max_workers, workers_dir_.string());
+}
+
+ApplyWorkerPool::~ApplyWorkerPool()
+{
+    std::vector<std::shared_ptr<Worker>> workers;
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { workers_mutex_ };
+        workers.swap(stopped_workers_);
+        for (auto& w : workers_)
+            workers.push_back(std::move(w.second));
+        workers_.clear();
+    }
+
+    // Workers exit on SIGTERM, even while initializing Puppet, so
+    // their threads terminate shortly
+    for (auto& worker : workers)
+        stopWorker(*worker);
+
+    for (auto& worker : workers) {
+        if (worker->thread_ptr->joinable())
+            worker->thread_ptr->join();
+        boost::system::error_code ec;
+        fs::remove(worker->socket_path, ec);
+    }
+}
+
+bool ApplyWorkerPool::enabled() const
+{
+    return max_workers_ > 0;
+}
+
+bool ApplyWorkerPool::run(const std::string& environment,
+                          const CommandObject& shim_command,
+                          const std::string& worker_input,
+                          const std::string& input,
+                          ActionOutput& output,
+                          std::function<void(size_t)> pid_callback)
+{
+    if (!enabled())
+        return false;
+
+    std::shared_ptr<Worker> worker;
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { workers_mutex_ };
+        worker = acquireWorker(environment, shim_command, worker_input);
+    }
+
+    if (!worker)
+        return false;
+
+    lth_util::scope_exit release_worker {
+        [this, &worker]() {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { workers_mutex_ };
+            worker->busy = false;
+            worker->last_used = std::chrono::steady_clock::now();
+        }
+    };
+
+    auto fd = connectToSocket(worker->socket_path.string());
+    if (fd < 0) {
+        LOG_DEBUG("Failed to connect to the apply worker for environment "
+                  "'{1}': {2}", environment, std::strerror(errno));
+        return false;
+    }
+
+    lth_util::scope_exit close_socket { [fd]() { close(fd); } };
+
+    if (!sendAll(fd, input) || shutdown(fd, SHUT_WR) < 0) {
+        LOG_WARNING("Failed to send the request to the apply worker for "
+                    "environment '{1}': {2}", environment, std::strerror(errno));
+        return false;
+    }
+
+    // The worker first sends the PID of the process that executes the
+    // request; up to that point the request can be safely retried
+    std::string buffer;
+    size_t pid_line_end;
+    while ((pid_line_end = buffer.find('\n')) == std::string::npos) {
+        if (readSome(fd, buffer) <= 0) {
+            LOG_WARNING("The apply worker for environment '{1}' did not accept "
+                        "the request", environment);
+            return false;
+        }
+    }
+
+    size_t pid;
+    try {
+        pid = std::stoul(buffer.substr(0, pid_line_end));
+    } catch (const std::exception&) {
+        LOG_WARNING("The apply worker for environment '{1}' sent an invalid "
+                    "PID", environment);
+        return false;
+    }
+
+    if (pid_callback)
+        pid_callback(pid);
+
+    ssize_t n;
+    while ((n = readSome(fd, buffer)) > 0) {}
+
+    if (n < 0)
+        throw Error { lth_loc::format("failed to read the output: {1}",
+                                      std::strerror(errno)) };
+
+    output = parseWorkerOutput(buffer, pid_line_end + 1);
+    return true;
+}
+
+//
+// Private interface
+//
+
+std::shared_ptr<ApplyWorkerPool::Worker>
+ApplyWorkerPool::acquireWorker(const std::string& environment,
+                               const CommandObject& shim_command,
+                               const std::string& worker_input)
+{
+    reapWorkers();
+
+    auto w_itr = workers_.find(environment);
+    if (w_itr == workers_.end()) {
+        if (workers_.size() < max_workers_ || evictWorker())
+            startWorker(environment, shim_command, worker_input);
+        return nullptr;
+    }
+
+    auto& worker = w_itr->second;
+
+    // The worker creates its socket once Puppet is initialized
+    boost::system::error_code ec;
+    if (worker->busy || !fs::exists(worker->socket_path, ec)) {
+        LOG_DEBUG("The apply worker for environment '{1}' is not ready",
+                  environment);
+        return nullptr;
+    }
+
+    worker->busy = true;
+    return worker;
+}
+
+void ApplyWorkerPool::startWorker(const std::string& environment,
+                                  const CommandObject& shim_command,
+                                  const std::string& worker_input)
+{
+    auto worker = std::make_shared<Worker>();
+    auto worker_name = "w" + std::to_string(++worker_counter_);
+    worker->environment = environment;
+    worker->socket_path = workers_dir_ / (worker_name + ".sock");
+    worker->stdout_path = workers_dir_ / (worker_name + ".out");
+    worker->stderr_path = workers_dir_ / (worker_name + ".err");
+    worker->last_used = std::chrono::steady_clock::now();
+
+    if (worker->socket_path.string().size() >= sizeof(sockaddr_un::sun_path)) {
+        LOG_WARNING("Cannot start apply workers; the socket path '{1}' is too "
+                    "long", worker->socket_path.string());
+        max_workers_ = 0;
+        return;
+    }
+
+    try {
+        createDir(workers_dir_);
+        fs::remove(worker->socket_path);
+    } catch (const fs::filesystem_error& e) {
+        LOG_WARNING("Cannot start the apply worker for environment '{1}': {2}",
+                    environment, e.what());
+        return;
+    }
+
+    auto cmd = shim_command;
+    cmd.arguments.push_back("--worker");
+    cmd.arguments.push_back(worker->socket_path.string());
+    cmd.arguments.push_back(std::to_string(idle_timeout_s_));
+
+    LOG_INFO("Starting the apply worker for environment '{1}'", environment);
+
+    worker->thread_ptr.reset(new pcp_util::thread(
+        [worker, cmd, worker_input]() {
+            try {
+                auto exec = lth_exec::execute(
+                    cmd.executable,
+                    cmd.arguments,
+                    worker_input,
+                    worker->stdout_path.string(),
+                    worker->stderr_path.string(),
+                    cmd.environment,
+                    [worker](size_t pid) {
+                        worker->pid = static_cast<int>(pid);
+                        if (worker->stopping)
+                            stopWorker(*worker);
+                    },
+                    0,  // timeout
+                    NIX_FILE_PERMS,
+                    lth_util::option_set<lth_exec::execution_options> {
+                        lth_exec::execution_options::thread_safe,
+                        lth_exec::execution_options::merge_environment,
+                        lth_exec::execution_options::inherit_locale,
+                        lth_exec::execution_options::create_detached_process });
+                if (exec.exit_code == EXIT_SUCCESS) {
+                    LOG_INFO("The apply worker for environment '{1}' exited",
+                             worker->environment);
+                    boost::system::error_code ec;
+                    fs::remove(worker->stdout_path, ec);
+                    fs::remove(worker->stderr_path, ec);
+                } else {
+                    LOG_WARNING("The apply worker for environment '{1}' exited "
+                                "with code {2}; its output is in '{3}' and '{4}'",
+                                worker->environment, exec.exit_code,
+                                worker->stdout_path.string(),
+                                worker->stderr_path.string());
+                }
+            } catch (const lth_exec::execution_exception& e) {
+                LOG_WARNING("Failed to start the apply worker for environment "
+                            "'{1}': {2}", worker->environment, e.what());
+                removeWorkerFiles(*worker);
+            }
+            worker->exited = true;
+        }));
+
+    workers_[environment] = std::move(worker);
+}
+
+void ApplyWorkerPool::reapWorkers()
+{
+    for (auto w_itr = stopped_workers_.begin(); w_itr != stopped_workers_.end();) {
+        if (!(*w_itr)->exited) {
+            ++w_itr;
+            continue;
+        }
+
+        if ((*w_itr)->thread_ptr->joinable())
+            (*w_itr)->thread_ptr->join();
+        w_itr = stopped_workers_.erase(w_itr);
+    }
+
+    for (auto w_itr = workers_.begin(); w_itr != workers_.end();) {
+        auto& worker = w_itr->second;
+        if (!worker->exited || worker->busy) {
+            ++w_itr;
+            continue;
+        }
+
+        if (worker->thread_ptr->joinable())
+            worker->thread_ptr->join();
+
+        boost::system::error_code ec;
+        fs::remove(worker->socket_path, ec);
+        w_itr = workers_.erase(w_itr);
+    }
+}
+
+bool ApplyWorkerPool::evictWorker()
+{
+    auto lru = workers_.end();
+    for (auto w_itr = workers_.begin(); w_itr != workers_.end(); ++w_itr) {
+        if (w_itr->second->busy)
+            continue;
+        if (lru == workers_.end() || w_itr->second->last_used < lru->second->last_used)
+            lru = w_itr;
+    }
+
+    if (lru == workers_.end())
+        return false;
+
+    LOG_DEBUG("Stopping the apply worker for environment '{1}' to make room "
+              "for a new one", lru->first);
+    stopWorker(*lru->second);
+
+    // The worker thread will terminate shortly; don't wait for that
+    stopped_workers_.push_back(std::move(lru->second));
+    workers_.erase(lru);
+    return true;
+}
+
+void ApplyWorkerPool::stopWorker(Worker& worker)
+{
+    // The worker stops accepting requests on SIGTERM; a request
+    // being processed by a child process will be completed. If the
+    // process is not started yet, the PID callback stops it.
+    worker.stopping = true;
+    int pid = worker.pid;
+    if (pid > 0 && !worker.exited && kill(pid, SIGTERM) < 0 && errno != ESRCH)
+        LOG_DEBUG("Failed to stop the apply worker for environment '{1}' "
+                  "(PID {2}): {3}", worker.environment, pid, std::strerror(errno));
+
+    // A worker that failed to start leaves only its files
+    if (pid == 0 && worker.exited)
+        removeWorkerFiles(worker);
+}
+
+void ApplyWorkerPool::removeWorkerFiles(const Worker& worker)
+{
+    boost::system::error_code ec;
+    fs::remove(worker.socket_path, ec);
+    fs::remove(worker.stdout_path, ec);
+    fs::remove(worker.stderr_path, ec);
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
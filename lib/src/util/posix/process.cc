@@ -30,5 +30,10 @@ int getPid() {
     return getpid();
 }
 
+bool terminateProcessGroup(int pid, bool force) {
+    auto sig = force ? SIGKILL : SIGTERM;
+    return kill(-pid, sig) == 0;
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
@@ -0,0 +1,80 @@
+#include <pxp-agent/util/trace.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.trace"
+#include <leatherman/logging/logging.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <semaphore.h>
+#include <signal.h>
+
+namespace PXPAgent {
+namespace Util {
+namespace Trace {
+
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+static sem_t dump_semaphore;
+
+// sem_post() is async-signal-safe, unlike serializing the trace
+static void sigDumpTrace(int)
+{
+    auto saved_errno = errno;
+    sem_post(&dump_semaphore);
+    errno = saved_errno;
+}
+
+static void dumpTask(std::string file_path)
+{
+    while (true) {
+        if (sem_wait(&dump_semaphore) == -1) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Failed to wait for SIGUSR1; the trace will no longer be "
+                      "dumped: {1}", strerror(errno));
+            return;
+        }
+
+        LOG_INFO("Caught SIGUSR1 signal; writing the trace to '{1}'", file_path);
+        try {
+            dumpChromeTrace(file_path);
+        } catch (const Error& e) {
+            LOG_ERROR(e.what());
+        }
+    }
+}
+
+void installDumpSignalHandler(const std::string& file_path)
+{
+    static std::atomic<bool> installed { false };
+    if (installed.exchange(true))
+        return;
+
+    if (sem_init(&dump_semaphore, 0, 0) == -1)
+        throw Error { lth_loc::format("failed to create the semaphore to dump the "
+                                      "trace: {1}", strerror(errno)) };
+
+    // Detached, as it waits for signals until the process exits
+    pcp_util::thread { &dumpTask, file_path }.detach();
+
+    struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = sigDumpTrace;
+
+    if (sigaction(SIGUSR1, &sa, nullptr) == -1)
+        throw Error { lth_loc::translate("failed to set the SIGUSR1 handler") };
+
+    LOG_DEBUG("Successfully registered the SIGUSR1 handler to dump the trace "
+              "to '{1}'", file_path);
+}
+
+}  // namespace Trace
+}  // namespace Util
+}  // namespace PXPAgent
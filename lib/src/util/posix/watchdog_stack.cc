@@ -0,0 +1,151 @@
+#include <pxp-agent/util/watchdog.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <semaphore.h>
+#include <signal.h>
+
+// backtrace() is provided by glibc and by the libc of Solaris 11
+#if defined(__GLIBC__) || defined(__sun)
+#define PXP_AGENT_HAS_BACKTRACE
+#include <execinfo.h>
+#endif
+
+namespace PXPAgent {
+namespace Util {
+namespace Watchdog {
+
+namespace lth_loc = leatherman::locale;
+
+ThreadHandle currentThread()
+{
+    return pthread_self();
+}
+
+#ifdef PXP_AGENT_HAS_BACKTRACE
+
+static const int MAX_FRAMES { 64 };
+
+// Written by the signal handler of the sampled thread; read once the
+// semaphore is posted
+static void* frames[MAX_FRAMES];
+static volatile sig_atomic_t num_frames { 0 };
+static sem_t sampled_semaphore;
+
+// Set when a sample is requested and cleared by the signal handler once
+// it's posted, so that a handler running after the collection of its
+// sample timed out can't write the frames of the next one
+static std::atomic<bool> is_sampling { false };
+
+// SIGUSR1 and SIGUSR2 are taken, to dump the trace and to reopen the
+// log file
+static int sampleSignal()
+{
+#ifdef SIGRTMIN
+    return SIGRTMIN + 3;
+#else
+    return SIGPROF;
+#endif
+}
+
+static void sigSampleStack(int)
+{
+    if (!is_sampling.load())
+        return;
+
+    auto saved_errno = errno;
+    num_frames = backtrace(frames, MAX_FRAMES);
+    sem_post(&sampled_semaphore);
+    is_sampling.store(false);
+    errno = saved_errno;
+}
+
+void installStackSampler()
+{
+    static std::atomic<bool> installed { false };
+    if (installed.exchange(true))
+        return;
+
+    if (sem_init(&sampled_semaphore, 0, 0) == -1)
+        throw Error { lth_loc::format("failed to create the semaphore to sample "
+                                      "stacks: {1}", strerror(errno)) };
+
+    // The first call of backtrace() loads libgcc, which allocates;
+    // do it here rather than in the signal handler
+    num_frames = backtrace(frames, MAX_FRAMES);
+
+    struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = sigSampleStack;
+
+    if (sigaction(sampleSignal(), &sa, nullptr) == -1)
+        throw Error { lth_loc::format("failed to set the handler of signal {1} to "
+                                      "sample stacks: {2}",
+                                      sampleSignal(), strerror(errno)) };
+}
+
+bool requestStackSample(ThreadHandle thread)
+{
+    // The last sample may still be pending after its collection timed out
+    bool expected { false };
+    if (!is_sampling.compare_exchange_strong(expected, true))
+        return false;
+
+    // Discard a sample taken after its collection timed out
+    while (sem_trywait(&sampled_semaphore) == 0) {}
+    if (pthread_kill(thread, sampleSignal()) == 0)
+        return true;
+    is_sampling.store(false);
+    return false;
+}
+
+std::vector<std::string> collectStackSample()
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 1;
+
+    while (sem_timedwait(&sampled_semaphore, &deadline) == -1) {
+        if (errno != EINTR)
+            return {};
+    }
+
+    // The first frame is the one of the signal handler
+    std::vector<std::string> sample {};
+    char** symbols = backtrace_symbols(frames, num_frames);
+    if (symbols == nullptr)
+        return sample;
+    for (int idx = 1; idx < num_frames; idx++)
+        sample.push_back(symbols[idx]);
+    free(symbols);
+    return sample;
+}
+
+#else  // PXP_AGENT_HAS_BACKTRACE
+
+void installStackSampler()
+{
+    throw Error { lth_loc::translate("stacks cannot be sampled on this platform") };
+}
+
+bool requestStackSample(ThreadHandle)
+{
+    return false;
+}
+
+std::vector<std::string> collectStackSample()
+{
+    return {};
+}
+
+#endif  // PXP_AGENT_HAS_BACKTRACE
+
+}  // namespace Watchdog
+}  // namespace Util
+}  // namespace PXPAgent
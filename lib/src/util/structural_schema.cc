@@ -0,0 +1,139 @@
+#include <pxp-agent/util/structural_schema.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>  // validation_error
+
+#include <leatherman/locale/locale.hpp>
+
+#include <boost/algorithm/string/join.hpp>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace lth_jc  = leatherman::json_container;
+namespace lth_loc = leatherman::locale;
+
+using T_C = PCPClient::TypeConstraint;
+
+static bool satisfies(lth_jc::DataType data_type, T_C type)
+{
+    switch (type) {
+        case T_C::Object:
+            return data_type == lth_jc::DataType::Object;
+        case T_C::Array:
+            return data_type == lth_jc::DataType::Array;
+        case T_C::String:
+            return data_type == lth_jc::DataType::String;
+        case T_C::Int:
+            return data_type == lth_jc::DataType::Int;
+        case T_C::Bool:
+            return data_type == lth_jc::DataType::Bool;
+        case T_C::Double:
+            // As JSON schema numbers, which include integers
+            return data_type == lth_jc::DataType::Double
+                   || data_type == lth_jc::DataType::Int;
+        case T_C::Null:
+            return data_type == lth_jc::DataType::Null;
+        case T_C::Any:
+            return true;
+    }
+    return false;
+}
+
+StructuralSchema::StructuralSchema(std::string name)
+        : name_ { std::move(name) },
+          constraints_ {}
+{
+}
+
+void StructuralSchema::addConstraint(std::string field, T_C type, bool required)
+{
+    constraints_.push_back(Constraint { std::move(field), type, required, nullptr });
+}
+
+void StructuralSchema::addConstraint(std::string field,
+                                     const StructuralSchema& sub_schema,
+                                     bool required)
+{
+    constraints_.push_back(Constraint {
+        std::move(field), T_C::Object, required,
+        std::make_shared<const StructuralSchema>(sub_schema) });
+}
+
+const std::string& StructuralSchema::getName() const
+{
+    return name_;
+}
+
+PCPClient::Schema StructuralSchema::toSchema() const
+{
+    PCPClient::Schema schema { name_ };
+    for (const auto& constraint : constraints_) {
+        if (constraint.sub_schema) {
+            schema.addConstraint(constraint.field,
+                                 constraint.sub_schema->toSchema(),
+                                 constraint.required);
+        } else {
+            schema.addConstraint(constraint.field, constraint.type, constraint.required);
+        }
+    }
+    return schema;
+}
+
+bool StructuralSchema::matches(const lth_jc::JsonContainer& data,
+                               const std::vector<lth_jc::JsonContainerKey>& path) const
+{
+    return (path.empty() || data.includes(path)) && check(data, path).empty();
+}
+
+void StructuralSchema::validate(const lth_jc::JsonContainer& data,
+                                const std::vector<lth_jc::JsonContainerKey>& path) const
+{
+    if (!path.empty() && !data.includes(path))
+        throw PCPClient::validation_error {
+            lth_loc::format("does not match schema '{1}': '{2}' is missing",
+                            name_, boost::algorithm::join(path, ".")) };
+
+    auto violation = check(data, path);
+    if (!violation.empty())
+        throw PCPClient::validation_error {
+            lth_loc::format("does not match schema '{1}': {2}", name_, violation) };
+}
+
+// Nested entries are accessed by path, to avoid copying them
+std::string StructuralSchema::check(const lth_jc::JsonContainer& data,
+                                    const std::vector<lth_jc::JsonContainerKey>& path) const
+{
+    auto data_type = path.empty() ? data.type() : data.type(path);
+    if (data_type != lth_jc::DataType::Object)
+        return path.empty()
+               ? lth_loc::translate("not an object")
+               : lth_loc::format("'{1}' is not an object", boost::algorithm::join(path, "."));
+
+    auto entry_path = path;
+    entry_path.emplace_back();
+
+    for (const auto& constraint : constraints_) {
+        entry_path.back() = constraint.field;
+
+        if (!data.includes(entry_path)) {
+            if (constraint.required)
+                return lth_loc::format("'{1}' is missing",
+                                       boost::algorithm::join(entry_path, "."));
+            continue;
+        }
+
+        if (constraint.sub_schema) {
+            auto violation = constraint.sub_schema->check(data, entry_path);
+            if (!violation.empty())
+                return violation;
+        } else if (!satisfies(data.type(entry_path), constraint.type)) {
+            return lth_loc::format("'{1}' has the wrong type",
+                                   boost::algorithm::join(entry_path, "."));
+        }
+    }
+
+    return "";
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,117 @@
+#include <pxp-agent/util/timer_wheel.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.timer_wheel"
+#include <leatherman/logging/logging.hpp>
+
+#include <cassert>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace pcp_util = PCPClient::Util;
+
+TimerWheel::TimerWheel(pcp_util::chrono::milliseconds tick, size_t num_slots)
+    : tick_ { tick },
+      slots_(num_slots),
+      current_slot_ { 0 },
+      next_id_ { 1 },
+      timers_ {},
+      stopping_ { false }
+{
+    assert(tick_.count() > 0 && num_slots > 0);
+    thread_ptr_.reset(new pcp_util::thread(&TimerWheel::run, this));
+}
+
+TimerWheel::~TimerWheel()
+{
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        cond_var_.notify_one();
+    }
+
+    if (thread_ptr_ != nullptr && thread_ptr_->joinable())
+        thread_ptr_->join();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(pcp_util::chrono::milliseconds delay,
+                                         std::function<void()> callback)
+{
+    // Round up, so that timers never fire early
+    uint64_t ticks = delay.count() <= 0
+                     ? 1
+                     : static_cast<uint64_t>((delay.count() + tick_.count() - 1) / tick_.count());
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto slot = (current_slot_ + ticks) % slots_.size();
+    auto rounds = (ticks - 1) / slots_.size();
+    auto timer_id = next_id_++;
+    slots_[slot].push_front(Timer { timer_id, rounds, std::move(callback) });
+    timers_.emplace(timer_id, std::make_pair(slot, slots_[slot].begin()));
+    return timer_id;
+}
+
+bool TimerWheel::cancel(TimerId timer_id)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto timer = timers_.find(timer_id);
+    if (timer == timers_.end())
+        return false;
+
+    slots_[timer->second.first].erase(timer->second.second);
+    timers_.erase(timer);
+    return true;
+}
+
+size_t TimerWheel::pending() const
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return timers_.size();
+}
+
+void TimerWheel::run()
+{
+    auto next_tick = pcp_util::chrono::steady_clock::now() + tick_;
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    while (true) {
+        cond_var_.wait_until(the_lock, next_tick, [this] { return stopping_; });
+        if (stopping_)
+            break;
+
+        // Catch up after a delay, one slot per tick, as wait_until
+        // returns at once for ticks that are past; timers then keep
+        // firing relative to the time they were scheduled
+        next_tick += tick_;
+        current_slot_ = (current_slot_ + 1) % slots_.size();
+
+        std::vector<std::function<void()>> expired {};
+        auto& slot = slots_[current_slot_];
+        for (auto timer = slot.begin(); timer != slot.end();) {
+            if (timer->rounds > 0) {
+                timer->rounds--;
+                ++timer;
+            } else {
+                expired.push_back(std::move(timer->callback));
+                timers_.erase(timer->id);
+                timer = slot.erase(timer);
+            }
+        }
+
+        if (expired.empty())
+            continue;
+
+        the_lock.unlock();
+        for (auto& callback : expired) {
+            try {
+                callback();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Unexpected failure of a timer callback: {1}", e.what());
+            }
+        }
+        the_lock.lock();
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,238 @@
+#include <pxp-agent/util/trace.hpp>
+#include <pxp-agent/util/json_escape.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/locale/locale.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace PXPAgent {
+namespace Util {
+namespace Trace {
+
+namespace lth_file = leatherman::file_util;
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+static const size_t TRANSACTION_ID_WORDS { 6 };
+
+// All the fields are atomics, updated with relaxed stores, so that
+// reading a slot while it's being written is not a data race; the
+// sequence number tells readers whether what they read is consistent.
+// The sequence is 0 for empty slots, odd while the slot is written,
+// and 2 * (index + 1) once the span with that index is stored.
+struct Tracer::Slot {
+    std::atomic<uint64_t> sequence;
+    std::atomic<const char*> stage;
+    std::atomic<int64_t> start_us;
+    std::atomic<int64_t> end_us;
+    std::atomic<uint32_t> thread;
+    std::atomic<uint64_t> transaction_id[TRANSACTION_ID_WORDS];
+};
+
+// Small numbers are easier to read than native thread IDs in the
+// trace viewers
+static uint32_t threadNumber()
+{
+    static std::atomic<uint32_t> next_number { 1 };
+    thread_local uint32_t number { next_number++ };
+    return number;
+}
+
+Tracer::Tracer(size_t capacity)
+        : mask_ { 0 },
+          slots_ {},
+          head_ { 0 },
+          num_dropped_ { 0 }
+{
+    size_t rounded { 1 };
+    while (rounded < capacity)
+        rounded <<= 1;
+    mask_ = rounded - 1;
+
+    slots_.reset(new Slot[rounded]);
+    for (size_t idx = 0; idx < rounded; idx++)
+        slots_[idx].sequence.store(0, std::memory_order_relaxed);
+}
+
+Tracer::~Tracer() = default;
+
+void Tracer::record(const char* stage,
+                    const std::string& transaction_id,
+                    int64_t start_us,
+                    int64_t end_us)
+{
+    auto index = head_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[index & mask_];
+    uint64_t writing { 2 * index + 1 };
+
+    // Another writer holds the slot, or already stored a newer span
+    auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) || sequence > writing
+            || !slot.sequence.compare_exchange_strong(sequence, writing,
+                                                      std::memory_order_relaxed)) {
+        num_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t words[TRANSACTION_ID_WORDS] {};
+    std::memcpy(words, transaction_id.data(),
+                std::min(transaction_id.size(), sizeof(words)));
+
+    slot.stage.store(stage, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.end_us.store(end_us, std::memory_order_relaxed);
+    slot.thread.store(threadNumber(), std::memory_order_relaxed);
+    for (size_t idx = 0; idx < TRANSACTION_ID_WORDS; idx++)
+        slot.transaction_id[idx].store(words[idx], std::memory_order_relaxed);
+
+    slot.sequence.store(writing + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::numDropped() const
+{
+    return num_dropped_.load(std::memory_order_relaxed);
+}
+
+std::string Tracer::toChromeTrace() const
+{
+    std::string trace { "{\"traceEvents\":[" };
+    bool first { true };
+
+    for (size_t idx = 0; idx <= mask_; idx++) {
+        const auto& slot = slots_[idx];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || (sequence & 1))
+            continue;
+
+        auto stage = slot.stage.load(std::memory_order_relaxed);
+        auto start_us = slot.start_us.load(std::memory_order_relaxed);
+        auto end_us = slot.end_us.load(std::memory_order_relaxed);
+        auto thread = slot.thread.load(std::memory_order_relaxed);
+        uint64_t words[TRANSACTION_ID_WORDS];
+        for (size_t word = 0; word < TRANSACTION_ID_WORDS; word++)
+            words[word] = slot.transaction_id[word].load(std::memory_order_relaxed);
+
+        // Skip the slot if it was overwritten while being read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        const char* transaction_id { reinterpret_cast<const char*>(words) };
+        auto transaction_id_size = strnlen(transaction_id, sizeof(words));
+
+        if (!first)
+            trace += ",";
+        first = false;
+        trace += "{\"name\":";
+        appendJSONString(trace, stage, std::strlen(stage));
+        trace += ",\"cat\":\"pxp-agent\",\"ph\":\"X\",\"ts\":" + std::to_string(start_us)
+                 + ",\"dur\":" + std::to_string(end_us - start_us)
+                 + ",\"pid\":1,\"tid\":" + std::to_string(thread)
+                 + ",\"args\":{\"transaction_id\":";
+        appendJSONString(trace, transaction_id, transaction_id_size);
+        trace += "}}";
+    }
+
+    trace += "],\"displayTimeUnit\":\"ms\"}";
+    return trace;
+}
+
+//
+// Process-wide tracer
+//
+
+// Never destroyed, as threads may record spans while the process exits
+static std::atomic<Tracer*> the_tracer { nullptr };
+
+void enable(size_t capacity)
+{
+    std::unique_ptr<Tracer> tracer { new Tracer(capacity) };
+    Tracer* expected { nullptr };
+    if (the_tracer.compare_exchange_strong(expected, tracer.get()))
+        tracer.release();
+}
+
+bool isEnabled()
+{
+    return the_tracer.load(std::memory_order_acquire) != nullptr;
+}
+
+int64_t now()
+{
+    return pcp_util::chrono::duration_cast<pcp_util::chrono::microseconds>(
+        pcp_util::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* stage, const std::string& transaction_id, int64_t start_us)
+{
+    auto tracer = the_tracer.load(std::memory_order_acquire);
+    if (tracer != nullptr)
+        tracer->record(stage, transaction_id, start_us, now());
+}
+
+void record(const char* stage,
+            const std::string& transaction_id,
+            int64_t start_us,
+            int64_t end_us)
+{
+    auto tracer = the_tracer.load(std::memory_order_acquire);
+    if (tracer != nullptr)
+        tracer->record(stage, transaction_id, start_us, end_us);
+}
+
+std::string toChromeTrace()
+{
+    auto tracer = the_tracer.load(std::memory_order_acquire);
+    if (tracer == nullptr)
+        return "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}";
+    return tracer->toChromeTrace();
+}
+
+ChildSpans::ChildSpans(const std::string& transaction_id)
+        : transaction_id_ ( transaction_id ),
+          start_us_ { isEnabled() ? now() : 0 },
+          spawned_us_ { 0 }
+{
+}
+
+std::function<void(size_t)> ChildSpans::spawning(std::function<void(size_t)> pid_callback)
+{
+    if (start_us_ == 0)
+        return pid_callback;
+
+    // The pid callback is called by the thread that executes the child
+    return [this, pid_callback](size_t pid) {
+        if (pid_callback)
+            pid_callback(pid);
+        spawned_us_ = now();
+        record("child_spawn", transaction_id_, start_us_, spawned_us_);
+    };
+}
+
+void ChildSpans::end()
+{
+    if (spawned_us_ != 0)
+        record("child_run", transaction_id_, spawned_us_, now());
+    start_us_ = 0;
+    spawned_us_ = 0;
+}
+
+void dumpChromeTrace(const std::string& file_path)
+{
+    try {
+        lth_file::atomic_write_to_file(toChromeTrace(), file_path);
+    } catch (const std::exception& e) {
+        throw Error {
+            lth_loc::format("failed to write the trace to '{1}': {2}",
+                            file_path, e.what()) };
+    }
+}
+
+}  // namespace Trace
+}  // namespace Util
+}  // namespace PXPAgent
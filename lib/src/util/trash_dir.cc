@@ -0,0 +1,170 @@
+#include <pxp-agent/util/trash_dir.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.trash_dir"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+namespace pcp_util = PCPClient::Util;
+namespace lth_loc = leatherman::locale;
+
+const uint32_t TrashDir::DEFAULT_REMOVALS_PER_S { 1000 };
+
+// Removals between two pauses of the removal thread
+static const uint32_t REMOVALS_BATCH { 100 };
+
+TrashDir::TrashDir(fs::path trash_dir, uint32_t removals_per_s)
+        : trash_dir_ { std::move(trash_dir) },
+          removals_per_s_ { removals_per_s > 0 ? removals_per_s : DEFAULT_REMOVALS_PER_S },
+          num_removals_ { 0 },
+          instance_id_ { std::to_string(
+              pcp_util::chrono::duration_cast<pcp_util::chrono::microseconds>(
+                  pcp_util::chrono::system_clock::now().time_since_epoch()).count()) },
+          num_moved_ { 0 },
+          pending_ { false },
+          is_destructing_ { false },
+          thread_ptr_ {},
+          mutex_ {},
+          cond_var_ {}
+{
+}
+
+TrashDir::~TrashDir()
+{
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        is_destructing_ = true;
+        cond_var_.notify_one();
+    }
+
+    if (thread_ptr_ != nullptr && thread_ptr_->joinable())
+        thread_ptr_->join();
+}
+
+void TrashDir::moveToTrash(const fs::path& path)
+{
+    try {
+        fs::create_directories(trash_dir_);
+
+        // Prefix the name with a counter, as the same name may be
+        // trashed again before being removed; skip the names taken by
+        // instances started at the same time, if any
+        fs::path trashed_path {};
+        do {
+            uint64_t num_moved { 0 };
+            {
+                pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+                num_moved = num_moved_++;
+            }
+            trashed_path = trash_dir_ / (instance_id_ + "-" + std::to_string(num_moved)
+                                         + "-" + path.filename().string());
+        } while (fs::exists(fs::symlink_status(trashed_path)));
+
+        fs::rename(path, trashed_path);
+    } catch (const fs::filesystem_error& e) {
+        throw Error { lth_loc::format("failed to move '{1}' to the trash: {2}",
+                                      path.string(), e.what()) };
+    }
+}
+
+void TrashDir::empty()
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    pending_ = true;
+    if (thread_ptr_ == nullptr) {
+        thread_ptr_.reset(new pcp_util::thread(&TrashDir::removalTask, this));
+    } else {
+        cond_var_.notify_one();
+    }
+}
+
+static void lowerThreadPriority()
+{
+#ifdef __linux__
+    // Both apply to the calling thread only; the ioprio_set constants
+    // are not exposed by glibc: IOPRIO_WHO_PROCESS and the idle class
+    static const int IOPRIO_WHO_PROCESS { 1 };
+    static const int IOPRIO_IDLE { 3 << 13 };
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_IDLE) != 0)
+        LOG_DEBUG("Failed to set the I/O priority of the trash removal thread");
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19) != 0)
+        LOG_DEBUG("Failed to set the priority of the trash removal thread");
+#endif
+}
+
+bool TrashDir::removeThrottled(const fs::path& path)
+{
+    boost::system::error_code ec;
+
+    if (fs::is_directory(fs::symlink_status(path, ec))) {
+        std::vector<fs::path> children {};
+        for (fs::directory_iterator it { path, ec }, end; !ec && it != end; it.increment(ec))
+            children.push_back(it->path());
+        for (const auto& child : children)
+            if (!removeThrottled(child))
+                return false;
+    }
+
+    fs::remove(path, ec);
+    if (ec)
+        LOG_DEBUG("Failed to remove '{1}': {2}", path.string(), ec.message());
+
+    if (++num_removals_ % REMOVALS_BATCH != 0)
+        return true;
+
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+    cond_var_.wait_for(the_lock,
+                       pcp_util::chrono::milliseconds(
+                           1000 * REMOVALS_BATCH / removals_per_s_),
+                       [this]() { return is_destructing_; });
+    return !is_destructing_;
+}
+
+void TrashDir::removalTask()
+{
+    lowerThreadPriority();
+
+    while (true) {
+        {
+            pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+            while (!pending_ && !is_destructing_)
+                cond_var_.wait(the_lock);
+            if (is_destructing_)
+                return;
+            pending_ = false;
+        }
+
+        std::vector<fs::path> entries {};
+        boost::system::error_code ec;
+        for (fs::directory_iterator it { trash_dir_, ec }, end; !ec && it != end; it.increment(ec))
+            entries.push_back(it->path());
+
+        if (entries.empty())
+            continue;
+
+        LOG_DEBUG("Removing {1} entries from the trash '{2}'",
+                  entries.size(), trash_dir_.string());
+        for (const auto& entry : entries)
+            if (!removeThrottled(entry))
+                return;
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -1,24 +1,322 @@
-#include <rapidjson/rapidjson.h>
-#if RAPIDJSON_MAJOR_VERSION > 1 || RAPIDJSON_MAJOR_VERSION == 1 && RAPIDJSON_MINOR_VERSION >= 1
-// Header for StringStream was added in rapidjson 1.1 in a backwards incompatible way.
-#include <rapidjson/stream.h>
-#endif
+#include <pxp-agent/util/utf8.hpp>
+
+#include <cstdint>
+#include <cstring>
 
-#include <string>
+// The vectorised validators are compiled with target attributes and
+// selected at runtime, so that the binary runs on any x86 CPU
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PXP_AGENT_UTF8_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace PXPAgent {
 namespace Util {
-    bool isValidUTF8(std::string &s) {
-        rapidjson::StringStream source(s.data());
-        rapidjson::InsituStringStream target(&s[0]);
 
-        target.PutBegin();
-        while (source.Tell() < s.size()) {
-            if (!rapidjson::UTF8<char>::Validate(source, target)) {
-                return false;
+//
+// Scalar validation
+//
+
+static const uint64_t ASCII_MASK { 0x8080808080808080ULL };
+
+static bool isValidUTF8Scalar(const unsigned char* s, size_t size)
+{
+    size_t i { 0 };
+
+    while (i < size) {
+        // Skip ASCII, 8 bytes at a time
+        if (i + 8 <= size) {
+            uint64_t chunk;
+            std::memcpy(&chunk, s + i, sizeof(chunk));
+            if ((chunk & ASCII_MASK) == 0) {
+                i += 8;
+                continue;
             }
         }
-        return true;
+
+        unsigned char lead = s[i];
+        if (lead < 0x80) {
+            i++;
+            continue;
+        }
+
+        // Well-formed byte sequences, as per table 3-7 of the Unicode
+        // standard; the second byte range depends on the lead byte
+        size_t length;
+        unsigned char min_second { 0x80 }, max_second { 0xBF };
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            if (lead == 0xE0) min_second = 0xA0;         // overlong
+            else if (lead == 0xED) max_second = 0x9F;    // surrogates
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            if (lead == 0xF0) min_second = 0x90;         // overlong
+            else if (lead == 0xF4) max_second = 0x8F;    // > U+10FFFF
+        } else {
+            return false;
+        }
+
+        if (size - i < length)
+            return false;
+        if (s[i + 1] < min_second || s[i + 1] > max_second)
+            return false;
+        for (size_t j = 2; j < length; j++)
+            if ((s[i + j] & 0xC0) != 0x80)
+                return false;
+        i += length;
+    }
+
+    return true;
+}
+
+#ifdef PXP_AGENT_UTF8_SIMD
+
+//
+// Vectorised validation
+//
+// The lookup algorithm by Keiser and Lemire ("Validating UTF-8 In Less
+// Than One Instruction Per Byte", 2021): the errors of each pair of
+// consecutive bytes are given by three 16-entry tables, indexed by the
+// high and low nibbles of the first byte and the high nibble of the
+// second; the third and fourth bytes of multibyte sequences are checked
+// by comparing the bytes two and three positions before.
+//
+
+// Errors of a pair of bytes
+static const uint8_t TOO_SHORT  { 1 << 0 };  // 11______ 0_______ / 11______ 11______
+static const uint8_t TOO_LONG   { 1 << 1 };  // 0_______ 10______
+static const uint8_t OVERLONG_3 { 1 << 2 };  // 11100000 100_____
+static const uint8_t TOO_LARGE  { 1 << 3 };  // 11110100 1001____ / 11110101+ ...
+static const uint8_t SURROGATE  { 1 << 4 };  // 11101101 101_____
+static const uint8_t OVERLONG_2 { 1 << 5 };  // 1100000_ 10______
+static const uint8_t TOO_LARGE_1000 { 1 << 6 };  // 11110101+ 1000____
+static const uint8_t OVERLONG_4 { 1 << 6 };  // 11110000 1000____
+static const uint8_t TWO_CONTS  { 1 << 7 };  // 10______ 10______
+static const uint8_t CARRY { TOO_SHORT | TOO_LONG | TWO_CONTS };
+
+// Errors given the high nibble of the first byte, its low nibble and
+// the high nibble of the second byte
+static const uint8_t BYTE_1_HIGH[16] {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4 };
+static const uint8_t BYTE_1_LOW[16] {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 };
+static const uint8_t BYTE_2_HIGH[16] {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT };
+// Bytes that start a sequence not complete within the block
+static const uint8_t INCOMPLETE_MAX[32] {
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1 };
+
+__attribute__((target("sse4.1")))
+static bool isValidUTF8SSE4(const unsigned char* s, size_t size)
+{
+    const __m128i byte_1_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH));
+    const __m128i byte_1_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW));
+    const __m128i byte_2_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH));
+    const __m128i incomplete_max = _mm_loadu_si128(reinterpret_cast<const __m128i*>(INCOMPLETE_MAX + 16));
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    const __m128i high_bit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i third_byte_min = _mm_set1_epi8(static_cast<char>(0xE0 - 0x80));
+    const __m128i fourth_byte_min = _mm_set1_epi8(static_cast<char>(0xF0 - 0x80));
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+
+    for (size_t i = 0; i < size; i += 16) {
+        __m128i input;
+        if (i + 16 <= size) {
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        } else {
+            // Pad the last block with ASCII
+            unsigned char tail[16] {};
+            std::memcpy(tail, s + i, size - i);
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+        }
+
+        if (_mm_testz_si128(input, high_bit)) {
+            // ASCII block; only a sequence left incomplete is an error
+            error = _mm_or_si128(error, prev_incomplete);
+            prev_input = input;
+            prev_incomplete = _mm_setzero_si128();
+            continue;
+        }
+
+        __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+        __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+        __m128i sc = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(byte_1_high,
+                                 _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble_mask)),
+                _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble_mask))),
+            _mm_shuffle_epi8(byte_2_high,
+                             _mm_and_si128(_mm_srli_epi16(input, 4), nibble_mask)));
+
+        __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, third_byte_min),
+                                      _mm_subs_epu8(prev3, fourth_byte_min));
+        __m128i must23_80 = _mm_and_si128(must23, high_bit);
+
+        error = _mm_or_si128(error, _mm_xor_si128(must23_80, sc));
+        prev_incomplete = _mm_subs_epu8(input, incomplete_max);
+        prev_input = input;
+    }
+
+    error = _mm_or_si128(error, prev_incomplete);
+    return _mm_testz_si128(error, error) != 0;
+}
+
+__attribute__((target("avx2")))
+static bool isValidUTF8AVX2(const unsigned char* s, size_t size)
+{
+    // The tables are repeated in both lanes, as vpshufb works per lane
+    const __m256i byte_1_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH)));
+    const __m256i byte_1_low = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW)));
+    const __m256i byte_2_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH)));
+    const __m256i incomplete_max = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(INCOMPLETE_MAX));
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+    const __m256i third_byte_min = _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80));
+    const __m256i fourth_byte_min = _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80));
+    const __m256i high_bit = _mm256_set1_epi8(static_cast<char>(0x80));
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+
+    for (size_t i = 0; i < size; i += 32) {
+        __m256i input;
+        if (i + 32 <= size) {
+            input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        } else {
+            unsigned char tail[32] {};
+            std::memcpy(tail, s + i, size - i);
+            input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail));
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_input = input;
+            prev_incomplete = _mm256_setzero_si256();
+            continue;
+        }
+
+        // The previous bytes across the lanes: [prev_input.high, input.low]
+        __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+        __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+        __m256i sc = _mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_shuffle_epi8(byte_1_high,
+                                    _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble_mask)),
+                _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble_mask))),
+            _mm256_shuffle_epi8(byte_2_high,
+                                _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask)));
+
+        __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, third_byte_min),
+                                         _mm256_subs_epu8(prev3, fourth_byte_min));
+        __m256i must23_80 = _mm256_and_si256(must23, high_bit);
+
+        error = _mm256_or_si256(error, _mm256_xor_si256(must23_80, sc));
+        prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        prev_input = input;
     }
+
+    error = _mm256_or_si256(error, prev_incomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif  // PXP_AGENT_UTF8_SIMD
+
+//
+// Dispatch
+//
+
+bool supportsUTF8Validator(UTF8Validator validator)
+{
+    switch (validator) {
+        case UTF8Validator::Scalar:
+            return true;
+#ifdef PXP_AGENT_UTF8_SIMD
+        case UTF8Validator::SSE4:
+            return __builtin_cpu_supports("sse4.1");
+        case UTF8Validator::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool isValidUTF8(const char* data, size_t size, UTF8Validator validator)
+{
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    switch (validator) {
+#ifdef PXP_AGENT_UTF8_SIMD
+        case UTF8Validator::AVX2:
+            return isValidUTF8AVX2(s, size);
+        case UTF8Validator::SSE4:
+            return isValidUTF8SSE4(s, size);
+#endif
+        default:
+            return isValidUTF8Scalar(s, size);
+    }
+}
+
+static UTF8Validator selectUTF8Validator()
+{
+    for (auto validator : { UTF8Validator::AVX2, UTF8Validator::SSE4 })
+        if (supportsUTF8Validator(validator))
+            return validator;
+    return UTF8Validator::Scalar;
+}
+
+bool isValidUTF8(const char* data, size_t size)
+{
+    static const UTF8Validator validator { selectUTF8Validator() };
+    return isValidUTF8(data, size, validator);
+}
+
+bool isValidUTF8(const std::string& s)
+{
+    return isValidUTF8(s.data(), s.size());
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
@@ -0,0 +1,336 @@
+#include <pxp-agent/util/watchdog.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.watchdog"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/algorithm/string/join.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <memory>
+
+namespace PXPAgent {
+namespace Util {
+namespace Watchdog {
+
+namespace lth_loc  = leatherman::locale;
+namespace pcp_util = PCPClient::Util;
+
+// Lower bound of the interval between checks
+static const uint32_t MIN_CHECK_INTERVAL_MS { 10 };
+
+// 0 while the watchdog is disabled
+static std::atomic<uint32_t> threshold_ms_ { 0 };
+static std::atomic<bool> stack_sampler_installed_ { false };
+
+static int64_t elapsedMs(pcp_util::chrono::steady_clock::time_point since,
+                         pcp_util::chrono::steady_clock::time_point until)
+{
+    return pcp_util::chrono::duration_cast<pcp_util::chrono::milliseconds>(
+        until - since).count();
+}
+
+static std::string withConsequence(const std::string& message,
+                                   const std::string& consequence)
+{
+    return consequence.empty() ? message : message + "; " + consequence;
+}
+
+//
+// Executor
+//
+
+Executor::Executor(const std::string& name, const std::string& stall_consequence)
+        : name_ { name },
+          stall_consequence_ { stall_consequence },
+          busy_duration_ { Metrics::Registry::Instance().histogram(
+              "pxp_agent_executor_busy_seconds",
+              "Duration of the units of work of the executors tracked by the watchdog",
+              {{ "executor", name }}) },
+          lag_ { Metrics::Registry::Instance().histogram(
+              "pxp_agent_executor_lag_seconds",
+              "Delay between the time units of work were due and their start",
+              {{ "executor", name }}) },
+          stalls_ { Metrics::Registry::Instance().counter(
+              "pxp_agent_executor_stalls_total",
+              "Units of work that were busy, or late, for longer than the "
+              "watchdog threshold",
+              {{ "executor", name }}) },
+          mutex_ {},
+          busy_since_ {},
+          is_busy_ { false },
+          is_waiting_ { false },
+          waiting_since_ {},
+          activity_ { 0 },
+          reported_activity_ { 0 },
+          thread_ {}
+{
+}
+
+void Executor::recordLag(pcp_util::chrono::steady_clock::time_point due)
+{
+    auto threshold = threshold_ms_.load(std::memory_order_relaxed);
+    if (threshold == 0)
+        return;
+
+    auto lag_ms = std::max<int64_t>(
+        elapsedMs(due, pcp_util::chrono::steady_clock::now()), 0);
+    lag_.observe(lag_ms / 1e3);
+
+    if (lag_ms > threshold) {
+        stalls_.add();
+        LOG_WARNING(withConsequence(
+            lth_loc::format("A unit of work of the {1} executor started {2} ms "
+                            "late, more than the watchdog threshold of {3} ms",
+                            name_, lag_ms, threshold),
+            stall_consequence_));
+    }
+}
+
+static pcp_util::mutex& executorsMutex()
+{
+    static pcp_util::mutex the_mutex {};
+    return the_mutex;
+}
+
+static std::map<std::string, std::unique_ptr<Executor>>& executors()
+{
+    static std::map<std::string, std::unique_ptr<Executor>> the_executors {};
+    return the_executors;
+}
+
+Executor& executor(const std::string& name, const std::string& stall_consequence)
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { executorsMutex() };
+    auto& executor_ptr = executors()[name];
+    if (executor_ptr == nullptr)
+        executor_ptr.reset(new Executor(name, stall_consequence));
+    return *executor_ptr;
+}
+
+//
+// Busy
+//
+
+Busy::Busy(Executor& executor)
+        : executor_ { isEnabled() ? &executor : nullptr },
+          activity_ { 0 }
+{
+    if (executor_ == nullptr)
+        return;
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { executor_->mutex_ };
+    executor_->busy_since_ = pcp_util::chrono::steady_clock::now();
+    executor_->is_busy_ = true;
+    executor_->thread_ = currentThread();
+    activity_ = ++executor_->activity_;
+}
+
+Busy::~Busy()
+{
+    if (executor_ == nullptr)
+        return;
+
+    pcp_util::chrono::steady_clock::time_point busy_since {};
+    bool was_reported { false };
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { executor_->mutex_ };
+        executor_->is_busy_ = false;
+        busy_since = executor_->busy_since_;
+        was_reported = executor_->reported_activity_ == activity_;
+    }
+
+    auto busy_ms = elapsedMs(busy_since, pcp_util::chrono::steady_clock::now());
+    executor_->busy_duration_.observe(busy_ms / 1e3);
+
+    if (was_reported)
+        LOG_WARNING("The stalled {1} executor completed its unit of work, after "
+                    "{2} ms", executor_->name(), busy_ms);
+}
+
+//
+// Waiting
+//
+
+Waiting::Waiting(Executor& executor)
+        : executor_ { nullptr }
+{
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { executor.mutex_ };
+    if (!executor.is_busy_ || executor.is_waiting_)
+        return;
+
+    executor_ = &executor;
+    executor_->is_waiting_ = true;
+    executor_->waiting_since_ = pcp_util::chrono::steady_clock::now();
+}
+
+Waiting::~Waiting()
+{
+    if (executor_ == nullptr)
+        return;
+
+    // Shifting the start of the unit of work leaves the wait out of
+    // its busy time
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { executor_->mutex_ };
+    executor_->is_waiting_ = false;
+    executor_->busy_since_ += pcp_util::chrono::steady_clock::now()
+                              - executor_->waiting_since_;
+}
+
+//
+// Watchdog thread
+//
+
+void checkExecutors()
+{
+    auto threshold = threshold_ms_.load(std::memory_order_relaxed);
+    if (threshold == 0)
+        return;
+
+    // Executors are never destroyed; they can be checked without
+    // holding the lock of the registry
+    std::vector<Executor*> all_executors {};
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { executorsMutex() };
+        for (const auto& name_and_executor : executors())
+            all_executors.push_back(name_and_executor.second.get());
+    }
+
+    for (auto executor_ptr : all_executors) {
+        int64_t busy_ms { 0 };
+        bool sample_requested { false };
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { executor_ptr->mutex_ };
+            if (!executor_ptr->is_busy_ || executor_ptr->is_waiting_
+                    || executor_ptr->reported_activity_ == executor_ptr->activity_)
+                continue;
+
+            busy_ms = elapsedMs(executor_ptr->busy_since_,
+                                pcp_util::chrono::steady_clock::now());
+            if (busy_ms <= threshold)
+                continue;
+
+            executor_ptr->reported_activity_ = executor_ptr->activity_;
+            sample_requested = stack_sampler_installed_
+                               && requestStackSample(executor_ptr->thread_);
+        }
+
+        executor_ptr->stalls_.add();
+        LOG_WARNING(withConsequence(
+            lth_loc::format("The {1} executor has been busy with a unit of work "
+                            "for {2} ms, more than the watchdog threshold of {3} ms",
+                            executor_ptr->name(), busy_ms, threshold),
+            executor_ptr->stall_consequence_));
+
+        if (!sample_requested)
+            continue;
+
+        auto frames = collectStackSample();
+        if (frames.empty()) {
+            LOG_WARNING("Failed to sample the stack of the stalled {1} executor",
+                        executor_ptr->name());
+        } else {
+            LOG_WARNING("Stack sample of the stalled {1} executor:\n  {2}",
+                        executor_ptr->name(), boost::algorithm::join(frames, "\n  "));
+        }
+    }
+}
+
+struct WatchdogThread {
+    pcp_util::mutex mutex;
+    pcp_util::condition_variable cond_var;
+    bool stopping { false };
+    std::unique_ptr<pcp_util::thread> thread_ptr;
+};
+
+static WatchdogThread& watchdogThread()
+{
+    static WatchdogThread the_thread {};
+    return the_thread;
+}
+
+static pcp_util::chrono::milliseconds checkInterval()
+{
+    return pcp_util::chrono::milliseconds(
+        std::max(threshold_ms_.load(std::memory_order_relaxed) / 4, MIN_CHECK_INTERVAL_MS));
+}
+
+// The lag of the watchdog thread itself tells whether the whole
+// process is starved
+static void watchdogTask()
+{
+    auto& self = executor("watchdog",
+                          "pxp-agent may be starved of CPU, or was suspended");
+    auto& state = watchdogThread();
+    auto next_check = pcp_util::chrono::steady_clock::now() + checkInterval();
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { state.mutex };
+
+    while (true) {
+        if (state.cond_var.wait_until(the_lock, next_check,
+                                      [&state]() { return state.stopping; }))
+            return;
+
+        the_lock.unlock();
+        self.recordLag(next_check);
+        checkExecutors();
+        the_lock.lock();
+
+        next_check = pcp_util::chrono::steady_clock::now() + checkInterval();
+    }
+}
+
+void enable(uint32_t threshold_ms)
+{
+    assert(threshold_ms > 0);
+    auto& state = watchdogThread();
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { state.mutex };
+        threshold_ms_ = threshold_ms;
+        if (state.thread_ptr != nullptr)
+            return;
+
+        state.stopping = false;
+        state.thread_ptr.reset(new pcp_util::thread(&watchdogTask));
+    }
+
+    LOG_INFO("Watching for stalled threads, with a threshold of {1} ms", threshold_ms);
+
+    if (!stack_sampler_installed_) {
+        installStackSampler();
+        stack_sampler_installed_ = true;
+    }
+}
+
+void disable()
+{
+    auto& state = watchdogThread();
+    std::unique_ptr<pcp_util::thread> thread_ptr {};
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { state.mutex };
+        threshold_ms_ = 0;
+        state.stopping = true;
+        state.cond_var.notify_all();
+        thread_ptr = std::move(state.thread_ptr);
+    }
+
+    if (thread_ptr != nullptr && thread_ptr->joinable())
+        thread_ptr->join();
+}
+
+bool isEnabled()
+{
+    return threshold_ms_.load(std::memory_order_relaxed) > 0;
+}
+
+uint32_t thresholdMs()
+{
+    return threshold_ms_.load(std::memory_order_relaxed);
+}
+
+}  // namespace Watchdog
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,45 @@
+#include <pxp-agent/util/apply_worker_pool.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.windows.apply_worker_pool"
+#include <leatherman/logging/logging.hpp>
+
+namespace PXPAgent {
+namespace Util {
+
+namespace fs = boost::filesystem;
+
+// Workers communicate through Unix domain sockets, which are not
+// available to the Ruby shipped with puppet-agent on Windows
+
+ApplyWorkerPool::ApplyWorkerPool(uint32_t max_workers,
+                                 fs::path workers_dir,
+                                 uint32_t idle_timeout_s)
+        : max_workers_ { 0 },
+          workers_dir_ { std::move(workers_dir) },
+          idle_timeout_s_ { idle_timeout_s },
+          worker_counter_ { 0 }
+{
+    if (max_workers > 0)
+        LOG_WARNING("Warm apply workers are not supported on Windows; apply "
+                    "requests will be processed by starting a new process");
+}
+
+ApplyWorkerPool::~ApplyWorkerPool() = default;
+
+bool ApplyWorkerPool::enabled() const
+{
+    return false;
+}
+
+bool ApplyWorkerPool::run(const std::string& environment,
+                          const CommandObject& shim_command,
+                          const std::string& worker_input,
+                          const std::string& input,
+                          ActionOutput& output,
+                          std::function<void(size_t)> pid_callback)
+{
+    return false;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
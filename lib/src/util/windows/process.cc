@@ -27,5 +27,21 @@ int getPid() {
     return GetCurrentProcessId();
 }
 
+// Windows has no SIGTERM equivalent for console processes that
+// don't share our console; terminate the process right away
+bool terminateProcessGroup(int pid, bool force) {
+    auto p_handle = OpenProcess(PROCESS_TERMINATE, FALSE, pid);
+    if (!p_handle) {
+        LOG_DEBUG("OpenProcess failure while trying to terminate PID {1}: {2}",
+                  pid, lth_win::system_error());
+        return false;
+    }
+    auto terminated = TerminateProcess(p_handle, 1) != 0;
+    if (!terminated)
+        LOG_DEBUG("Failed to terminate PID {1}: {2}", pid, lth_win::system_error());
+    CloseHandle(p_handle);
+    return terminated;
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
@@ -0,0 +1,19 @@
+#include <pxp-agent/util/trace.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.util.trace"
+#include <leatherman/logging/logging.hpp>
+
+namespace PXPAgent {
+namespace Util {
+namespace Trace {
+
+void installDumpSignalHandler(const std::string& file_path)
+{
+    LOG_WARNING("The trace cannot be dumped to '{1}' on Windows, as there is no "
+                "SIGUSR1; use the 'trace' action of the 'metrics' module instead",
+                file_path);
+}
+
+}  // namespace Trace
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,35 @@
+#include <pxp-agent/util/watchdog.hpp>
+
+#include <leatherman/locale/locale.hpp>
+
+#include <leatherman/windows/windows.hpp>
+
+namespace PXPAgent {
+namespace Util {
+namespace Watchdog {
+
+namespace lth_loc = leatherman::locale;
+
+ThreadHandle currentThread()
+{
+    return GetCurrentThreadId();
+}
+
+void installStackSampler()
+{
+    throw Error { lth_loc::translate("stacks cannot be sampled on Windows") };
+}
+
+bool requestStackSample(ThreadHandle)
+{
+    return false;
+}
+
+std::vector<std::string> collectStackSample()
+{
+    return {};
+}
+
+}  // namespace Watchdog
+}  // namespace Util
+}  // namespace PXPAgent
@@ -0,0 +1,163 @@
+#ifndef PXP_AGENT_TESTS_BENCH_BENCH_HPP_
+#define PXP_AGENT_TESTS_BENCH_BENCH_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Bench {
+
+/// Command line options of pxp-agent-bench
+struct Options {
+    /// Number of samples taken for each benchmark
+    unsigned int repetitions { 1 };
+
+    /// If any, only the benchmarks whose name contains one of them
+    /// are run
+    std::vector<std::string> filters {};
+};
+
+inline Options& options()
+{
+    static Options the_options {};
+    return the_options;
+}
+
+/// The samples of a benchmark; each one is the mean over the
+/// iterations, in the specified unit
+struct Result {
+    std::string name;
+    std::string unit;
+    uint64_t iterations;
+    std::vector<double> samples;
+};
+
+/// The results of the benchmarks run so far
+inline std::vector<Result>& results()
+{
+    static std::vector<Result> the_results {};
+    return the_results;
+}
+
+inline double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    auto middle = values.size() / 2;
+    return values.size() % 2 ? values[middle]
+                             : (values[middle - 1] + values[middle]) / 2;
+}
+
+/// Time the specified number of calls to the function, after warming
+/// up caches and static initializers, once per repetition; return
+/// the durations, in seconds
+inline std::vector<double> sampleDurations(uint64_t iterations,
+                                           const std::function<void()>& fn)
+{
+    for (uint64_t i = 0; i < iterations / 10 + 1; i++)
+        fn();
+
+    std::vector<double> durations {};
+    for (unsigned int rep = 0; rep < options().repetitions; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            fn();
+        durations.push_back(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    return durations;
+}
+
+inline double report(Result result)
+{
+    auto value = median(result.samples);
+    std::cout << std::left << std::setw(56) << result.name
+              << std::right << std::setw(14) << std::fixed
+              << std::setprecision(1) << value << " " << result.unit << std::endl;
+    results().push_back(std::move(result));
+    return value;
+}
+
+inline bool isSelected(const std::string& name)
+{
+    const auto& filters = options().filters;
+    return filters.empty()
+           || std::any_of(filters.begin(), filters.end(),
+                          [&name](const std::string& filter) {
+                              return name.find(filter) != std::string::npos;
+                          });
+}
+
+/// Run the function the specified number of times and print the mean
+/// duration of a call, in nanoseconds; the median of the samples, if
+/// there are several repetitions
+inline double measure(const std::string& name,
+                      uint64_t iterations,
+                      const std::function<void()>& fn)
+{
+    if (!isSelected(name))
+        return 0;
+
+    Result result { name, "ns/op", iterations, {} };
+    for (auto duration : sampleDurations(iterations, fn))
+        result.samples.push_back(duration * 1e9 / static_cast<double>(iterations));
+    return report(std::move(result));
+}
+
+/// As measure, but print the throughput in MB/s for a function that
+/// processes the specified number of bytes per call
+inline double measureThroughput(const std::string& name,
+                                uint64_t iterations,
+                                size_t bytes,
+                                const std::function<void()>& fn)
+{
+    if (!isSelected(name))
+        return 0;
+
+    Result result { name, "MB/s", iterations, {} };
+    for (auto duration : sampleDurations(iterations, fn))
+        result.samples.push_back(static_cast<double>(bytes)
+                                 * static_cast<double>(iterations) / duration / 1e6);
+    return report(std::move(result));
+}
+
+/// Bytes allocated through the global operator new so far, which
+/// main.cc replaces to count them
+uint64_t allocatedBytes();
+
+/// As measure, but print the mean number of bytes allocated by a call
+inline double measureAllocations(const std::string& name,
+                                 uint64_t iterations,
+                                 const std::function<void()>& fn)
+{
+    if (!isSelected(name))
+        return 0;
+
+    fn();
+    Result result { name, "B/op", iterations, {} };
+    for (unsigned int rep = 0; rep < options().repetitions; rep++) {
+        auto before = allocatedBytes();
+        for (uint64_t i = 0; i < iterations; i++)
+            fn();
+        result.samples.push_back(static_cast<double>(allocatedBytes() - before)
+                                 / static_cast<double>(iterations));
+    }
+    return report(std::move(result));
+}
+
+// Benchmark groups, run in sequence by main()
+void runRequestBenchmarks();
+void runStorageBenchmarks();
+void runValidationBenchmarks();
+void runUTF8Benchmarks();
+void runJSONEscapeBenchmarks();
+
+}  // namespace Bench
+}  // namespace PXPAgent
+
+#endif  // PXP_AGENT_TESTS_BENCH_BENCH_HPP_
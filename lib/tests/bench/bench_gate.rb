@@ -0,0 +1,245 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Performance regression gate for pxp-agent-bench.
+#
+#   bench_gate.rb record  --bench BIN [--baseline FILE] [--repetitions N]
+#   bench_gate.rb compare --bench BIN [--baseline FILE] [--repetitions N]
+#                         [--alpha P] [--threshold PERCENT] [--force]
+#                         [--require-baseline]
+#
+# `record` runs the gated benchmarks and stores their samples, with a
+# fingerprint of the host, in the baseline file. `compare` runs them again
+# and fails if any of them is slower than its baseline, both significantly
+# (one-sided Mann-Whitney U test over the samples) and by more than the
+# threshold (relative change of the medians).
+#
+# Exit codes: 0 no regression, 1 regression, 2 usage or bench failure,
+# 77 skipped (no baseline, or a baseline recorded on a different host).
+# With --require-baseline, as on CI, a missing or incomparable baseline
+# is a failure (2) rather than a skip.
+
+require 'etc'
+require 'json'
+require 'optparse'
+require 'socket'
+require 'tempfile'
+require 'time'
+
+module BenchGate
+  SKIP = 77
+
+  # Hot paths of pxp-agent: request dispatch and copies, status queries,
+  # metadata I/O
+  GATED_BENCHMARKS = [
+    'ActionRequest, ',
+    'ActionRequest copy, ',
+    'ActionRequest::paramsTxt, ',
+    'RequestProcessor::processRequest, ',
+    'ActionResponse::toJSON',
+    'ResultsStorage::',
+    'ResultsMutex '
+  ].freeze
+
+  DEFAULT_BASELINE = File.join(__dir__, 'baseline.json')
+
+  module_function
+
+  def cpu_model
+    model = File.foreach('/proc/cpuinfo').grep(/^model name/).first
+    model ? model.split(':', 2).last.strip : RUBY_PLATFORM
+  rescue SystemCallError
+    RUBY_PLATFORM
+  end
+
+  def host_fingerprint(build_info)
+    uname = Etc.uname
+    {
+      'hostname' => Socket.gethostname,
+      'os' => "#{uname[:sysname]} #{uname[:release]}",
+      'arch' => uname[:machine],
+      'cpu' => cpu_model,
+      'cpus' => Etc.nprocessors,
+      'build' => build_info.to_s
+    }
+  end
+
+  # Fields that must match for the samples to be comparable
+  def comparable?(a, b)
+    %w[cpu cpus arch build].all? { |key| a[key] == b[key] }
+  end
+
+  def run_bench(bench, repetitions)
+    Tempfile.create(['pxp-agent-bench', '.json']) do |json|
+      args = [bench, '--repetitions', repetitions.to_s, '--json', json.path]
+      GATED_BENCHMARKS.each { |name| args.push('--filter', name) }
+      system(*args) or abort_with(2, "#{bench} failed (#{$?})")
+      JSON.parse(File.read(json.path)).fetch('benchmarks')
+    end
+  end
+
+  def median(values)
+    sorted = values.sort
+    middle = sorted.size / 2
+    sorted.size.odd? ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2.0
+  end
+
+  # p-value of the one-sided Mann-Whitney U test that the values of
+  # `current` tend to be greater than the ones of `baseline`; normal
+  # approximation, with tie and continuity corrections
+  def mann_whitney_greater(baseline, current)
+    n1 = baseline.size
+    n2 = current.size
+    return 1.0 if n1.zero? || n2.zero?
+
+    pooled = baseline.map { |v| [v, 0] } + current.map { |v| [v, 1] }
+    pooled.sort_by!(&:first)
+
+    ranks = Array.new(pooled.size)
+    tie_term = 0.0
+    idx = 0
+    while idx < pooled.size
+      last = idx
+      last += 1 while last + 1 < pooled.size && pooled[last + 1][0] == pooled[idx][0]
+      ties = last - idx + 1
+      (idx..last).each { |i| ranks[i] = (idx + last) / 2.0 + 1 }
+      tie_term += ties**3 - ties
+      idx = last + 1
+    end
+
+    rank_sum = pooled.each_index.sum { |i| pooled[i][1] == 1 ? ranks[i] : 0 }
+    u = rank_sum - n2 * (n2 + 1) / 2.0
+    n = n1 + n2
+    mean = n1 * n2 / 2.0
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    return(u > mean ? 0.0 : 1.0) if variance <= 0
+
+    z = (u - mean - 0.5) / Math.sqrt(variance)
+    0.5 * Math.erfc(z / Math.sqrt(2))
+  end
+
+  # Durations regress when they grow, throughputs when they drop
+  def regression(baseline, current)
+    sign = baseline['unit'] == 'MB/s' ? -1 : 1
+    base = baseline['samples'].map { |v| sign * v }
+    cur = current['samples'].map { |v| sign * v }
+    base_median = median(baseline['samples'])
+    change = base_median.zero? ? 0.0 : sign * (median(current['samples']) - base_median) / base_median
+    [change, mann_whitney_greater(base, cur)]
+  end
+
+  def record(options)
+    benchmarks = run_bench(options[:bench], options[:repetitions])
+    baseline = {
+      'host' => host_fingerprint(options[:build_info]),
+      'recorded_at' => Time.now.utc.iso8601,
+      'repetitions' => options[:repetitions],
+      'benchmarks' => benchmarks
+    }
+    File.write(options[:baseline], JSON.pretty_generate(baseline) + "\n")
+    puts "Recorded #{benchmarks.size} benchmarks in #{options[:baseline]}"
+    0
+  end
+
+  # Skip the comparison, or fail if a baseline is required
+  def skip(options, reason)
+    if options[:require_baseline]
+      puts "FAILED: #{reason}"
+      return 2
+    end
+    puts "SKIPPED: #{reason}"
+    SKIP
+  end
+
+  def compare(options)
+    unless File.exist?(options[:baseline])
+      return skip(options, "no baseline in #{options[:baseline]}; record one with `bench_gate.rb record`")
+    end
+
+    baseline = JSON.parse(File.read(options[:baseline]))
+    host = host_fingerprint(options[:build_info])
+    unless options[:force] || comparable?(baseline['host'], host)
+      puts "  baseline: #{baseline['host'].to_json}"
+      puts "  current:  #{host.to_json}"
+      return skip(options, 'the baseline was recorded on a different host or build')
+    end
+
+    current = run_bench(options[:bench], options[:repetitions])
+                .to_h { |b| [b['name'], b] }
+    failures = []
+
+    puts
+    puts format('%-56s %12s %12s %8s %8s', 'benchmark', 'baseline', 'current', 'change', 'p')
+    baseline['benchmarks'].each do |base|
+      cur = current[base['name']]
+      if cur.nil?
+        puts format('%-56s %s', base['name'], 'missing from the current run')
+        next
+      end
+
+      change, p_value = regression(base, cur)
+      regressed = p_value < options[:alpha] && change > options[:threshold]
+      failures << base['name'] if regressed
+      puts format('%-56s %12.1f %12.1f %+7.1f%% %8.4f%s',
+                  base['name'], median(base['samples']), median(cur['samples']),
+                  change * 100, p_value, regressed ? '  REGRESSION' : '')
+    end
+
+    puts
+    if failures.empty?
+      puts 'No regression'
+      0
+    else
+      puts "#{failures.size} benchmark(s) regressed by more than " \
+           "#{(options[:threshold] * 100).round(1)}% (alpha #{options[:alpha]})"
+      1
+    end
+  end
+
+  def abort_with(code, message)
+    warn message
+    exit code
+  end
+
+  def parse(argv)
+    options = {
+      baseline: DEFAULT_BASELINE,
+      repetitions: 15,
+      alpha: 0.01,
+      threshold: 0.10,
+      build_info: '',
+      force: false,
+      require_baseline: false
+    }
+
+    parser = OptionParser.new do |opts|
+      opts.banner = "Usage: #{File.basename($PROGRAM_NAME)} record|compare --bench BIN [options]"
+      opts.on('--bench BIN', 'pxp-agent-bench executable') { |v| options[:bench] = v }
+      opts.on('--baseline FILE', "baseline file; default: #{DEFAULT_BASELINE}") { |v| options[:baseline] = v }
+      opts.on('--repetitions N', Integer, 'samples per benchmark; default: 15') { |v| options[:repetitions] = v }
+      opts.on('--alpha P', Float, 'significance level; default: 0.01') { |v| options[:alpha] = v }
+      opts.on('--threshold PERCENT', Float, 'tolerated slowdown of the median; default: 10') do |v|
+        options[:threshold] = v / 100.0
+      end
+      opts.on('--build-info TEXT', 'compiler and build type, part of the fingerprint') { |v| options[:build_info] = v }
+      opts.on('--force', 'compare against a baseline recorded on another host') { options[:force] = true }
+      opts.on('--require-baseline', 'fail, rather than skip, without a comparable baseline') do
+        options[:require_baseline] = true
+      end
+    end
+
+    mode = argv.shift
+    parser.parse!(argv)
+    unless %w[record compare].include?(mode) && options[:bench] && options[:repetitions] > 1
+      abort_with(2, parser.help)
+    end
+    [mode, options]
+  rescue OptionParser::ParseError => e
+    abort_with(2, "#{e.message}\n#{parser.help}")
+  end
+end
+
+if $PROGRAM_NAME == __FILE__
+  mode, options = BenchGate.parse(ARGV)
+  exit(mode == 'record' ? BenchGate.record(options) : BenchGate.compare(options))
+end
@@ -0,0 +1,74 @@
+#include "bench.hpp"
+
+#include <pxp-agent/util/json_escape.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+namespace Bench {
+
+namespace lth_jc = leatherman::json_container;
+
+static const size_t OUTPUT_SIZE { 4 * 1024 * 1024 };
+
+// Output of the specified size, made by repeating the sample
+static std::string repeat(const std::string& sample)
+{
+    std::string output {};
+    output.reserve(OUTPUT_SIZE + sample.size());
+    while (output.size() < OUTPUT_SIZE)
+        output += sample;
+    return output;
+}
+
+void runJSONEscapeBenchmarks()
+{
+    struct Input {
+        std::string name;
+        std::string data;
+    };
+
+    const Input inputs[] {
+        // Typical task output: long clean runs, a newline per line
+        { "log lines", repeat("Notice: /Stage[main]/Main/File[/tmp/foo]/ensure: created\n") },
+        // JSON printed by a task, with a quote every few bytes
+        { "JSON output", repeat("{\"name\": \"foo\", \"value\": 42, \"path\": \"C:\\\\tmp\"}\n") },
+        { "no escapes", repeat("abcdefghijklmnopqrstuvwxyz0123456789 ") },
+    };
+
+    const std::pair<Util::JSONEscaper, std::string> escapers[] {
+        { Util::JSONEscaper::Scalar, "scalar" },
+        { Util::JSONEscaper::SSE2, "SSE2" },
+        { Util::JSONEscaper::AVX2, "AVX2" },
+    };
+
+    for (const auto& input : inputs) {
+        for (const auto& escaper : escapers) {
+            if (!Util::supportsJSONEscaper(escaper.first))
+                continue;
+            std::string out {};
+            measureThroughput("JSON escape, 4 MiB " + input.name + " (" + escaper.second + ")",
+                              50, input.data.size(),
+                              [&] {
+                                  out.clear();
+                                  Util::appendJSONString(out, input.data.data(),
+                                                         input.data.size(), escaper.first);
+                              });
+        }
+
+        // The baseline: setting the output in a JsonContainer and
+        // serializing it, as done by ActionResponse::toJSON
+        measureThroughput("JSON escape, 4 MiB " + input.name + " (JsonContainer)",
+                          20, input.data.size(),
+                          [&] {
+                              lth_jc::JsonContainer results {};
+                              results.set<std::string>("stdout", input.data);
+                              results.toString();
+                          });
+    }
+}
+
+}  // namespace Bench
+}  // namespace PXPAgent
@@ -0,0 +1,104 @@
+#include "bench.hpp"
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace lth_jc   = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+
+// Counted for measureAllocations; the replacement is confined to the
+// benchmark binary, the unit tests use the default allocator
+static std::atomic<uint64_t> allocated_bytes { 0 };
+
+void* operator new(std::size_t size)
+{
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+uint64_t PXPAgent::Bench::allocatedBytes()
+{
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+static const std::string USAGE {
+    "Usage: pxp-agent-bench [--repetitions N] [--filter TEXT] [--json FILE]\n"
+    "  --repetitions N  take N samples of each benchmark; default: 1\n"
+    "  --filter TEXT    run only the benchmarks whose name contains TEXT;\n"
+    "                   repeatable\n"
+    "  --json FILE      write the samples of the benchmarks to FILE, in JSON\n" };
+
+// {"benchmarks": [{"name", "unit", "iterations", "samples"}]}
+static std::string resultsToJSON()
+{
+    std::vector<lth_jc::JsonContainer> benchmarks {};
+    for (const auto& result : PXPAgent::Bench::results()) {
+        lth_jc::JsonContainer benchmark {};
+        benchmark.set<std::string>("name", result.name);
+        benchmark.set<std::string>("unit", result.unit);
+        benchmark.set<int>("iterations", static_cast<int>(result.iterations));
+        benchmark.set<std::vector<double>>("samples", result.samples);
+        benchmarks.push_back(std::move(benchmark));
+    }
+
+    lth_jc::JsonContainer json {};
+    json.set<std::vector<lth_jc::JsonContainer>>("benchmarks", benchmarks);
+    return json.toString();
+}
+
+int main(int argc, char** argv)
+{
+    auto& options = PXPAgent::Bench::options();
+    std::string json_file {};
+
+    for (int idx = 1; idx < argc; idx++) {
+        std::string arg { argv[idx] };
+        if (idx + 1 < argc && arg == "--repetitions") {
+            auto repetitions = std::atoi(argv[++idx]);
+            if (repetitions < 1) {
+                std::cerr << "the number of repetitions must be positive" << std::endl;
+                return 2;
+            }
+            options.repetitions = static_cast<unsigned int>(repetitions);
+        } else if (idx + 1 < argc && arg == "--filter") {
+            options.filters.push_back(argv[++idx]);
+        } else if (idx + 1 < argc && arg == "--json") {
+            json_file = argv[++idx];
+        } else {
+            std::cerr << USAGE;
+            return 2;
+        }
+    }
+
+    PXPAgent::Bench::runRequestBenchmarks();
+    PXPAgent::Bench::runStorageBenchmarks();
+    PXPAgent::Bench::runValidationBenchmarks();
+    PXPAgent::Bench::runUTF8Benchmarks();
+    PXPAgent::Bench::runJSONEscapeBenchmarks();
+
+    if (!json_file.empty()) {
+        try {
+            lth_file::atomic_write_to_file(resultsToJSON(), json_file);
+        } catch (const std::exception& e) {
+            std::cerr << "failed to write the results to '" << json_file
+                      << "': " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "bench.hpp"
+#include "../common/content_format.hpp"
+#include "../common/mock_connector.hpp"
+
+#include <pxp-agent/action_request.hpp>
+#include <pxp-agent/action_response.hpp>
+#include <pxp-agent/module_type.hpp>
+#include <pxp-agent/request_processor.hpp>
+#include <pxp-agent/request_type.hpp>
+#include <pxp-agent/results_storage.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Bench {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+
+static PCPClient::ParsedChunks getChunks(const std::string& data_txt)
+{
+    return PCPClient::ParsedChunks { lth_jc::JsonContainer(ENVELOPE_TXT),
+                                     lth_jc::JsonContainer(data_txt),
+                                     std::vector<lth_jc::JsonContainer> {},
+                                     0 };
+}
+
+static const std::string ECHO_TXT {
+    (DATA_FORMAT % "\"bench-echo\""
+                 % "\"echo\""
+                 % "\"echo\""
+                 % "{\"argument\" : \"maradona\"}").str() };
+
+static const std::string TASK_TXT {
+    (NON_BLOCKING_DATA_FORMAT % "\"bench-task\""
+                              % "\"task\""
+                              % "\"run\""
+                              % R"({"task": "package::install",
+                                    "input": {"name": "openssl", "action": "upgrade"},
+                                    "files": [{"filename": "init.rb",
+                                               "uri": {"path": "/package/tasks/init.rb",
+                                                       "params": {"environment": "production"}},
+                                               "sha256": "e1c10f8c709f06f4327ac6a07a918e297a039a24a788fabf4e2ebc31d16e8dc3",
+                                               "size_bytes": 2841}]})"
+                              % "false").str() };
+
+static const std::string STATUS_TXT {
+    (DATA_FORMAT % "\"bench-status-query\""
+                 % "\"status\""
+                 % "\"query\""
+                 % "{\"transaction_id\" : \"bench-status\"}").str() };
+
+// Unlike MockConnector, accepts status responses, so that the status
+// query benchmark doesn't time the throwing of an exception
+class StatusConnector : public MockConnector {
+  public:
+    void sendStatusResponse(const ActionResponse&,
+                            const ActionRequest&,
+                            const std::string&,
+                            bool) override
+    {
+    }
+};
+
+// Stores the metadata of a completed echo action, to be queried
+static void storeCompletedAction(const std::string& data_txt)
+{
+    ResultsStorage storage { SPOOL, "0d" };
+    ActionRequest request { RequestType::NonBlocking, getChunks(data_txt) };
+    storage.initializeMetadataFile(request.transactionId(),
+                                   ActionResponse::getMetadataFromRequest(request));
+
+    ActionResponse response { ModuleType::Internal, request };
+    lth_jc::JsonContainer results {};
+    results.set<std::string>("outcome", "maradona");
+    response.setValidResultsAndEnd(std::move(results));
+    storage.updateMetadataFile(request.transactionId(), response.action_metadata);
+}
+
+void runRequestBenchmarks()
+{
+    auto echo_chunks = getChunks(ECHO_TXT);
+    auto task_chunks = getChunks(TASK_TXT);
+    auto status_chunks = getChunks(STATUS_TXT);
+
+    measure("ActionRequest, blocking echo", 100000,
+            [&] { ActionRequest request { RequestType::Blocking, echo_chunks }; });
+    measure("ActionRequest, non-blocking task", 100000,
+            [&] { ActionRequest request { RequestType::NonBlocking, task_chunks }; });
+
+    {
+        // Copies share the payload of the request, whatever its size
+        auto apply_chunks = getChunks(ECHO_TXT);
+        lth_jc::JsonContainer params {};
+        params.set<std::string>("catalog", std::string(4 * 1024 * 1024, 'x'));
+        apply_chunks.data.set<lth_jc::JsonContainer>("params", params);
+        ActionRequest apply_request { RequestType::NonBlocking, apply_chunks };
+        apply_request.paramsTxt();
+
+        measureAllocations("ActionRequest copy, 4 MiB params", 10000,
+                           [&] { ActionRequest copy { apply_request }; });
+        measureAllocations("ActionRequest::paramsTxt, 4 MiB params", 10000,
+                           [&] { ActionRequest copy { apply_request }; copy.paramsTxt(); });
+    }
+
+    {
+        auto connector_ptr = std::make_shared<StatusConnector>();
+        RequestProcessor processor { connector_ptr, AGENT_CONFIGURATION };
+
+        // Validation of the request content, execution of the echo
+        // action and serialization of the response
+        measure("RequestProcessor::processRequest, blocking echo", 20000,
+                [&] { processor.processRequest(RequestType::Blocking, echo_chunks); });
+
+        storeCompletedAction(
+            (NON_BLOCKING_DATA_FORMAT % "\"bench-status\"" % "\"echo\"" % "\"echo\""
+                                      % "{\"argument\" : \"maradona\"}" % "false").str());
+        measure("RequestProcessor::processRequest, status query", 5000,
+                [&] { processor.processRequest(RequestType::Blocking, status_chunks); });
+    }
+    fs::remove_all(SPOOL);
+
+    ActionRequest request { RequestType::Blocking, echo_chunks };
+    for (size_t size : { 256, 64 * 1024 }) {
+        ActionResponse response { ModuleType::Internal, request };
+        lth_jc::JsonContainer results {};
+        results.set<std::string>("stdout", std::string(size, 'x'));
+        results.set<int>("exitcode", 0);
+        response.setValidResultsAndEnd(std::move(results));
+        auto label = std::to_string(size) + " B output";
+
+        measure("ActionResponse::toJSON, " + label, 20000,
+                [&] { response.toJSON(ActionResponse::ResponseType::Blocking); });
+        measure("ActionResponse::toJSONString, " + label, 20000,
+                [&] { response.toJSONString(ActionResponse::ResponseType::Blocking); });
+    }
+}
+
+}  // namespace Bench
+}  // namespace PXPAgent
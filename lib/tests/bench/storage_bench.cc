@@ -0,0 +1,171 @@
+#include "bench.hpp"
+#include "../common/content_format.hpp"
+
+#include <pxp-agent/action_request.hpp>
+#include <pxp-agent/action_response.hpp>
+#include <pxp-agent/module_cache_dir.hpp>
+#include <pxp-agent/module_type.hpp>
+#include <pxp-agent/request_type.hpp>
+#include <pxp-agent/results_mutex.hpp>
+#include <pxp-agent/results_storage.hpp>
+#include <pxp-agent/thread_container.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <leatherman/curl/client.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/json_container/json_container.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+namespace Bench {
+
+namespace fs = boost::filesystem;
+namespace lth_curl = leatherman::curl;
+namespace lth_file = leatherman::file_util;
+namespace lth_jc   = leatherman::json_container;
+namespace pcp_util = PCPClient::Util;
+
+static const std::string TRANSACTION_ID { "bench-metadata" };
+
+static const std::string CACHED_FILE_LINE {
+    "Notice: /Stage[main]/Main/File[/tmp/foo]/ensure: created\n" };
+
+// SHA-256 of 1 MiB of repeated CACHED_FILE_LINE
+static const std::string CACHED_FILE_SHA256 {
+    "79e4820f593c32a6753acb9be6f3eee79ff83202040fa0e3c40cf2f6a48c3fc9" };
+
+// The metadata of a completed task, with its output
+static lth_jc::JsonContainer getMetadata()
+{
+    ActionRequest request {
+        RequestType::NonBlocking,
+        PCPClient::ParsedChunks {
+            lth_jc::JsonContainer(ENVELOPE_TXT),
+            lth_jc::JsonContainer((NON_BLOCKING_DATA_FORMAT % ("\"" + TRANSACTION_ID + "\"")
+                                                            % "\"task\""
+                                                            % "\"run\""
+                                                            % "{\"task\" : \"foo\"}"
+                                                            % "false").str()),
+            std::vector<lth_jc::JsonContainer> {},
+            0 } };
+
+    ActionResponse response { ModuleType::Internal, request };
+    lth_jc::JsonContainer results {};
+    results.set<int>("exitcode", 0);
+    results.set<std::string>("stdout", std::string(4096, 'x'));
+    response.setValidResultsAndEnd(std::move(results));
+    return response.action_metadata;
+}
+
+static void runMetadataBenchmarks(const fs::path& spool_dir)
+{
+    ResultsStorage storage { spool_dir.string(), "0d" };
+    auto metadata = getMetadata();
+    storage.initializeMetadataFile(TRANSACTION_ID, metadata);
+
+    measure("ResultsStorage::updateMetadataFile", 2000,
+            [&] { storage.updateMetadataFile(TRANSACTION_ID, metadata); });
+    measure("ResultsStorage::getActionMetadata", 5000,
+            [&] { storage.getActionMetadata(TRANSACTION_ID); });
+    measure("ResultsStorage::getActionSummary", 5000,
+            [&] { storage.getActionSummary(TRANSACTION_ID); });
+}
+
+static void runResultsMutexBenchmarks()
+{
+    auto& results_mutex = ResultsMutex::Instance();
+
+    // As done for each non-blocking action, and its status queries
+    measure("ResultsMutex add, get and remove", 100000,
+            [&] {
+                {
+                    ResultsMutex::LockGuard a_l { results_mutex.access_mtx };
+                    results_mutex.add(TRANSACTION_ID);
+                }
+                ResultsMutex::Mutex_Ptr mtx_ptr {};
+                {
+                    ResultsMutex::LockGuard a_l { results_mutex.access_mtx };
+                    if (results_mutex.exists(TRANSACTION_ID))
+                        mtx_ptr = results_mutex.get(TRANSACTION_ID);
+                }
+                ResultsMutex::LockGuard a_l { results_mutex.access_mtx };
+                results_mutex.remove(TRANSACTION_ID);
+            });
+}
+
+static void runThreadContainerBenchmarks()
+{
+    // Completed threads; the container is destroyed once all of them
+    // are done, after the timed region
+    pcp_util::mutex done_mutex;
+    pcp_util::condition_variable done_cond_var;
+    uint64_t num_done { 0 };
+
+    // Threads are reclaimed by the monitoring task once more than 10
+    // are stored, as for the actions of RequestProcessor
+    ThreadContainer container { "Bench", 10, 10 };
+    uint64_t thread_number { 0 };
+
+    measure("ThreadContainer::add, with reclaim", 2000,
+            [&] {
+                auto done = std::make_shared<std::atomic<bool>>(false);
+                container.add("bench_" + std::to_string(thread_number++),
+                              pcp_util::thread([&, done] {
+                                  pcp_util::lock_guard<pcp_util::mutex> the_lock { done_mutex };
+                                  *done = true;
+                                  num_done++;
+                                  done_cond_var.notify_one();
+                              }),
+                              done);
+            });
+
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { done_mutex };
+    done_cond_var.wait(the_lock, [&] { return num_done == thread_number; });
+}
+
+static void runModuleCacheDirBenchmarks(const fs::path& cache_dir)
+{
+    ModuleCacheDir module_cache_dir { cache_dir.string(), "14d" };
+    auto file_cache_dir = module_cache_dir.createCacheDir(CACHED_FILE_SHA256);
+    auto destination = file_cache_dir / "init.rb";
+
+    std::string content {};
+    while (content.size() < 1024 * 1024)
+        content += CACHED_FILE_LINE;
+    content.resize(1024 * 1024);
+    lth_file::atomic_write_to_file(content, destination.string());
+
+    Util::RemoteFile file { "init.rb", CACHED_FILE_SHA256, "/tasks/init.rb", {} };
+    lth_curl::client client {};
+
+    // A cache hit computes the SHA-256 of the cached file
+    measureThroughput("ModuleCacheDir cache hit, 1 MiB file", 200, content.size(),
+                      [&] {
+                          module_cache_dir.downloadFileFromMaster(
+                              {}, 0, 0, client, file_cache_dir, destination, file);
+                      });
+}
+
+void runStorageBenchmarks()
+{
+    auto bench_dir = fs::temp_directory_path() / fs::unique_path("pxp-agent-bench-%%%%-%%%%");
+    fs::create_directories(bench_dir);
+
+    runMetadataBenchmarks(bench_dir / "spool");
+    runResultsMutexBenchmarks();
+    runThreadContainerBenchmarks();
+    runModuleCacheDirBenchmarks(bench_dir / "task-cache");
+
+    fs::remove_all(bench_dir);
+}
+
+}  // namespace Bench
+}  // namespace PXPAgent
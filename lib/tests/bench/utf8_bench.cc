@@ -0,0 +1,62 @@
+#include "bench.hpp"
+
+#include <pxp-agent/util/utf8.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+namespace Bench {
+
+static const size_t OUTPUT_SIZE { 1024 * 1024 };
+
+// Output of the specified size, made by repeating the sample
+static std::string repeat(const std::string& sample)
+{
+    std::string output {};
+    output.reserve(OUTPUT_SIZE + sample.size());
+    while (output.size() < OUTPUT_SIZE)
+        output += sample;
+    return output;
+}
+
+void runUTF8Benchmarks()
+{
+    struct Input {
+        std::string name;
+        std::string data;
+    };
+
+    auto ascii = repeat("Notice: /Stage[main]/Main/File[/tmp/foo]/ensure: created\n");
+    auto invalid = ascii;
+    invalid[invalid.size() - 2] = '\xff';
+
+    const Input inputs[] {
+        { "ASCII", ascii },
+        { "mostly ASCII", repeat("Caf\xc3\xa9 ouvert de 8h \xc3\xa0 18h, 5\xe2\x82\xac le menu\n") },
+        { "multibyte", repeat("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae"
+                              "\xe3\x83\x86\xe3\x82\xad\xe3\x82\xb9\xe3\x83\x88 "
+                              "\xf0\x9f\x98\x80\n") },
+        { "invalid at the end", invalid },
+    };
+
+    const std::pair<Util::UTF8Validator, std::string> validators[] {
+        { Util::UTF8Validator::Scalar, "scalar" },
+        { Util::UTF8Validator::SSE4, "SSE4" },
+        { Util::UTF8Validator::AVX2, "AVX2" },
+    };
+
+    for (const auto& input : inputs) {
+        for (const auto& validator : validators) {
+            if (!Util::supportsUTF8Validator(validator.first))
+                continue;
+            measure("UTF-8, 1 MiB " + input.name + " (" + validator.second + ")", 200,
+                    [&] {
+                        Util::isValidUTF8(input.data.data(), input.data.size(),
+                                          validator.first);
+                    });
+        }
+    }
+}
+
+}  // namespace Bench
+}  // namespace PXPAgent
@@ -0,0 +1,104 @@
+#include "bench.hpp"
+
+#include <pxp-agent/util/structural_schema.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>
+#include <cpp-pcp-client/validator/schema.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+namespace Bench {
+
+namespace lth_jc = leatherman::json_container;
+
+using T_C = PCPClient::TypeConstraint;
+
+// Same constraints as the action metadata schema of ActionResponse
+static Util::StructuralSchema getMetadataSchema()
+{
+    Util::StructuralSchema sch { "metadata" };
+    for (auto& field : { "requester", "module", "action", "request_params",
+                         "transaction_id", "request_id", "start", "status" })
+        sch.addConstraint(field, T_C::String, true);
+    sch.addConstraint("notify_outcome", T_C::Bool, true);
+    sch.addConstraint("end", T_C::String, false);
+    sch.addConstraint("results", T_C::Any, false);
+    sch.addConstraint("results_are_valid", T_C::Bool, false);
+    sch.addConstraint("execution_error", T_C::String, false);
+    sch.addConstraint("resource_usage", T_C::Object, false);
+    return sch;
+}
+
+static lth_jc::JsonContainer getMetadata()
+{
+    return lth_jc::JsonContainer { R"({
+        "requester": "pcp://controller/server",
+        "module": "task",
+        "action": "run",
+        "request_params": "{}",
+        "transaction_id": "7a5e6d1c-1e08-4b5a-9b8e-0e2d8a6a8c33",
+        "request_id": "1f0e8e0e-4c1e-4a5c-8d3e-2f7a1b9c0d11",
+        "notify_outcome": false,
+        "start": "2026-01-01T00:00:00.000000Z",
+        "status": "success",
+        "end": "2026-01-01T00:00:01.000000Z",
+        "results": {"exitcode": 0, "stdout": "done"},
+        "results_are_valid": true
+    })" };
+}
+
+// An apply request with a catalog of the specified number of resources
+static lth_jc::JsonContainer getApplyParams(int num_resources)
+{
+    std::string catalog { R"({"resources": [)" };
+    for (int i = 0; i < num_resources; i++) {
+        if (i)
+            catalog += ",";
+        catalog += R"({"type": "File", "title": "/tmp/file_)" + std::to_string(i)
+                   + R"(", "exported": false, "parameters": {"ensure": "file",)"
+                   + R"( "content": "some content", "mode": "0644"}})";
+    }
+    catalog += "]}";
+
+    lth_jc::JsonContainer params {};
+    params.set<lth_jc::JsonContainer>("catalog", lth_jc::JsonContainer { catalog });
+    params.set<lth_jc::JsonContainer>("apply_options",
+                                      lth_jc::JsonContainer { R"({"noop": false})" });
+    return params;
+}
+
+static void compare(const std::string& name,
+                    const Util::StructuralSchema& schema,
+                    const lth_jc::JsonContainer& data,
+                    uint64_t iterations)
+{
+    PCPClient::Validator validator {};
+    validator.registerSchema(schema.toSchema());
+
+    measure(name + " (PCPClient::Validator)", iterations,
+            [&] { validator.validate(data, schema.getName()); });
+    measure(name + " (StructuralSchema)", iterations,
+            [&] { schema.validate(data); });
+}
+
+void runValidationBenchmarks()
+{
+    compare("action metadata", getMetadataSchema(), getMetadata(), 20000);
+
+    Util::StructuralSchema echo_schema { "echo" };
+    echo_schema.addConstraint("argument", T_C::String, true);
+    lth_jc::JsonContainer echo_params {};
+    echo_params.set<std::string>("argument", "maradona");
+    compare("echo input", echo_schema, echo_params, 20000);
+
+    Util::StructuralSchema apply_schema { "apply" };
+    apply_schema.addConstraint("catalog", T_C::Object, true);
+    apply_schema.addConstraint("apply_options", T_C::Object, true);
+    compare("apply input, 1000 resources", apply_schema, getApplyParams(1000), 200);
+}
+
+}  // namespace Bench
+}  // namespace PXPAgent
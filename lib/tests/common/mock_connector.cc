@@ -28,18 +28,24 @@ void MockConnector::sendPXPError(const ActionResponse&)
 }
 
 void MockConnector::sendBlockingResponse(const ActionResponse&,
-                                         const ActionRequest&)
+                                         const ActionRequest&,
+                                         const std::string&,
+                                         bool)
 {
     sent_blocking_response = true;
 }
 
 void MockConnector::sendStatusResponse(const ActionResponse& response,
-                                       const ActionRequest& request)
+                                       const ActionRequest& request,
+                                       const std::string& json_text,
+                                       bool compressed_results)
 {
     throw MockConnector::pxpError_msg {};
 }
 
-void MockConnector::sendNonBlockingResponse(const ActionResponse&)
+void MockConnector::sendNonBlockingResponse(const ActionResponse&,
+                                            const std::string&,
+                                            bool)
 {
     sent_non_blocking_response = true;
 }
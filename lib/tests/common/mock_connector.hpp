@@ -41,6 +41,9 @@ static Configuration::Agent AGENT_CONFIGURATION { MODULES,
                                                   CRL,
                                                   SPOOL,
                                                   "0d",  // don't purge spool!
+                                                  false, // don't pack results
+                                                  0,     // no spool size quota
+                                                  0,     // no spool count quota
                                                   "",    // modules config dir
                                                   "",    // task cache dir
                                                   "0d",  // don't purge task cache!
@@ -55,7 +58,15 @@ static Configuration::Agent AGENT_CONFIGURATION { MODULES,
                                                   15,    // ping interval
                                                   30,    // task download connection timeout
                                                   120,   // task download timeout
-                                                  64 * 1024 * 1024 };  // default max-message-size
+                                                  64 * 1024 * 1024,  // default max-message-size
+                                                  0,     // no warm apply workers
+                                                  "0m",  // don't cache facts
+                                                  "",    // no action cgroups
+                                                  1024 * 1024,  // compress results above 1 MiB
+                                                  "",    // don't export metrics
+                                                  0,     // no tracing
+                                                  "",    // no trace file
+                                                  0 };   // no watchdog
 
 static const std::string VALID_ENVELOPE_TXT {
     " { \"id\" : \"123456\","
@@ -89,12 +100,18 @@ class MockConnector : public PXPConnector {
     void sendPXPError(const ActionResponse&) override;
 
     void sendBlockingResponse(const ActionResponse&,
-                              const ActionRequest&) override;
+                              const ActionRequest&,
+                              const std::string&,
+                              bool) override;
 
     void sendStatusResponse(const ActionResponse& response,
-                            const ActionRequest& request) override;
+                            const ActionRequest& request,
+                            const std::string& json_text,
+                            bool compressed_results) override;
 
-    void sendNonBlockingResponse(const ActionResponse&) override;
+    void sendNonBlockingResponse(const ActionResponse&,
+                                 const std::string&,
+                                 bool) override;
 
     void sendProvisionalResponse(const ActionRequest&) override;
 
@@ -0,0 +1,751 @@
+#!/usr/bin/env ruby
+# Load generator for pxp-agent: runs a real pxp-agent against a minimal
+# local stand-in of the PCP broker, fires a mix of blocking, non-blocking
+# and status requests at it from a synthetic controller, and reports the
+# throughput, the latency percentiles, and the thread count and RSS of
+# the agent over time. Runs offline, on Linux; see README.md.
+require 'digest/sha1'
+require 'fileutils'
+require 'json'
+require 'openssl'
+require 'optparse'
+require 'securerandom'
+require 'socket'
+require 'tmpdir'
+
+module PXPLoad
+  BLOCKING_REQUEST_TYPE = 'http://puppetlabs.com/rpc_blocking_request'
+  BLOCKING_RESPONSE_TYPE = 'http://puppetlabs.com/rpc_blocking_response'
+  NON_BLOCKING_REQUEST_TYPE = 'http://puppetlabs.com/rpc_non_blocking_request'
+  NON_BLOCKING_RESPONSE_TYPE = 'http://puppetlabs.com/rpc_non_blocking_response'
+  PROVISIONAL_RESPONSE_TYPE = 'http://puppetlabs.com/rpc_provisional_response'
+  PXP_ERROR_TYPE = 'http://puppetlabs.com/rpc_error_message'
+  PCP_ERROR_TYPE = 'http://puppetlabs.com/error_message'
+
+  CONTROLLER_URI = 'pcp://load-controller/controller'
+  AGENT_CN = 'load-agent'
+
+  KINDS = [:blocking, :non_blocking, :status].freeze
+
+  def self.now
+    Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  end
+
+  # A throwaway CA, and the broker and agent certificates it signs. The
+  # certificates of lib/tests/resources/config, used by the unit tests,
+  # expired in 2019 and don't include a broker certificate and key.
+  module Certs
+    def self.generate(dir)
+      ca_key = OpenSSL::PKey::RSA.new(2048)
+      ca = certificate('pxp-load CA', ca_key, ca_key, nil, ca: true)
+      write(dir, 'ca.pem', ca)
+
+      { 'broker' => 'localhost', 'agent' => AGENT_CN }.each do |name, cn|
+        key = OpenSSL::PKey::RSA.new(2048)
+        write(dir, "#{name}.pem", certificate(cn, key, ca_key, ca))
+        write(dir, "#{name}_key.pem", key)
+      end
+      dir
+    end
+
+    def self.certificate(cn, key, signing_key, issuer, ca: false)
+      cert = OpenSSL::X509::Certificate.new
+      cert.version = 2
+      cert.serial = SecureRandom.random_number(2**64)
+      cert.subject = OpenSSL::X509::Name.parse("/CN=#{cn}")
+      cert.issuer = issuer ? issuer.subject : cert.subject
+      cert.public_key = key.public_key
+      cert.not_before = Time.now - 3600
+      cert.not_after = Time.now + 30 * 86400
+
+      extensions = OpenSSL::X509::ExtensionFactory.new
+      extensions.subject_certificate = cert
+      extensions.issuer_certificate = issuer || cert
+      if ca
+        cert.add_extension(extensions.create_extension('basicConstraints', 'CA:TRUE', true))
+        cert.add_extension(extensions.create_extension('keyUsage', 'keyCertSign,cRLSign', true))
+      else
+        cert.add_extension(extensions.create_extension('subjectAltName',
+                                                       "DNS:#{cn},IP:127.0.0.1"))
+      end
+      cert.sign(signing_key, OpenSSL::Digest.new('SHA256'))
+      cert
+    end
+
+    def self.write(dir, name, pem)
+      File.write(File.join(dir, name), pem.to_pem)
+    end
+  end
+
+  # Server side of a WebSocket connection (RFC 6455), enough for the
+  # PCP v2 text messages and the keepalive pings of pxp-agent
+  class WebSocket
+    GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+    attr_reader :path
+
+    def initialize(socket)
+      @socket = socket
+      @write_mutex = Mutex.new
+    end
+
+    # Read the HTTP upgrade request and accept it
+    def handshake
+      request = +''
+      request << @socket.readpartial(4096) until request.include?("\r\n\r\n")
+      @path = request[/\AGET (\S+) HTTP/, 1]
+      key = request[/^Sec-WebSocket-Key:\s*(\S+)/i, 1]
+      raise "invalid WebSocket upgrade request:\n#{request}" unless @path && key
+
+      accept = [Digest::SHA1.digest(key + GUID)].pack('m0')
+      @socket.write("HTTP/1.1 101 Switching Protocols\r\n" \
+                    "Upgrade: websocket\r\n" \
+                    "Connection: Upgrade\r\n" \
+                    "Sec-WebSocket-Accept: #{accept}\r\n\r\n")
+    end
+
+    # Return the next text or binary message; nil once closed
+    def read_message
+      message = nil
+      loop do
+        fin, opcode, payload = read_frame
+        case opcode
+        when 0x0
+          next unless message
+          message << payload
+        when 0x1, 0x2
+          message = payload
+        when 0x8
+          write_frame(0x8, payload[0, 2] || '')
+          return nil
+        when 0x9
+          write_frame(0xA, payload)
+          next
+        else
+          next
+        end
+        return message.force_encoding(Encoding::UTF_8) if fin
+      end
+    rescue EOFError, IOError, OpenSSL::SSL::SSLError, SystemCallError
+      nil
+    end
+
+    def write_message(text)
+      write_frame(0x1, text)
+    end
+
+    def close
+      write_frame(0x8, [1000].pack('n'))
+    rescue IOError, OpenSSL::SSL::SSLError, SystemCallError
+    ensure
+      @socket.close rescue nil
+    end
+
+    private
+
+    def read_frame
+      b0, b1 = read_bytes(2).unpack('CC')
+      length = b1 & 0x7f
+      length = read_bytes(2).unpack1('n') if length == 126
+      length = read_bytes(8).unpack1('Q>') if length == 127
+      mask = (b1 & 0x80) != 0 ? read_bytes(4) : nil
+      payload = length.zero? ? +'' : read_bytes(length)
+      payload = unmask(payload, mask) if mask
+      [(b0 & 0x80) != 0, b0 & 0x0f, payload]
+    end
+
+    # IO#read returns nil, or fewer bytes, once the peer closed the connection
+    def read_bytes(count)
+      data = @socket.read(count)
+      raise EOFError, 'the WebSocket connection was closed' unless data && data.bytesize == count
+
+      data
+    end
+
+    def unmask(payload, mask)
+      padding = (4 - payload.bytesize % 4) % 4
+      key = mask.unpack1('N')
+      words = (payload + "\0" * padding).unpack('N*').map! { |word| word ^ key }
+      words.pack('N*')[0, payload.bytesize]
+    end
+
+    def write_frame(opcode, payload)
+      payload = payload.b
+      header = [0x80 | opcode].pack('C')
+      header << if payload.bytesize < 126
+                  [payload.bytesize].pack('C')
+                elsif payload.bytesize < 65536
+                  [126, payload.bytesize].pack('Cn')
+                else
+                  [127, payload.bytesize].pack('CQ>')
+                end
+      @write_mutex.synchronize { @socket.write(header + payload) }
+    end
+  end
+
+  # Stand-in of the PCP broker, speaking PCP v2: messages are JSON text
+  # frames, clients are identified by the CN of their certificate and
+  # the last segment of the URI path (e.g. wss://localhost:8142/pcp2/agent
+  # for pcp://<cn>/agent), and messages are routed by their target,
+  # after setting their sender. Local endpoints, like the synthetic
+  # controller, get their messages through a callback.
+  class Broker
+    attr_reader :port, :num_undeliverable
+
+    def initialize(ssl_dir, port)
+      context = OpenSSL::SSL::SSLContext.new
+      context.cert = OpenSSL::X509::Certificate.new(File.read(File.join(ssl_dir, 'broker.pem')))
+      context.key = OpenSSL::PKey.read(File.read(File.join(ssl_dir, 'broker_key.pem')))
+      context.ca_file = File.join(ssl_dir, 'ca.pem')
+      context.verify_mode = OpenSSL::SSL::VERIFY_PEER | OpenSSL::SSL::VERIFY_FAIL_IF_NO_PEER_CERT
+
+      @tcp_server = TCPServer.new('127.0.0.1', port)
+      @port = @tcp_server.addr[1]
+      @ssl_server = OpenSSL::SSL::SSLServer.new(@tcp_server, context)
+      @ssl_server.start_immediately = false
+      @clients = {}
+      @endpoints = {}
+      @mutex = Mutex.new
+      @connected = ConditionVariable.new
+      @num_undeliverable = 0
+    end
+
+    def start
+      @accept_thread = Thread.new do
+        loop do
+          socket = begin
+                     @ssl_server.accept
+                   rescue IOError
+                     break
+                   end
+          Thread.new(socket) { |s| serve(s) }
+        end
+      end
+      self
+    end
+
+    def stop
+      @tcp_server.close rescue nil
+      @mutex.synchronize { @clients.values }.each(&:close)
+    end
+
+    # Register a local endpoint, called with each message sent to it
+    def attach(uri, &callback)
+      @mutex.synchronize { @endpoints[uri] = callback }
+    end
+
+    # Wait for the client with the specified URI; false on timeout
+    def wait_for_client(uri, timeout)
+      deadline = PXPLoad.now + timeout
+      @mutex.synchronize do
+        until @clients.key?(uri)
+          remaining = deadline - PXPLoad.now
+          return false if remaining <= 0
+          @connected.wait(@mutex, remaining)
+        end
+      end
+      true
+    end
+
+    # Route the message, as sent by the specified sender
+    def deliver(message, sender)
+      message['sender'] = sender
+      target = message['target']
+      client, endpoint = @mutex.synchronize { [@clients[target], @endpoints[target]] }
+
+      if client
+        client.write_message(message.to_json)
+      elsif endpoint
+        endpoint.call(message)
+      else
+        @mutex.synchronize { @num_undeliverable += 1 }
+      end
+    rescue IOError, OpenSSL::SSL::SSLError, SystemCallError
+      @mutex.synchronize { @num_undeliverable += 1 }
+    end
+
+    private
+
+    def serve(ssl_socket)
+      ssl_socket.accept
+      websocket = WebSocket.new(ssl_socket)
+      websocket.handshake
+      cn = ssl_socket.peer_cert.subject.to_a.find { |entry| entry[0] == 'CN' }[1]
+      client_type = websocket.path.split('/').reject(&:empty?).last || 'agent'
+      uri = "pcp://#{cn}/#{client_type}"
+
+      @mutex.synchronize do
+        @clients[uri]&.close
+        @clients[uri] = websocket
+        @connected.broadcast
+      end
+
+      while (text = websocket.read_message)
+        begin
+          deliver(JSON.parse(text), uri)
+        rescue JSON::ParserError
+          @mutex.synchronize { @num_undeliverable += 1 }
+        end
+      end
+
+      @mutex.synchronize { @clients.delete(uri) if @clients[uri] == websocket }
+      websocket.close
+    rescue StandardError => e
+      warn "broker: dropped a connection: #{e.class}: #{e.message}"
+      ssl_socket.close rescue nil
+    end
+  end
+
+  # Latencies, in seconds, and outcomes of the requests of one kind
+  class Stats
+    attr_reader :latencies, :num_errors, :num_timeouts
+
+    def initialize
+      @latencies = []
+      @num_errors = 0
+      @num_timeouts = 0
+    end
+
+    def record(outcome, latency)
+      case outcome
+      when :ok then @latencies << latency
+      when :error then @num_errors += 1
+      when :timeout then @num_timeouts += 1
+      end
+    end
+
+    def to_h(duration)
+      sorted = @latencies.sort
+      { 'completed' => sorted.size,
+        'errors' => @num_errors,
+        'timeouts' => @num_timeouts,
+        'throughput' => (sorted.size / duration).round(2),
+        'p50_ms' => percentile_ms(sorted, 0.5),
+        'p99_ms' => percentile_ms(sorted, 0.99),
+        'p999_ms' => percentile_ms(sorted, 0.999),
+        'max_ms' => percentile_ms(sorted, 1.0) }
+    end
+
+    private
+
+    # Nearest-rank percentile
+    def percentile_ms(sorted, quantile)
+      return nil if sorted.empty?
+      (sorted[[(quantile * sorted.size).ceil - 1, 0].max] * 1000).round(3)
+    end
+  end
+
+  # Synthetic controller: sends the requests to the agent through the
+  # broker and matches the responses by transaction ID. Blocking and
+  # status requests complete with their blocking response, non-blocking
+  # ones with their non-blocking response (notify_outcome is set); the
+  # latency of their provisional responses is reported separately.
+  class Controller
+    Pending = Struct.new(:kind, :request_id, :sent_at, :done)
+
+    MAX_QUERYABLE = 1000
+
+    def initialize(broker, agent_uri, options)
+      @broker = broker
+      @agent_uri = agent_uri
+      @options = options
+      @mutex = Mutex.new
+      @pending = {}
+      @transaction_ids = {}
+      @queryable = []
+      @stats = Hash[(KINDS + [:provisional]).map { |kind| [kind, Stats.new] }]
+      @num_completed = 0
+      broker.attach(CONTROLLER_URI) { |message| receive(message) }
+    end
+
+    # Forget the statistics collected so far
+    def reset_stats
+      @mutex.synchronize do
+        @stats = Hash[(KINDS + [:provisional]).map { |kind| [kind, Stats.new] }]
+        @num_completed = 0
+      end
+    end
+
+    def num_completed
+      @mutex.synchronize { @num_completed }
+    end
+
+    def num_outstanding
+      @mutex.synchronize { @pending.size }
+    end
+
+    def stats
+      @mutex.synchronize { @stats.dup }
+    end
+
+    # Send a request of the specified kind; return a queue that gets
+    # its outcome
+    def send_request(kind)
+      transaction_id = SecureRandom.uuid
+      message = { 'id' => SecureRandom.uuid,
+                  'message_type' => BLOCKING_REQUEST_TYPE,
+                  'target' => @agent_uri }
+
+      case kind
+      when :blocking
+        message['data'] = { 'transaction_id' => transaction_id,
+                            'module' => 'echo',
+                            'action' => 'echo',
+                            'params' => { 'argument' => 'x' * @options[:payload_bytes] } }
+      when :non_blocking
+        message['message_type'] = NON_BLOCKING_REQUEST_TYPE
+        message['data'] = { 'transaction_id' => transaction_id,
+                            'module' => 'load_test',
+                            'action' => 'sleep',
+                            'params' => { 'milliseconds' => @options[:task_ms] },
+                            'notify_outcome' => true }
+      when :status
+        queried = @mutex.synchronize { @queryable.sample } || SecureRandom.uuid
+        message['data'] = { 'transaction_id' => transaction_id,
+                            'module' => 'status',
+                            'action' => 'query',
+                            'params' => { 'transaction_id' => queried } }
+      end
+
+      done = Queue.new
+      @mutex.synchronize do
+        @pending[transaction_id] = Pending.new(kind, message['id'], PXPLoad.now, done)
+        @transaction_ids[message['id']] = transaction_id
+      end
+      @broker.deliver(message, CONTROLLER_URI)
+      [transaction_id, done]
+    end
+
+    # Count the request as timed out, unless it has completed
+    def expire(transaction_id)
+      complete(transaction_id, :timeout)
+    end
+
+    # Expire the requests sent more than the specified seconds ago
+    def expire_older_than(seconds)
+      sent_before = PXPLoad.now - seconds
+      stale = @mutex.synchronize do
+        @pending.select { |_, pending| pending.sent_at < sent_before }.keys
+      end
+      stale.each { |transaction_id| expire(transaction_id) }
+    end
+
+    private
+
+    def receive(message)
+      data = message['data'].is_a?(Hash) ? message['data'] : {}
+
+      case message['message_type']
+      when PROVISIONAL_RESPONSE_TYPE
+        @mutex.synchronize do
+          pending = @pending[data['transaction_id']]
+          @stats[:provisional].record(:ok, PXPLoad.now - pending.sent_at) if pending
+        end
+      when BLOCKING_RESPONSE_TYPE, NON_BLOCKING_RESPONSE_TYPE
+        complete(data['transaction_id'], :ok)
+      when PXP_ERROR_TYPE
+        complete(data['transaction_id'], :error)
+      when PCP_ERROR_TYPE
+        transaction_id = @mutex.synchronize { @transaction_ids[data['id']] }
+        complete(transaction_id, :error)
+      end
+    end
+
+    def complete(transaction_id, outcome)
+      @mutex.synchronize do
+        pending = @pending.delete(transaction_id)
+        return unless pending
+
+        @transaction_ids.delete(pending.request_id)
+        @stats[pending.kind].record(outcome, PXPLoad.now - pending.sent_at)
+        @num_completed += 1 if outcome == :ok
+        if pending.kind == :non_blocking && outcome == :ok
+          @queryable << transaction_id
+          @queryable.shift if @queryable.size > MAX_QUERYABLE
+        end
+        pending.done << outcome
+      end
+    end
+  end
+
+  # Samples the threads and RSS of a process, and the throughput of the
+  # controller, at a fixed interval
+  class Sampler
+    attr_reader :samples
+
+    def initialize(pid, controller, interval)
+      @pid = pid
+      @controller = controller
+      @interval = interval
+      @samples = []
+    end
+
+    def start
+      @started_at = PXPLoad.now
+      @thread = Thread.new do
+        last_completed = @controller.num_completed
+        loop do
+          sleep(@interval)
+          completed = @controller.num_completed
+          sample = { 't_s' => (PXPLoad.now - @started_at).round(1),
+                     'throughput' => ((completed - last_completed) / @interval).round(1),
+                     'outstanding' => @controller.num_outstanding }
+          sample.merge!(process_status)
+          last_completed = completed
+          @samples << sample
+          puts format('%6.1fs %8.1f req/s %6d outstanding %5s threads %8s MiB RSS',
+                      sample['t_s'], sample['throughput'], sample['outstanding'],
+                      sample['threads'], sample['rss_mib'])
+        end
+      end
+      self
+    end
+
+    def stop
+      @thread&.kill
+    end
+
+    private
+
+    def process_status
+      status = File.read("/proc/#{@pid}/status")
+      { 'threads' => status[/^Threads:\s+(\d+)/, 1].to_i,
+        'rss_mib' => (status[/^VmRSS:\s+(\d+)/, 1].to_i / 1024.0).round(1) }
+    rescue SystemCallError
+      { 'threads' => nil, 'rss_mib' => nil }
+    end
+  end
+
+  # Picks the kinds of requests according to their weights
+  class Mix
+    def initialize(spec)
+      @weights = {}
+      spec.split(',').each do |entry|
+        kind, weight = entry.split('=')
+        kind = kind.strip.to_sym
+        raise ArgumentError, "unknown request kind '#{kind}'" unless KINDS.include?(kind)
+        @weights[kind] = Float(weight)
+      end
+      @total = @weights.values.sum
+      raise ArgumentError, 'the request mix has no weight' unless @total > 0
+    end
+
+    def sample
+      point = rand * @total
+      @weights.each do |kind, weight|
+        return kind if point < weight
+        point -= weight
+      end
+      @weights.keys.last
+    end
+  end
+
+  class Runner
+    DEFAULTS = { port: 0,
+                 mix: 'blocking=50,non_blocking=30,status=20',
+                 concurrency: 8,
+                 rate: nil,
+                 duration: 60,
+                 warmup: 5,
+                 timeout: 60,
+                 task_ms: 100,
+                 payload_bytes: 64,
+                 sample_interval: 1.0,
+                 agent_args: [],
+                 json: nil,
+                 ssl_dir: nil,
+                 work_dir: nil }.freeze
+
+    def initialize(options)
+      @options = DEFAULTS.merge(options)
+      @mix = Mix.new(@options[:mix])
+    end
+
+    def run
+      @work_dir = @options[:work_dir] || Dir.mktmpdir('pxp-load-')
+      ssl_dir = @options[:ssl_dir]
+      unless ssl_dir
+        ssl_dir = File.join(@work_dir, 'ssl')
+        FileUtils.mkdir_p(ssl_dir)
+        Certs.generate(ssl_dir)
+      end
+
+      @broker = Broker.new(ssl_dir, @options[:port]).start
+      agent_uri = "pcp://#{AGENT_CN}/agent"
+      @agent_pid = spawn_agent(ssl_dir)
+      puts "Started pxp-agent (PID #{@agent_pid}); broker on port #{@broker.port}; " \
+           "working directory #{@work_dir}"
+
+      unless @broker.wait_for_client(agent_uri, 60)
+        raise "pxp-agent did not connect to the broker within 60 s; " \
+              "see #{File.join(@work_dir, 'pxp-agent.log')}"
+      end
+
+      @controller = Controller.new(@broker, agent_uri, @options)
+      warm_up
+      sampler = Sampler.new(@agent_pid, @controller, @options[:sample_interval]).start
+      duration = generate_load
+      sampler.stop
+
+      report(duration, sampler.samples)
+    ensure
+      stop_agent
+      @broker&.stop
+      FileUtils.rm_rf(@work_dir) if @work_dir && !@options[:work_dir]
+    end
+
+    private
+
+    def spawn_agent(ssl_dir)
+      config = { 'broker-ws-uri' => "wss://localhost:#{@broker.port}/pcp2/",
+                 'pcp-version' => '2',
+                 'ssl-ca-cert' => File.join(ssl_dir, 'ca.pem'),
+                 'ssl-cert' => File.join(ssl_dir, 'agent.pem'),
+                 'ssl-key' => File.join(ssl_dir, 'agent_key.pem'),
+                 'spool-dir' => File.join(@work_dir, 'spool'),
+                 'task-cache-dir' => File.join(@work_dir, 'tasks-cache'),
+                 'modules-dir' => File.join(__dir__, 'modules'),
+                 'modules-config-dir' => File.join(@work_dir, 'modules.d'),
+                 'logfile' => File.join(@work_dir, 'pxp-agent.log'),
+                 'loglevel' => 'info' }
+      config_file = File.join(@work_dir, 'pxp-agent.conf')
+      File.write(config_file, JSON.pretty_generate(config))
+
+      Process.spawn(@options[:pxp_agent], '--foreground', '--config-file', config_file,
+                    *@options[:agent_args],
+                    out: File.join(@work_dir, 'pxp-agent.out'), err: [:child, :out])
+    end
+
+    def stop_agent
+      return unless @agent_pid
+      Process.kill('TERM', @agent_pid)
+      Process.wait(@agent_pid)
+    rescue Errno::ESRCH, Errno::ECHILD
+    end
+
+    # A few requests of each kind, not reported, so that the modules
+    # and caches of the agent are loaded
+    def warm_up
+      deadline = PXPLoad.now + @options[:warmup]
+      KINDS.each do |kind|
+        break if PXPLoad.now > deadline
+        transaction_id, done = @controller.send_request(kind)
+        @controller.expire(transaction_id) unless done.pop(timeout: @options[:timeout])
+      end
+      @controller.reset_stats
+    end
+
+    # Return the time, in seconds, taken to send the requests and get
+    # their responses
+    def generate_load
+      started_at = PXPLoad.now
+      deadline = started_at + @options[:duration]
+      if @options[:rate]
+        open_loop(deadline)
+      else
+        Array.new(@options[:concurrency]) { Thread.new { closed_loop(deadline) } }
+             .each(&:join)
+      end
+      PXPLoad.now - started_at
+    end
+
+    # Each worker sends a request once the previous one completed
+    def closed_loop(deadline)
+      while PXPLoad.now < deadline
+        transaction_id, done = @controller.send_request(@mix.sample)
+        @controller.expire(transaction_id) unless done.pop(timeout: @options[:timeout])
+      end
+    end
+
+    # Requests are sent at a fixed rate, whatever the response times;
+    # then the outstanding ones are waited for, up to the timeout
+    def open_loop(deadline)
+      reaper = Thread.new do
+        loop do
+          sleep(0.5)
+          @controller.expire_older_than(@options[:timeout])
+        end
+      end
+
+      interval = 1.0 / @options[:rate]
+      next_at = PXPLoad.now
+      while next_at < deadline
+        sleep([next_at - PXPLoad.now, 0].max)
+        @controller.send_request(@mix.sample)
+        next_at += interval
+      end
+
+      sleep(0.1) while @controller.num_outstanding > 0
+      reaper.kill
+    end
+
+    def report(duration, samples)
+      stats = @controller.stats
+      results = { 'duration_s' => duration.round(3),
+                  'options' => @options.reject { |key, _| key == :agent_args }
+                                       .transform_keys(&:to_s),
+                  'requests' => stats.transform_keys(&:to_s)
+                                     .transform_values { |s| s.to_h(duration) },
+                  'undeliverable' => @broker.num_undeliverable,
+                  'samples' => samples }
+
+      total = KINDS.sum { |kind| stats[kind].latencies.size }
+      puts
+      puts format('%d requests in %.1f s: %.1f req/s', total, duration, total / duration)
+      puts format('%-14s %9s %7s %8s %10s %10s %10s %10s',
+                  'kind', 'completed', 'errors', 'timeouts', 'p50 ms', 'p99 ms', 'p999 ms', 'max ms')
+      results['requests'].each do |kind, row|
+        next if row['completed'].zero? && row['errors'].zero? && row['timeouts'].zero?
+        puts format('%-14s %9d %7d %8d %10s %10s %10s %10s', kind,
+                    row['completed'], row['errors'], row['timeouts'],
+                    row['p50_ms'], row['p99_ms'], row['p999_ms'], row['max_ms'])
+      end
+      threads = samples.map { |s| s['threads'] }.compact
+      rss = samples.map { |s| s['rss_mib'] }.compact
+      puts "pxp-agent threads: max #{threads.max}; RSS: max #{rss.max} MiB" unless threads.empty?
+
+      File.write(@options[:json], JSON.pretty_generate(results)) if @options[:json]
+      results
+    end
+  end
+
+  def self.parse_options(argv)
+    options = {}
+    parser = OptionParser.new do |opts|
+      opts.banner = 'Usage: pxp_load.rb --pxp-agent PATH [options]'
+      opts.on('--pxp-agent PATH', 'pxp-agent executable') { |v| options[:pxp_agent] = v }
+      opts.on('--mix SPEC', 'weights of the request kinds; default: ' \
+              "#{Runner::DEFAULTS[:mix]}") { |v| options[:mix] = v }
+      opts.on('--concurrency N', Integer, 'requests in flight, when no rate is ' \
+              "given; default: #{Runner::DEFAULTS[:concurrency]}") { |v| options[:concurrency] = v }
+      opts.on('--rate N', Float, 'requests per second, sent regardless of ' \
+              'the responses') { |v| options[:rate] = v }
+      opts.on('--duration S', Float, 'seconds of load; default: ' \
+              "#{Runner::DEFAULTS[:duration]}") { |v| options[:duration] = v }
+      opts.on('--timeout S', Float, 'seconds after which a request is counted as ' \
+              "timed out; default: #{Runner::DEFAULTS[:timeout]}") { |v| options[:timeout] = v }
+      opts.on('--task-ms N', Integer, 'run time of the non-blocking tasks; default: ' \
+              "#{Runner::DEFAULTS[:task_ms]}") { |v| options[:task_ms] = v }
+      opts.on('--payload-bytes N', Integer, 'size of the echo argument of blocking ' \
+              "requests; default: #{Runner::DEFAULTS[:payload_bytes]}") { |v| options[:payload_bytes] = v }
+      opts.on('--sample-interval S', Float, 'seconds between samples; default: ' \
+              "#{Runner::DEFAULTS[:sample_interval]}") { |v| options[:sample_interval] = v }
+      opts.on('--port N', Integer, 'broker port; default: any free port') { |v| options[:port] = v }
+      opts.on('--ssl-dir DIR', 'ca.pem, broker.pem, broker_key.pem, agent.pem and ' \
+              'agent_key.pem to use; default: generated') { |v| options[:ssl_dir] = v }
+      opts.on('--work-dir DIR', 'kept directory for the spool, the configuration ' \
+              'and the logs; default: a temporary one') { |v| options[:work_dir] = v }
+      opts.on('--agent-arg ARG', 'extra pxp-agent argument; repeatable') do |v|
+        (options[:agent_args] ||= []) << v
+      end
+      opts.on('--json FILE', 'write the results and samples to FILE') { |v| options[:json] = v }
+    end
+    parser.parse!(argv)
+    abort(parser.help) unless options[:pxp_agent]
+    options
+  end
+end
+
+if $PROGRAM_NAME == __FILE__
+  PXPLoad::Runner.new(PXPLoad.parse_options(ARGV)).run
+end
@@ -0,0 +1,18 @@
+# Run the pluginsync of the apply shim against the Puppet stand-in:
+#   ruby -I <this dir> pluginsync.rb <shim> <plugin cache> <server dir> <download log>
+shim_path, plugin_cache, server_dir, download_log = ARGV
+ENV['PXP_TEST_PLUGIN_SERVER'] = server_dir
+ENV['PXP_TEST_DOWNLOAD_LOG'] = download_log
+
+# Only define the functions of the shim, without running it
+shim = File.read(shim_path)
+eval(shim[0...shim.index("if ARGV[0] == '--worker'")], TOPLEVEL_BINDING, shim_path)
+
+Puppet[:pluginsource] = 'plugins'
+Puppet[:pluginfactsource] = 'pluginfacts'
+Puppet[:plugindest] = File.join(plugin_cache, 'plugins')
+Puppet[:pluginfactdest] = File.join(plugin_cache, 'pluginfacts')
+Puppet[:pluginsignore] = '.svn CVS .git'
+Puppet[:digest_algorithm] = 'sha256'
+
+pluginsync(plugin_cache, 'production')
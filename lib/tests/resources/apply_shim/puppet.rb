@@ -0,0 +1,90 @@
+# Minimal stand-in of Puppet for testing the pluginsync of the apply
+# shim; the "server" serves the files of the directory set in
+# PXP_TEST_PLUGIN_SERVER and the downloaders copy them, logging their
+# name in PXP_TEST_DOWNLOAD_LOG.
+require 'digest'
+require 'fileutils'
+
+module Puppet
+  @settings = {}
+
+  def self.[](setting)
+    @settings[setting]
+  end
+
+  def self.[]=(setting, value)
+    @settings[setting] = value
+  end
+
+  def self.debug(_message); end
+
+  module Util
+    module Platform
+      def self.windows?
+        false
+      end
+    end
+
+    module Checksums
+      def self.sha256_file(path)
+        Digest::SHA256.file(path).hexdigest
+      end
+
+      def self.sumdata(checksum)
+        checksum.sub(/\A\{\w+\}/, '')
+      end
+    end
+  end
+
+  module FileServing
+    class Metadata
+      Entry = Struct.new(:relative_path, :ftype, :mode, :checksum, :checksum_type)
+
+      class Indirection
+        def search(source, **_options)
+          raise 'metadata unavailable' if ENV['PXP_TEST_METADATA_FAILS']
+
+          root = File.join(ENV['PXP_TEST_PLUGIN_SERVER'], source)
+          return nil unless File.directory?(root)
+
+          Dir.chdir(root) { Dir.glob('**/*', File::FNM_DOTMATCH) }
+             .reject { |path| File.basename(path) == '.' || File.basename(path) == '..' }
+             .map { |path| entry(root, path) } << Entry.new('.', 'directory', 0o755, '', :ctime)
+        end
+
+        private
+
+        def entry(root, relative_path)
+          path = File.join(root, relative_path)
+          if File.directory?(path)
+            Entry.new(relative_path, 'directory', 0o755, "{ctime}#{File.ctime(path)}", :ctime)
+          else
+            Entry.new(relative_path, 'file', 0o644,
+                      "{sha256}#{Digest::SHA256.file(path).hexdigest}", :sha256)
+          end
+        end
+      end
+
+      def self.indirection
+        @indirection ||= Indirection.new
+      end
+    end
+  end
+
+  class Configurer
+    class Downloader
+      def initialize(name, destination, source, _ignore, _environment, _source_permissions = nil)
+        @name = name
+        @destination = destination
+        @source = source
+      end
+
+      def evaluate
+        File.open(ENV['PXP_TEST_DOWNLOAD_LOG'], 'a') { |log| log.puts(@name) }
+        root = File.join(ENV['PXP_TEST_PLUGIN_SERVER'], @source)
+        FileUtils.mkdir_p(@destination)
+        FileUtils.cp_r(File.join(root, '.'), @destination) if File.directory?(root)
+      end
+    end
+  end
+end
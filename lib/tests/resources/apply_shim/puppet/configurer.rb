@@ -0,0 +1,2 @@
+# Puppet::Configurer is defined by the puppet.rb stand-in
+require 'puppet'
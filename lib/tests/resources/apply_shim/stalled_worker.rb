@@ -0,0 +1,26 @@
+# Stand-in of the apply shim whose worker never completes a request; without
+# --worker, the request is processed at once.
+require 'socket'
+
+unless ARGV[0] == '--worker'
+  puts 'processed'
+  exit 0
+end
+
+STDIN.read
+server = UNIXServer.new(ARGV[1])
+loop do
+  client = server.accept
+  client.read
+  pid = fork do
+    Process.setpgid(0, 0)
+    server.close
+    client.write("#{Process.pid}\n")
+    client.flush
+    sleep 60
+    client.write("0 0 0\n")
+    exit!(0)
+  end
+  client.close
+  Process.wait(pid)
+end
@@ -8,8 +8,13 @@
 
 #include <catch.hpp>
 
+#include <cstdint>
 #include <vector>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 using namespace PXPAgent;
 
 namespace lth_jc = leatherman::json_container;
@@ -116,6 +121,44 @@ TEST_CASE("ActionRequest getters", "[request]") {
         SECTION("can call prettyLabel") {
             REQUIRE_NOTHROW(a_r.prettyLabel());
         }
+
+        SECTION("timeout is 0 if not specified") {
+            REQUIRE(a_r.timeout() == 0u);
+        }
+
+        SECTION("no result encodings are accepted if not specified") {
+            REQUIRE(a_r.resultEncodings().empty());
+            REQUIRE_FALSE(a_r.acceptsResultEncoding("gzip+base64"));
+        }
+    }
+
+    SECTION("get the result encodings") {
+        data.set<std::vector<std::string>>("result_encodings", { "gzip+base64" });
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+        REQUIRE(a_r.acceptsResultEncoding("gzip+base64"));
+        REQUIRE_FALSE(a_r.acceptsResultEncoding("zstd"));
+    }
+
+    SECTION("throw a ActionRequest::Error if the result encodings are not strings") {
+        data.set<std::vector<int>>("result_encodings", { 1 });
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
+                          ActionRequest::Error);
+    }
+
+    SECTION("get the timeout") {
+        data.set<int>("timeout", 30);
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+        REQUIRE(a_r.timeout() == 30u);
+    }
+
+    SECTION("throw a ActionRequest::Error if the timeout is negative") {
+        data.set<int>("timeout", -1);
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
+                          ActionRequest::Error);
     }
 }
 
@@ -137,3 +180,75 @@ TEST_CASE("ActionRequest results_dir setter / getter", "[request]") {
         REQUIRE(a_r.resultsDir() == results_dir);
     }
 }
+
+TEST_CASE("ActionRequest copies share the payload", "[request]") {
+    const std::string catalog(1024, 'x');
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { DATA_TXT };
+    lth_jc::JsonContainer params {};
+    params.set<std::string>("catalog", catalog);
+    data.set<lth_jc::JsonContainer>("params", params);
+    ActionRequest a_r { RequestType::NonBlocking,
+                        PCPClient::ParsedChunks { envelope, data, {}, 0 } };
+
+    SECTION("copying a request does not copy its chunks and params") {
+        ActionRequest copy { a_r };
+        auto moved = std::move(copy);
+
+        REQUIRE(&moved.params() == &a_r.params());
+        REQUIRE(&moved.parsedChunks() == &a_r.parsedChunks());
+        REQUIRE(moved.params().get<std::string>("catalog") == catalog);
+    }
+
+    SECTION("the params are serialized once for all copies") {
+        const ActionRequest copy { a_r };
+        const auto& params_txt = copy.paramsTxt();
+        const auto& same_params_txt = a_r.paramsTxt();
+        REQUIRE(&same_params_txt == &params_txt);
+        REQUIRE(params_txt == a_r.params().toString());
+    }
+
+    SECTION("copies have their own results directory") {
+        const ActionRequest copy { a_r };
+        copy.setResultsDir("/tmp/beans");
+        REQUIRE(a_r.resultsDir().empty());
+    }
+}
+
+#ifdef __GLIBC__
+// The bytes allocated by malloc, which backs operator new, and not yet
+// freed; read from the allocator, without replacing operator new
+static int64_t mallocInUse()
+{
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    auto info = mallinfo2();
+#else
+    auto info = mallinfo();
+#endif
+    return static_cast<int64_t>(info.uordblks) + static_cast<int64_t>(info.hblkhd);
+}
+
+TEST_CASE("ActionRequest copies allocate a bounded amount", "[request]") {
+    const size_t PAYLOAD_SIZE { 4 * 1024 * 1024 };
+    const size_t NUM_COPIES { 16 };
+    lth_jc::JsonContainer data { DATA_TXT };
+    lth_jc::JsonContainer params {};
+    params.set<std::string>("catalog", std::string(PAYLOAD_SIZE, 'x'));
+    data.set<lth_jc::JsonContainer>("params", params);
+    ActionRequest a_r { RequestType::NonBlocking,
+                        PCPClient::ParsedChunks { lth_jc::JsonContainer { ENVELOPE_TXT },
+                                                  data, {}, 0 } };
+    a_r.paramsTxt();
+
+    SECTION("copies of a large request allocate less than its payload altogether") {
+        std::vector<ActionRequest> copies {};
+        copies.reserve(NUM_COPIES);
+        auto before = mallocInUse();
+        for (size_t idx = 0; idx < NUM_COPIES; idx++) {
+            copies.push_back(a_r);
+            copies.back().paramsTxt();
+        }
+        REQUIRE(mallocInUse() - before < static_cast<int64_t>(PAYLOAD_SIZE));
+    }
+}
+#endif
@@ -1,6 +1,7 @@
 #include "../common/content_format.hpp"
 
 #include <pxp-agent/action_response.hpp>
+#include <pxp-agent/util/compression.hpp>
 
 #include <cpp-pcp-client/protocol/chunks.hpp>
 
@@ -38,6 +39,11 @@ TEST_CASE("ActionResponse::ActionResponse", "[response]") {
         REQUIRE_NOTHROW(ActionResponse(ModuleType::External, RequestType::NonBlocking, {}, std::move(metadata)));
     }
 
+    SECTION("does not store the request params in the metadata") {
+        auto metadata = ActionResponse::getMetadataFromRequest(req);
+        REQUIRE(metadata.get<std::string>("request_params") == "{}");
+    }
+
     SECTION("throw a ActionResponse::Error if invalid metadata") {
         REQUIRE_THROWS_AS(ActionResponse(ModuleType::External, RequestType::NonBlocking, {}, {}),
                           ActionResponse::Error);
@@ -98,4 +104,168 @@ TEST_CASE("ActionResponse::toJSON", "[response]") {
         REQUIRE(resp.toJSON(R_T::StatusOutput).toString() ==
                 "{\"transaction_id\":\"04352987\",\"results\":{\"transaction_id\":\"\",\"exitcode\":0,\"status\":\"failure\",\"stdout\":\"{\\\"_error\\\":{\\\"kind\\\":\\\"puppetlabs.pxp-agent/execution-error\\\",\\\"details\\\":{},\\\"msg\\\":\\\"other\\\"}}\"}}");
     }
+
+    SECTION("serializes the resource usage if present in a status response") {
+        auto output = ActionOutput{0, "", ""};
+        auto metadata = ActionResponse::getMetadataFromRequest(req);
+        auto resp = ActionResponse(ModuleType::External, RequestType::Blocking, output, std::move(metadata));
+
+        auto results = lth_jc::JsonContainer{"{\"transaction_id\":\"123456\",\"status\":\"success\",\"resource_usage\":{\"cpu_time_ms\":10}}"};
+        resp.setValidResultsAndEnd(std::move(results), "");
+
+        REQUIRE(resp.toJSON(R_T::StatusOutput).toString() ==
+                "{\"transaction_id\":\"04352987\",\"results\":{\"transaction_id\":\"\",\"exitcode\":0,\"status\":\"success\",\"resource_usage\":{\"cpu_time_ms\":10}}}");
+    }
+
+    SECTION("reports a timed out action as failed in a status response") {
+        auto output = ActionOutput{143, "", ""};
+        auto metadata = ActionResponse::getMetadataFromRequest(req);
+        auto resp = ActionResponse(ModuleType::External, RequestType::Blocking, output, std::move(metadata));
+
+        auto results = lth_jc::JsonContainer{"{\"transaction_id\":\"123456\",\"status\":\"timed_out\"}"};
+        resp.setValidResultsAndEnd(std::move(results), "");
+
+        REQUIRE(resp.toJSON(R_T::StatusOutput).toString() ==
+                "{\"transaction_id\":\"04352987\",\"results\":{\"transaction_id\":\"\",\"exitcode\":143,\"status\":\"failure\"}}");
+    }
+}
+
+TEST_CASE("ActionResponse::toJSONString", "[response]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { DATA_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+    auto req = ActionRequest(RequestType::Blocking, p_c);
+
+    SECTION("matches toJSON for blocking and nonblocking responses") {
+        auto results = lth_jc::JsonContainer{
+            "{\"stdout\":\"line \\\"1\\\"\\n\\tline 2\\u0001\",\"exitcode\":1,"
+            "\"nested\":{\"a\":[1,\"b\",null]},\"empty\":\"\"}"};
+        auto resp = ActionResponse(ModuleType::Internal, req);
+        resp.setValidResultsAndEnd(std::move(results));
+        REQUIRE(resp.toJSONString(R_T::Blocking) == resp.toJSON(R_T::Blocking).toString());
+        REQUIRE(resp.toJSONString(R_T::NonBlocking) == resp.toJSON(R_T::NonBlocking).toString());
+    }
+
+    SECTION("matches toJSON once the results are replaced in the metadata") {
+        auto resp = ActionResponse(ModuleType::Internal, req);
+        resp.setValidResultsAndEnd(lth_jc::JsonContainer{ "{\"stdout\":\"out\",\"exitcode\":0}" });
+        resp.action_metadata.set<lth_jc::JsonContainer>("results",
+            lth_jc::JsonContainer{ "{\"stdout\":\"other\",\"stderr\":\"err\"}" });
+        REQUIRE(resp.toJSONString(R_T::Blocking) == resp.toJSON(R_T::Blocking).toString());
+    }
+
+    SECTION("matches toJSON for empty results") {
+        auto resp = ActionResponse(ModuleType::Internal, req);
+        resp.setValidResultsAndEnd(lth_jc::JsonContainer{});
+        REQUIRE(resp.toJSONString(R_T::Blocking) == resp.toJSON(R_T::Blocking).toString());
+    }
+
+    SECTION("matches toJSON for an rpc error") {
+        auto resp = ActionResponse(ModuleType::External, req);
+        resp.setBadResultsAndEnd("some \"failure\"");
+        REQUIRE(resp.toJSONString(R_T::RPCError) == resp.toJSON(R_T::RPCError).toString());
+    }
+
+    SECTION("matches toJSON for a status response with output") {
+        auto output = ActionOutput{1, "{\"foo\": true}\n", "warning:\t\\ oops\r\n"};
+        auto metadata = ActionResponse::getMetadataFromRequest(req);
+        auto resp = ActionResponse(ModuleType::External, RequestType::Blocking, output, std::move(metadata));
+        resp.status_query_transaction = "7890";
+
+        auto results = lth_jc::JsonContainer{"{\"transaction_id\":\"123456\",\"status\":\"success\",\"resource_usage\":{\"cpu_time_ms\":10}}"};
+        resp.setValidResultsAndEnd(std::move(results), "");
+
+        REQUIRE(resp.toJSONString(R_T::StatusOutput) == resp.toJSON(R_T::StatusOutput).toString());
+    }
+
+    SECTION("matches toJSON for a status response with an execution error") {
+        auto output = ActionOutput{0, "{\"foo\": true}", "some error"};
+        auto metadata = ActionResponse::getMetadataFromRequest(req);
+        auto resp = ActionResponse(ModuleType::External, RequestType::Blocking, output, std::move(metadata));
+
+        auto results = lth_jc::JsonContainer{"{\"transaction_id\":\"123456\",\"status\":\"failure\"}"};
+        resp.setValidResultsAndEnd(std::move(results), "other");
+
+        REQUIRE(resp.toJSONString(R_T::StatusOutput) == resp.toJSON(R_T::StatusOutput).toString());
+    }
+}
+
+TEST_CASE("ActionResponse::toJSONString with a maximum size", "[response]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { DATA_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+    auto req = ActionRequest(RequestType::Blocking, p_c);
+
+    auto output = ActionOutput{0, std::string(4096, 'x'), "some error"};
+    auto metadata = ActionResponse::getMetadataFromRequest(req);
+    auto resp = ActionResponse(ModuleType::External, RequestType::Blocking, output, std::move(metadata));
+    auto results = lth_jc::JsonContainer{"{\"transaction_id\":\"123456\",\"status\":\"success\"}"};
+    resp.setValidResultsAndEnd(std::move(results), "");
+    auto full_text = resp.toJSONString(R_T::StatusOutput);
+
+    SECTION("serializes the whole response if it fits") {
+        std::string json_text {};
+        REQUIRE(resp.toJSONString(R_T::StatusOutput, full_text.size(), json_text)
+                == full_text.size());
+        REQUIRE(json_text == full_text);
+    }
+
+    SECTION("stops with a lower bound of the size if it doesn't fit") {
+        std::string json_text {};
+        auto size = resp.toJSONString(R_T::StatusOutput, 1024, json_text);
+        REQUIRE(size > 1024);
+        REQUIRE(size <= full_text.size());
+        // The output that can't fit is not serialized
+        REQUIRE(json_text.size() < 1024);
+    }
+
+    SECTION("reports a response exceeding the limit by one byte") {
+        std::string json_text {};
+        REQUIRE(resp.toJSONString(R_T::StatusOutput, full_text.size() - 1, json_text)
+                > full_text.size() - 1);
+    }
+}
+
+TEST_CASE("ActionResponse::toCompressedJSONString", "[response]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { DATA_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+    auto req = ActionRequest(RequestType::Blocking, p_c);
+
+    std::string stdout_text {};
+    while (stdout_text.size() < 256 * 1024)
+        stdout_text += "Notice: /Stage[main]/Main/File[/tmp/foo]/ensure: created\n";
+    lth_jc::JsonContainer results {};
+    results.set<std::string>("stdout", stdout_text);
+    results.set<int>("exitcode", 0);
+    auto resp = ActionResponse(ModuleType::Internal, req);
+    resp.setValidResultsAndEnd(std::move(results));
+
+    SECTION("compresses the results, which can be restored") {
+        std::string json_text {};
+        auto size = resp.toCompressedJSONString(R_T::Blocking, 64 * 1024, json_text);
+        REQUIRE(size == json_text.size());
+        REQUIRE(size < 64 * 1024);
+
+        lth_jc::JsonContainer compressed { json_text };
+        REQUIRE(compressed.get<std::string>("transaction_id") == "04352987");
+        REQUIRE(compressed.get<std::string>({ "results", "content_encoding" })
+                == "gzip+base64");
+
+        auto results_text = Util::gzipDecompress(Util::base64Decode(
+            compressed.get<std::string>({ "results", "content" })));
+        REQUIRE(results_text == resp.toJSON(R_T::Blocking)
+                                    .get<lth_jc::JsonContainer>("results").toString());
+    }
+
+    SECTION("reports compressed responses larger than the maximum size") {
+        std::string json_text {};
+        REQUIRE(resp.toCompressedJSONString(R_T::Blocking, 16, json_text) > 16);
+    }
 }
@@ -409,6 +409,18 @@ TEST_CASE("Configuration::validate", "[configuration]") {
         REQUIRE_THROWS_AS(Configuration::Instance().validate(),
                           Configuration::Error);
     }
+
+    SECTION("it fails when --apply-worker-pool-size is negative") {
+        HW::SetFlag<int>("apply-worker-pool-size", -1);
+        REQUIRE_THROWS_AS(Configuration::Instance().validate(),
+                          Configuration::Error);
+    }
+
+    SECTION("it fails when --apply-fact-cache-ttl as not a valid timestamp") {
+        HW::SetFlag<std::string>("apply-fact-cache-ttl", "1.0");
+        REQUIRE_THROWS_AS(Configuration::Instance().validate(),
+                          Configuration::Error);
+    }
 }
 
 TEST_CASE("Configuration::validate with unknown config options", "[configuration]") {
@@ -0,0 +1,96 @@
+#include <pxp-agent/metadata_record.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+using namespace PXPAgent;
+
+namespace lth_jc = leatherman::json_container;
+
+static lth_jc::JsonContainer someMetadata() {
+    lth_jc::JsonContainer metadata {};
+    metadata.set<std::string>("requester", "pcp://client01.example.com/test");
+    metadata.set<std::string>("module", "task");
+    metadata.set<std::string>("action", "run");
+    metadata.set<std::string>("request_params", "{}");
+    metadata.set<std::string>("transaction_id", "0632");
+    metadata.set<std::string>("request_id", "0563");
+    metadata.set<bool>("notify_outcome", false);
+    metadata.set<std::string>("start", "2016-01-11T10:09:18.283484Z");
+    metadata.set<std::string>("status", "success");
+    metadata.set<std::string>("end", "2016-01-11T10:09:28.1234Z");
+    metadata.set<bool>("results_are_valid", true);
+    metadata.set<lth_jc::JsonContainer>(
+        "results", lth_jc::JsonContainer { "{\"stdout\":\"a \\\"b\\\"\\n\",\"exitcode\":0}" });
+    return metadata;
+}
+
+TEST_CASE("MetadataRecord::encode", "[metadata]") {
+    SECTION("starts with the record magic") {
+        auto record = MetadataRecord::encode(someMetadata());
+
+        REQUIRE(MetadataRecord::isRecord(record));
+    }
+
+    SECTION("JSON metadata is not a record") {
+        REQUIRE_FALSE(MetadataRecord::isRecord(someMetadata().toString()));
+        REQUIRE_FALSE(MetadataRecord::isRecord(""));
+    }
+}
+
+TEST_CASE("MetadataRecord::decode", "[metadata]") {
+    SECTION("returns the encoded metadata, in the same order") {
+        auto metadata = someMetadata();
+        auto decoded = MetadataRecord::decode(MetadataRecord::encode(metadata));
+
+        REQUIRE(decoded.toString() == metadata.toString());
+    }
+
+    SECTION("decodes values of any JSON type") {
+        lth_jc::JsonContainer metadata {};
+        metadata.set<int>("int", -3);
+        metadata.set<double>("double", 2.5);
+        metadata.set<std::vector<std::string>>("array", { "a", "b" });
+        metadata.set<lth_jc::JsonContainer>("object", lth_jc::JsonContainer {});
+        auto decoded = MetadataRecord::decode(MetadataRecord::encode(metadata));
+
+        REQUIRE(decoded.toString() == metadata.toString());
+    }
+
+    SECTION("throws an Error if the record is truncated") {
+        auto record = MetadataRecord::encode(someMetadata());
+        record.resize(record.size() - 1);
+
+        REQUIRE_THROWS_AS(MetadataRecord::decode(record), MetadataRecord::Error);
+    }
+
+    SECTION("throws an Error if the version is not supported") {
+        auto record = MetadataRecord::encode(someMetadata());
+        record[4] = static_cast<char>(MetadataRecord::VERSION + 1);
+
+        REQUIRE_THROWS_AS(MetadataRecord::decode(record), MetadataRecord::Error);
+    }
+}
+
+TEST_CASE("MetadataRecord::decodeSummary", "[metadata]") {
+    auto metadata = someMetadata();
+    auto record = MetadataRecord::encode(metadata);
+
+    SECTION("returns the status and start time") {
+        auto summary = MetadataRecord::decodeSummary(
+            record.substr(0, MetadataRecord::SUMMARY_SIZE));
+
+        REQUIRE(summary.status == "success");
+        REQUIRE(summary.start == "2016-01-11T10:09:18.283484Z");
+    }
+
+    SECTION("returns an empty status if unknown") {
+        metadata.set<std::string>("status", "paused");
+        auto summary = MetadataRecord::decodeSummary(MetadataRecord::encode(metadata));
+
+        REQUIRE(summary.status.empty());
+    }
+}
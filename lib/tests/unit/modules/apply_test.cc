@@ -3,10 +3,13 @@
 
 #include <pxp-agent/modules/apply.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/util/action_cgroups.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
 #include <pxp-agent/util/process.hpp>
 
 #include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
 
+#include <leatherman/execution/execution.hpp>
 #include <leatherman/json_container/json_container.hpp>
 #include <leatherman/util/scope_exit.hpp>
 #include <leatherman/file_util/file.hpp>
@@ -19,6 +22,8 @@
 
 #include <catch.hpp>
 
+#include <chrono>
+#include <map>
 #include <string>
 #include <vector>
 #include <unistd.h>
@@ -27,6 +32,7 @@ using namespace PXPAgent;
 
 namespace fs = boost::filesystem;
 namespace pt = boost::posix_time;
+namespace lth_exec = leatherman::execution;
 namespace lth_jc = leatherman::json_container;
 namespace lth_util = leatherman::util;
 namespace lth_file = leatherman::file_util;
@@ -64,12 +70,12 @@ static const std::string DATA_TXT {
 
 TEST_CASE("Modules::Apply", "[modules]") {
     SECTION("can successfully instantiate") {
-        REQUIRE_NOTHROW(Modules::Apply(PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", MODULE_CACHE_DIR, STORAGE));
+        REQUIRE_NOTHROW(Modules::Apply(PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "0m", MODULE_CACHE_DIR, STORAGE));
     }
 }
 
 TEST_CASE("Modules::Apply::hasAction", "[modules]") {
-    Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", MODULE_CACHE_DIR, STORAGE };
+    Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "0m", MODULE_CACHE_DIR, STORAGE };
     SECTION("correctly reports false") {
         REQUIRE(!mod.hasAction("foo"));
     }
@@ -95,7 +101,7 @@ TEST_CASE("Modules::Apply::purge purges old cached files", "[modules]") {
     static const auto PURGE_MODULE_CACHE_DIR = std::make_shared<ModuleCacheDir>(PURGE_CACHE, CACHE_TTL);
 
     // Start with 0 TTL to prevent initial cleanup
-    Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", PURGE_MODULE_CACHE_DIR, STORAGE };
+    Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "0m", PURGE_MODULE_CACHE_DIR, STORAGE };
 
     unsigned int num_purged_results { 0 };
     auto purgeCallback =
@@ -125,8 +131,303 @@ TEST_CASE("Modules::buildCommandObject", "[modules]") {
         std::vector<lth_jc::JsonContainer> debug {};
         const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
 
-        Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, "", "", MODULE_CACHE_DIR, STORAGE };
+        Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, "", "", 0, "0m", MODULE_CACHE_DIR, STORAGE };
 
         REQUIRE_THROWS_AS(mod.buildCommandObject(ActionRequest(RequestType::Blocking, p_c)), Configuration::Error);
     }
 }
+
+TEST_CASE("Util::ApplyWorkerPool::run", "[modules]") {
+    const Util::CommandObject shim_command { "false", {}, {}, "", nullptr };
+    ActionOutput output { 0, "", "" };
+
+    SECTION("does not process requests when disabled") {
+        Util::ApplyWorkerPool pool { 0, TEMP_CACHE_DIR, 60 };
+
+        REQUIRE_FALSE(pool.enabled());
+        REQUIRE_FALSE(pool.run("production", shim_command, "{}", "{}", output));
+    }
+
+#ifndef _WIN32
+    SECTION("does not process requests before a worker is ready") {
+        lth_util::scope_exit remove_temp_dir { [] { fs::remove_all(TEMP_CACHE_DIR); } };
+        Util::ApplyWorkerPool pool { 1, TEMP_CACHE_DIR, 60 };
+
+        REQUIRE(pool.enabled());
+        // The first request starts a worker in the background
+        REQUIRE_FALSE(pool.run("production", shim_command, "{}", "{}", output));
+        REQUIRE_FALSE(pool.run("production", shim_command, "{}", "{}", output));
+    }
+
+    SECTION("stops the workers and waits for them when destroyed") {
+        lth_util::scope_exit remove_temp_dir { [] { fs::remove_all(TEMP_CACHE_DIR); } };
+        // The worker arguments are passed to sh as positional ones
+        const Util::CommandObject slow_command { "sh", { "-c", "sleep 30", "sh" }, {}, "", nullptr };
+        auto start = std::chrono::steady_clock::now();
+        {
+            Util::ApplyWorkerPool pool { 1, TEMP_CACHE_DIR, 60 };
+            REQUIRE_FALSE(pool.run("production", slow_command, "{}", "{}", output));
+            // Let the worker process start
+            usleep(100 * 1000);
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+    }
+#endif
+}
+
+#ifndef _WIN32
+// Exposes the execution of a command for a request
+class TestApply : public Modules::Apply {
+  public:
+    using Modules::Apply::Apply;
+    using Modules::Apply::callBlockingAction;
+};
+
+static ActionRequest apply_request(const std::string& action,
+                                   const std::string& params_txt) {
+    std::string prep_txt {
+        (DATA_FORMAT % "\"04352987\""
+                     % "\"apply\""
+                     % ("\"" + action + "\"")
+                     % params_txt).str() };
+    PCPClient::ParsedChunks prep_content {
+        lth_jc::JsonContainer(ENVELOPE_TXT),
+        lth_jc::JsonContainer(prep_txt),
+        {},
+        0 };
+    return ActionRequest { RequestType::Blocking, prep_content };
+}
+
+static const std::string APPLY_PARAMS_TXT {
+    "{ \"catalog\" : { \"environment\" : \"production\" }, \"apply_options\" : {} }" };
+
+static ActionRequest prep_request(const std::string& params_txt) {
+    return apply_request("prep", params_txt);
+}
+
+// The digest of the plugins served by the "server"
+static const std::string SERVER_DIGEST_PATH { TEMP_CACHE_DIR + "/server_digest" };
+
+// Mimics the shim: the pluginsync action prints the digest served by the
+// server, while a prep syncs the manifest of the plugin cache and prints
+// the facts
+static std::string prep_facts(TestApply& mod,
+                              const ActionRequest& request,
+                              const std::string& facts,
+                              const std::string& environment = "production") {
+    static const std::string SHIM {
+        "input=$(cat)\n"
+        "case \"$input\" in\n"
+        "  *'\"action\":\"pluginsync\"'*) cat \"$1\" ;;\n"
+        "  *) printf '{\"digest\":\"%s\"}' \"$(cat \"$1\")\" > \"$2\"; echo \"$0\" ;;\n"
+        "esac\n" };
+    const auto manifest_path = fs::path(TEMP_CACHE_DIR) / environment
+                               / ".pluginsync_manifest.json";
+    const Util::CommandObject command {
+        "sh", { "-c", SHIM, facts, SERVER_DIGEST_PATH, manifest_path.string() },
+        {}, request.paramsTxt(), nullptr };
+    ActionResponse response { ModuleType::Internal, request };
+    mod.callBlockingAction(request, command, response);
+    return boost::algorithm::trim_copy(response.output.std_out);
+}
+
+TEST_CASE("Modules::Apply fact cache", "[modules]") {
+    lth_util::scope_exit remove_temp_dir { [] { fs::remove_all(TEMP_CACHE_DIR); } };
+    auto temp_cache_dir = std::make_shared<ModuleCacheDir>(TEMP_CACHE_DIR, CACHE_TTL);
+    temp_cache_dir->createCacheDir("production");
+    lth_file::atomic_write_to_file("1", SERVER_DIGEST_PATH);
+
+    const auto request = prep_request("{ \"environment\" : \"production\" }");
+
+    SECTION("does not cache facts when disabled") {
+        TestApply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "0m", temp_cache_dir, STORAGE };
+
+        REQUIRE(prep_facts(mod, request, "{\"a\":1}") == "{\"a\":1}");
+        REQUIRE(prep_facts(mod, request, "{\"a\":2}") == "{\"a\":2}");
+    }
+
+    TestApply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "10m", temp_cache_dir, STORAGE };
+    REQUIRE(prep_facts(mod, request, "{\"a\":1}") == "{\"a\":1}");
+
+    SECTION("returns the cached facts") {
+        REQUIRE(prep_facts(mod, request, "{\"a\":2}") == "{\"a\":1}");
+    }
+
+    SECTION("does not cache facts of other environments") {
+        temp_cache_dir->createCacheDir("other");
+        const auto other_request = prep_request("{ \"environment\" : \"other\" }");
+        REQUIRE(prep_facts(mod, other_request, "{\"a\":2}", "other") == "{\"a\":2}");
+    }
+
+    SECTION("resolves facts again once the server serves other plugins") {
+        lth_file::atomic_write_to_file("2", SERVER_DIGEST_PATH);
+        REQUIRE(prep_facts(mod, request, "{\"a\":2}") == "{\"a\":2}");
+        REQUIRE(prep_facts(mod, request, "{\"a\":3}") == "{\"a\":2}");
+    }
+
+    SECTION("does not use the cached facts if the plugins can't be synced") {
+        fs::remove(SERVER_DIGEST_PATH);
+        REQUIRE(prep_facts(mod, request, "{\"a\":2}") == "{\"a\":2}");
+    }
+
+    SECTION("resolves facts of all environments again after an apply") {
+        temp_cache_dir->createCacheDir("other");
+        const auto other_request = prep_request("{ \"environment\" : \"other\" }");
+        REQUIRE(prep_facts(mod, other_request, "{\"b\":1}", "other") == "{\"b\":1}");
+
+        prep_facts(mod, apply_request("apply", APPLY_PARAMS_TXT), "");
+        REQUIRE(prep_facts(mod, request, "{\"a\":2}") == "{\"a\":2}");
+        REQUIRE(prep_facts(mod, other_request, "{\"b\":2}", "other") == "{\"b\":2}");
+    }
+
+    SECTION("resolves facts again when requested") {
+        const auto refresh_request =
+            prep_request("{ \"environment\" : \"production\", \"refresh_facts\" : true }");
+        REQUIRE(prep_facts(mod, refresh_request, "{\"a\":2}") == "{\"a\":2}");
+        REQUIRE(prep_facts(mod, request, "{\"a\":3}") == "{\"a\":2}");
+    }
+}
+
+TEST_CASE("Modules::Apply deadlines", "[modules]") {
+    lth_util::scope_exit cleaner { [] {
+        Util::ActionDeadlines::Instance().reset();
+        fs::remove_all(TEMP_CACHE_DIR);
+    } };
+    auto temp_cache_dir = std::make_shared<ModuleCacheDir>(TEMP_CACHE_DIR, CACHE_TTL);
+    Util::ActionDeadlines::Instance().setModuleTimeout("apply", 1);
+
+    const auto stalled_worker = std::string { PXP_AGENT_ROOT_PATH }
+                                + "/lib/tests/resources/apply_shim/stalled_worker.rb";
+    const Util::CommandObject command { "ruby", { stalled_worker }, {}, "", nullptr };
+    const auto request = apply_request("apply", APPLY_PARAMS_TXT);
+
+    SECTION("terminates the requests processed by a worker once they time out") {
+        TestApply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 1, "0m", temp_cache_dir, STORAGE };
+
+        // Requests are processed directly until the worker is ready
+        ActionResponse response { ModuleType::Internal, request };
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            response = ActionResponse { ModuleType::Internal, request };
+            mod.callBlockingAction(request, command, response);
+            if (response.output.std_out.find("processed") == std::string::npos)
+                break;
+            usleep(100 * 1000);
+        }
+
+        REQUIRE(response.action_metadata.get<std::string>("status")
+                == ACTION_STATUS_NAMES.at(ActionStatus::TimedOut));
+        REQUIRE_FALSE(response.action_metadata.get<bool>("results_are_valid"));
+    }
+}
+
+#ifdef __linux__
+TEST_CASE("Modules::Apply workers and cgroups", "[modules]") {
+    // A regular directory that mimics the cgroup v2 interface
+    const auto cgroup_parent = fs::path(TEMP_CACHE_DIR) / "cgroups";
+    lth_util::scope_exit cleaner { [] {
+        Util::ActionCGroups::Instance().reset();
+        fs::remove_all(TEMP_CACHE_DIR);
+    } };
+    fs::create_directories(cgroup_parent);
+    lth_file::atomic_write_to_file("cpu memory io\n",
+                                   (cgroup_parent / "cgroup.controllers").string());
+    Util::ActionCGroups::Instance().configure(cgroup_parent.string());
+
+    auto temp_cache_dir = std::make_shared<ModuleCacheDir>(TEMP_CACHE_DIR, CACHE_TTL);
+    const auto stalled_worker = std::string { PXP_AGENT_ROOT_PATH }
+                                + "/lib/tests/resources/apply_shim/stalled_worker.rb";
+    const Util::CommandObject command { "ruby", { stalled_worker }, {}, "", nullptr };
+
+    SECTION("does not process requests on workers when actions have their own cgroup") {
+        TestApply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 1, "0m", temp_cache_dir, STORAGE };
+
+        for (int idx = 0; idx < 5; idx++) {
+            const auto request = apply_request("apply", APPLY_PARAMS_TXT);
+            ActionResponse response { ModuleType::Internal, request };
+            mod.callBlockingAction(request, command, response);
+            REQUIRE(boost::algorithm::trim_copy(response.output.std_out) == "processed");
+            usleep(100 * 1000);
+        }
+        REQUIRE_FALSE(fs::exists(fs::path(TEMP_CACHE_DIR) / "apply_workers"));
+    }
+}
+#endif
+
+// Runs the pluginsync of the shim written by buildCommandObject with a
+// stand-in of Puppet; return the names of the downloaders that ran
+static std::string pluginsync(const fs::path& shim_path,
+                              const fs::path& plugin_cache,
+                              const fs::path& server_dir,
+                              bool metadata_fails = false) {
+    const auto stubs_dir = std::string { PXP_AGENT_ROOT_PATH }
+                           + "/lib/tests/resources/apply_shim";
+    const auto download_log = (fs::path(TEMP_CACHE_DIR) / "downloads.log").string();
+    fs::remove(download_log);
+
+    std::map<std::string, std::string> environment {};
+    if (metadata_fails)
+        environment["PXP_TEST_METADATA_FAILS"] = "1";
+
+    auto exec = lth_exec::execute(
+        "ruby",
+        { "-I", stubs_dir, stubs_dir + "/pluginsync.rb", shim_path.string(),
+          plugin_cache.string(), server_dir.string(), download_log },
+        "", environment, nullptr, 0,
+        { lth_exec::execution_options::thread_safe,
+          lth_exec::execution_options::merge_environment });
+    REQUIRE(exec.exit_code == 0);
+
+    std::string downloads {};
+    lth_file::read(download_log, downloads);
+    boost::algorithm::trim(downloads);
+    return downloads;
+}
+
+TEST_CASE("Modules::Apply pluginsync manifest", "[modules]") {
+    lth_util::scope_exit remove_temp_dir { [] { fs::remove_all(TEMP_CACHE_DIR); } };
+    auto temp_cache_dir = std::make_shared<ModuleCacheDir>(TEMP_CACHE_DIR, CACHE_TTL);
+    Modules::Apply mod { PXP_AGENT_BIN_PATH, MASTER_URIS, CA, CRT, KEY, CRL, "", 0, "0m", temp_cache_dir, STORAGE };
+    mod.buildCommandObject(prep_request("{ \"environment\" : \"production\" }"));
+
+    const auto shim_path = fs::path(TEMP_CACHE_DIR) / "apply_ruby_shim" / "apply_ruby_shim.rb";
+    const auto plugin_cache = temp_cache_dir->createCacheDir("production");
+    const auto manifest_path = plugin_cache / ".pluginsync_manifest.json";
+    const auto server_dir = fs::path(TEMP_CACHE_DIR) / "server";
+    fs::create_directories(server_dir / "plugins" / "lib");
+    fs::create_directories(server_dir / "pluginfacts");
+    lth_file::atomic_write_to_file("1", (server_dir / "plugins" / "lib" / "a.rb").string());
+    lth_file::atomic_write_to_file("a=1", (server_dir / "pluginfacts" / "a.txt").string());
+
+    // The first sync writes the manifest
+    REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "plugin\npluginfacts");
+    REQUIRE(fs::exists(manifest_path));
+
+    SECTION("skips the sync if the plugins are unchanged") {
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "");
+    }
+
+    SECTION("syncs the plugins once they changed") {
+        lth_file::atomic_write_to_file("2", (server_dir / "plugins" / "lib" / "a.rb").string());
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "plugin\npluginfacts");
+        REQUIRE(lth_file::read((plugin_cache / "plugins" / "lib" / "a.rb").string()) == "2");
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "");
+    }
+
+    SECTION("syncs the plugins if the manifest is missing") {
+        fs::remove(manifest_path);
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "plugin\npluginfacts");
+        REQUIRE(fs::exists(manifest_path));
+    }
+
+    SECTION("syncs the plugins if the manifest is corrupt") {
+        lth_file::atomic_write_to_file("{\"dig", manifest_path.string());
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "plugin\npluginfacts");
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir) == "");
+    }
+
+    SECTION("syncs the plugins without a manifest if the metadata is unavailable") {
+        REQUIRE(pluginsync(shim_path, plugin_cache, server_dir, true) == "plugin\npluginfacts");
+        REQUIRE_FALSE(fs::exists(manifest_path));
+    }
+}
+#endif
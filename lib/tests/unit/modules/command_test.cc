@@ -4,12 +4,16 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <chrono>
+
 #include <leatherman/execution/execution.hpp>
 #include <leatherman/util/scope_exit.hpp>
 #include <leatherman/file_util/file.hpp>
 
+#include <pxp-agent/action_status.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/modules/command.hpp>
+#include <pxp-agent/util/action_deadlines.hpp>
 
 using namespace PXPAgent;
 
@@ -218,3 +222,37 @@ TEST_CASE("Modules::Command::callAction where the command fails", "[modules]") {
         }
     }
 }
+
+#ifndef _WIN32
+TEST_CASE("Modules::Command::callAction once the deadline expires", "[modules]") {
+    configureTest();
+    lth_util::scope_exit cleaner { [] {
+        Util::ActionDeadlines::Instance().reset();
+        resetTest();
+    } };
+    Util::ActionDeadlines::Instance().setModuleTimeout("command", 1);
+    Modules::Command mod { PXP_AGENT_BIN_PATH, STORAGE };
+
+    // The subshell leaves a grandchild that keeps stdout open
+    std::string command_txt {
+        (DATA_FORMAT % "\"0988\""
+                     % "\"command\""
+                     % "\"run\""
+                     % "{ \"command\": \"(sleep 30 &); sleep 30\" }").str() };
+    PCPClient::ParsedChunks command_content {
+        lth_jc::JsonContainer(ENVELOPE_TXT),
+        lth_jc::JsonContainer(command_txt),
+        {},
+        0 };
+    ActionRequest request { RequestType::Blocking, command_content };
+
+    SECTION("terminates the processes spawned by the command") {
+        auto start = std::chrono::steady_clock::now();
+        auto response = mod.executeAction(request);
+
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        REQUIRE(response.action_metadata.get<std::string>("status")
+                == ACTION_STATUS_NAMES.at(ActionStatus::TimedOut));
+    }
+}
+#endif
@@ -0,0 +1,78 @@
+#include "../../common/content_format.hpp"
+
+#include <pxp-agent/modules/metrics.hpp>
+#include <pxp-agent/util/metrics.hpp>
+#include <pxp-agent/util/trace.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <vector>
+
+using namespace PXPAgent;
+
+namespace lth_jc = leatherman::json_container;
+
+static const std::string METRICS_TXT {
+    (DATA_FORMAT % "\"0564\""
+                 % "\"metrics\""
+                 % "\"metrics\""
+                 % "{}").str() };
+
+static const PCPClient::ParsedChunks PARSED_CHUNKS {
+                    lth_jc::JsonContainer(ENVELOPE_TXT),
+                    lth_jc::JsonContainer(METRICS_TXT),
+                    std::vector<lth_jc::JsonContainer>{},
+                    0 };
+
+static const std::string TRACE_TXT {
+    (DATA_FORMAT % "\"0565\""
+                 % "\"metrics\""
+                 % "\"trace\""
+                 % "{}").str() };
+
+static const PCPClient::ParsedChunks TRACE_CHUNKS {
+                    lth_jc::JsonContainer(ENVELOPE_TXT),
+                    lth_jc::JsonContainer(TRACE_TXT),
+                    std::vector<lth_jc::JsonContainer>{},
+                    0 };
+
+TEST_CASE("Modules::Metrics::executeAction", "[modules]") {
+    Modules::Metrics metrics_module {};
+    ActionRequest request { RequestType::Blocking, PARSED_CHUNKS };
+
+    SECTION("the metrics module has the metrics action") {
+        REQUIRE(metrics_module.module_name == "metrics");
+        REQUIRE(metrics_module.hasAction("metrics"));
+        REQUIRE(metrics_module.hasAction("trace"));
+    }
+
+    SECTION("it reports the value of each series") {
+        Util::Metrics::Registry::Instance().counter(
+            "test_module_total", "Test", { { "module", "echo" } }).add(3);
+        auto response = metrics_module.executeAction(request);
+        auto results = response.action_metadata.get<lth_jc::JsonContainer>("results");
+        auto metrics = results.get<lth_jc::JsonContainer>("metrics");
+
+        REQUIRE(metrics.get<double>("test_module_total{module=\"echo\"}") == 3);
+    }
+}
+
+TEST_CASE("Modules::Metrics::executeAction trace", "[modules]") {
+    Modules::Metrics metrics_module {};
+    ActionRequest request { RequestType::Blocking, TRACE_CHUNKS };
+
+    SECTION("it reports the recorded spans as Chrome trace events") {
+        Util::Trace::enable(16);
+        Util::Trace::record("validate", "test-trace-module", Util::Trace::now());
+        auto response = metrics_module.executeAction(request);
+        auto results = response.action_metadata.get<lth_jc::JsonContainer>("results");
+        auto events = results.get<std::vector<lth_jc::JsonContainer>>("traceEvents");
+
+        REQUIRE_FALSE(events.empty());
+        REQUIRE(events.back().get<std::string>("ph") == "X");
+    }
+}
@@ -7,6 +7,9 @@
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <cpp-pcp-client/util/chrono.hpp>
+#include <cpp-pcp-client/util/thread.hpp>
+
 #include <catch.hpp>
 
 #include <boost/filesystem.hpp>
@@ -17,6 +20,11 @@
 #include <unistd.h>
 #include <atomic>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
 using namespace PXPAgent;
 
 namespace lth_jc = leatherman::json_container;
@@ -52,6 +60,10 @@ TEST_CASE("RequestProcessor::hasModule", "[agent]") {
     SECTION("returns false if the requested module was not loaded") {
         REQUIRE_FALSE(r_p.hasModule("this_module_here_does_not_exist"));
     }
+
+    SECTION("loads the internal metrics module") {
+        REQUIRE(r_p.hasModule("metrics"));
+    }
 }
 
 TEST_CASE("RequestProcessor::hasModuleConfig", "[agent]") {
@@ -154,3 +166,48 @@ TEST_CASE("RequestProcessor::processRequest", "[agent]") {
 
     fs::remove_all(SPOOL);
 }
+
+#ifndef _WIN32
+TEST_CASE("RequestProcessor purges on the purge thread", "[agent]") {
+    // The purge blocks reading the metadata of this transaction, a
+    // FIFO, until the test opens it for writing and closes it
+    auto results_dir = fs::path(SPOOL) / "blocking_purge";
+    fs::create_directories(results_dir);
+    auto metadata_file = (results_dir / "metadata").string();
+    REQUIRE(mkfifo(metadata_file.c_str(), 0600) == 0);
+
+    auto agent_configuration = AGENT_CONFIGURATION;
+    agent_configuration.spool_dir_purge_ttl = "1d";
+    auto c_ptr = std::make_shared<MockConnector>();
+
+    {
+        RequestProcessor r_p { c_ptr, agent_configuration };
+
+        // Opening the FIFO fails until the purge thread reads it
+        int fd { -1 };
+        for (int i = 0; fd < 0 && i < 500; i++) {
+            fd = open(metadata_file.c_str(), O_WRONLY | O_NONBLOCK);
+            if (fd < 0)
+                pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+        }
+        REQUIRE(fd >= 0);
+
+        lth_jc::JsonContainer envelope { VALID_ENVELOPE_TXT };
+        lth_jc::JsonContainer data {};
+        data.set<std::string>("transaction_id", "42");
+        data.set<std::string>("module", "echo");
+        data.set<std::string>("action", "echo");
+        data.set<lth_jc::JsonContainer>("params",
+            lth_jc::JsonContainer { "{\"argument\":\"maradona\"}" });
+        std::vector<lth_jc::JsonContainer> debug {};
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+
+        r_p.processRequest(RequestType::Blocking, p_c);
+        close(fd);
+
+        REQUIRE(c_ptr->sent_blocking_response);
+    }
+
+    fs::remove_all(SPOOL);
+}
+#endif
@@ -137,6 +137,13 @@ TEST_CASE("ResultsStorage::updateMetadataFile", "[module][results]") {
         REQUIRE(read_metadata.get<std::string>("status") == "success");
     }
 
+    SECTION("Redacts the request params") {
+        st.initializeMetadataFile(valid_transaction_id, some_valid_metadata);
+        auto read_metadata = st.getActionMetadata(valid_transaction_id);
+        REQUIRE(read_metadata.get<std::string>("request_params") == "{}");
+        REQUIRE(some_valid_metadata.get<std::string>("request_params") == "abc");
+    }
+
     resetTest();
 }
 
@@ -187,16 +194,104 @@ TEST_CASE("ResultsStorage::getOutput", "[module][results]") {
     }
 }
 
+// Copy the valid results directory, whose metadata file is JSON, to
+// the spool; packing removes it
+static void copyValidResults() {
+    configureTest();
+    auto results_dir = SPOOL_DIR + "/" + VALID_TRANSACTION;
+    fs::create_directories(results_dir);
+    for (const auto& file : { "exitcode", "metadata", "pid", "stderr", "stdout" })
+        fs::copy_file(TESTING_RESULTS + "/" + VALID_TRANSACTION + "/" + file,
+                      results_dir + "/" + file);
+}
+
+TEST_CASE("ResultsStorage::packResults", "[module][results]") {
+    copyValidResults();
+    ResultsStorage st { SPOOL_DIR, SPOOL_TTL, true };
+    auto metadata = st.getActionMetadata(VALID_TRANSACTION);
+    metadata.set<std::string>("request_params", "{}");
+
+    SECTION("does nothing if packing is disabled") {
+        ResultsStorage unpacked_st { SPOOL_DIR, SPOOL_TTL };
+        unpacked_st.packResults(VALID_TRANSACTION);
+
+        REQUIRE_FALSE(unpacked_st.isPacked(VALID_TRANSACTION));
+        REQUIRE(fs::exists(SPOOL_DIR + "/" + VALID_TRANSACTION + "/stdout"));
+    }
+
+    SECTION("does nothing if the action is running") {
+        metadata.set<std::string>("status", "running");
+        st.updateMetadataFile(VALID_TRANSACTION, metadata);
+        st.packResults(VALID_TRANSACTION);
+
+        REQUIRE_FALSE(st.isPacked(VALID_TRANSACTION));
+    }
+
+    SECTION("replaces the results directory by a single file") {
+        st.packResults(VALID_TRANSACTION);
+
+        REQUIRE(st.isPacked(VALID_TRANSACTION));
+        REQUIRE(st.find(VALID_TRANSACTION));
+        REQUIRE_FALSE(fs::exists(SPOOL_DIR + "/" + VALID_TRANSACTION));
+        REQUIRE(fs::is_regular_file(SPOOL_DIR + "/" + VALID_TRANSACTION + ".pxpr"));
+    }
+
+    SECTION("the packed results can be retrieved") {
+        st.packResults(VALID_TRANSACTION);
+        auto output = st.getOutput(VALID_TRANSACTION);
+
+        REQUIRE(st.outputIsReady(VALID_TRANSACTION));
+        REQUIRE_FALSE(st.pidFileExists(VALID_TRANSACTION));
+        REQUIRE(output.exitcode == 0);
+        REQUIRE(output.std_err == "Hey, all good here!");
+        REQUIRE(output.std_out == "{\"spam\":\"eggs\"}");
+        REQUIRE(st.getActionMetadata(VALID_TRANSACTION).toString() == metadata.toString());
+        REQUIRE(st.getActionSummary(VALID_TRANSACTION).status == "success");
+    }
+
+    SECTION("the packed metadata can be updated") {
+        st.packResults(VALID_TRANSACTION);
+        metadata.set<std::string>("status", "failure");
+        st.updateMetadataFile(VALID_TRANSACTION, metadata);
+
+        REQUIRE(st.getActionMetadata(VALID_TRANSACTION).get<std::string>("status")
+                == "failure");
+        REQUIRE(st.getOutput(VALID_TRANSACTION).std_err == "Hey, all good here!");
+    }
+
+    SECTION("packed results are purged") {
+        st.packResults(VALID_TRANSACTION);
+        auto results = st.purge("10d", std::vector<std::string>());
+
+        REQUIRE(results == 1);
+        REQUIRE_FALSE(st.find(VALID_TRANSACTION));
+    }
+
+    resetTest();
+}
+
 static const std::string PURGE_TEST_RESULTS { std::string { PXP_AGENT_ROOT_PATH}
                                               + "/lib/tests/resources/purge_test" };
 
 static const std::string OLD_TRANSACTION { "valid_old" };
 static const std::string RECENT_TRANSACTION { "valid_recent" };
 
+// The metadata files of the purge_test resources are JSON, as written
+// by older versions; copy them, as updating a file stores it as a
+// MetadataRecord
+static void copyPurgeTestResults() {
+    configureTest();
+    for (const auto& transaction_id : { OLD_TRANSACTION, RECENT_TRANSACTION }) {
+        fs::create_directories(SPOOL_DIR + "/" + transaction_id);
+        fs::copy_file(PURGE_TEST_RESULTS + "/" + transaction_id + "/metadata",
+                      SPOOL_DIR + "/" + transaction_id + "/metadata");
+    }
+}
+
 TEST_CASE("ResultsStorage::purge", "[module][results]") {
-    ResultsStorage st { PURGE_TEST_RESULTS, SPOOL_TTL };
-    auto recent_metadata_old = st.getActionMetadata(RECENT_TRANSACTION);
-    lth_jc::JsonContainer recent_metadata { recent_metadata_old };
+    copyPurgeTestResults();
+    ResultsStorage st { SPOOL_DIR, SPOOL_TTL };
+    auto recent_metadata = st.getActionMetadata(RECENT_TRANSACTION);
     recent_metadata.set<std::string>("start", lth_util::get_ISO8601_time());
     unsigned int num_purged_results { 0 };
     auto purgeCallback =
@@ -210,7 +305,120 @@ TEST_CASE("ResultsStorage::purge", "[module][results]") {
         REQUIRE(num_purged_results == 1);
     }
 
-    // Let's keep the recent metadata file as it was, to avoid
-    // updating it at every "git add -A"...
-    st.updateMetadataFile(RECENT_TRANSACTION, recent_metadata_old);
+    SECTION("Then only inspects the indexed results") {
+        REQUIRE(st.purge("10d", std::vector<std::string>(), purgeCallback) == 1);
+
+        // Results stored by someone else are not indexed
+        fs::create_directories(SPOOL_DIR + "/unindexed");
+        fs::copy_file(PURGE_TEST_RESULTS + "/" + OLD_TRANSACTION + "/metadata",
+                      SPOOL_DIR + "/unindexed/metadata");
+        // Finishing an action indexes it
+        recent_metadata.set<std::string>("start", "2015-01-01T00:00:00.000000Z");
+        st.updateMetadataFile(RECENT_TRANSACTION, recent_metadata);
+
+        REQUIRE(st.purge("10d", std::vector<std::string>(), purgeCallback) == 1);
+        REQUIRE(num_purged_results == 2);
+    }
+
+    SECTION("Skips the ongoing transactions") {
+        recent_metadata.set<std::string>("start", "2015-01-01T00:00:00.000000Z");
+        st.updateMetadataFile(RECENT_TRANSACTION, recent_metadata);
+
+        REQUIRE(st.purge("10d", { RECENT_TRANSACTION }, purgeCallback) == 1);
+        REQUIRE(st.purge("10d", { RECENT_TRANSACTION }, purgeCallback) == 0);
+        REQUIRE(st.purge("10d", std::vector<std::string>(), purgeCallback) == 1);
+    }
+
+    SECTION("Packs the recent results if packing is enabled") {
+        ResultsStorage packing_st { SPOOL_DIR, SPOOL_TTL, true };
+        auto results = packing_st.purge("10d", std::vector<std::string>(), purgeCallback);
+        REQUIRE(results == 1);
+        REQUIRE(packing_st.isPacked(RECENT_TRANSACTION));
+    }
+
+    SECTION("Skips the results of running actions") {
+        recent_metadata.set<std::string>("start", "2015-01-01T00:00:00.000000Z");
+        recent_metadata.set<std::string>("status", "running");
+        st.updateMetadataFile(RECENT_TRANSACTION, recent_metadata);
+
+        auto results = st.purge("10d", std::vector<std::string>(), purgeCallback);
+        REQUIRE(results == 1);
+        REQUIRE(num_purged_results == 1);
+    }
+
+    resetTest();
+}
+
+TEST_CASE("ResultsStorage::setQuotas", "[module][results]") {
+    copyPurgeTestResults();
+    ResultsStorage st { SPOOL_DIR, "0d" };
+    std::vector<std::string> purged_paths {};
+    auto purgeCallback =
+        [&purged_paths](const std::string& path) -> void { purged_paths.push_back(path); };
+
+    SECTION("Removes the oldest results over the count quota, even if ttl is 0") {
+        st.setQuotas(0, 1, nullptr);
+        REQUIRE(st.purge("0d", std::vector<std::string>(), purgeCallback) == 1);
+        REQUIRE(purged_paths.size() == 1);
+        REQUIRE(fs::path(purged_paths.front()).filename().string() == OLD_TRANSACTION);
+    }
+
+    SECTION("Removes the oldest results over the size quota") {
+        st.setQuotas(1, 0, nullptr);
+        REQUIRE(st.purge("0d", std::vector<std::string>(), purgeCallback) == 2);
+    }
+
+    SECTION("Skips the ongoing transactions") {
+        st.setQuotas(0, 1, nullptr);
+        REQUIRE(st.purge("0d", { OLD_TRANSACTION }, purgeCallback) == 1);
+        REQUIRE(fs::path(purged_paths.front()).filename().string() == RECENT_TRANSACTION);
+    }
+
+    SECTION("Signals when a completed action exceeds the quotas") {
+        unsigned int num_signals { 0 };
+        st.setQuotas(0, 2, [&num_signals]() { num_signals++; });
+        REQUIRE(st.purge("0d", std::vector<std::string>(), purgeCallback) == 0);
+
+        auto metadata = st.getActionMetadata(RECENT_TRANSACTION);
+        fs::create_directories(SPOOL_DIR + "/valid_new");
+        metadata.set<std::string>("start", lth_util::get_ISO8601_time());
+        st.updateMetadataFile("valid_new", metadata);
+        REQUIRE(num_signals == 1);
+
+        REQUIRE(st.purge("0d", std::vector<std::string>(), purgeCallback) == 1);
+        REQUIRE(fs::path(purged_paths.front()).filename().string() == OLD_TRANSACTION);
+    }
+
+    resetTest();
+}
+
+TEST_CASE("ResultsStorage::getActionSummary", "[module][results]") {
+    copyPurgeTestResults();
+    ResultsStorage st { SPOOL_DIR, SPOOL_TTL };
+
+    SECTION("Reads the summary of JSON metadata") {
+        auto metadata = st.getActionMetadata(OLD_TRANSACTION);
+        auto summary = st.getActionSummary(OLD_TRANSACTION);
+
+        REQUIRE(summary.status == metadata.get<std::string>("status"));
+        REQUIRE(summary.start == metadata.get<std::string>("start"));
+    }
+
+    SECTION("Migrates JSON metadata to a record when updating it") {
+        auto metadata = st.getActionMetadata(OLD_TRANSACTION);
+        metadata.set<std::string>("request_params", "{}");
+        st.updateMetadataFile(OLD_TRANSACTION, metadata);
+        auto summary = st.getActionSummary(OLD_TRANSACTION);
+
+        REQUIRE(summary.status == metadata.get<std::string>("status"));
+        REQUIRE(summary.start == metadata.get<std::string>("start"));
+        REQUIRE(st.getActionMetadata(OLD_TRANSACTION).toString() == metadata.toString());
+    }
+
+    SECTION("Throws an Error if the metadata file does not exist") {
+        REQUIRE_THROWS_AS(st.getActionSummary("not_there"),
+                          ResultsStorage::Error);
+    }
+
+    resetTest();
 }
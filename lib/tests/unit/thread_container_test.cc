@@ -181,6 +181,18 @@ TEST_CASE("ThreadContainer::find", "[async]") {
     }
 }
 
+TEST_CASE("ThreadContainer::getNumRunningThreads", "[async]") {
+    ThreadContainer container { "TESTING_6" };
+
+    SECTION("counts only the threads that have not completed") {
+        addTasksTo(container, 2, 0, 0);
+        addTasksTo(container, 3, 0, 200000, "running_");
+        REQUIRE(container.getNumRunningThreads() == 3);
+        pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(400));
+        REQUIRE(container.getNumRunningThreads() == 0);
+    }
+}
+
 TEST_CASE("ThreadContainer::getThreadNames", "[async]") {
     ThreadContainer container { "TESTING_5" };
 
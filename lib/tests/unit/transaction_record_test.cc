@@ -0,0 +1,80 @@
+#include <pxp-agent/transaction_record.hpp>
+#include <pxp-agent/metadata_record.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+using namespace PXPAgent;
+using TransactionRecord::Segment;
+
+namespace lth_jc = leatherman::json_container;
+
+static TransactionRecord::Segments someSegments() {
+    lth_jc::JsonContainer metadata {};
+    metadata.set<std::string>("transaction_id", "0632");
+    metadata.set<std::string>("start", "2016-01-11T10:09:18.283484Z");
+    metadata.set<std::string>("status", "failure");
+
+    TransactionRecord::Segments segments {};
+    segments[Segment::Metadata] = MetadataRecord::encode(metadata);
+    segments[Segment::Stdout] = std::string { "out\0put", 7 };
+    segments[Segment::Stderr] = "";
+    segments[Segment::Exitcode] = "1";
+    return segments;
+}
+
+TEST_CASE("TransactionRecord::encode", "[results]") {
+    SECTION("starts with the record magic") {
+        auto record = TransactionRecord::encode(someSegments());
+
+        REQUIRE(TransactionRecord::isRecord(record));
+        REQUIRE_FALSE(MetadataRecord::isRecord(record));
+    }
+
+    SECTION("throws an Error if there's no metadata segment") {
+        auto segments = someSegments();
+        segments.erase(Segment::Metadata);
+
+        REQUIRE_THROWS_AS(TransactionRecord::encode(segments),
+                          TransactionRecord::Error);
+    }
+}
+
+TEST_CASE("TransactionRecord::decode", "[results]") {
+    SECTION("returns the encoded segments") {
+        auto segments = someSegments();
+
+        REQUIRE(TransactionRecord::decode(TransactionRecord::encode(segments))
+                == segments);
+    }
+
+    SECTION("throws an Error if the record is truncated") {
+        auto record = TransactionRecord::encode(someSegments());
+        record.resize(record.size() - 1);
+
+        REQUIRE_THROWS_AS(TransactionRecord::decode(record),
+                          TransactionRecord::Error);
+    }
+
+    SECTION("throws an Error if the version is not supported") {
+        auto record = TransactionRecord::encode(someSegments());
+        record[4] = static_cast<char>(TransactionRecord::VERSION + 1);
+
+        REQUIRE_THROWS_AS(TransactionRecord::decode(record),
+                          TransactionRecord::Error);
+    }
+}
+
+TEST_CASE("TransactionRecord::decodeSummary", "[results]") {
+    SECTION("returns the summary of the metadata segment") {
+        auto record = TransactionRecord::encode(someSegments());
+        auto summary = TransactionRecord::decodeSummary(
+            record.substr(0, TransactionRecord::SUMMARY_SIZE));
+
+        REQUIRE(summary.status == "failure");
+        REQUIRE(summary.start == "2016-01-11T10:09:18.283484Z");
+    }
+}
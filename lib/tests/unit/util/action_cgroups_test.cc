@@ -0,0 +1,177 @@
+#include "root_path.hpp"
+#include "../../common/content_format.hpp"
+
+#include <pxp-agent/util/action_cgroups.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/execution/execution.hpp>
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+
+#include <catch.hpp>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace fs = boost::filesystem;
+namespace lth_exec = leatherman::execution;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+TEST_CASE("ActionCGroups::parseLimits", "[util]") {
+    SECTION("parses integer and string values") {
+        auto limits = ActionCGroups::parseLimits(
+            lth_jc::JsonContainer { "{ \"cpu.weight\" : 50, \"memory.max\" : \"1G\" }" });
+
+        REQUIRE(limits.size() == 2u);
+        REQUIRE(limits.at("cpu.weight") == "50");
+        REQUIRE(limits.at("memory.max") == "1G");
+    }
+
+    SECTION("fails for unknown interface files") {
+        REQUIRE_THROWS_AS(
+            ActionCGroups::parseLimits(lth_jc::JsonContainer { "{ \"pids.max\" : 10 }" }),
+            ActionCGroups::Error);
+    }
+
+    SECTION("fails for values that are neither strings nor integers") {
+        REQUIRE_THROWS_AS(
+            ActionCGroups::parseLimits(lth_jc::JsonContainer { "{ \"io.weight\" : true }" }),
+            ActionCGroups::Error);
+    }
+
+    SECTION("fails if the limits are not an object") {
+        REQUIRE_THROWS_AS(
+            ActionCGroups::parseLimits(lth_jc::JsonContainer { "[ 1, 2 ]" }),
+            ActionCGroups::Error);
+    }
+}
+
+#ifdef __linux__
+static const std::string CGROUP_PARENT { std::string { PXP_AGENT_ROOT_PATH }
+                                         + "/lib/tests/resources/action_cgroups" };
+
+static ActionRequest task_request(const std::string& transaction_id) {
+    std::string data_txt {
+        (DATA_FORMAT % ("\"" + transaction_id + "\"")
+                     % "\"task\""
+                     % "\"run\""
+                     % "{}").str() };
+    PCPClient::ParsedChunks content {
+        lth_jc::JsonContainer(ENVELOPE_TXT),
+        lth_jc::JsonContainer(data_txt),
+        {},
+        0 };
+    return ActionRequest { RequestType::Blocking, content };
+}
+
+// Tests rely on a regular directory that mimics the cgroup v2 interface
+TEST_CASE("ActionCGroups::create", "[util]") {
+    lth_util::scope_exit cleaner { [] {
+        ActionCGroups::Instance().reset();
+        fs::remove_all(CGROUP_PARENT);
+    } };
+    fs::create_directories(CGROUP_PARENT);
+    auto& cgroups = ActionCGroups::Instance();
+
+    SECTION("does not create cgroups when not configured") {
+        REQUIRE_FALSE(cgroups.enabled());
+        REQUIRE(cgroups.create(task_request("1234")) == nullptr);
+    }
+
+    SECTION("fails to configure a directory that is not a cgroup") {
+        REQUIRE_THROWS_AS(cgroups.configure(CGROUP_PARENT), ActionCGroups::Error);
+        REQUIRE_FALSE(cgroups.enabled());
+    }
+
+    SECTION("creates a cgroup per transaction with the module limits") {
+        lth_file::atomic_write_to_file("cpu memory io\n",
+                                       CGROUP_PARENT + "/cgroup.controllers");
+        cgroups.configure(CGROUP_PARENT);
+        cgroups.setModuleLimits("task", { { "cpu.weight", "50" }, { "io.weight", "20" } });
+        REQUIRE(cgroups.enabled());
+
+        auto cgroup = cgroups.create(task_request("1234"));
+        REQUIRE(cgroup != nullptr);
+        REQUIRE(cgroup->path() == fs::path(CGROUP_PARENT) / "1234");
+        REQUIRE(lth_file::read((cgroup->path() / "cpu.weight").string()) == "50");
+        REQUIRE(lth_file::read((cgroup->path() / "io.weight").string()) == "default 20");
+        REQUIRE_FALSE(fs::exists(cgroup->path() / "memory.max"));
+
+        SECTION("does not create a cgroup for the same transaction twice") {
+            REQUIRE(cgroups.create(task_request("1234")) == nullptr);
+        }
+
+        SECTION("reports the resource usage") {
+            lth_file::atomic_write_to_file("usage_usec 2500000\nuser_usec 2000000\n",
+                                           (cgroup->path() / "cpu.stat").string());
+            lth_file::atomic_write_to_file("4194304\n",
+                                           (cgroup->path() / "memory.peak").string());
+            lth_file::atomic_write_to_file("8:0 rbytes=2048 wbytes=4096 rios=1 wios=2\n"
+                                           "8:16 rbytes=1024 wbytes=0 rios=1 wios=0\n",
+                                           (cgroup->path() / "io.stat").string());
+
+            auto usage = cgroup->getUsage();
+            REQUIRE(usage.get<int64_t>("cpu_time_ms") == 2500);
+            REQUIRE(usage.get<int64_t>("memory_peak_kb") == 4096);
+            REQUIRE(usage.get<int64_t>("io_read_kb") == 3);
+            REQUIRE(usage.get<int64_t>("io_write_kb") == 4);
+        }
+
+        SECTION("reports a resource usage that exceeds 32 bits") {
+            lth_file::atomic_write_to_file("usage_usec 5000000000000\n",
+                                           (cgroup->path() / "cpu.stat").string());
+            lth_file::atomic_write_to_file("4398046511104\n",
+                                           (cgroup->path() / "memory.peak").string());
+
+            auto usage = cgroup->getUsage();
+            REQUIRE(usage.get<int64_t>("cpu_time_ms") == 5000000000);
+            REQUIRE(usage.get<int64_t>("memory_peak_kb") == 4294967296);
+        }
+
+        SECTION("moves the process of a command to the cgroup before executing it") {
+            std::string executable { "sh" };
+            std::vector<std::string> arguments { "-c", "echo $$" };
+            cgroup->attachBeforeExec(executable, arguments);
+
+            auto exec = lth_exec::execute(executable, arguments, 0,
+                                          { lth_exec::execution_options::thread_safe,
+                                            lth_exec::execution_options::trim_output });
+            REQUIRE(exec.exit_code == 0);
+            REQUIRE_FALSE(exec.output.empty());
+            REQUIRE(boost::algorithm::trim_copy(
+                        lth_file::read((cgroup->path() / "cgroup.procs").string()))
+                    == exec.output);
+        }
+
+        SECTION("executes the command even if the process cannot be moved") {
+            ActionCGroup removed_cgroup { fs::path(CGROUP_PARENT) / "removed" };
+            std::string executable { "sh" };
+            std::vector<std::string> arguments { "-c", "echo done" };
+            removed_cgroup.attachBeforeExec(executable, arguments);
+
+            auto exec = lth_exec::execute(executable, arguments, 0,
+                                          { lth_exec::execution_options::thread_safe,
+                                            lth_exec::execution_options::trim_output });
+            REQUIRE(exec.exit_code == 0);
+            REQUIRE(exec.output == "done");
+            REQUIRE(exec.error.empty());
+        }
+
+        SECTION("does not rewrite a command whose executable is missing") {
+            std::string executable { "pxp-agent-missing-executable" };
+            std::vector<std::string> arguments { "arg" };
+            cgroup->attachBeforeExec(executable, arguments);
+
+            REQUIRE(executable == "pxp-agent-missing-executable");
+            REQUIRE(arguments == std::vector<std::string> { "arg" });
+        }
+    }
+}
+#endif
@@ -0,0 +1,130 @@
+#include "../../common/content_format.hpp"
+
+#include <pxp-agent/util/action_deadlines.hpp>
+#include <pxp-agent/action_status.hpp>
+#include <pxp-agent/module_type.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <leatherman/execution/execution.hpp>
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <catch.hpp>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace lth_exec = leatherman::execution;
+namespace lth_jc   = leatherman::json_container;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+static ActionRequest task_request(int timeout)
+{
+    lth_jc::JsonContainer data {
+        (DATA_FORMAT % "\"1234\"" % "\"task\"" % "\"run\"" % "{}").str() };
+    if (timeout > 0)
+        data.set<int>("timeout", timeout);
+    PCPClient::ParsedChunks content {
+        lth_jc::JsonContainer(ENVELOPE_TXT),
+        data,
+        {},
+        0 };
+    return ActionRequest { RequestType::Blocking, content };
+}
+
+TEST_CASE("ActionDeadlines::create", "[util]") {
+    lth_util::scope_exit cleaner { [] { ActionDeadlines::Instance().reset(); } };
+    auto& deadlines = ActionDeadlines::Instance();
+
+    SECTION("does not create a deadline without timeouts") {
+        REQUIRE(deadlines.create(task_request(0)) == nullptr);
+    }
+
+    SECTION("uses the timeout of the request") {
+        auto deadline = deadlines.create(task_request(30));
+        REQUIRE(deadline != nullptr);
+        REQUIRE(deadline->timeout() == pcp_util::chrono::seconds(30));
+        REQUIRE(deadline->gracePeriod()
+                == pcp_util::chrono::seconds(ActionDeadlines::KILL_GRACE_S));
+    }
+
+    SECTION("uses the timeout of the module") {
+        deadlines.setModuleTimeout("task", 60);
+        auto deadline = deadlines.create(task_request(0));
+        REQUIRE(deadline != nullptr);
+        REQUIRE(deadline->timeout() == pcp_util::chrono::seconds(60));
+
+        SECTION("unless the request has a shorter one") {
+            REQUIRE(deadlines.create(task_request(30))->timeout()
+                    == pcp_util::chrono::seconds(30));
+        }
+
+        SECTION("but not a longer one") {
+            REQUIRE(deadlines.create(task_request(90))->timeout()
+                    == pcp_util::chrono::seconds(60));
+        }
+    }
+}
+
+#ifndef _WIN32
+TEST_CASE("ActionDeadline", "[util]") {
+    TimerWheel wheel { pcp_util::chrono::milliseconds(10), 64 };
+
+    SECTION("does not expire if the process completes in time") {
+        ActionDeadline deadline { wheel,
+                                  pcp_util::chrono::milliseconds(2000),
+                                  pcp_util::chrono::milliseconds(100) };
+        lth_exec::execute("true", {}, "", {}, deadline.arming(nullptr), 0,
+                          { lth_exec::execution_options::thread_safe,
+                            lth_exec::execution_options::create_detached_process });
+        REQUIRE_FALSE(deadline.expired());
+    }
+
+    SECTION("terminates the process once the timeout elapses") {
+        ActionDeadline deadline { wheel,
+                                  pcp_util::chrono::milliseconds(100),
+                                  pcp_util::chrono::milliseconds(2000) };
+        size_t callback_pid { 0 };
+        auto start = pcp_util::chrono::steady_clock::now();
+        auto exec = lth_exec::execute(
+            "sleep", { "30" }, "", {},
+            deadline.arming([&callback_pid](size_t pid) { callback_pid = pid; }),
+            0, { lth_exec::execution_options::thread_safe,
+                 lth_exec::execution_options::create_detached_process });
+
+        REQUIRE(deadline.expired());
+        REQUIRE(callback_pid != 0u);
+        REQUIRE(exec.exit_code != 0);
+        REQUIRE(pcp_util::chrono::steady_clock::now() - start
+                < pcp_util::chrono::seconds(2));
+
+        SECTION("marks the response as timed out") {
+            ActionResponse response { ModuleType::Internal, task_request(1) };
+            response.setValidResultsAndEnd(lth_jc::JsonContainer {});
+            deadline.updateResponse(response);
+            REQUIRE(response.action_metadata.get<std::string>("status")
+                    == ACTION_STATUS_NAMES.at(ActionStatus::TimedOut));
+            REQUIRE_FALSE(response.action_metadata.get<bool>("results_are_valid"));
+            REQUIRE(response.action_metadata.includes("execution_error"));
+        }
+    }
+
+    SECTION("kills the process if it ignores SIGTERM") {
+        ActionDeadline deadline { wheel,
+                                  pcp_util::chrono::milliseconds(100),
+                                  pcp_util::chrono::milliseconds(100) };
+        auto start = pcp_util::chrono::steady_clock::now();
+        lth_exec::execute("sh", { "-c", "trap '' TERM; sleep 30" }, "", {},
+                          deadline.arming(nullptr), 0,
+                          { lth_exec::execution_options::thread_safe,
+                            lth_exec::execution_options::create_detached_process });
+
+        REQUIRE(deadline.expired());
+        REQUIRE(pcp_util::chrono::steady_clock::now() - start
+                < pcp_util::chrono::seconds(5));
+    }
+}
+#endif
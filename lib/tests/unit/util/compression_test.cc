@@ -0,0 +1,63 @@
+#include <pxp-agent/util/compression.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+using namespace PXPAgent;
+using namespace Util;
+
+TEST_CASE("gzipCompress", "[util]") {
+    SECTION("round trips empty data") {
+        REQUIRE(gzipDecompress(gzipCompress("")).empty());
+    }
+
+    SECTION("round trips binary data") {
+        std::string data {};
+        for (int i = 0; i < 70000; i++)
+            data.push_back(static_cast<char>((i * 7919) % 256));
+        REQUIRE(gzipDecompress(gzipCompress(data)) == data);
+    }
+
+    SECTION("compresses repetitive text") {
+        std::string data {};
+        while (data.size() < 1024 * 1024)
+            data += "Notice: /Stage[main]/Main/File[/tmp/foo]/ensure: created\n";
+        auto compressed = gzipCompress(data);
+        REQUIRE(compressed.size() < data.size() / 20);
+        // The gzip magic number
+        REQUIRE(compressed.substr(0, 2) == "\x1f\x8b");
+        REQUIRE(gzipDecompress(compressed) == data);
+    }
+
+    SECTION("fails to decompress truncated or invalid data") {
+        auto compressed = gzipCompress("some text to compress");
+        REQUIRE_THROWS_AS(gzipDecompress(compressed.substr(0, compressed.size() / 2)),
+                          CompressionError);
+        REQUIRE_THROWS_AS(gzipDecompress("not gzip"), CompressionError);
+    }
+}
+
+TEST_CASE("base64Encode", "[util]") {
+    SECTION("encodes with padding") {
+        REQUIRE(base64Encode("") == "");
+        REQUIRE(base64Encode("f") == "Zg==");
+        REQUIRE(base64Encode("fo") == "Zm8=");
+        REQUIRE(base64Encode("foo") == "Zm9v");
+        REQUIRE(base64Encode("foobar") == "Zm9vYmFy");
+    }
+
+    SECTION("round trips binary data") {
+        for (size_t size = 0; size < 300; size++) {
+            std::string data {};
+            for (size_t i = 0; i < size; i++)
+                data.push_back(static_cast<char>(255 - i % 256));
+            REQUIRE(base64Decode(base64Encode(data)) == data);
+        }
+    }
+
+    SECTION("fails to decode invalid text") {
+        REQUIRE_THROWS_AS(base64Decode("Zm9"), CompressionError);
+        REQUIRE_THROWS_AS(base64Decode("Zm9*"), CompressionError);
+    }
+}
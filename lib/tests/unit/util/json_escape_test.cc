@@ -0,0 +1,79 @@
+#include <pxp-agent/util/json_escape.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace lth_jc = leatherman::json_container;
+
+static std::vector<JSONEscaper> supportedEscapers()
+{
+    std::vector<JSONEscaper> escapers {};
+    for (auto escaper : { JSONEscaper::Scalar, JSONEscaper::SSE2, JSONEscaper::AVX2 })
+        if (supportsJSONEscaper(escaper))
+            escapers.push_back(escaper);
+    return escapers;
+}
+
+static std::string escape(const std::string& s, JSONEscaper escaper)
+{
+    std::string out {};
+    appendJSONString(out, s.data(), s.size(), escaper);
+    return out;
+}
+
+TEST_CASE("appendJSONString", "[util]") {
+    SECTION("the scalar escaper is always supported") {
+        REQUIRE(supportsJSONEscaper(JSONEscaper::Scalar));
+    }
+
+    SECTION("appends to the existing content") {
+        std::string out { "[" };
+        appendJSONString(out, "foo");
+        REQUIRE(out == "[\"foo\"");
+    }
+
+    for (auto escaper : supportedEscapers()) {
+        SECTION("escapes as JsonContainer does with escaper "
+                + std::to_string(static_cast<int>(escaper))) {
+            REQUIRE(escape("", escaper) == "\"\"");
+            REQUIRE(escape("plain text", escaper) == "\"plain text\"");
+            REQUIRE(escape("say \"hi\"", escaper) == "\"say \\\"hi\\\"\"");
+            REQUIRE(escape("C:\\tmp", escaper) == "\"C:\\\\tmp\"");
+            REQUIRE(escape("a\nb\tc\rd\be\ff", escaper) == "\"a\\nb\\tc\\rd\\be\\ff\"");
+            REQUIRE(escape(std::string("\x00\x01\x1f", 3), escaper)
+                    == "\"\\u0000\\u0001\\u001F\"");
+            REQUIRE(escape("/ \x7f caf\xc3\xa9", escaper) == "\"/ \x7f caf\xc3\xa9\"");
+        }
+
+        SECTION("escapes the characters at every position with escaper "
+                + std::to_string(static_cast<int>(escaper))) {
+            // Cover the block boundaries and the tails of the vectorised scans
+            for (size_t size = 1; size <= 70; size++) {
+                for (size_t idx = 0; idx < size; idx++) {
+                    std::string s(size, 'x');
+                    s[idx] = '"';
+                    std::string expected = "\"" + s.substr(0, idx) + "\\\""
+                                           + s.substr(idx + 1) + "\"";
+                    REQUIRE(escape(s, escaper) == expected);
+                }
+            }
+        }
+
+        SECTION("produces JSON that parses back to the input with escaper "
+                + std::to_string(static_cast<int>(escaper))) {
+            std::string s {};
+            for (int c = 1; c < 128; c++)
+                s += std::string(static_cast<size_t>(c % 37), 'a') + static_cast<char>(c);
+
+            lth_jc::JsonContainer parsed { "{\"s\":" + escape(s, escaper) + "}" };
+            REQUIRE(parsed.get<std::string>("s") == s);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#include <pxp-agent/util/metrics.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace PXPAgent;
+using namespace Util::Metrics;
+
+namespace pcp_util = PCPClient::Util;
+
+TEST_CASE("Util::Metrics::Counter", "[util]") {
+    Counter counter {};
+
+    SECTION("starts from zero") {
+        REQUIRE(counter.value() == 0);
+    }
+
+    SECTION("sums the increments of all threads") {
+        std::vector<pcp_util::thread> threads {};
+        for (int i = 0; i < 8; i++)
+            threads.emplace_back([&counter]() {
+                for (int j = 0; j < 10000; j++)
+                    counter.add();
+            });
+        for (auto& thread : threads)
+            thread.join();
+        counter.add(5);
+
+        REQUIRE(counter.value() == 80005);
+    }
+}
+
+// Created before the tests run, possibly before the statics of metrics.cc
+static Histogram STATIC_HISTOGRAM {};
+
+TEST_CASE("Util::Metrics::Histogram", "[util]") {
+    Histogram histogram { { 1, 10 } };
+
+    SECTION("counts the values in cumulative buckets with inclusive bounds") {
+        for (auto value : { 0.5, 1.0, 2.0, 10.0, 50.0 })
+            histogram.observe(value);
+        auto snapshot = histogram.snapshot();
+
+        REQUIRE(snapshot.buckets == std::vector<uint64_t>({ 2, 4, 5 }));
+        REQUIRE(snapshot.count == 5);
+        REQUIRE(snapshot.sum == Approx(63.5));
+    }
+
+    SECTION("throws an Error if the bounds are not sorted") {
+        REQUIRE_THROWS_AS(Histogram({ 10, 1 }), Error);
+    }
+
+    SECTION("uses the duration buckets by default, even in static initializers") {
+        REQUIRE(STATIC_HISTOGRAM.snapshot().buckets.size()
+                == Histogram::durationBounds().size() + 1);
+    }
+}
+
+TEST_CASE("Util::Metrics::Registry", "[util]") {
+    auto& registry = Registry::Instance();
+
+    SECTION("returns the same counter for the same name and labels") {
+        auto& counter = registry.counter("test_registry_total", "Test", { { "a", "1" } });
+        REQUIRE(&counter == &registry.counter("test_registry_total", "Test", { { "a", "1" } }));
+        REQUIRE(&counter != &registry.counter("test_registry_total", "Test", { { "a", "2" } }));
+    }
+
+    SECTION("throws an Error if a metric is registered with another type") {
+        registry.counter("test_type_total", "Test");
+        REQUIRE_THROWS_AS(registry.histogram("test_type_total", "Test"), Error);
+    }
+
+    SECTION("samples the gauges until they are removed") {
+        double value { 3 };
+        registry.setGauge("test_gauge", "Test", [&value]() { return value; });
+        value = 4;
+
+        auto text = toPrometheusText(registry.collect());
+        REQUIRE(text.find("# TYPE test_gauge gauge\ntest_gauge 4\n") != std::string::npos);
+
+        registry.removeGauge("test_gauge");
+        REQUIRE(toPrometheusText(registry.collect()).find("test_gauge") == std::string::npos);
+    }
+
+    SECTION("samples the gauges without the registry locked") {
+        registry.setGauge("test_unlocked_gauge", "Test", [&registry]() {
+            registry.counter("test_unlocked_total", "Test").add();
+            return 1.0;
+        });
+
+        auto text = toPrometheusText(registry.collect());
+        REQUIRE(text.find("test_unlocked_gauge 1\n") != std::string::npos);
+        REQUIRE(registry.counter("test_unlocked_total", "Test").value() == 1);
+        registry.removeGauge("test_unlocked_gauge");
+    }
+
+    SECTION("renders the metrics in the Prometheus text format") {
+        registry.counter("test_text_total", "Requests \\ by module",
+                         { { "module", "a\"b" } }).add(2);
+        registry.histogram("test_text_seconds", "Durations", {}, { 0.5 }).observe(0.25);
+        auto text = toPrometheusText(registry.collect());
+
+        REQUIRE(text.find("# HELP test_text_total Requests \\\\ by module\n"
+                          "# TYPE test_text_total counter\n"
+                          "test_text_total{module=\"a\\\"b\"} 2\n") != std::string::npos);
+        REQUIRE(text.find("# TYPE test_text_seconds histogram\n"
+                          "test_text_seconds_bucket{le=\"0.5\"} 1\n"
+                          "test_text_seconds_bucket{le=\"+Inf\"} 1\n"
+                          "test_text_seconds_sum 0.25\n"
+                          "test_text_seconds_count 1\n") != std::string::npos);
+    }
+}
@@ -0,0 +1,154 @@
+#include <pxp-agent/util/module_params.hpp>
+#include <pxp-agent/module.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace lth_jc = leatherman::json_container;
+
+TEST_CASE("Util::TaskParams::decode", "[util]") {
+    SECTION("decodes the task metadata") {
+        lth_jc::JsonContainer params { R"({
+            "task": "test::multi",
+            "input": {"message": "hello"},
+            "metadata": {
+                "input_method": "stdin",
+                "features": ["foobar"],
+                "files": ["dir/"],
+                "implementations": [
+                    {"name": "multi.bat", "requirements": ["powershell"]},
+                    {"name": "multi", "files": ["file1.txt"], "input_method": "environment"}
+                ]
+            },
+            "files": [
+                {"filename": "multi", "sha256": "abc",
+                 "uri": {"path": "/files/multi", "params": {"environment": "production"}}}
+            ]
+        })" };
+
+        auto task_params = TaskParams::decode(params);
+        REQUIRE(task_params.task == "test::multi");
+        REQUIRE(task_params.input.get<std::string>("message") == "hello");
+        REQUIRE(task_params.input_method == "stdin");
+        REQUIRE(task_params.features == std::vector<std::string> { "foobar" });
+        REQUIRE(task_params.metadata_files == std::vector<std::string> { "dir/" });
+
+        REQUIRE(task_params.implementations.size() == 2u);
+        REQUIRE(task_params.implementations[0].requirements
+                == std::vector<std::string> { "powershell" });
+        REQUIRE(task_params.implementations[1].name == "multi");
+        REQUIRE(task_params.implementations[1].input_method == "environment");
+        REQUIRE(task_params.implementations[1].files
+                == std::vector<std::string> { "file1.txt" });
+
+        REQUIRE(task_params.files.size() == 1u);
+        REQUIRE(task_params.files[0].filename == "multi");
+        REQUIRE(task_params.files[0].sha256 == "abc");
+        REQUIRE(task_params.files[0].uri_path == "/files/multi");
+        REQUIRE(task_params.files[0].uri_params.size() == 1u);
+        REQUIRE(task_params.files[0].uri_params[0].first == "environment");
+        REQUIRE(task_params.files[0].uri_params[0].second == "production");
+    }
+
+    SECTION("takes the metadata from the params when there is no metadata entry") {
+        lth_jc::JsonContainer params { R"({
+            "task": "test::multi",
+            "input": {},
+            "input_method": "environment",
+            "files": [{"filename": "multi", "sha256": "abc"}]
+        })" };
+
+        auto task_params = TaskParams::decode(params);
+        REQUIRE(task_params.input_method == "environment");
+        REQUIRE(task_params.implementations.empty());
+        // The task files are not metadata files
+        REQUIRE(task_params.metadata_files.empty());
+    }
+
+    SECTION("throws a ProcessingError in case a required entry is missing") {
+        lth_jc::JsonContainer params { R"({"task": "test::multi", "files": []})" };
+        REQUIRE_THROWS_AS(TaskParams::decode(params), Module::ProcessingError);
+    }
+
+    SECTION("throws a ProcessingError in case an entry has the wrong type") {
+        lth_jc::JsonContainer params { R"({
+            "task": "test::multi",
+            "input": {},
+            "features": "foobar",
+            "files": []
+        })" };
+        REQUIRE_THROWS_AS(TaskParams::decode(params), Module::ProcessingError);
+    }
+
+    SECTION("throws a ProcessingError in case the metadata files are not strings") {
+        lth_jc::JsonContainer params { R"({
+            "task": "test::multi",
+            "input": {},
+            "metadata": {"files": [{"name": "dir/"}]},
+            "files": []
+        })" };
+        REQUIRE_THROWS_AS(TaskParams::decode(params), Module::ProcessingError);
+
+        lth_jc::JsonContainer metadata { R"({"files": "dir/"})" };
+        params.set<lth_jc::JsonContainer>("metadata", metadata);
+        REQUIRE_THROWS_AS(TaskParams::decode(params), Module::ProcessingError);
+    }
+
+    SECTION("throws a ProcessingError in case a file URI has no path") {
+        lth_jc::JsonContainer params { R"({
+            "task": "test::multi",
+            "input": {},
+            "files": [{"filename": "multi", "sha256": "abc",
+                       "uri": {"params": {"environment": "production"}}}]
+        })" };
+        REQUIRE_THROWS_AS(TaskParams::decode(params), Module::ProcessingError);
+    }
+}
+
+TEST_CASE("Util::FileParams::decode", "[util]") {
+    SECTION("decodes the file entries") {
+        lth_jc::JsonContainer params { R"({"files": [
+            {"uri": {"path": "/dl_files/file.txt", "params": {}}, "sha256": "abc",
+             "destination": "/tmp/file.txt", "link_source": "", "kind": "file"}
+        ]})" };
+
+        auto file_params = FileParams::decode(params);
+        REQUIRE(file_params.files.size() == 1u);
+        REQUIRE(file_params.files[0].destination == "/tmp/file.txt");
+        REQUIRE(file_params.files[0].kind == "file");
+        REQUIRE(file_params.files[0].source.uri_path == "/dl_files/file.txt");
+        REQUIRE(file_params.files[0].source.sha256 == "abc");
+    }
+
+    SECTION("throws a ProcessingError in case a URI param is not a string") {
+        lth_jc::JsonContainer params { R"({"files": [
+            {"uri": {"path": "/f", "params": {"environment": 1}}, "sha256": "abc",
+             "destination": "/tmp/file.txt", "kind": "file"}
+        ]})" };
+        REQUIRE_THROWS_AS(FileParams::decode(params), Module::ProcessingError);
+    }
+}
+
+TEST_CASE("Util::ApplyParams::decode", "[util]") {
+    SECTION("decodes the catalog environment") {
+        lth_jc::JsonContainer params {
+            R"({"catalog": {"environment": "production"}, "apply_options": {}})" };
+        REQUIRE(ApplyParams::decode(params).environment == "production");
+    }
+
+    SECTION("throws a ProcessingError in case the catalog has no environment") {
+        lth_jc::JsonContainer params { R"({"catalog": {}, "apply_options": {}})" };
+        REQUIRE_THROWS_AS(ApplyParams::decode(params), Module::ProcessingError);
+    }
+}
+
+TEST_CASE("Util::PrepParams::decode", "[util]") {
+    lth_jc::JsonContainer params { R"({"environment": "production"})" };
+    auto prep_params = PrepParams::decode(params);
+    REQUIRE(prep_params.environment == "production");
+    REQUIRE_FALSE(prep_params.refresh_facts);
+}
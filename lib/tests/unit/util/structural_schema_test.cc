@@ -0,0 +1,96 @@
+#include <pxp-agent/util/structural_schema.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace lth_jc = leatherman::json_container;
+
+using T_C = PCPClient::TypeConstraint;
+
+static StructuralSchema getApplySchema()
+{
+    StructuralSchema options { "options" };
+    options.addConstraint("noop", T_C::Bool);
+    options.addConstraint("timeout", T_C::Double);
+
+    StructuralSchema schema { "apply" };
+    schema.addConstraint("catalog", T_C::Object, true);
+    schema.addConstraint("apply_options", options, true);
+    schema.addConstraint("environment", T_C::String);
+    return schema;
+}
+
+TEST_CASE("StructuralSchema::validate", "[util]") {
+    auto schema = getApplySchema();
+
+    SECTION("accepts an object that satisfies the constraints") {
+        lth_jc::JsonContainer data {
+            R"({"catalog": {"resources": [1, 2]}, "apply_options": {"noop": true},
+                "environment": "production", "unconstrained": 1})" };
+        REQUIRE_NOTHROW(schema.validate(data));
+        REQUIRE(schema.matches(data));
+    }
+
+    SECTION("accepts an integer where a number is expected") {
+        lth_jc::JsonContainer data {
+            R"({"catalog": {}, "apply_options": {"timeout": 42}})" };
+        REQUIRE(schema.matches(data));
+    }
+
+    SECTION("rejects an object that misses a required entry") {
+        lth_jc::JsonContainer data { R"({"catalog": {}})" };
+        REQUIRE_THROWS_AS(schema.validate(data), PCPClient::validation_error);
+        REQUIRE_FALSE(schema.matches(data));
+    }
+
+    SECTION("rejects an entry of the wrong type") {
+        lth_jc::JsonContainer data {
+            R"({"catalog": [], "apply_options": {}})" };
+        REQUIRE_THROWS_AS(schema.validate(data), PCPClient::validation_error);
+    }
+
+    SECTION("rejects a nested entry of the wrong type") {
+        lth_jc::JsonContainer data {
+            R"({"catalog": {}, "apply_options": {"noop": "yes"}})" };
+        REQUIRE_THROWS_AS(schema.validate(data), PCPClient::validation_error);
+    }
+
+    SECTION("rejects data that is not an object") {
+        lth_jc::JsonContainer data { R"([1, 2])" };
+        REQUIRE_FALSE(schema.matches(data));
+    }
+
+    SECTION("validates the entry at the specified path") {
+        lth_jc::JsonContainer data {
+            R"({"request": {"catalog": {}, "apply_options": {}}, "other": 1})" };
+        REQUIRE_NOTHROW(schema.validate(data, { "request" }));
+        REQUIRE_THROWS_AS(schema.validate(data, { "other" }),
+                          PCPClient::validation_error);
+        REQUIRE_THROWS_AS(schema.validate(data, { "missing" }),
+                          PCPClient::validation_error);
+    }
+}
+
+TEST_CASE("StructuralSchema::toSchema", "[util]") {
+    auto schema = getApplySchema();
+    PCPClient::Validator validator {};
+    validator.registerSchema(schema.toSchema());
+
+    SECTION("returns a Schema with the same name and constraints") {
+        lth_jc::JsonContainer valid {
+            R"({"catalog": {}, "apply_options": {"noop": false}})" };
+        lth_jc::JsonContainer invalid {
+            R"({"catalog": {}, "apply_options": {"noop": 1}})" };
+
+        REQUIRE(validator.includesSchema("apply"));
+        REQUIRE_NOTHROW(validator.validate(valid, "apply"));
+        REQUIRE_THROWS_AS(validator.validate(invalid, "apply"),
+                          PCPClient::validation_error);
+    }
+}
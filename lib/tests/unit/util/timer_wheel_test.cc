@@ -0,0 +1,80 @@
+#include <pxp-agent/util/timer_wheel.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <vector>
+
+using namespace PXPAgent;
+using namespace Util;
+
+namespace pcp_util = PCPClient::Util;
+
+static void waitFor(const std::atomic<int>& counter, int value)
+{
+    for (int i = 0; i < 200 && counter < value; i++)
+        pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+}
+
+TEST_CASE("TimerWheel", "[util]") {
+    TimerWheel wheel { pcp_util::chrono::milliseconds(5), 8 };
+    std::atomic<int> fired { 0 };
+
+    SECTION("executes a timer after its delay") {
+        auto start = pcp_util::chrono::steady_clock::now();
+        wheel.schedule(pcp_util::chrono::milliseconds(20), [&fired] { fired++; });
+        REQUIRE(wheel.pending() == 1u);
+
+        waitFor(fired, 1);
+        REQUIRE(fired == 1);
+        REQUIRE(pcp_util::chrono::steady_clock::now() - start
+                >= pcp_util::chrono::milliseconds(20));
+        REQUIRE(wheel.pending() == 0u);
+    }
+
+    SECTION("executes timers whose delay exceeds a round of the wheel") {
+        // 8 slots of 5 ms; the timer wraps around the wheel several times
+        auto start = pcp_util::chrono::steady_clock::now();
+        wheel.schedule(pcp_util::chrono::milliseconds(130), [&fired] { fired++; });
+
+        waitFor(fired, 1);
+        REQUIRE(fired == 1);
+        REQUIRE(pcp_util::chrono::steady_clock::now() - start
+                >= pcp_util::chrono::milliseconds(130));
+    }
+
+    SECTION("executes all the timers scheduled in the same slot") {
+        for (int i = 0; i < 10; i++)
+            wheel.schedule(pcp_util::chrono::milliseconds(10), [&fired] { fired++; });
+
+        waitFor(fired, 10);
+        REQUIRE(fired == 10);
+    }
+
+    SECTION("does not execute cancelled timers") {
+        auto timer_id = wheel.schedule(pcp_util::chrono::milliseconds(20),
+                                       [&fired] { fired++; });
+        wheel.schedule(pcp_util::chrono::milliseconds(40), [&fired] { fired += 10; });
+        REQUIRE(wheel.cancel(timer_id));
+        REQUIRE(wheel.pending() == 1u);
+
+        waitFor(fired, 10);
+        REQUIRE(fired == 10);
+
+        SECTION("cannot cancel a timer twice") {
+            REQUIRE_FALSE(wheel.cancel(timer_id));
+        }
+    }
+
+    SECTION("survives callbacks that throw") {
+        wheel.schedule(pcp_util::chrono::milliseconds(5),
+                       [] { throw std::runtime_error("boom"); });
+        wheel.schedule(pcp_util::chrono::milliseconds(15), [&fired] { fired++; });
+
+        waitFor(fired, 1);
+        REQUIRE(fired == 1);
+    }
+}
@@ -0,0 +1,111 @@
+#include <pxp-agent/util/trace.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace PXPAgent;
+using namespace Util::Trace;
+
+namespace pcp_util = PCPClient::Util;
+
+static size_t countEvents(const std::string& trace) {
+    size_t count { 0 };
+    for (auto pos = trace.find("\"ph\":\"X\""); pos != std::string::npos;
+            pos = trace.find("\"ph\":\"X\"", pos + 1))
+        count++;
+    return count;
+}
+
+TEST_CASE("Util::Trace::Tracer", "[util]") {
+    SECTION("rounds the capacity up to a power of 2") {
+        REQUIRE(Tracer(5).capacity() == 8);
+        REQUIRE(Tracer(8).capacity() == 8);
+    }
+
+    SECTION("exports no events if no span was recorded") {
+        REQUIRE(Tracer(4).toChromeTrace()
+                == "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}");
+    }
+
+    SECTION("exports the spans as complete events") {
+        Tracer tracer { 4 };
+        tracer.record("validate", "a\"b", 100, 142);
+        auto trace = tracer.toChromeTrace();
+
+        REQUIRE(trace.find("{\"name\":\"validate\",\"cat\":\"pxp-agent\",\"ph\":\"X\","
+                           "\"ts\":100,\"dur\":42,\"pid\":1,\"tid\":")
+                != std::string::npos);
+        REQUIRE(trace.find("\"args\":{\"transaction_id\":\"a\\\"b\"}}") != std::string::npos);
+    }
+
+    SECTION("truncates long transaction IDs") {
+        Tracer tracer { 4 };
+        tracer.record("parse", std::string(100, 'x'), 0, 1);
+        REQUIRE(tracer.toChromeTrace().find("\"" + std::string(48, 'x') + "\"")
+                != std::string::npos);
+    }
+
+    SECTION("keeps the most recent spans") {
+        Tracer tracer { 4 };
+        for (int i = 0; i < 10; i++)
+            tracer.record("send", std::to_string(i), i, i + 1);
+        auto trace = tracer.toChromeTrace();
+
+        REQUIRE(countEvents(trace) == 4);
+        REQUIRE(trace.find("\"transaction_id\":\"5\"") == std::string::npos);
+        REQUIRE(trace.find("\"transaction_id\":\"6\"") != std::string::npos);
+        REQUIRE(trace.find("\"transaction_id\":\"9\"") != std::string::npos);
+    }
+
+    SECTION("records the spans of concurrent threads") {
+        Tracer tracer { 1024 };
+        std::vector<pcp_util::thread> threads {};
+        for (int i = 0; i < 4; i++)
+            threads.emplace_back([&tracer]() {
+                for (int j = 0; j < 5000; j++)
+                    tracer.record("child_run", "transaction", j, j + 1);
+            });
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(countEvents(tracer.toChromeTrace()) + tracer.numDropped() >= 1024);
+        REQUIRE(countEvents(tracer.toChromeTrace()) <= 1024);
+    }
+}
+
+TEST_CASE("Util::Trace::Span", "[util]") {
+    // Tracing can't be disabled once enabled
+    enable(16);
+
+    SECTION("records the span once") {
+        std::string transaction_id { "test-span-once" };
+        {
+            Span span { "validate", transaction_id };
+            span.end();
+        }
+        auto trace = toChromeTrace();
+        auto event = trace.find("\"transaction_id\":\"test-span-once\"");
+
+        REQUIRE(event != std::string::npos);
+        REQUIRE(trace.find("\"transaction_id\":\"test-span-once\"", event + 1)
+                == std::string::npos);
+    }
+
+    SECTION("records the spawn and the run of a child process") {
+        std::string transaction_id { "test-child-spans" };
+        size_t child_pid { 0 };
+        {
+            ChildSpans child_spans { transaction_id };
+            child_spans.spawning([&child_pid](size_t pid) { child_pid = pid; })(42);
+        }
+        auto trace = toChromeTrace();
+
+        REQUIRE(child_pid == 42);
+        REQUIRE(trace.find("\"name\":\"child_spawn\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"child_run\"") != std::string::npos);
+    }
+}
@@ -0,0 +1,109 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/util/trash_dir.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <iterator>
+
+using namespace PXPAgent;
+
+namespace fs = boost::filesystem;
+namespace pcp_util = PCPClient::Util;
+
+static const fs::path TEST_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                 + "/lib/tests/resources/test_trash" };
+
+static void createDirWithFiles(const fs::path& dir, int num_files) {
+    fs::create_directories(dir / "nested");
+    for (int i = 0; i < num_files; i++)
+        fs::ofstream { dir / "nested" / std::to_string(i) } << i;
+}
+
+// Wait up to 5 s for the removal thread
+static bool waitUntilEmpty(const fs::path& dir) {
+    for (int i = 0; i < 500; i++) {
+        if (fs::is_empty(dir))
+            return true;
+        pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+TEST_CASE("Util::TrashDir", "[util]") {
+    fs::remove_all(TEST_DIR);
+    fs::create_directories(TEST_DIR);
+    auto trash_path = TEST_DIR / ".trash";
+
+    SECTION("moves a directory into the trash") {
+        Util::TrashDir trash { trash_path };
+        createDirWithFiles(TEST_DIR / "cached", 3);
+        trash.moveToTrash(TEST_DIR / "cached");
+
+        REQUIRE_FALSE(fs::exists(TEST_DIR / "cached"));
+        REQUIRE(fs::exists(trash_path));
+        REQUIRE_FALSE(fs::is_empty(trash_path));
+    }
+
+    SECTION("can trash the same name twice") {
+        Util::TrashDir trash { trash_path };
+        createDirWithFiles(TEST_DIR / "cached", 1);
+        trash.moveToTrash(TEST_DIR / "cached");
+        createDirWithFiles(TEST_DIR / "cached", 1);
+
+        REQUIRE_NOTHROW(trash.moveToTrash(TEST_DIR / "cached"));
+    }
+
+    SECTION("can trash the same name as a previous instance") {
+        {
+            Util::TrashDir trash { trash_path };
+            createDirWithFiles(TEST_DIR / "cached", 1);
+            trash.moveToTrash(TEST_DIR / "cached");
+        }
+
+        Util::TrashDir trash { trash_path };
+        createDirWithFiles(TEST_DIR / "cached", 1);
+        REQUIRE_NOTHROW(trash.moveToTrash(TEST_DIR / "cached"));
+        REQUIRE_FALSE(fs::exists(TEST_DIR / "cached"));
+        REQUIRE(std::distance(fs::directory_iterator { trash_path },
+                              fs::directory_iterator {}) == 2);
+    }
+
+    SECTION("throws an Error if the path does not exist") {
+        Util::TrashDir trash { trash_path };
+
+        REQUIRE_THROWS_AS(trash.moveToTrash(TEST_DIR / "missing"),
+                          Util::TrashDir::Error);
+    }
+
+    SECTION("removes the content of the trash in the background") {
+        Util::TrashDir trash { trash_path, 100000 };
+        createDirWithFiles(TEST_DIR / "first", 250);
+        createDirWithFiles(TEST_DIR / "second", 5);
+        trash.moveToTrash(TEST_DIR / "first");
+        trash.moveToTrash(TEST_DIR / "second");
+        trash.empty();
+
+        REQUIRE(waitUntilEmpty(trash_path));
+    }
+
+    SECTION("removes what was left in the trash by a previous instance") {
+        {
+            Util::TrashDir trash { trash_path };
+            createDirWithFiles(TEST_DIR / "cached", 3);
+            trash.moveToTrash(TEST_DIR / "cached");
+        }
+        Util::TrashDir trash { trash_path };
+        trash.empty();
+
+        REQUIRE(waitUntilEmpty(trash_path));
+    }
+
+    fs::remove_all(TEST_DIR);
+}
@@ -0,0 +1,79 @@
+#include <pxp-agent/util/utf8.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace PXPAgent;
+using namespace Util;
+
+static std::vector<UTF8Validator> supportedValidators()
+{
+    std::vector<UTF8Validator> validators {};
+    for (auto validator : { UTF8Validator::Scalar, UTF8Validator::SSE4, UTF8Validator::AVX2 })
+        if (supportsUTF8Validator(validator))
+            validators.push_back(validator);
+    return validators;
+}
+
+// Check the string at every offset of a block, so that multibyte
+// sequences straddle the block boundaries of the vectorised validators
+static bool isValidAtAllOffsets(const std::string& s, UTF8Validator validator)
+{
+    bool valid = isValidUTF8(s.data(), s.size(), validator);
+    for (size_t offset = 1; offset <= 64; offset++) {
+        std::string padded = std::string(offset, 'a') + s + std::string(offset % 7, 'b');
+        REQUIRE(isValidUTF8(padded.data(), padded.size(), validator) == valid);
+    }
+    return valid;
+}
+
+TEST_CASE("isValidUTF8", "[util]") {
+    SECTION("the scalar validator is always supported") {
+        REQUIRE(supportsUTF8Validator(UTF8Validator::Scalar));
+    }
+
+    for (auto validator : supportedValidators()) {
+        SECTION("accepts valid input with validator "
+                + std::to_string(static_cast<int>(validator))) {
+            for (const std::string s : {
+                    "",
+                    "plain ASCII output",
+                    "\xc2\x80\xdf\xbf",              // U+0080, U+07FF
+                    "\xe0\xa0\x80\xef\xbf\xbf",      // U+0800, U+FFFF
+                    "\xed\x9f\xbf\xee\x80\x80",      // around the surrogates
+                    "\xf0\x90\x80\x80\xf4\x8f\xbf\xbf",  // U+10000, U+10FFFF
+                    "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80" }) {
+                REQUIRE(isValidAtAllOffsets(s, validator));
+            }
+        }
+
+        SECTION("rejects invalid input with validator "
+                + std::to_string(static_cast<int>(validator))) {
+            for (const std::string s : {
+                    "\x80",                      // lone continuation
+                    "\xc2",                      // truncated sequences
+                    "\xe2\x82",
+                    "\xf0\x9f\x98",
+                    "\xc2\x41",                  // lead followed by ASCII
+                    "\xc0\x80", "\xc1\xbf",      // overlong
+                    "\xe0\x80\x80", "\xe0\x9f\xbf",
+                    "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf",
+                    "\xed\xa0\x80", "\xed\xbf\xbf",  // surrogates
+                    "\xf4\x90\x80\x80",          // above U+10FFFF
+                    "\xf5\x80\x80\x80",
+                    "\xff", "\xfe",
+                    "\xe2\x82\xac\x80" }) {      // extra continuation
+                REQUIRE_FALSE(isValidAtAllOffsets(s, validator));
+            }
+        }
+    }
+
+    SECTION("does not modify the data") {
+        const std::string original { "caf\xc3\xa9 \xe2\x82\xac" };
+        std::string s { original };
+        REQUIRE(isValidUTF8(s));
+        REQUIRE(s == original);
+    }
+}
@@ -0,0 +1,149 @@
+#include <pxp-agent/util/watchdog.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <catch.hpp>
+
+#include <signal.h>
+
+using namespace PXPAgent;
+using namespace Util::Watchdog;
+
+namespace pcp_util = PCPClient::Util;
+
+// Executors live as long as the process; each test uses its own
+TEST_CASE("Util::Watchdog::Executor::recordLag", "[util]") {
+    auto& executor = Util::Watchdog::executor("test_lag");
+    auto now = pcp_util::chrono::steady_clock::now();
+
+    SECTION("doesn't count stalls if the watchdog is disabled") {
+        executor.recordLag(now - pcp_util::chrono::seconds(10));
+        REQUIRE(executor.numStalls() == 0);
+    }
+
+    SECTION("counts the units of work that started late") {
+        enable(100);
+        executor.recordLag(now);
+        REQUIRE(executor.numStalls() == 0);
+        executor.recordLag(now - pcp_util::chrono::seconds(10));
+        REQUIRE(executor.numStalls() == 1);
+        disable();
+    }
+}
+
+TEST_CASE("Util::Watchdog::Busy", "[util]") {
+    SECTION("doesn't track the executor if the watchdog is disabled") {
+        auto& executor = Util::Watchdog::executor("test_disabled");
+        {
+            Busy busy { executor };
+            pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(50));
+            checkExecutors();
+        }
+        REQUIRE(executor.numStalls() == 0);
+    }
+
+    SECTION("reports a unit of work longer than the threshold once") {
+        auto& executor = Util::Watchdog::executor("test_stall");
+        enable(20);
+        {
+            Busy busy { executor };
+            pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(200));
+        }
+        disable();
+        REQUIRE(executor.numStalls() == 1);
+    }
+
+    SECTION("doesn't report the time spent waiting") {
+        auto& executor = Util::Watchdog::executor("test_waiting");
+        enable(100);
+        {
+            Busy busy { executor };
+            {
+                Waiting waiting { executor };
+                pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(300));
+                checkExecutors();
+            }
+            checkExecutors();
+        }
+        disable();
+        REQUIRE(executor.numStalls() == 0);
+    }
+
+    SECTION("doesn't report units of work shorter than the threshold") {
+        auto& executor = Util::Watchdog::executor("test_no_stall");
+        enable(1000);
+        for (int i = 0; i < 10; i++) {
+            Busy busy { executor };
+            checkExecutors();
+        }
+        disable();
+        REQUIRE(executor.numStalls() == 0);
+    }
+}
+
+#if defined(__GLIBC__) || defined(__sun)
+TEST_CASE("Util::Watchdog::requestStackSample", "[util]") {
+    installStackSampler();
+
+    // The thread blocks signals until it's told to unblock them, so
+    // that the sample is taken after its collection timed out
+    pcp_util::mutex mutex;
+    pcp_util::condition_variable cond_var;
+    ThreadHandle handle {};
+    bool started { false };
+    bool unblock { false };
+    bool stop { false };
+
+    pcp_util::thread sampled { [&] {
+        sigset_t all_signals;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_BLOCK, &all_signals, nullptr);
+
+        pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex };
+        handle = currentThread();
+        started = true;
+        cond_var.notify_all();
+        cond_var.wait(the_lock, [&] { return unblock; });
+        pthread_sigmask(SIG_UNBLOCK, &all_signals, nullptr);
+        cond_var.wait(the_lock, [&] { return stop; });
+    } };
+
+    {
+        pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex };
+        cond_var.wait(the_lock, [&] { return started; });
+    }
+
+    REQUIRE(requestStackSample(handle));
+    REQUIRE(collectStackSample().empty());
+
+    SECTION("doesn't request a sample while the last one is pending") {
+        REQUIRE_FALSE(requestStackSample(handle));
+    }
+
+    SECTION("requests samples again once the late one is taken") {
+        {
+            pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex };
+            unblock = true;
+            cond_var.notify_all();
+        }
+
+        bool requested { false };
+        for (int i = 0; !requested && i < 100; i++) {
+            requested = requestStackSample(handle);
+            if (!requested)
+                pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+        }
+        REQUIRE(requested);
+        REQUIRE_FALSE(collectStackSample().empty());
+    }
+
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex };
+        unblock = true;
+        stop = true;
+        cond_var.notify_all();
+    }
+    sampled.join();
+}
+#endif